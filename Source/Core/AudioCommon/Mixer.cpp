@@ -13,6 +13,7 @@
 #include "Common/MathUtil.h"
 #include "Common/Swap.h"
 #include "Core/ConfigManager.h"
+#include "Core/Rollback.h"
 
 Mixer::Mixer(unsigned int BackendSampleRate)
     : m_sampleRate(BackendSampleRate), m_stretcher(BackendSampleRate)
@@ -206,6 +207,9 @@ void Mixer::MixerFifo::PushSamples(const short* samples, unsigned int num_sample
 
 void Mixer::PushSamples(const short* samples, unsigned int num_samples)
 {
+  // The frames run again after a NetPlay rollback were already heard
+  if (Rollback::IsResimulating())
+    return;
   m_dma_mixer.PushSamples(samples, num_samples);
   int sample_rate = m_dma_mixer.GetInputSampleRate();
   if (m_log_dsp_audio)
@@ -214,6 +218,8 @@ void Mixer::PushSamples(const short* samples, unsigned int num_samples)
 
 void Mixer::PushStreamingSamples(const short* samples, unsigned int num_samples)
 {
+  if (Rollback::IsResimulating())
+    return;
   m_streaming_mixer.PushSamples(samples, num_samples);
   int sample_rate = m_streaming_mixer.GetInputSampleRate();
   if (m_log_dtk_audio)
@@ -225,7 +231,7 @@ void Mixer::PushWiimoteSpeakerSamples(const short* samples, unsigned int num_sam
 {
   short samples_stereo[MAX_SAMPLES * 2];
 
-  if (num_samples < MAX_SAMPLES)
+  if (num_samples < MAX_SAMPLES && !Rollback::IsResimulating())
   {
     m_wiimote_speaker_mixer.SetInputSampleRate(sample_rate);
 
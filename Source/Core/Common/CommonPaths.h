@@ -56,6 +56,9 @@
 #define CACHE_DIR "Cache"
 #define SHADERCACHE_DIR "Shaders"
 #define SHADERUIDCACHE_DIR  "ShadersUIDS"
+#define SCALEDTEXTURES_DIR "ScaledTextures"
+#define VERTEXLOADERS_DIR "VertexLoaders"
+#define HIRESTEXTURES_USAGE_DIR "HiresTextureUsage"
 #define STATESAVES_DIR "StateSaves"
 #define SCREENSHOTS_DIR "ScreenShots"
 #define OPENCL_DIR			 "OpenCL"
@@ -117,6 +120,7 @@
 // Files in the directory returned by GetUserPath(D_MEMORYWATCHER_IDX)
 #define MEMORYWATCHER_LOCATIONS "Locations.txt"
 #define MEMORYWATCHER_SOCKET "MemoryWatcher"
+#define MEMORYWATCHER_SHARED_MEMORY "SharedMemory"
 
 // Sys files
 #define TOTALDB "totaldb.dsy"
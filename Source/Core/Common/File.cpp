@@ -8,10 +8,14 @@
 
 #ifdef _WIN32
 #include <io.h>
+#include <windows.h>
 
 #include "Common/CommonFuncs.h"
 #include "Common/StringUtil.h"
 #else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #endif
 
@@ -130,4 +134,83 @@ bool IOFile::Resize(u64 size)
   return m_good;
 }
 
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+bool MappedFile::Open(const std::string& filename, u64 size)
+{
+  Close();
+#ifdef _WIN32
+  // Others may write to the file, the cache files are appended to while they are mapped
+  HANDLE file = CreateFile(UTF8ToTStr(filename).c_str(), GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0 ||
+      static_cast<u64>(file_size.QuadPart) < size)
+  {
+    CloseHandle(file);
+    return false;
+  }
+  if (size == 0)
+    size = file_size.QuadPart;
+
+  m_mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, static_cast<DWORD>(size >> 32),
+                                static_cast<DWORD>(size), nullptr);
+  CloseHandle(file);
+  if (!m_mapping)
+    return false;
+
+  m_data = static_cast<const u8*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, size));
+  if (!m_data)
+  {
+    CloseHandle(m_mapping);
+    m_mapping = nullptr;
+    return false;
+  }
+#else
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat file_info;
+  if (fstat(fd, &file_info) != 0 || file_info.st_size == 0 ||
+      static_cast<u64>(file_info.st_size) < size)
+  {
+    close(fd);
+    return false;
+  }
+  if (size == 0)
+    size = file_info.st_size;
+
+  void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+  m_data = static_cast<const u8*>(data);
+#endif
+  m_size = size;
+  return true;
+}
+
+void MappedFile::Close()
+{
+  if (!m_data)
+    return;
+#ifdef _WIN32
+  UnmapViewOfFile(m_data);
+  CloseHandle(m_mapping);
+  m_mapping = nullptr;
+#else
+  munmap(const_cast<u8*>(m_data), m_size);
+#endif
+  m_data = nullptr;
+  m_size = 0;
+}
+
 }  // namespace File
@@ -92,4 +92,31 @@ private:
   bool m_good;
 };
 
+// Read-only view of the start of a file. The file may grow while it is mapped, but it must not
+// shrink below the mapped size.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Maps the first size bytes, or the whole file when size is 0
+  bool Open(const std::string& filename, u64 size = 0);
+  void Close();
+
+  bool IsOpen() const { return m_data != nullptr; }
+  const u8* GetData() const { return m_data; }
+  u64 GetSize() const { return m_size; }
+
+private:
+  const u8* m_data = nullptr;
+  u64 m_size = 0;
+#ifdef _WIN32
+  void* m_mapping = nullptr;
+#endif
+};
+
 }  // namespace File
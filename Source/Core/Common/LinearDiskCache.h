@@ -4,27 +4,37 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
-#include <fstream>
+#include <memory>
 #include <string>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "Common/CommonTypes.h"
+#include "Common/File.h"
 #include "Common/FileUtil.h"
+#include "Common/Hash.h"
 #include "Common/Version.h"
 
 // On disk format:
 // header{
-// u32 'DCAC';
-// u32 version;  // svn_rev
+// u32 'DCIX';
 // u16 sizeof(key_type);
 // u16 sizeof(value_type);
+// char version[40];  // scm_rev_cache_str
 //}
 
-// key_value_pair{
+// record{  // 8 byte aligned
+// u32 'DREC';
 // u32 value_size;
-// key_type   key;
-// value_type[value_size]   value;
+// u64 checksum;  // of the key and the value
+// key_type   key;  // padded to 8 bytes
+// value_type[value_size]   value;  // padded to 8 bytes
 //}
 
 template <typename K, typename V>
@@ -34,147 +44,371 @@ public:
   virtual void Read(const K& key, const V* value, u32 value_size) = 0;
 };
 
-// Dead simple unsorted key-value store with append functionality.
-// No random read functionality, all reading is done in OpenAndRead.
+// Keys are compared as the bytes stored in the file
+template <typename K>
+struct LinearDiskCacheKeyHasher
+{
+  size_t operator()(const K& key) const
+  {
+    return static_cast<size_t>(GetMurmurHash3(reinterpret_cast<const u8*>(&key), sizeof(K), 0));
+  }
+};
+
+template <typename K>
+struct LinearDiskCacheKeyEqual
+{
+  bool operator()(const K& a, const K& b) const { return std::memcmp(&a, &b, sizeof(K)) == 0; }
+};
+
+// Unsorted key-value store with append functionality.
 // Keys and values can contain any characters, including \0.
 //
 // Suitable for caching generated shader bytecode between executions.
-// Not tuned for extreme performance but should be reasonably fast.
+// Opening the file maps it and indexes the keys without reading the values, which are only
+// touched when they are looked up (or all passed to a reader by OpenAndRead).
+// A record is only used if it is complete: what a crash leaves in the middle of an append is
+// cut off on open, and the checksum of a record is checked the first time its value is read.
+// A key may be appended several times, the last value wins. When the older values take a good
+// part of the file, the live records are copied to a new file in the background, which
+// replaces the cache on Close.
 // Does not support keys or values larger than 2GB, which should be reasonable.
 // Keys must have non-zero length; values can have zero length.
 
 // K and V are some POD type
 // K : the key type
 // V : value array type
-template <typename K, typename V>
+template <typename K, typename V, typename KeyHasher = LinearDiskCacheKeyHasher<K>,
+          typename KeyEqual = LinearDiskCacheKeyEqual<K>>
 class LinearDiskCache
 {
 public:
-  // return number of read entries
-  u32 OpenAndRead(const std::string& filename, LinearDiskCacheReader<K, V>& reader, std::string version = {})
-  {
-    using std::ios_base;
+  LinearDiskCache() = default;
+  ~LinearDiskCache() { Close(); }
+
+  LinearDiskCache(const LinearDiskCache&) = delete;
+  LinearDiskCache& operator=(const LinearDiskCache&) = delete;
 
-// Since we're reading/writing directly to the storage of K instances,
-// K must be trivially copyable. TODO: Remove #if once GCC 5.0 is a
-// minimum requirement.
-#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 5
-    static_assert(std::has_trivial_copy_constructor<K>::value,
-                  "K must be a trivially copyable type");
-#else
+  // Indexes the file, creating it if it is missing or was written by another version.
+  // Returns the number of keys.
+  u32 Open(const std::string& filename, const std::string& version = {})
+  {
+    // Since we're reading/writing directly to the storage of K instances,
+    // K must be trivially copyable.
     static_assert(std::is_trivially_copyable<K>::value, "K must be a trivially copyable type");
-#endif
+    static_assert(std::is_trivially_copyable<V>::value, "V must be a trivially copyable type");
+    static_assert(alignof(V) <= RECORD_ALIGNMENT, "V can't be aligned in the mapped file");
 
     // close any currently opened file
     Close();
-    m_num_entries = 0;
+    m_filename = filename;
+    if (version.empty())
+      m_header.Init();
+    else
+      m_header.Init(version);
 
-    // try opening for reading/writing
-    File::OpenFStream(m_file, filename, ios_base::in | ios_base::out | ios_base::binary);
+    // Left by a compaction that didn't finish
+    if (File::Exists(GetCompactFilename()))
+      File::Delete(GetCompactFilename());
 
-    m_file.seekg(0, std::ios::end);
-    std::fstream::pos_type end_pos = m_file.tellg();
-    m_file.seekg(0, std::ios::beg);
-    std::fstream::pos_type start_pos = m_file.tellg();
-    std::streamoff file_size = end_pos - start_pos;
-    if (version.empty())
+    u64 valid_end = 0;
+    if (m_map.Open(filename) && m_map.GetSize() >= sizeof(Header) &&
+        std::memcmp(m_map.GetData(), &m_header, sizeof(Header)) == 0)
     {
-      m_header.Init();
+      valid_end = BuildIndex();
     }
-    else
+
+    if (valid_end == 0)
     {
-      m_header.Init(version);
+      // failed to open file for reading or bad header
+      // close and recreate file
+      Close();
+      m_filename = filename;
+      if (m_file.Open(filename, "wb"))
+      {
+        m_file.WriteBytes(&m_header, sizeof(Header));
+        m_file.Flush();
+      }
+      return 0;
     }
-    if (m_file.is_open() && ValidateHeader())
+
+    if (valid_end < m_map.GetSize())
     {
-      // good header, read some key/value pairs
-      K key;
+      // Cut off the incomplete record, the mapping can't extend past the end of the file
+      m_map.Close();
+      bool truncated = false;
+      {
+        File::IOFile file(filename, "r+b");
+        truncated = file.Resize(valid_end);
+      }
+      if (!truncated || !m_map.Open(filename, valid_end))
+      {
+        ClearIndex();
+        m_map.Close();
+        m_file.Open(filename, "wb");
+        m_file.WriteBytes(&m_header, sizeof(Header));
+        m_file.Flush();
+        return 0;
+      }
+    }
 
-      V* value = nullptr;
-      u32 value_size = 0;
-      u32 entry_number = 0;
+    m_file.Open(filename, "ab");
+    StartCompaction();
+    return static_cast<u32>(m_index.size());
+  }
 
-      std::fstream::pos_type last_pos = m_file.tellg();
+  // return number of read entries
+  u32 OpenAndRead(const std::string& filename, LinearDiskCacheReader<K, V>& reader,
+                  std::string version = {})
+  {
+    Open(filename, version);
+    return ForEach(reader);
+  }
 
-      while (Read(&value_size))
+  // Passes the latest value of each key to the reader, in the order they were appended.
+  // Returns the number of values read.
+  u32 ForEach(LinearDiskCacheReader<K, V>& reader)
+  {
+    u32 count = 0;
+    // The reader may append
+    for (size_t i = 0; i < m_entries.size(); i++)
+    {
+      if (!m_entries[i].live)
+        continue;
+      const K key = m_entries[i].key;
+      const u32 value_size = m_entries[i].value_size;
+      if (const V* value = GetValue(m_entries[i]))
       {
-        std::streamoff next_extent = (last_pos - start_pos) + sizeof(value_size) + value_size;
-        if (next_extent > file_size)
-          break;
-
-        delete[] value;
-        value = new V[value_size];
-
-        // read key/value and pass to reader
-        if (Read(&key) && Read(value, value_size) && Read(&entry_number) &&
-            entry_number == m_num_entries + 1)
-        {
-          reader.Read(key, value, value_size);
-        }
-        else
-        {
-          break;
-        }
-
-        m_num_entries++;
-        last_pos = m_file.tellg();
+        reader.Read(key, value, value_size);
+        count++;
       }
-      m_file.seekp(last_pos);
-      m_file.clear();
-
-      delete[] value;
-      return m_num_entries;
     }
+    return count;
+  }
 
-    // failed to open file for reading or bad header
-    // close and recreate file
-    Close();
-    m_file.open(filename, ios_base::out | ios_base::trunc | ios_base::binary);
-    WriteHeader();
-    return 0;
+  bool Contains(const K& key) const { return m_index.find(key) != m_index.end(); }
+  // The value stays valid until the cache is closed. Returns nullptr if the key is missing or
+  // its record is corrupt.
+  const V* Lookup(const K& key, u32* value_size)
+  {
+    auto it = m_index.find(key);
+    if (it == m_index.end())
+      return nullptr;
+    Entry& entry = m_entries[it->second];
+    const V* value = GetValue(entry);
+    if (value)
+      *value_size = entry.value_size;
+    return value;
   }
 
-  void Sync() { m_file.flush(); }
+  u32 GetEntryCount() const { return static_cast<u32>(m_index.size()); }
+
+  void Sync() { m_file.Flush(); }
   void Close()
   {
-    if (m_file.is_open())
-      m_file.close();
-    // clear any error flags
-    m_file.clear();
+    if (m_compaction.joinable())
+    {
+      m_compaction.join();
+      if (m_compaction_succeeded)
+        FinishCompaction();
+      else
+        File::Delete(GetCompactFilename());
+    }
+    m_file.Close();
+    m_map.Close();
+    ClearIndex();
   }
 
   // Appends a key-value pair to the store.
   void Append(const K& key, const V* value, u32 value_size)
   {
-    // TODO: Should do a check that we don't already have "key"? (I think each caller does that
-    // already.)
-    Write(&value_size);
-    Write(&key);
-    Write(value, value_size);
-    m_num_entries++;
-    Write(&m_num_entries);
+    if (!m_file.IsOpen())
+      return;
+
+    // Values appended after the file was mapped are kept in memory for Lookup
+    std::unique_ptr<V[]> copy(new V[std::max(value_size, 1u)]);
+    std::copy(value, value + value_size, copy.get());
+    // Flushed whole, a crash can only leave an incomplete last record
+    WriteRecord(m_file, key, copy.get(), value_size);
+    m_file.Flush();
+    AddEntry(key, 0, value_size, copy.get());
+    m_appended.push_back(std::move(copy));
   }
 
 private:
-  void WriteHeader() { Write(&m_header); }
-  bool ValidateHeader()
+  static constexpr u64 RECORD_ALIGNMENT = 8;
+  static constexpr u32 RECORD_MARKER = 0x43455244;  // 'DREC'
+  // Compact when the stale records take a quarter of the file, and at least that much
+  static constexpr u64 MIN_COMPACTION_BYTES = 256 * 1024;
+
+  struct RecordHeader
   {
-    char file_header[sizeof(Header)];
+    u32 marker;
+    u32 value_size;
+    u64 checksum;
+  };
 
-    return (Read(file_header, sizeof(Header)) &&
-            !memcmp((const char*)&m_header, file_header, sizeof(Header)));
+  static constexpr u64 KEY_OFFSET = sizeof(RecordHeader);
+  static constexpr u64 VALUE_OFFSET =
+      KEY_OFFSET + (sizeof(K) + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+
+  enum class RecordState : u8
+  {
+    Unchecked,
+    Good,
+    Bad,
+  };
+
+  struct Entry
+  {
+    K key;
+    u32 value_size;
+    // Offset of the record in the mapping, when the value was not appended since Open
+    u64 offset;
+    const V* appended;
+    RecordState state;
+    bool live;
+  };
+
+  static u64 GetRecordSize(u32 value_size)
+  {
+    const u64 value_bytes = static_cast<u64>(value_size) * sizeof(V);
+    return VALUE_OFFSET + (value_bytes + RECORD_ALIGNMENT - 1) / RECORD_ALIGNMENT * RECORD_ALIGNMENT;
+  }
+
+  static u64 GetChecksum(const K& key, const V* value, u32 value_size)
+  {
+    const u64 key_hash = GetMurmurHash3(reinterpret_cast<const u8*>(&key), sizeof(K), 0);
+    const u64 value_hash = GetMurmurHash3(reinterpret_cast<const u8*>(value),
+                                          static_cast<u32>(value_size * sizeof(V)), 0);
+    return key_hash * 31 + value_hash;
+  }
+
+  static bool WriteRecord(File::IOFile& file, const K& key, const V* value, u32 value_size)
+  {
+    static const u8 padding[RECORD_ALIGNMENT] = {};
+    const RecordHeader header = {RECORD_MARKER, value_size, GetChecksum(key, value, value_size)};
+    const u64 value_bytes = static_cast<u64>(value_size) * sizeof(V);
+    return file.WriteBytes(&header, sizeof(header)) && file.WriteBytes(&key, sizeof(K)) &&
+           file.WriteBytes(padding, VALUE_OFFSET - KEY_OFFSET - sizeof(K)) &&
+           file.WriteBytes(value, value_bytes) &&
+           file.WriteBytes(padding, GetRecordSize(value_size) - VALUE_OFFSET - value_bytes);
+  }
+
+  // Returns the end of the last complete record
+  u64 BuildIndex()
+  {
+    const u8* data = m_map.GetData();
+    const u64 size = m_map.GetSize();
+    u64 offset = sizeof(Header);
+    while (size - offset >= VALUE_OFFSET)
+    {
+      RecordHeader header;
+      std::memcpy(&header, data + offset, sizeof(header));
+      if (header.marker != RECORD_MARKER || GetRecordSize(header.value_size) > size - offset)
+        break;
+
+      K key;
+      std::memcpy(&key, data + offset + KEY_OFFSET, sizeof(K));
+      AddEntry(key, offset, header.value_size, nullptr);
+      offset += GetRecordSize(header.value_size);
+    }
+    return offset;
+  }
+
+  void AddEntry(const K& key, u64 offset, u32 value_size, const V* appended)
+  {
+    const size_t index = m_entries.size();
+    m_entries.push_back({key, value_size, offset, appended, RecordState::Unchecked, true});
+    auto result = m_index.emplace(key, index);
+    if (!result.second)
+    {
+      Entry& old_entry = m_entries[result.first->second];
+      old_entry.live = false;
+      if (!old_entry.appended)
+        m_stale_bytes += GetRecordSize(old_entry.value_size);
+      result.first->second = index;
+    }
+  }
+
+  void ClearIndex()
+  {
+    m_index.clear();
+    m_entries.clear();
+    m_appended.clear();
+    m_stale_bytes = 0;
   }
 
-  template <typename D>
-  bool Write(const D* data, u32 count = 1)
+  bool VerifyRecord(u64 offset) const
   {
-    return m_file.write((const char*)data, count * sizeof(D)).good();
+    RecordHeader header;
+    K key;
+    std::memcpy(&header, m_map.GetData() + offset, sizeof(header));
+    std::memcpy(&key, m_map.GetData() + offset + KEY_OFFSET, sizeof(K));
+    const V* value = reinterpret_cast<const V*>(m_map.GetData() + offset + VALUE_OFFSET);
+    return header.checksum == GetChecksum(key, value, header.value_size);
   }
 
-  template <typename D>
-  bool Read(const D* data, u32 count = 1)
+  const V* GetValue(Entry& entry)
   {
-    return m_file.read((char*)data, count * sizeof(D)).good();
+    if (entry.appended)
+      return entry.appended;
+    if (entry.state == RecordState::Unchecked)
+      entry.state = VerifyRecord(entry.offset) ? RecordState::Good : RecordState::Bad;
+    if (entry.state == RecordState::Bad)
+      return nullptr;
+    return reinterpret_cast<const V*>(m_map.GetData() + entry.offset + VALUE_OFFSET);
+  }
+
+  std::string GetCompactFilename() const { return m_filename + ".compact"; }
+
+  void StartCompaction()
+  {
+    if (m_stale_bytes < MIN_COMPACTION_BYTES || m_stale_bytes * 4 < m_map.GetSize())
+      return;
+
+    std::vector<u64> offsets;
+    for (const Entry& entry : m_entries)
+    {
+      if (entry.live && !entry.appended)
+        offsets.push_back(entry.offset);
+    }
+    // Only reads the mapping, which stays until Close joins the thread
+    m_compaction_succeeded = false;
+    m_compaction = std::thread([this, offsets = std::move(offsets)] {
+      File::IOFile file(GetCompactFilename(), "wb");
+      bool good = file.WriteBytes(&m_header, sizeof(Header));
+      for (u64 offset : offsets)
+      {
+        // Corrupt records are dropped as well
+        if (!good || !VerifyRecord(offset))
+          continue;
+        RecordHeader header;
+        std::memcpy(&header, m_map.GetData() + offset, sizeof(header));
+        good = file.WriteBytes(m_map.GetData() + offset, GetRecordSize(header.value_size));
+      }
+      m_compaction_succeeded = file.Close() && good;
+    });
+  }
+
+  // Adds what was appended since Open to the compacted file, and puts it in place of the cache
+  void FinishCompaction()
+  {
+    bool good;
+    {
+      File::IOFile file(GetCompactFilename(), "ab");
+      good = file.IsOpen();
+      for (const Entry& entry : m_entries)
+      {
+        if (good && entry.live && entry.appended)
+          good = WriteRecord(file, entry.key, entry.appended, entry.value_size);
+      }
+      good = file.Close() && good;
+    }
+
+    m_file.Close();
+    m_map.Close();
+    if (!good || !File::Rename(GetCompactFilename(), m_filename))
+      File::Delete(GetCompactFilename());
   }
 
   struct Header
@@ -182,7 +416,8 @@ private:
     void Init(std::string version)
     {
       // Null-terminator is intentionally not copied.
-      std::memcpy(&id, "DCAC", sizeof(u32));
+      std::memcpy(&id, "DCIX", sizeof(u32));
+      std::memset(ver, 0, sizeof(ver));
       std::memcpy(ver, version.c_str(), std::min(version.size(), sizeof(ver)));
     }
     void Init()
@@ -198,6 +433,17 @@ private:
 
   } m_header;
 
-  std::fstream m_file;
-  u32 m_num_entries;
+  std::string m_filename;
+  File::MappedFile m_map;
+  File::IOFile m_file;
+
+  // All the records in file order, then the ones appended since Open
+  std::vector<Entry> m_entries;
+  // The latest entry of each key
+  std::unordered_map<K, size_t, KeyHasher, KeyEqual> m_index;
+  std::vector<std::unique_ptr<V[]>> m_appended;
+  u64 m_stale_bytes = 0;
+
+  std::thread m_compaction;
+  bool m_compaction_succeeded = false;
 };
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "Common/Common.h"
 #include "Common/CPUDetect.h"
 #include "Common/ThreadPool.h"
@@ -156,3 +158,118 @@ void AsyncWorker::ExecuteAsync(std::function<void()> &&func)
 }
 
 
+struct LoopWorker::LoopJob
+{
+  const std::function<void(int, int)>* func;
+  int upper;
+  int band;
+  std::atomic<int> next;
+  std::atomic<int> remaining;
+  std::atomic<int> free_slots;
+};
+
+LoopWorker& LoopWorker::Getinstance()
+{
+  static LoopWorker intance;
+  return intance;
+}
+
+LoopWorker::LoopWorker() : m_jobLock(), m_jobs()
+{
+  ThreadPool::RegisterWorker(this);
+}
+
+LoopWorker::~LoopWorker()
+{
+  ThreadPool::UnregisterWorker(this);
+}
+
+bool LoopWorker::RunBand(LoopJob& job)
+{
+  int l = job.next.fetch_add(job.band);
+  if (l >= job.upper)
+  {
+    return false;
+  }
+  int u = std::min(l + job.band, job.upper);
+  (*job.func)(l, u);
+  job.remaining.fetch_sub(1);
+  return true;
+}
+
+bool LoopWorker::NextTask(size_t ID)
+{
+  std::shared_ptr<LoopJob> job;
+  {
+    std::lock_guard<std::mutex> guard(m_jobLock);
+    for (auto& current : m_jobs)
+    {
+      if (current->next.load() < current->upper && current->free_slots.fetch_sub(1) > 0)
+      {
+        job = current;
+        break;
+      }
+    }
+  }
+  if (!job)
+  {
+    return false;
+  }
+  bool worked = false;
+  while (RunBand(*job))
+  {
+    worked = true;
+  }
+  return worked;
+}
+
+void LoopWorker::Loop(const std::function<void(int, int)>& func, int lower, int upper, int min_band, int max_threads)
+{
+  int helpers = static_cast<int>(ThreadPool::GetThreadCount());
+  if (max_threads > 0)
+  {
+    helpers = std::min(helpers, max_threads - 1);
+  }
+  int range = upper - lower;
+  min_band = std::max(min_band, 1);
+  if (helpers < 1 || range <= min_band)
+  {
+    func(lower, upper);
+    return;
+  }
+  // A few bands per thread so fast threads can pick up the work of slow ones
+  int band = std::max(min_band, (range + (helpers + 1) * 4 - 1) / ((helpers + 1) * 4));
+  int bands = (range + band - 1) / band;
+  helpers = std::min(helpers, bands - 1);
+
+  auto job = std::make_shared<LoopJob>();
+  job->func = &func;
+  job->upper = upper;
+  job->band = band;
+  job->next.store(lower);
+  job->remaining.store(bands);
+  job->free_slots.store(helpers);
+
+  LoopWorker& instance = Getinstance();
+  {
+    std::lock_guard<std::mutex> guard(instance.m_jobLock);
+    instance.m_jobs.push_back(job);
+  }
+  for (int i = 0; i < helpers; i++)
+  {
+    ThreadPool::NotifyWorkPending();
+  }
+  while (RunBand(*job))
+  {
+  }
+  {
+    std::lock_guard<std::mutex> guard(instance.m_jobLock);
+    instance.m_jobs.erase(std::find(instance.m_jobs.begin(), instance.m_jobs.end(), job));
+  }
+  // Wait for the bands still being processed by the pool threads
+  size_t count = 0;
+  while (job->remaining.load() > 0)
+  {
+    cYield(count++);
+  }
+}
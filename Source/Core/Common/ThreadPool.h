@@ -39,6 +39,7 @@
 #include <utility>
 #include <vector>
 
+#include "Common/Common.h"
 #include "Common/Thread.h"
 
 namespace Common
@@ -473,4 +474,23 @@ public:
   bool NextTask(size_t ID) override;
   static void ExecuteAsync(std::function<void()> &&func);
 };
+
+// Parallel for over the range [lower, upper)
+// The range is split in bands of at least min_band elements that are processed
+// by the pool threads and the calling thread, returns when all bands are done.
+// max_threads limits the threads working on the loop (including the caller), 0 means no limit
+class LoopWorker final : IWorker
+{
+private:
+  struct LoopJob;
+  std::mutex m_jobLock;
+  std::vector<std::shared_ptr<LoopJob>> m_jobs;
+  static LoopWorker &Getinstance();
+  static bool RunBand(LoopJob &job);
+  LoopWorker();
+public:
+  virtual ~LoopWorker();
+  bool NextTask(size_t ID) override;
+  static void Loop(const std::function<void(int, int)> &func, int lower, int upper, int min_band = 1, int max_threads = 0);
+};
 }
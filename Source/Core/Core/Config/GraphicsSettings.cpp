@@ -138,6 +138,12 @@ const ConfigInfo<int> GFX_ENHANCE_TEXTURE_SCALING_TYPE{ { System::GFX, "Enhancem
 const ConfigInfo<int> GFX_ENHANCE_TEXTURE_SCALING_FACTOR{ { System::GFX, "Enhancements", "TextureScalingFactor" }, 2 };
 const ConfigInfo<bool> GFX_ENHANCE_USE_DEPOSTERIZE{ { System::GFX, "Enhancements", "UseDePosterize" },
 true };
+const ConfigInfo<bool> GFX_ENHANCE_TEXTURE_SCALING_ASYNC{ { System::GFX, "Enhancements", "TextureScalingAsync" },
+false };
+const ConfigInfo<bool> GFX_ENHANCE_TEXTURE_SCALING_CACHE{ { System::GFX, "Enhancements", "TextureScalingCache" },
+false };
+const ConfigInfo<int> GFX_ENHANCE_TEXTURE_SCALING_CACHE_SIZE{ { System::GFX, "Enhancements", "TextureScalingCacheSize" },
+2048 };
 
 const ConfigInfo<bool> GFX_ENHANCE_TESSELLATION{ { System::GFX, "Enhancements", "Tessellation" }, true };
 const ConfigInfo<bool> GFX_ENHANCE_TESSELLATION_EARLY_CULLING{ { System::GFX, "Enhancements", "TessellationEarlyCulling" }, false };
@@ -177,6 +183,7 @@ const ConfigInfo<bool> GFX_HACK_FORCE_DUAL_SOURCE{ { System::GFX, "Hacks", "Forc
 const ConfigInfo<bool> GFX_HACK_FULL_ASYNC_SHADER_COMPILATION{ { System::GFX, "Hacks", "FullAsyncShaderCompilation" }, false };
 const ConfigInfo<bool> GFX_HACK_LAST_HISTORY_EFBTORAM{ { System::GFX, "Hacks", "LastStoryEFBToRam" }, false };
 const ConfigInfo<bool> GFX_HACK_FORCE_LOGICOP_BLEND{ { System::GFX, "Hacks", "ForceLogicOpBlend" }, false };
+const ConfigInfo<bool> GFX_HACK_DISPLAY_LIST_CACHE{ { System::GFX, "Hacks", "DisplayListCache" }, false };
 
 // Graphics.GameSpecific
 
@@ -103,6 +103,9 @@ extern const ConfigInfo<bool> GFX_ENHANCE_USE_SCALING_FILTER;
 extern const ConfigInfo<int> GFX_ENHANCE_TEXTURE_SCALING_TYPE;
 extern const ConfigInfo<int> GFX_ENHANCE_TEXTURE_SCALING_FACTOR;
 extern const ConfigInfo<bool> GFX_ENHANCE_USE_DEPOSTERIZE;
+extern const ConfigInfo<bool> GFX_ENHANCE_TEXTURE_SCALING_ASYNC;
+extern const ConfigInfo<bool> GFX_ENHANCE_TEXTURE_SCALING_CACHE;
+extern const ConfigInfo<int> GFX_ENHANCE_TEXTURE_SCALING_CACHE_SIZE;  // in MiB, 0 is unlimited
 extern const ConfigInfo<bool> GFX_ENHANCE_TESSELLATION;
 extern const ConfigInfo<bool> GFX_ENHANCE_TESSELLATION_EARLY_CULLING;
 extern const ConfigInfo<int> GFX_ENHANCE_TESSELLATION_DISTANCE;
@@ -135,6 +138,7 @@ extern const ConfigInfo<bool> GFX_HACK_FORCE_DUAL_SOURCE;
 extern const ConfigInfo<bool> GFX_HACK_FULL_ASYNC_SHADER_COMPILATION;
 extern const ConfigInfo<bool> GFX_HACK_LAST_HISTORY_EFBTORAM;
 extern const ConfigInfo<bool> GFX_HACK_FORCE_LOGICOP_BLEND;
+extern const ConfigInfo<bool> GFX_HACK_DISPLAY_LIST_CACHE;
 
 // Graphics.GameSpecific
 
@@ -42,6 +42,7 @@ const ConfigInfo<int> MAIN_SLOT_B{{System::Main, "Core", "SlotB"},
 const ConfigInfo<int> MAIN_SERIAL_PORT_1{{System::Main, "Core", "SerialPort1"},
                                          ExpansionInterface::EXIDEVICE_NONE};
 const ConfigInfo<std::string> MAIN_BBA_MAC{{System::Main, "Core", "BBA_MAC"}, ""};
+const ConfigInfo<std::string> MAIN_SAMPLING_PROFILE{{System::Main, "Core", "SamplingProfile"}, ""};
 
 ConfigInfo<u32> GetInfoForSIDevice(u32 channel)
 {
@@ -93,6 +94,17 @@ const ConfigInfo<bool> MAIN_CUSTOM_RTC_ENABLE{{System::Main, "Core", "EnableCust
 const ConfigInfo<u32> MAIN_CUSTOM_RTC_VALUE{{System::Main, "Core", "CustomRTCValue"}, 946684800};
 const ConfigInfo<bool> MAIN_ENABLE_SIGNATURE_CHECKS{{System::Main, "Core", "EnableSignatureChecks"},
                                                     true};
+const ConfigInfo<bool> MAIN_REWIND_ENABLE{{System::Main, "Core", "EnableRewind"}, false};
+// Frames between two rewind states
+const ConfigInfo<int> MAIN_REWIND_INTERVAL{{System::Main, "Core", "RewindInterval"}, 30};
+// Memory used by the rewind history in MiB
+const ConfigInfo<int> MAIN_REWIND_BUFFER_SIZE{{System::Main, "Core", "RewindBufferSize"}, 32};
+// Publish the watched values in a shared memory ring instead of the socket
+const ConfigInfo<bool> MAIN_MEMORY_WATCHER_SHARED_MEMORY{
+    {System::Main, "Core", "MemoryWatcherSharedMemory"}, false};
+// Step the memory watcher once per field instead of 600 times per second
+const ConfigInfo<bool> MAIN_MEMORY_WATCHER_FRAME_SYNC{
+    {System::Main, "Core", "MemoryWatcherFrameSync"}, false};
 
 // Main.DSP
 
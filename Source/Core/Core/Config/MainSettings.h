@@ -36,6 +36,8 @@ extern const ConfigInfo<int> MAIN_SLOT_A;
 extern const ConfigInfo<int> MAIN_SLOT_B;
 extern const ConfigInfo<int> MAIN_SERIAL_PORT_1;
 extern const ConfigInfo<std::string> MAIN_BBA_MAC;
+// Where to write the samples of SamplingProfiler, it only runs when set
+extern const ConfigInfo<std::string> MAIN_SAMPLING_PROFILE;
 ConfigInfo<u32> GetInfoForSIDevice(u32 channel);
 ConfigInfo<bool> GetInfoForAdapterRumble(u32 channel);
 ConfigInfo<bool> GetInfoForSimulateKonga(u32 channel);
@@ -66,6 +68,11 @@ extern const ConfigInfo<std::string> MAIN_PERF_MAP_DIR;
 extern const ConfigInfo<bool> MAIN_CUSTOM_RTC_ENABLE;
 extern const ConfigInfo<u32> MAIN_CUSTOM_RTC_VALUE;
 extern const ConfigInfo<bool> MAIN_ENABLE_SIGNATURE_CHECKS;
+extern const ConfigInfo<bool> MAIN_REWIND_ENABLE;
+extern const ConfigInfo<int> MAIN_REWIND_INTERVAL;
+extern const ConfigInfo<int> MAIN_REWIND_BUFFER_SIZE;
+extern const ConfigInfo<bool> MAIN_MEMORY_WATCHER_SHARED_MEMORY;
+extern const ConfigInfo<bool> MAIN_MEMORY_WATCHER_FRAME_SYNC;
 
 // Main.DSP
 
@@ -32,5 +32,7 @@ const ConfigInfo<std::string> NETPLAY_NICKNAME{{System::Main, "NetPlay", "Nickna
 const ConfigInfo<std::string> NETPLAY_SELECTED_HOST_GAME{
     {System::Main, "NetPlay", "SelectedHostGame"}, ""};
 const ConfigInfo<bool> NETPLAY_USE_UPNP{{System::Main, "NetPlay", "UseUPNP"}, false};
+const ConfigInfo<int> NETPLAY_PAD_REDUNDANCY{{System::Main, "NetPlay", "PadRedundancy"}, 0};
+const ConfigInfo<int> NETPLAY_ROLLBACK_FRAMES{{System::Main, "NetPlay", "RollbackFrames"}, 0};
 
 }  // namespace Config
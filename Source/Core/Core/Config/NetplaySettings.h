@@ -28,5 +28,7 @@ extern const ConfigInfo<u16> NETPLAY_LISTEN_PORT;
 extern const ConfigInfo<std::string> NETPLAY_NICKNAME;
 extern const ConfigInfo<std::string> NETPLAY_SELECTED_HOST_GAME;
 extern const ConfigInfo<bool> NETPLAY_USE_UPNP;
+extern const ConfigInfo<int> NETPLAY_PAD_REDUNDANCY;
+extern const ConfigInfo<int> NETPLAY_ROLLBACK_FRAMES;
 
 }  // namespace Config
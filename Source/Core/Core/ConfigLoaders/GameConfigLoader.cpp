@@ -113,6 +113,8 @@ static const INIToLocationMap& GetINIToLocationMap()
       {{"Video_Enhancements", "TextureScalingType"}, { Config::GFX_ENHANCE_TEXTURE_SCALING_TYPE.location}},
       {{"Video_Enhancements", "TextureScalingFactor"}, { Config::GFX_ENHANCE_TEXTURE_SCALING_FACTOR.location}},
       {{"Video_Enhancements", "UseDePosterize"}, { Config::GFX_ENHANCE_USE_DEPOSTERIZE.location}},
+      {{"Video_Enhancements", "TextureScalingAsync"}, { Config::GFX_ENHANCE_TEXTURE_SCALING_ASYNC.location}},
+      {{"Video_Enhancements", "TextureScalingCache"}, { Config::GFX_ENHANCE_TEXTURE_SCALING_CACHE.location}},
       
       {{"Video_Enhancements", "Tessellation"}, { Config::GFX_ENHANCE_TESSELLATION.location}},
       {{"Video_Enhancements", "TessellationEarlyCulling"}, { Config::GFX_ENHANCE_TESSELLATION_EARLY_CULLING.location}},
@@ -147,6 +149,7 @@ static const INIToLocationMap& GetINIToLocationMap()
       {{"Video_Hacks", "EFBEmulateFormatChanges"},
        {Config::GFX_HACK_EFB_EMULATE_FORMAT_CHANGES.location}},
       {{"Video_Hacks", "VertexRounding"}, {Config::GFX_HACK_VERTEX_ROUDING.location}},
+      {{"Video_Hacks", "DisplayListCache"}, {Config::GFX_HACK_DISPLAY_LIST_CACHE.location}},
 
       {{"Video", "ProjectionHack"}, {Config::GFX_PROJECTION_HACK.location}},
       {{"Video", "PH_SZNear"}, {Config::GFX_PROJECTION_HACK_SZNEAR.location}},
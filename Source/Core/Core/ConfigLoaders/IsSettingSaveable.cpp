@@ -72,6 +72,8 @@ bool IsSettingSaveable(const Config::ConfigLocation& config_location)
       Config::GFX_ENHANCE_FORCE_TRUE_COLOR.location,
       Config::GFX_ENHANCE_USE_SCALING_FILTER.location, Config::GFX_ENHANCE_TEXTURE_SCALING_TYPE.location,
       Config::GFX_ENHANCE_TEXTURE_SCALING_FACTOR.location, Config::GFX_ENHANCE_USE_DEPOSTERIZE.location,
+      Config::GFX_ENHANCE_TEXTURE_SCALING_ASYNC.location, Config::GFX_ENHANCE_TEXTURE_SCALING_CACHE.location,
+      Config::GFX_ENHANCE_TEXTURE_SCALING_CACHE_SIZE.location,
       Config::GFX_ENHANCE_TESSELLATION.location, Config::GFX_ENHANCE_TESSELLATION_EARLY_CULLING.location,
       Config::GFX_ENHANCE_TESSELLATION_DISTANCE.location, Config::GFX_ENHANCE_TESSELLATION_MAX.location,
       Config::GFX_ENHANCE_TESSELLATION_ROUNDING_INTENSITY.location,
@@ -96,6 +98,7 @@ bool IsSettingSaveable(const Config::ConfigLocation& config_location)
       Config::GFX_HACK_FULL_ASYNC_SHADER_COMPILATION.location,
       Config::GFX_HACK_LAST_HISTORY_EFBTORAM.location,
       Config::GFX_HACK_FORCE_LOGICOP_BLEND.location,
+      Config::GFX_HACK_DISPLAY_LIST_CACHE.location,
 
       // Graphics.GameSpecific
 
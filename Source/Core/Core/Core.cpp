@@ -33,6 +33,7 @@
 
 #include "Core/Analytics.h"
 #include "Core/BootManager.h"
+#include "Core/Config/MainSettings.h"
 #include "Core/ConfigManager.h"
 #include "Core/CoreTiming.h"
 #include "Core/DSPEmulator.h"
@@ -60,6 +61,8 @@
 #include "Core/PatchEngine.h"
 #include "Core/PowerPC/JitInterface.h"
 #include "Core/PowerPC/PowerPC.h"
+#include "Core/PowerPC/SamplingProfiler.h"
+#include "Core/Rewind.h"
 #include "Core/State.h"
 #include "Core/WiiRoot.h"
 
@@ -389,7 +392,9 @@ static void CpuThread()
 #endif
 
   // Enter CPU run loop. When we leave it - we are done.
+  SamplingProfiler::RegisterThread("CPU thread");
   CPU::Run();
+  SamplingProfiler::UnregisterThread();
 
   s_is_started = false;
 
@@ -423,7 +428,9 @@ static void FifoPlayerThread()
     s_is_started = true;
 
     CPUSetInitialExecutionState();
+    SamplingProfiler::RegisterThread("FIFO player thread");
     CPU::Run();
+    SamplingProfiler::UnregisterThread();
 
     s_is_started = false;
     PowerPC::InjectExternalCPUCore(nullptr);
@@ -601,6 +608,10 @@ static void EmuThread(std::unique_ptr<BootParameters> boot)
   Host_UpdateDisasmDialog();
   Host_UpdateMainFrame();
 
+  const std::string profile_path = Config::Get(Config::MAIN_SAMPLING_PROFILE);
+  if (!profile_path.empty())
+    SamplingProfiler::Start();
+
   // ENTER THE VIDEO THREAD LOOP
   if (core_parameter.bCPUThread)
   {
@@ -654,6 +665,12 @@ static void EmuThread(std::unique_ptr<BootParameters> boot)
 
   INFO_LOG(CONSOLE, "%s", StopMessage(true, "CPU thread stopped.").c_str());
 
+  if (SamplingProfiler::IsRunning())
+  {
+    SamplingProfiler::Stop();
+    SamplingProfiler::WriteCollapsedStacks(profile_path);
+  }
+
   if (core_parameter.bCPUThread)
     video_backend->Video_Cleanup();
 
@@ -831,6 +848,12 @@ void RunAsCPUThread(std::function<void()> function)
 // This should only be called from VI
 void VideoThrottle()
 {
+#ifdef USE_MEMORYWATCHER
+  MemoryWatcher::FrameUpdate();
+#endif
+
+  Rewind::FrameUpdate();
+
   // Update info per second
   u32 ElapseTime = (u32)s_timer.GetTimeDifference();
   if ((ElapseTime >= 1000 && s_drawn_video.load() > 0) || s_request_refresh_info)
@@ -5,16 +5,18 @@
 #include "Core/CoreTiming.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cinttypes>
-#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "Common/Assert.h"
+#include "Common/BitHelpers.h"
 #include "Common/ChunkFile.h"
-#include "Common/FifoQueue.h"
 #include "Common/Logging/Log.h"
+#include "Common/MathUtil.h"
 #include "Common/StringUtil.h"
 #include "Common/Thread.h"
 
@@ -27,10 +29,14 @@
 
 namespace CoreTiming
 {
+constexpr u32 INVALID_NODE = UINT32_MAX;
+
 struct EventType
 {
   TimedCallback callback;
   const std::string* name;
+  // Pending events of this type, so RemoveEvent doesn't have to search the queue
+  u32 first_pending;
 };
 
 struct Event
@@ -56,14 +62,61 @@ static bool operator<(const Event& left, const Event& right)
 static std::unordered_map<std::string, EventType> s_event_types;
 
 // STATE_TO_SAVE
-// The queue is a min-heap using std::make_heap/push_heap/pop_heap.
-// We don't use std::priority_queue because we need to be able to serialize, unserialize and
-// erase arbitrary events (RemoveEvent()) regardless of the queue order. These aren't accomodated
-// by the standard adaptor class.
-static std::vector<Event> s_event_queue;
+// Pending events live in a pool of nodes and are found through a hierarchical timing wheel:
+// WHEEL_LEVELS levels of 64 slots, a slot of level N covering 64^N cycles. An event is filed in
+// the lowest level whose slot range still contains it, relative to s_wheel_time, so scheduling
+// and removing an event are O(1). Finding the next event cascades the first occupied slot down
+// the levels until it reaches events of a single time.
+// Events at or before s_wheel_time are kept in s_ready, a small min-heap ordered by time and
+// then by fifo_order, which makes the dispatch order identical to a single ordered queue.
+enum class NodeLocation : u8
+{
+  Free,
+  Wheel,
+  Ready,
+  // Removed while in s_ready, freed when it reaches the top of the heap
+  Cancelled,
+};
+
+struct EventNode
+{
+  Event event;
+  u32 prev;
+  u32 next;
+  u32 type_prev;
+  u32 type_next;
+  NodeLocation location;
+  u8 level;
+  u8 slot;
+};
+
+constexpr int WHEEL_SLOT_BITS = 6;
+constexpr int WHEEL_SLOTS = 1 << WHEEL_SLOT_BITS;
+// Enough levels to cover the whole 64 bit time range
+constexpr int WHEEL_LEVELS = (64 + WHEEL_SLOT_BITS - 1) / WHEEL_SLOT_BITS;
+
+struct WheelLevel
+{
+  u64 occupied;
+  std::array<u32, WHEEL_SLOTS> heads;
+};
+
+static std::vector<EventNode> s_nodes;
+static u32 s_free_nodes = INVALID_NODE;
+static size_t s_pending_events = 0;
+static std::array<WheelLevel, WHEEL_LEVELS> s_wheel;
+static s64 s_wheel_time;
+static std::vector<u32> s_ready;
 static u64 s_event_fifo_id;
-static std::mutex s_ts_write_lock;
-static Common::FifoQueue<Event, false> s_ts_queue;
+
+// Events scheduled from other threads, a lock-free stack drained by MoveEvents on the CPU
+// thread. It is reversed when drained, so the events get their fifo_order in push order.
+struct ThreadSafeEvent
+{
+  Event event;
+  ThreadSafeEvent* next;
+};
+static std::atomic<ThreadSafeEvent*> s_ts_inbox{nullptr};
 
 static float s_last_OC_factor;
 static constexpr int MAX_SLICE_LENGTH = 20000;
@@ -100,6 +153,190 @@ static int CyclesToDowncount(int cycles)
   return static_cast<int>(cycles * s_last_OC_factor);
 }
 
+// Maps the signed times to keys that keep their order as unsigned integers
+static u64 WheelKey(s64 time)
+{
+  return static_cast<u64>(time) ^ (UINT64_C(1) << 63);
+}
+
+static bool ReadyOrder(u32 left, u32 right)
+{
+  return s_nodes[left].event > s_nodes[right].event;
+}
+
+static u32 AllocateNode(const Event& event)
+{
+  u32 index;
+  if (s_free_nodes != INVALID_NODE)
+  {
+    index = s_free_nodes;
+    s_free_nodes = s_nodes[index].next;
+  }
+  else
+  {
+    index = static_cast<u32>(s_nodes.size());
+    s_nodes.emplace_back();
+  }
+
+  EventNode& node = s_nodes[index];
+  node.event = event;
+  node.type_prev = INVALID_NODE;
+  node.type_next = event.type->first_pending;
+  if (node.type_next != INVALID_NODE)
+    s_nodes[node.type_next].type_prev = index;
+  event.type->first_pending = index;
+  s_pending_events++;
+  return index;
+}
+
+static void UnlinkFromType(u32 index)
+{
+  EventNode& node = s_nodes[index];
+  if (node.type_prev != INVALID_NODE)
+    s_nodes[node.type_prev].type_next = node.type_next;
+  else
+    node.event.type->first_pending = node.type_next;
+  if (node.type_next != INVALID_NODE)
+    s_nodes[node.type_next].type_prev = node.type_prev;
+  s_pending_events--;
+}
+
+static void FreeNode(u32 index)
+{
+  s_nodes[index].location = NodeLocation::Free;
+  s_nodes[index].next = s_free_nodes;
+  s_free_nodes = index;
+}
+
+static void InsertNode(u32 index)
+{
+  EventNode& node = s_nodes[index];
+  if (node.event.time <= s_wheel_time)
+  {
+    node.location = NodeLocation::Ready;
+    s_ready.push_back(index);
+    std::push_heap(s_ready.begin(), s_ready.end(), ReadyOrder);
+    return;
+  }
+
+  const u64 key = WheelKey(node.event.time);
+  const int level = IntLog2(key ^ WheelKey(s_wheel_time)) / WHEEL_SLOT_BITS;
+  const int slot = static_cast<int>(key >> (level * WHEEL_SLOT_BITS)) & (WHEEL_SLOTS - 1);
+  WheelLevel& wheel_level = s_wheel[level];
+  node.location = NodeLocation::Wheel;
+  node.level = static_cast<u8>(level);
+  node.slot = static_cast<u8>(slot);
+  node.prev = INVALID_NODE;
+  node.next = wheel_level.heads[slot];
+  if (node.next != INVALID_NODE)
+    s_nodes[node.next].prev = index;
+  wheel_level.heads[slot] = index;
+  wheel_level.occupied |= UINT64_C(1) << slot;
+}
+
+static void InsertEvent(const Event& event)
+{
+  InsertNode(AllocateNode(event));
+}
+
+static void CancelNode(u32 index)
+{
+  EventNode& node = s_nodes[index];
+  UnlinkFromType(index);
+  if (node.location == NodeLocation::Ready)
+  {
+    node.location = NodeLocation::Cancelled;
+    return;
+  }
+
+  WheelLevel& wheel_level = s_wheel[node.level];
+  if (node.prev != INVALID_NODE)
+    s_nodes[node.prev].next = node.next;
+  else
+    wheel_level.heads[node.slot] = node.next;
+  if (node.next != INVALID_NODE)
+    s_nodes[node.next].prev = node.prev;
+  if (wheel_level.heads[node.slot] == INVALID_NODE)
+    wheel_level.occupied &= ~(UINT64_C(1) << node.slot);
+  FreeNode(index);
+}
+
+// Makes sure the earliest pending event is at the top of s_ready.
+// Returns false if no event is pending.
+static bool PrepareNextEvent()
+{
+  while (true)
+  {
+    while (!s_ready.empty() && s_nodes[s_ready.front()].location == NodeLocation::Cancelled)
+    {
+      FreeNode(s_ready.front());
+      std::pop_heap(s_ready.begin(), s_ready.end(), ReadyOrder);
+      s_ready.pop_back();
+    }
+    if (!s_ready.empty())
+      return true;
+
+    // The wheel only holds events after s_wheel_time, so only the slots after the current one
+    // can be occupied, and the first of them in the lowest level holds the earliest events.
+    const u64 wheel_key = WheelKey(s_wheel_time);
+    int level = 0;
+    u64 later_slots = 0;
+    for (; level < WHEEL_LEVELS; level++)
+    {
+      const int current_slot =
+          static_cast<int>(wheel_key >> (level * WHEEL_SLOT_BITS)) & (WHEEL_SLOTS - 1);
+      later_slots = (s_wheel[level].occupied >> current_slot) >> 1 << current_slot << 1;
+      if (later_slots)
+        break;
+    }
+    if (level == WHEEL_LEVELS)
+      return false;
+
+    // Move the wheel to the start of that slot and refile its events in the lower levels,
+    // the ones at exactly that time go to s_ready
+    const int slot = LeastSignificantSetBit(later_slots);
+    const int shift = level * WHEEL_SLOT_BITS;
+    const int upper_shift = shift + WHEEL_SLOT_BITS;
+    u64 start_key = upper_shift < 64 ? wheel_key >> upper_shift << upper_shift : 0;
+    start_key |= static_cast<u64>(slot) << shift;
+    s_wheel_time = static_cast<s64>(start_key ^ (UINT64_C(1) << 63));
+
+    u32 index = s_wheel[level].heads[slot];
+    s_wheel[level].heads[slot] = INVALID_NODE;
+    s_wheel[level].occupied &= ~(UINT64_C(1) << slot);
+    while (index != INVALID_NODE)
+    {
+      const u32 next = s_nodes[index].next;
+      InsertNode(index);
+      index = next;
+    }
+  }
+}
+
+static Event PopNextEvent()
+{
+  const u32 index = s_ready.front();
+  std::pop_heap(s_ready.begin(), s_ready.end(), ReadyOrder);
+  s_ready.pop_back();
+  Event event = s_nodes[index].event;
+  UnlinkFromType(index);
+  FreeNode(index);
+  return event;
+}
+
+static std::vector<Event> GetPendingEvents()
+{
+  std::vector<Event> events;
+  events.reserve(s_pending_events);
+  for (const EventNode& node : s_nodes)
+  {
+    if (node.location == NodeLocation::Wheel || node.location == NodeLocation::Ready)
+      events.push_back(node.event);
+  }
+  std::sort(events.begin(), events.end());
+  return events;
+}
+
 EventType* RegisterEvent(const std::string& name, TimedCallback callback)
 {
   // check for existing type with same name.
@@ -109,7 +346,7 @@ EventType* RegisterEvent(const std::string& name, TimedCallback callback)
                "during Init to avoid breaking save states.",
                name.c_str());
 
-  auto info = s_event_types.emplace(name, EventType{callback, nullptr});
+  auto info = s_event_types.emplace(name, EventType{callback, nullptr, INVALID_NODE});
   EventType* event_type = &info.first->second;
   event_type->name = &info.first->first;
   return event_type;
@@ -117,7 +354,7 @@ EventType* RegisterEvent(const std::string& name, TimedCallback callback)
 
 void UnregisterAllEvents()
 {
-  _assert_msg_(POWERPC, s_event_queue.empty(), "Cannot unregister events with events pending");
+  _assert_msg_(POWERPC, s_pending_events == 0, "Cannot unregister events with events pending");
   s_event_types.clear();
 }
 
@@ -137,12 +374,12 @@ void Init()
   s_is_global_timer_sane = true;
 
   s_event_fifo_id = 0;
+  ClearPendingEvents();
   s_ev_lost = RegisterEvent("_lost_event", &EmptyTimedCallback);
 }
 
 void Shutdown()
 {
-  std::lock_guard<std::mutex> lk(s_ts_write_lock);
   MoveEvents();
   ClearPendingEvents();
   UnregisterAllEvents();
@@ -150,7 +387,6 @@ void Shutdown()
 
 void DoState(PointerWrap& p)
 {
-  std::lock_guard<std::mutex> lk(s_ts_write_lock);
   p.Do(g.slice_length);
   p.Do(g.global_timer);
   p.Do(s_idled_cycles);
@@ -165,7 +401,11 @@ void DoState(PointerWrap& p)
   p.DoMarker("CoreTimingData");
 
   MoveEvents();
-  p.DoEachElement(s_event_queue, [](PointerWrap& pw, Event& ev) {
+  // Saved in dispatch order, which keeps the savestates of identical queues identical
+  std::vector<Event> events;
+  if (p.GetMode() != PointerWrap::MODE_READ)
+    events = GetPendingEvents();
+  p.DoEachElement(events, [](PointerWrap& pw, Event& ev) {
     pw.Do(ev.time);
     pw.Do(ev.fifo_order);
 
@@ -199,10 +439,13 @@ void DoState(PointerWrap& p)
   p.DoMarker("CoreTimingEvents");
 
   // When loading from a save state, we must assume the Event order is random and meaningless.
-  // The exact layout of the heap in memory is implementation defined, therefore it is platform
-  // and library version specific.
+  // Older savestates stored the layout of a heap.
   if (p.GetMode() == PointerWrap::MODE_READ)
-    std::make_heap(s_event_queue.begin(), s_event_queue.end(), std::greater<Event>());
+  {
+    ClearPendingEvents();
+    for (const Event& ev : events)
+      InsertEvent(ev);
+  }
 }
 
 // This should only be called from the CPU thread. If you are calling
@@ -225,7 +468,18 @@ u64 GetIdleTicks()
 
 void ClearPendingEvents()
 {
-  s_event_queue.clear();
+  for (auto& entry : s_event_types)
+    entry.second.first_pending = INVALID_NODE;
+  s_nodes.clear();
+  s_free_nodes = INVALID_NODE;
+  s_pending_events = 0;
+  for (WheelLevel& level : s_wheel)
+  {
+    level.occupied = 0;
+    level.heads.fill(INVALID_NODE);
+  }
+  s_ready.clear();
+  s_wheel_time = g.global_timer;
 }
 
 void ScheduleEvent(s64 cycles_into_future, EventType* event_type, u64 userdata, FromThread from)
@@ -253,8 +507,7 @@ void ScheduleEvent(s64 cycles_into_future, EventType* event_type, u64 userdata,
     if (!s_is_global_timer_sane)
       ForceExceptionCheck(cycles_into_future);
 
-    s_event_queue.emplace_back(Event{timeout, s_event_fifo_id++, userdata, event_type});
-    std::push_heap(s_event_queue.begin(), s_event_queue.end(), std::greater<Event>());
+    InsertEvent(Event{timeout, s_event_fifo_id++, userdata, event_type});
   }
   else
   {
@@ -265,22 +518,23 @@ void ScheduleEvent(s64 cycles_into_future, EventType* event_type, u64 userdata,
                 event_type->name->c_str());
     }
 
-    std::lock_guard<std::mutex> lk(s_ts_write_lock);
-    s_ts_queue.Push(Event{g.global_timer + cycles_into_future, 0, userdata, event_type});
+    ThreadSafeEvent* ts_event =
+        new ThreadSafeEvent{Event{g.global_timer + cycles_into_future, 0, userdata, event_type},
+                            s_ts_inbox.load(std::memory_order_relaxed)};
+    while (!s_ts_inbox.compare_exchange_weak(ts_event->next, ts_event, std::memory_order_release,
+                                             std::memory_order_relaxed))
+    {
+    }
   }
 }
 
 void RemoveEvent(EventType* event_type)
 {
-  auto itr = std::remove_if(s_event_queue.begin(), s_event_queue.end(),
-                            [&](const Event& e) { return e.type == event_type; });
-
-  // Removing random items breaks the invariant so we have to re-establish it.
-  if (itr != s_event_queue.end())
-  {
-    s_event_queue.erase(itr, s_event_queue.end());
-    std::make_heap(s_event_queue.begin(), s_event_queue.end(), std::greater<Event>());
-  }
+  // Before Init and after Shutdown the type may not be registered, nothing is pending then
+  if (s_pending_events == 0)
+    return;
+  while (event_type->first_pending != INVALID_NODE)
+    CancelNode(event_type->first_pending);
 }
 
 void RemoveAllEvents(EventType* event_type)
@@ -293,11 +547,9 @@ void RemoveAllEvents(EventType* event_type)
 void ProcessFifoWaitEvents()
 {
   MoveEvents();
-  while (!s_event_queue.empty() && s_event_queue.front().time <= g.global_timer)
+  while (PrepareNextEvent() && s_nodes[s_ready.front()].event.time <= g.global_timer)
   {
-    Event evt = std::move(s_event_queue.front());
-    std::pop_heap(s_event_queue.begin(), s_event_queue.end(), std::greater<Event>());
-    s_event_queue.pop_back();
+    Event evt = PopNextEvent();
     // NOTICE_LOG(POWERPC, "[Scheduler] %-20s (%lld, %lld)", evt.type->name->c_str(),
     //            g.global_timer, evt.time);
     evt.type->callback(evt.userdata, g.global_timer - evt.time);
@@ -318,11 +570,25 @@ void ForceExceptionCheck(s64 cycles)
 
 void MoveEvents()
 {
-  for (Event ev; s_ts_queue.Pop(ev);)
+  if (!s_ts_inbox.load(std::memory_order_relaxed))
+    return;
+
+  ThreadSafeEvent* ts_event = s_ts_inbox.exchange(nullptr, std::memory_order_acquire);
+  ThreadSafeEvent* in_order = nullptr;
+  while (ts_event)
   {
-    ev.fifo_order = s_event_fifo_id++;
-    s_event_queue.emplace_back(std::move(ev));
-    std::push_heap(s_event_queue.begin(), s_event_queue.end(), std::greater<Event>());
+    ThreadSafeEvent* next = ts_event->next;
+    ts_event->next = in_order;
+    in_order = ts_event;
+    ts_event = next;
+  }
+  while (in_order)
+  {
+    ThreadSafeEvent* next = in_order->next;
+    in_order->event.fifo_order = s_event_fifo_id++;
+    InsertEvent(in_order->event);
+    delete in_order;
+    in_order = next;
   }
 }
 
@@ -338,11 +604,9 @@ void Advance()
 
   s_is_global_timer_sane = true;
 
-  while (!s_event_queue.empty() && s_event_queue.front().time <= g.global_timer)
+  while (PrepareNextEvent() && s_nodes[s_ready.front()].event.time <= g.global_timer)
   {
-    Event evt = std::move(s_event_queue.front());
-    std::pop_heap(s_event_queue.begin(), s_event_queue.end(), std::greater<Event>());
-    s_event_queue.pop_back();
+    Event evt = PopNextEvent();
     // NOTICE_LOG(POWERPC, "[Scheduler] %-20s (%lld, %lld)", evt.type->name->c_str(),
     //            g.global_timer, evt.time);
     evt.type->callback(evt.userdata, g.global_timer - evt.time);
@@ -351,10 +615,10 @@ void Advance()
   s_is_global_timer_sane = false;
 
   // Still events left (scheduled in the future)
-  if (!s_event_queue.empty())
+  if (PrepareNextEvent())
   {
     g.slice_length = static_cast<int>(
-        std::min<s64>(s_event_queue.front().time - g.global_timer, MAX_SLICE_LENGTH));
+        std::min<s64>(s_nodes[s_ready.front()].event.time - g.global_timer, MAX_SLICE_LENGTH));
   }
 
   PowerPC::ppcState.downcount = CyclesToDowncount(g.slice_length);
@@ -368,9 +632,7 @@ void Advance()
 
 void LogPendingEvents()
 {
-  auto clone = s_event_queue;
-  std::sort(clone.begin(), clone.end());
-  for (const Event& ev : clone)
+  for (const Event& ev : GetPendingEvents())
   {
     INFO_LOG(POWERPC, "PENDING: Now: %" PRId64 " Pending: %" PRId64 " Type: %s", g.global_timer,
              ev.time, ev.type->name->c_str());
@@ -380,10 +642,13 @@ void LogPendingEvents()
 // Should only be called from the CPU thread after the PPC clock has changed
 void AdjustEventQueueTimes(u32 new_ppc_clock, u32 old_ppc_clock)
 {
-  for (Event& ev : s_event_queue)
+  std::vector<Event> events = GetPendingEvents();
+  ClearPendingEvents();
+  for (Event& ev : events)
   {
     const s64 ticks = (ev.time - g.global_timer) * new_ppc_clock / old_ppc_clock;
     ev.time = g.global_timer + ticks;
+    InsertEvent(ev);
   }
 }
 
@@ -406,9 +671,7 @@ std::string GetScheduledEventsSummary()
   std::string text = "Scheduled events\n";
   text.reserve(1000);
 
-  auto clone = s_event_queue;
-  std::sort(clone.begin(), clone.end());
-  for (const Event& ev : clone)
+  for (const Event& ev : GetPendingEvents())
   {
     text += StringFromFormat("%s : %" PRIi64 " %016" PRIx64 "\n", ev.type->name->c_str(), ev.time,
                              ev.userdata);
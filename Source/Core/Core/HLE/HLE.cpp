@@ -17,6 +17,7 @@
 #include "Core/IOS/ES/ES.h"
 #include "Core/PowerPC/PPCSymbolDB.h"
 #include "Core/PowerPC/PowerPC.h"
+#include "Core/PowerPC/SamplingProfiler.h"
 
 namespace HLE
 {
@@ -176,7 +177,9 @@ void Execute(u32 _CurrentPC, u32 _Instruction)
   unsigned int FunctionIndex = _Instruction & 0xFFFFF;
   if (FunctionIndex > 0 && FunctionIndex < ArraySize(OSPatches))
   {
+    SamplingProfiler::EnterHLE(_CurrentPC);
     OSPatches[FunctionIndex].PatchFunction();
+    SamplingProfiler::LeaveHLE();
   }
   else
   {
@@ -147,7 +147,8 @@ static const int DSP_MAIL_SLICE = 72;
 
 void DoState(PointerWrap& p)
 {
-  if (!s_ARAM.wii_mode)
+  // Incremental snapshots track the GameCube ARAM with the memory
+  if (!s_ARAM.wii_mode && Memory::StateIncludesMemory())
     p.DoArray(s_ARAM.ptr, s_ARAM.size);
   p.DoPOD(s_dspState);
   p.DoPOD(s_audioDMA);
@@ -553,6 +554,8 @@ static void Do_ARAM_DMA()
           {
             *(u64*)&s_ARAM.ptr[(s_arDMA.ARAddr + 0x400000) & s_ARAM.mask] =
                 Common::swap64(Memory::Read_U64(s_arDMA.MMAddr));
+            if (!s_ARAM.wii_mode)
+              Memory::MarkARAMDirty((s_arDMA.ARAddr + 0x400000) & s_ARAM.mask, 8);
           }
           *(u64*)&s_ARAM.ptr[s_arDMA.ARAddr & s_ARAM.mask] =
               Common::swap64(Memory::Read_U64(s_arDMA.MMAddr));
@@ -562,6 +565,8 @@ static void Do_ARAM_DMA()
           *(u64*)&s_ARAM.ptr[s_arDMA.ARAddr & s_ARAM.mask] =
               Common::swap64(Memory::Read_U64(s_arDMA.MMAddr));
         }
+        if (!s_ARAM.wii_mode)
+          Memory::MarkARAMDirty(s_arDMA.ARAddr & s_ARAM.mask, 8);
 
         s_arDMA.MMAddr += 8;
         s_arDMA.ARAddr += 8;
@@ -601,6 +606,8 @@ void WriteARAM(u8 value, u32 address)
 {
   // TODO: verify this on Wii
   s_ARAM.ptr[address & s_ARAM.mask] = value;
+  if (!s_ARAM.wii_mode)
+    Memory::MarkARAMDirty(address & s_ARAM.mask, 1);
 }
 
 u8* GetARAMPtr()
@@ -23,6 +23,8 @@
 #include "Core/HW/VideoInterface.h"
 #include "Core/HW/WII_IPC.h"
 #include "Core/IOS/IOS.h"
+#include "Core/Rewind.h"
+#include "Core/Rollback.h"
 #include "Core/State.h"
 #include "Core/WiiRoot.h"
 
@@ -34,6 +36,8 @@ void Init()
   SystemTimers::PreInit();
 
   State::Init();
+  Rewind::Init();
+  Rollback::Init();
 
   // Init the whole Hardware
   AudioInterface::Init();
@@ -73,6 +77,8 @@ void Shutdown()
   SerialInterface::Shutdown();
   AudioInterface::Shutdown();
 
+  Rollback::Shutdown();
+  Rewind::Shutdown();
   State::Shutdown();
   CoreTiming::Shutdown();
 }
@@ -10,13 +10,21 @@
 #include "Core/HW/Memmap.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <memory>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
 #include "Common/ChunkFile.h"
 #include "Common/CommonTypes.h"
 #include "Common/Logging/Log.h"
 #include "Common/MemArena.h"
+#include "Common/MemoryUtil.h"
 #include "Common/Swap.h"
 #include "Core/ConfigManager.h"
 #include "Core/HW/AudioInterface.h"
@@ -113,6 +121,7 @@ struct LogicalMemoryView
 {
   void* mapped_pointer;
   u32 mapped_size;
+  u32 shm_position;
 };
 
 // Dolphin allocates memory to represent four regions:
@@ -163,6 +172,113 @@ static PhysicalMemoryRegion physical_regions[] = {
 };
 
 static std::vector<LogicalMemoryView> logical_mapped_entries;
+static u32 s_arena_size = 0;
+static u32 s_active_region_flags = 0;
+
+// Dirty page tracking. Clean pages are write protected in every view of the arena, the first
+// write to one of them faults, EMM calls HandleDirtyPageFault which marks the page as dirty and
+// lifts the protection. A fault is always handled by making the page writable first and marking
+// it second, while collecting clears the mark first and protects second, so a concurrent write is
+// never lost. The lock only guards the list of logical views, which the CPU thread changes.
+static bool s_dirty_tracking = false;
+static u32 s_dirty_page_size = 0;
+static std::unique_ptr<std::atomic<u8>[]> s_dirty_pages;
+static std::atomic_flag s_logical_views_lock = ATOMIC_FLAG_INIT;
+static bool s_state_includes_memory = true;
+// On the GameCube ARAM is not in the arena and only the ARAM DMA and the DSP write to it, they
+// mark the pages they write with MarkARAMDirty. It follows the arena in the tracked image.
+static std::unique_ptr<std::atomic<u8>[]> s_dirty_aram_pages;
+
+class LogicalViewsLock
+{
+public:
+  LogicalViewsLock()
+  {
+    while (s_logical_views_lock.test_and_set(std::memory_order_acquire))
+    {
+    }
+  }
+  ~LogicalViewsLock() { s_logical_views_lock.clear(std::memory_order_release); }
+};
+
+static bool IsRegionActive(const PhysicalMemoryRegion& region)
+{
+  return (s_active_region_flags & region.flags) == region.flags && *region.out_pointer;
+}
+
+static u32 GetHostPageSize()
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwPageSize;
+#else
+  return static_cast<u32>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// Changes the protection of [position, position + size) of the arena in every view mapping it.
+// The caller holds the logical views lock.
+static void SetArenaRangeWritable(u32 position, u32 size, bool writable)
+{
+  auto apply = [&](u8* view, u32 view_position, u32 view_size) {
+    const u32 start = std::max(position, view_position);
+    const u32 end = std::min(position + size, view_position + view_size);
+    if (start >= end)
+      return;
+    if (writable)
+      Common::UnWriteProtectMemory(view + (start - view_position), end - start);
+    else
+      Common::WriteProtectMemory(view + (start - view_position), end - start);
+  };
+  for (const PhysicalMemoryRegion& region : physical_regions)
+  {
+    if (IsRegionActive(region))
+      apply(*region.out_pointer, region.shm_position, region.size);
+  }
+  for (const LogicalMemoryView& view : logical_mapped_entries)
+    apply(static_cast<u8*>(view.mapped_pointer), view.shm_position, view.mapped_size);
+}
+
+// Protects every clean page of a range, merging runs of clean pages.
+// The caller holds the logical views lock.
+static void ProtectCleanPages(u32 position, u32 size)
+{
+  const u32 first = position / s_dirty_page_size;
+  const u32 last = (position + size + s_dirty_page_size - 1) / s_dirty_page_size;
+  u32 run_start = first;
+  for (u32 page = first; page <= last; page++)
+  {
+    if (page == last || s_dirty_pages[page].load())
+    {
+      if (page > run_start)
+        SetArenaRangeWritable(run_start * s_dirty_page_size, (page - run_start) * s_dirty_page_size,
+                              false);
+      run_start = page + 1;
+    }
+  }
+}
+
+static void MarkPageDirty(u32 page)
+{
+  SetArenaRangeWritable(page * s_dirty_page_size, s_dirty_page_size, true);
+  s_dirty_pages[page].store(1);
+}
+
+static u32 GetTrackedARAMSize()
+{
+  return SConfig::GetInstance().bWii || !DSP::GetARAMPtr() ? 0 : DSP::ARAM_SIZE;
+}
+
+static void MarkAllPagesDirty()
+{
+  LogicalViewsLock lk;
+  SetArenaRangeWritable(0, s_arena_size, true);
+  for (u32 page = 0; page < s_arena_size / s_dirty_page_size; page++)
+    s_dirty_pages[page].store(1);
+  for (u32 page = 0; page < GetTrackedARAMSize() / s_dirty_page_size; page++)
+    s_dirty_aram_pages[page].store(1);
+}
 
 void Init()
 {
@@ -191,6 +307,8 @@ void Init()
   }
   g_arena.GrabSHMSegment(mem_size);
   physical_base = MemArena::FindMemoryBase();
+  s_arena_size = mem_size;
+  s_active_region_flags = flags;
 
   for (PhysicalMemoryRegion& region : physical_regions)
   {
@@ -224,6 +342,7 @@ void Init()
 
 void UpdateLogicalMemory(const PowerPC::BatTable& dbat_table)
 {
+  LogicalViewsLock lk;
   for (auto& entry : logical_mapped_entries)
   {
     g_arena.ReleaseView(entry.mapped_pointer, entry.mapped_size);
@@ -256,7 +375,9 @@ void UpdateLogicalMemory(const PowerPC::BatTable& dbat_table)
             PanicAlert("MemoryMap_Setup: Failed finding a memory base.");
             exit(0);
           }
-          logical_mapped_entries.push_back({mapped_pointer, mapped_size});
+          logical_mapped_entries.push_back({mapped_pointer, mapped_size, position});
+          if (s_dirty_tracking)
+            ProtectCleanPages(position, mapped_size);
         }
       }
     }
@@ -266,6 +387,16 @@ void UpdateLogicalMemory(const PowerPC::BatTable& dbat_table)
 void DoState(PointerWrap& p)
 {
   bool wii = SConfig::GetInstance().bWii;
+  if (!s_state_includes_memory)
+  {
+    p.DoMarker("Memory RAM");
+    p.DoMarker("Memory FakeVMEM");
+    p.DoMarker("Memory EXRAM");
+    return;
+  }
+  // Everything is rewritten, don't take a fault per page
+  if (s_dirty_tracking && p.GetMode() == PointerWrap::MODE_READ)
+    MarkAllPagesDirty();
   p.DoArray(m_pRAM, RAM_SIZE);
   p.DoArray(m_pL1Cache, L1_CACHE_SIZE);
   p.DoMarker("Memory RAM");
@@ -279,6 +410,7 @@ void DoState(PointerWrap& p)
 
 void Shutdown()
 {
+  StopDirtyTracking();
   m_IsInitialized = false;
   u32 flags = 0;
   if (SConfig::GetInstance().bWii)
@@ -301,9 +433,218 @@ void Shutdown()
   physical_base = nullptr;
   logical_base = nullptr;
   mmio_mapping.reset();
+  s_active_region_flags = 0;
+  s_arena_size = 0;
   INFO_LOG(MEMMAP, "Memory system shut down.");
 }
 
+bool StartDirtyTracking()
+{
+  if (s_dirty_tracking)
+    return true;
+  // The write faults are handled by the fastmem exception handler. The Mach exception handler
+  // only covers the CPU thread, the GPU thread writes to RAM too.
+#if defined(_M_GENERIC) || (defined(__APPLE__) && !defined(USE_SIGACTION_ON_APPLE))
+  return false;
+#else
+  if (!m_IsInitialized || !SConfig::GetInstance().bFastmem)
+    return false;
+
+  s_dirty_page_size = std::max<u32>(GetHostPageSize(), 0x1000);
+  if (s_arena_size % s_dirty_page_size != 0)
+    return false;
+  s_dirty_pages.reset(new std::atomic<u8>[s_arena_size / s_dirty_page_size]);
+  s_dirty_aram_pages.reset(new std::atomic<u8>[GetTrackedARAMSize() / s_dirty_page_size]);
+  // Everything is dirty until the first collection
+  for (u32 page = 0; page < s_arena_size / s_dirty_page_size; page++)
+    s_dirty_pages[page].store(1);
+  for (u32 page = 0; page < GetTrackedARAMSize() / s_dirty_page_size; page++)
+    s_dirty_aram_pages[page].store(1);
+  s_dirty_tracking = true;
+  return true;
+#endif
+}
+
+void StopDirtyTracking()
+{
+  if (!s_dirty_tracking)
+    return;
+  MarkAllPagesDirty();
+  s_dirty_tracking = false;
+}
+
+bool HandleDirtyPageFault(uintptr_t address)
+{
+  if (!s_dirty_tracking)
+    return false;
+
+  // Devices write through the physical region views, check them before taking the lock
+  for (const PhysicalMemoryRegion& region : physical_regions)
+  {
+    const uintptr_t view = reinterpret_cast<uintptr_t>(*region.out_pointer);
+    if (IsRegionActive(region) && address >= view && address < view + region.size)
+    {
+      LogicalViewsLock lk;
+      MarkPageDirty((region.shm_position + u32(address - view)) / s_dirty_page_size);
+      return true;
+    }
+  }
+  LogicalViewsLock lk;
+  for (const LogicalMemoryView& entry : logical_mapped_entries)
+  {
+    const uintptr_t view = reinterpret_cast<uintptr_t>(entry.mapped_pointer);
+    if (address >= view && address < view + entry.mapped_size)
+    {
+      MarkPageDirty((entry.shm_position + u32(address - view)) / s_dirty_page_size);
+      return true;
+    }
+  }
+  return false;
+}
+
+void MarkDirty(const void* pointer, size_t size)
+{
+  if (!s_dirty_tracking || size == 0)
+    return;
+
+  const uintptr_t address = reinterpret_cast<uintptr_t>(pointer);
+  for (const PhysicalMemoryRegion& region : physical_regions)
+  {
+    const uintptr_t view = reinterpret_cast<uintptr_t>(*region.out_pointer);
+    if (!IsRegionActive(region) || address < view || address >= view + region.size)
+      continue;
+
+    const u32 start = region.shm_position + u32(address - view);
+    const u32 end = region.shm_position + u32(std::min<uintptr_t>(address + size - view, region.size));
+    LogicalViewsLock lk;
+    for (u32 page = start / s_dirty_page_size; page * s_dirty_page_size < end; page++)
+      MarkPageDirty(page);
+    return;
+  }
+}
+
+void MarkARAMDirty(u32 address, u32 size)
+{
+  if (!s_dirty_tracking || size == 0)
+    return;
+
+  for (u32 page = address / s_dirty_page_size; page * s_dirty_page_size < address + size; page++)
+    s_dirty_aram_pages[page].store(1);
+}
+
+u32 GetTrackedMemorySize()
+{
+  return s_arena_size + GetTrackedARAMSize();
+}
+
+u32 GetDirtyPageSize()
+{
+  return s_dirty_tracking ? s_dirty_page_size : 0x1000;
+}
+
+void CollectDirtyPages(const std::function<void(u32, const u8*)>& func)
+{
+  const u32 page_size = GetDirtyPageSize();
+  for (const PhysicalMemoryRegion& region : physical_regions)
+  {
+    if (!IsRegionActive(region))
+      continue;
+    for (u32 offset = 0; offset < region.size; offset += page_size)
+    {
+      const u32 position = region.shm_position + offset;
+      if (s_dirty_tracking)
+      {
+        const u32 page = position / page_size;
+        if (!s_dirty_pages[page].load())
+          continue;
+        s_dirty_pages[page].store(0);
+        LogicalViewsLock lk;
+        SetArenaRangeWritable(position, page_size, false);
+      }
+      func(position, *region.out_pointer + offset);
+    }
+  }
+
+  u8* aram = DSP::GetARAMPtr();
+  for (u32 offset = 0; offset < GetTrackedARAMSize(); offset += page_size)
+  {
+    if (s_dirty_tracking)
+    {
+      const u32 page = offset / page_size;
+      if (!s_dirty_aram_pages[page].load())
+        continue;
+      s_dirty_aram_pages[page].store(0);
+    }
+    func(s_arena_size + offset, aram + offset);
+  }
+}
+
+void RestoreTrackedMemory(const u8* image)
+{
+  if (s_dirty_tracking)
+    MarkAllPagesDirty();
+  for (const PhysicalMemoryRegion& region : physical_regions)
+  {
+    if (IsRegionActive(region))
+      memcpy(*region.out_pointer, image + region.shm_position, region.size);
+  }
+  if (GetTrackedARAMSize())
+    memcpy(DSP::GetARAMPtr(), image + s_arena_size, GetTrackedARAMSize());
+  if (s_dirty_tracking)
+  {
+    // The memory matches the image now, start over from a clean state
+    LogicalViewsLock lk;
+    for (u32 page = 0; page < s_arena_size / s_dirty_page_size; page++)
+      s_dirty_pages[page].store(0);
+    for (u32 page = 0; page < GetTrackedARAMSize() / s_dirty_page_size; page++)
+      s_dirty_aram_pages[page].store(0);
+    SetArenaRangeWritable(0, s_arena_size, false);
+  }
+}
+
+void RestoreTrackedPage(u32 offset, const u8* data)
+{
+  const u32 page_size = GetDirtyPageSize();
+  if (offset >= s_arena_size && offset < s_arena_size + GetTrackedARAMSize())
+  {
+    memcpy(DSP::GetARAMPtr() + (offset - s_arena_size), data, page_size);
+    if (s_dirty_tracking)
+      s_dirty_aram_pages[(offset - s_arena_size) / page_size].store(0);
+    return;
+  }
+  for (const PhysicalMemoryRegion& region : physical_regions)
+  {
+    if (!IsRegionActive(region) || offset < region.shm_position ||
+        offset >= region.shm_position + region.size)
+    {
+      continue;
+    }
+
+    u8* page = *region.out_pointer + (offset - region.shm_position);
+    if (!s_dirty_tracking)
+    {
+      memcpy(page, data, page_size);
+      return;
+    }
+    LogicalViewsLock lk;
+    SetArenaRangeWritable(offset, page_size, true);
+    memcpy(page, data, page_size);
+    s_dirty_pages[offset / page_size].store(0);
+    SetArenaRangeWritable(offset, page_size, false);
+    return;
+  }
+}
+
+void SetStateIncludesMemory(bool include)
+{
+  s_state_includes_memory = include;
+}
+
+bool StateIncludesMemory()
+{
+  return s_state_includes_memory;
+}
+
 void Clear()
 {
   if (m_pRAM)
@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -66,6 +69,36 @@ void DoState(PointerWrap& p);
 
 void UpdateLogicalMemory(const PowerPC::BatTable& dbat_table);
 
+// Page granular tracking of the writes to the emulated memory (RAM, EXRAM, FakeVMEM and the
+// locked L1), based on write protection faults, and to the GameCube ARAM. It needs the fastmem
+// exception handler, StartDirtyTracking returns false when it is not available.
+// The tracked memory is seen as one image of GetTrackedMemorySize() bytes, the GameCube ARAM is
+// at its end.
+bool StartDirtyTracking();
+void StopDirtyTracking();
+// Called by the exception handler, returns true if the fault was caused by the tracking
+bool HandleDirtyPageFault(uintptr_t address);
+// Host code that makes the OS write into emulated memory (file reads, sockets) has to call this
+// first, the kernel fails those writes instead of raising a fault.
+void MarkDirty(const void* pointer, size_t size);
+// The GameCube ARAM is not write protected, the code writing to it calls this after the write
+void MarkARAMDirty(u32 address, u32 size);
+u32 GetTrackedMemorySize();
+u32 GetDirtyPageSize();
+// Calls func with the image offset and the data of every page written since the previous call
+// and protects them again. Without tracking every page is reported.
+// The marks are cleared by the call, so there can only be one reader: rewind is not started
+// during NetPlay, where rollback reads them.
+void CollectDirtyPages(const std::function<void(u32, const u8*)>& func);
+// Copies a full image back into the emulated memory, all pages are clean afterwards
+void RestoreTrackedMemory(const u8* image);
+// Same for the single page at the given image offset
+void RestoreTrackedPage(u32 offset, const u8* data);
+// Incremental snapshots keep the memory, and the GameCube ARAM, out of the savestate and use the
+// dirty pages instead
+void SetStateIncludesMemory(bool include);
+bool StateIncludesMemory();
+
 void Clear();
 
 // Routines to access physically addressed memory, designed for use by
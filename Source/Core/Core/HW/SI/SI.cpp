@@ -13,6 +13,7 @@
 #include "Common/CommonTypes.h"
 #include "Core/ConfigManager.h"
 #include "Core/CoreTiming.h"
+#include "Core/HW/CPU.h"
 #include "Core/HW/MMIO.h"
 #include "Core/HW/ProcessorInterface.h"
 #include "Core/HW/SI/SI_DeviceGBA.h"
@@ -21,6 +22,9 @@
 #include "Core/NetPlayProto.h"
 
 #include "InputCommon/ControllerInterface/ControllerInterface.h"
+#ifdef CIFACE_USE_PIPES
+#include "InputCommon/ControllerInterface/Pipes/Pipes.h"
+#endif
 
 namespace SerialInterface
 {
@@ -568,6 +572,10 @@ void UpdateDevices()
 {
   // Update inputs at the rate of SI
   // Typically 120hz but is variable
+#ifdef CIFACE_USE_PIPES
+  // Stopping or pausing the emulation waits for the CPU thread, which can't wait for a pipe then
+  ciface::Pipes::WaitForLockstepInput([] { return CPU::GetState() == CPU::State::Running; });
+#endif
   g_controller_interface.UpdateInput();
 
   // Update channels and set the status bit if there's new data
@@ -64,6 +64,7 @@ IPC_HLE_PERIOD: For the Wii Remote this is the call schedule:
 #include "Core/IOS/IOS.h"
 #include "Core/PatchEngine.h"
 #include "Core/PowerPC/PowerPC.h"
+#include "Core/Rollback.h"
 #include "VideoCommon/Fifo.h"
 
 namespace SystemTimers
@@ -204,7 +205,8 @@ static void ThrottleCallback(u64 last_time, s64 cyclesLate)
 
   int diff = (u32)last_time - time;
   const SConfig& config = SConfig::GetInstance();
-  bool frame_limiter = config.m_EmulationSpeed > 0.0f && !Core::GetIsThrottlerTempDisabled();
+  bool frame_limiter = config.m_EmulationSpeed > 0.0f && !Core::GetIsThrottlerTempDisabled() &&
+                       !Rollback::IsResimulating();
   u32 next_event = GetTicksPerSecond() / 1000;
   if (frame_limiter)
   {
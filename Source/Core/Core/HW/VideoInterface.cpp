@@ -22,6 +22,7 @@
 #include "Core/HW/ProcessorInterface.h"
 #include "Core/HW/SI/SI.h"
 #include "Core/HW/SystemTimers.h"
+#include "Core/Rollback.h"
 
 #include "DiscIO/Enums.h"
 
@@ -711,7 +712,8 @@ static void BeginField(FieldType field, u64 ticks)
   // frame is scanning out.
   // To correctly handle that case we would need to collate all changes
   // to VI during scanout and delay outputting the frame till then.
-  if (xfbAddr)
+  // The frames run again after a rollback were presented already
+  if (xfbAddr && !Rollback::IsResimulating())
     g_video_backend->Video_BeginField(xfbAddr, fbWidth, fbStride, fbHeight, ticks);
 }
 
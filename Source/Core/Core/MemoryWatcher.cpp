@@ -2,13 +2,23 @@
 // Licensed under GPLv2+
 // Refer to the license.txt file included.
 
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
-#include <iostream>
 #include <memory>
+#include <set>
 #include <sstream>
+#include <sys/mman.h>
 #include <unistd.h>
 
+#include "Common/Align.h"
+#include "Common/Config/Config.h"
 #include "Common/FileUtil.h"
+#include "Common/Logging/Log.h"
+#include "Common/StringUtil.h"
+#include "Common/Swap.h"
+#include "Core/Config/MainSettings.h"
 #include "Core/CoreTiming.h"
 #include "Core/HW/Memmap.h"
 #include "Core/HW/SystemTimers.h"
@@ -16,8 +26,28 @@
 
 static std::unique_ptr<MemoryWatcher> s_memory_watcher;
 static CoreTiming::EventType* s_event;
+static bool s_frame_sync = false;
 static const int MW_RATE = 600;  // Steps per second
 
+static constexpr u32 SHARED_MEMORY_MAGIC = 0x4d53574d;  // "MWSM"
+static constexpr u32 SHARED_MEMORY_VERSION = 1;
+// Enough snapshots for a reader to copy one before the writer comes back to it
+static constexpr u32 SHARED_MEMORY_SLOTS = 16;
+
+struct SlotHeader
+{
+  u64 sequence;
+  u64 frame;
+};
+
+// The values are u64 aligned in the mapping, and lock-free atomics don't depend on the address
+// they live at, so readers in other processes see the same atomic accesses.
+static std::atomic<u64>& AtomicU64(u64* value)
+{
+  static_assert(sizeof(std::atomic<u64>) == sizeof(u64), "Unexpected atomic layout");
+  return *reinterpret_cast<std::atomic<u64>*>(value);
+}
+
 static void MWCallback(u64 userdata, s64 cyclesLate)
 {
   s_memory_watcher->Step();
@@ -27,8 +57,10 @@ static void MWCallback(u64 userdata, s64 cyclesLate)
 void MemoryWatcher::Init()
 {
   s_memory_watcher = std::make_unique<MemoryWatcher>();
+  s_frame_sync = Config::Get(Config::MAIN_MEMORY_WATCHER_FRAME_SYNC);
   s_event = CoreTiming::RegisterEvent("MemoryWatcher", MWCallback);
-  CoreTiming::ScheduleEvent(0, s_event);
+  if (!s_frame_sync)
+    CoreTiming::ScheduleEvent(0, s_event);
 }
 
 void MemoryWatcher::Shutdown()
@@ -37,13 +69,32 @@ void MemoryWatcher::Shutdown()
   s_memory_watcher.reset();
 }
 
+void MemoryWatcher::FrameUpdate()
+{
+  if (!s_memory_watcher)
+    return;
+
+  // Counted in both modes, the fixed rate steps don't line up with the fields
+  s_memory_watcher->m_frame++;
+  if (s_frame_sync)
+    s_memory_watcher->Step();
+}
+
 MemoryWatcher::MemoryWatcher()
 {
   m_running = false;
   if (!LoadAddresses(File::GetUserPath(F_MEMORYWATCHERLOCATIONS_IDX)))
     return;
-  if (!OpenSocket(File::GetUserPath(F_MEMORYWATCHERSOCKET_IDX)))
+  m_shared_memory = Config::Get(Config::MAIN_MEMORY_WATCHER_SHARED_MEMORY);
+  if (m_shared_memory)
+  {
+    if (!OpenSharedMemory(File::GetUserPath(F_MEMORYWATCHERSHAREDMEMORY_IDX)))
+      return;
+  }
+  else if (!OpenSocket(File::GetUserPath(F_MEMORYWATCHERSOCKET_IDX)))
+  {
     return;
+  }
   m_running = true;
 }
 
@@ -53,7 +104,10 @@ MemoryWatcher::~MemoryWatcher()
     return;
 
   m_running = false;
-  close(m_fd);
+  if (m_ring)
+    munmap(m_ring, m_ring_size);
+  if (m_fd >= 0)
+    close(m_fd);
 }
 
 bool MemoryWatcher::LoadAddresses(const std::string& path)
@@ -62,23 +116,40 @@ bool MemoryWatcher::LoadAddresses(const std::string& path)
   if (!locations)
     return false;
 
+  // A line listed again is watched once, its value would only be sent twice
+  std::set<std::string> lines;
   std::string line;
   while (std::getline(locations, line))
-    ParseLine(line);
+  {
+    if (lines.insert(line).second)
+      ParseLine(line);
+  }
+  m_node_ids.clear();
 
-  return m_values.size() > 0;
+  m_node_values.resize(m_plan.size());
+  m_values.assign(m_watches.size(), 0);
+  m_new_values.resize(m_watches.size());
+  return m_watches.size() > 0;
 }
 
 void MemoryWatcher::ParseLine(const std::string& line)
 {
-  m_values[line] = 0;
-  m_addresses[line] = std::vector<u32>();
+  Watch watch;
+  watch.line = line;
+  watch.node = NO_NODE;
 
   std::stringstream offsets(line);
   offsets >> std::hex;
   u32 offset;
   while (offsets >> offset)
-    m_addresses[line].push_back(offset);
+  {
+    auto inserted =
+        m_node_ids.emplace(std::make_pair(watch.node, offset), static_cast<u32>(m_plan.size()));
+    if (inserted.second)
+      m_plan.push_back({watch.node, offset});
+    watch.node = inserted.first->second;
+  }
+  m_watches.push_back(std::move(watch));
 }
 
 bool MemoryWatcher::OpenSocket(const std::string& path)
@@ -91,19 +162,90 @@ bool MemoryWatcher::OpenSocket(const std::string& path)
   return m_fd >= 0;
 }
 
-u32 MemoryWatcher::ChasePointer(const std::string& line)
+bool MemoryWatcher::OpenSharedMemory(const std::string& path)
+{
+  m_slot_size = Common::AlignUp(sizeof(SlotHeader) + m_watches.size() * sizeof(u32), sizeof(u64));
+  m_ring_size = sizeof(SharedMemoryHeader) + SHARED_MEMORY_SLOTS * m_slot_size;
+
+  int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+  {
+    ERROR_LOG(CORE, "Failed to open the memory watcher shared memory %s", path.c_str());
+    return false;
+  }
+  void* ring = MAP_FAILED;
+  if (ftruncate(fd, 0) == 0 && ftruncate(fd, m_ring_size) == 0)
+    ring = mmap(nullptr, m_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ring == MAP_FAILED)
+  {
+    ERROR_LOG(CORE, "Failed to map the memory watcher shared memory %s", path.c_str());
+    return false;
+  }
+  m_ring = static_cast<u8*>(ring);
+
+  SharedMemoryHeader* header = reinterpret_cast<SharedMemoryHeader*>(m_ring);
+  header->version = SHARED_MEMORY_VERSION;
+  header->value_count = static_cast<u32>(m_watches.size());
+  header->slot_count = SHARED_MEMORY_SLOTS;
+  AtomicU64(&header->latest_sequence).store(0, std::memory_order_relaxed);
+  // Readers check the magic last
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = SHARED_MEMORY_MAGIC;
+  return true;
+}
+
+// Same mapping as Memory::GetPointer, but a bad pointer in the game reads as 0 instead of
+// raising a panic alert on every step
+static u32 ReadRAM_U32(u32 address)
 {
-  u32 value = 0;
-  for (u32 offset : m_addresses[line])
-    value = Memory::Read_U32(value + offset);
-  return value;
+  address &= 0x3FFFFFFF;
+  if (address <= Memory::REALRAM_SIZE - sizeof(u32))
+    return Common::swap32(Memory::m_pRAM + address);
+  if (Memory::m_pEXRAM && (address >> 28) == 0x1 &&
+      (address & 0x0FFFFFFF) <= Memory::EXRAM_SIZE - sizeof(u32))
+  {
+    return Common::swap32(Memory::m_pEXRAM + (address & Memory::EXRAM_MASK));
+  }
+  return 0;
+}
+
+void MemoryWatcher::RunPlan()
+{
+  const ChaseNode* plan = m_plan.data();
+  u32* node_values = m_node_values.data();
+  for (size_t i = 0; i < m_plan.size(); i++)
+  {
+    const u32 base = plan[i].parent == NO_NODE ? 0 : node_values[plan[i].parent];
+    node_values[i] = ReadRAM_U32(base + plan[i].offset);
+  }
+
+  for (size_t i = 0; i < m_watches.size(); i++)
+  {
+    const u32 node = m_watches[i].node;
+    m_new_values[i] = node == NO_NODE ? 0 : node_values[node];
+  }
 }
 
 std::string MemoryWatcher::ComposeMessage(const std::string& line, u32 value)
 {
-  std::stringstream message_stream;
-  message_stream << line << '\n' << std::hex << value;
-  return message_stream.str();
+  return StringFromFormat("%s\n%x", line.c_str(), value);
+}
+
+void MemoryWatcher::Publish()
+{
+  const u64 sequence = ++m_sequence;
+  u8* slot = m_ring + sizeof(SharedMemoryHeader) + (sequence % SHARED_MEMORY_SLOTS) * m_slot_size;
+  SlotHeader* slot_header = reinterpret_cast<SlotHeader*>(slot);
+
+  AtomicU64(&slot_header->sequence).store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot_header->frame = m_frame;
+  memcpy(slot + sizeof(SlotHeader), m_values.data(), m_values.size() * sizeof(u32));
+  AtomicU64(&slot_header->sequence).store(sequence, std::memory_order_release);
+
+  SharedMemoryHeader* header = reinterpret_cast<SharedMemoryHeader*>(m_ring);
+  AtomicU64(&header->latest_sequence).store(sequence, std::memory_order_release);
 }
 
 void MemoryWatcher::Step()
@@ -111,19 +253,27 @@ void MemoryWatcher::Step()
   if (!m_running)
     return;
 
-  for (auto& entry : m_values)
+  RunPlan();
+  if (m_shared_memory)
   {
-    std::string address = entry.first;
-    u32& current_value = entry.second;
-
-    u32 new_value = ChasePointer(address);
-    if (new_value != current_value)
-    {
-      // Update the value
-      current_value = new_value;
-      std::string message = ComposeMessage(address, new_value);
-      sendto(m_fd, message.c_str(), message.size() + 1, 0, reinterpret_cast<sockaddr*>(&m_addr),
-             sizeof(m_addr));
-    }
+    m_values.swap(m_new_values);
+    Publish();
+    return;
+  }
+
+  // Nothing to send on most steps, check that before looking at the values one by one
+  const size_t size = m_values.size() * sizeof(u32);
+  if (memcmp(m_values.data(), m_new_values.data(), size) == 0)
+    return;
+
+  for (size_t i = 0; i < m_values.size(); i++)
+  {
+    if (m_new_values[i] == m_values[i])
+      continue;
+
+    std::string message = ComposeMessage(m_watches[i].line, m_new_values[i]);
+    sendto(m_fd, message.c_str(), message.size() + 1, 0, reinterpret_cast<sockaddr*>(&m_addr),
+           sizeof(m_addr));
   }
+  m_values.swap(m_new_values);
 }
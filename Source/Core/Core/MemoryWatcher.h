@@ -5,10 +5,14 @@
 #pragma once
 
 #include <map>
+#include <string>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <utility>
 #include <vector>
 
+#include "Common/CommonTypes.h"
+
 // MemoryWatcher reads a file containing in-game memory addresses and outputs
 // changes to those memory addresses to a unix domain socket as the game runs.
 //
@@ -17,31 +21,92 @@
 // "ABCD EF" will watch the address at (*0xABCD) + 0xEF.
 // The output to the socket is two lines. The first is the address from the
 // input file, and the second is the new value in hex.
+//
+// With MemoryWatcherSharedMemory set, every step publishes all the values instead,
+// in a ring of snapshots in the SharedMemory file next to the socket, which readers
+// map to poll the values without any system call. The layout, in host byte order:
+//   SharedMemoryHeader
+//   slot_count slots of: u64 sequence, u64 frame, u32 values[value_count],
+//                        padded to 8 bytes
+// values[i] is the value of line i of the input file, where a repeated line only counts
+// the first time, and frame is the number of fields emulated so far. Snapshot n (starting at 1)
+// goes to slot n % slot_count and latest_sequence is set to n once it is complete.
+// The slot sequence is 0 while the slot is written, so a reader copies the slot and
+// keeps the copy if the slot sequence was n before and after the copy.
+//
+// With MemoryWatcherFrameSync set, the values are sampled once per field instead of
+// at a fixed rate.
+//
+// The input file is compiled into a chase plan when it is loaded. Every distinct pointer
+// prefix is a node that is read once per step, so watches that go through the same
+// pointers share those reads. The nodes come after their parent, which makes a step a
+// single pass over the plan followed by a diff against the previous values.
 class MemoryWatcher final
 {
 public:
+  struct SharedMemoryHeader
+  {
+    u32 magic;
+    u32 version;
+    u32 value_count;
+    u32 slot_count;
+    u64 latest_sequence;
+  };
+
   MemoryWatcher();
   ~MemoryWatcher();
   void Step();
 
   static void Init();
   static void Shutdown();
+  static void FrameUpdate();
 
 private:
+  // The value of a node is the u32 at the value of its parent (0 for the roots) + offset
+  struct ChaseNode
+  {
+    u32 parent;
+    u32 offset;
+  };
+
+  struct Watch
+  {
+    std::string line;
+    // NO_NODE for a line without any address, its value stays 0
+    u32 node;
+  };
+
+  static constexpr u32 NO_NODE = 0xFFFFFFFF;
+
   bool LoadAddresses(const std::string& path);
   bool OpenSocket(const std::string& path);
+  bool OpenSharedMemory(const std::string& path);
 
   void ParseLine(const std::string& line);
-  u32 ChasePointer(const std::string& line);
+  void RunPlan();
   std::string ComposeMessage(const std::string& line, u32 value);
+  void Publish();
 
   bool m_running;
+  bool m_shared_memory = false;
 
-  int m_fd;
+  int m_fd = -1;
   sockaddr_un m_addr;
 
-  // Address as stored in the file -> list of offsets to follow
-  std::map<std::string, std::vector<u32>> m_addresses;
-  // Address as stored in the file -> current value
-  std::map<std::string, u32> m_values;
+  u8* m_ring = nullptr;
+  size_t m_ring_size = 0;
+  size_t m_slot_size = 0;
+  u64 m_sequence = 0;
+  u64 m_frame = 0;
+
+  // In the order of the input file
+  std::vector<Watch> m_watches;
+  std::vector<ChaseNode> m_plan;
+  // Only used while loading, to find the nodes shared with earlier lines
+  std::map<std::pair<u32, u32>, u32> m_node_ids;
+
+  // Scratch space of the steps, indexed like m_plan and m_watches
+  std::vector<u32> m_node_values;
+  std::vector<u32> m_values;
+  std::vector<u32> m_new_values;
 };
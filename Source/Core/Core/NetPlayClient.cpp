@@ -5,6 +5,7 @@
 #include "Core/NetPlayClient.h"
 
 #include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <memory>
 #include <mutex>
@@ -17,6 +18,7 @@
 #include "Common/CommonPaths.h"
 #include "Common/CommonTypes.h"
 #include "Common/ENetUtil.h"
+#include "Common/Logging/Log.h"
 #include "Common/MD5.h"
 #include "Common/MsgHandler.h"
 #include "Common/StringUtil.h"
@@ -32,6 +34,7 @@
 #include "Core/HW/WiimoteReal/WiimoteReal.h"
 #include "Core/IOS/USB/Bluetooth/BTEmu.h"
 #include "Core/Movie.h"
+#include "Core/Rollback.h"
 #include "InputCommon/GCAdapter.h"
 #include "VideoCommon/OnScreenDisplay.h"
 #include "VideoCommon/VideoConfig.h"
@@ -40,6 +43,9 @@ static std::mutex crit_netplay_client;
 static NetPlayClient* netplay_client = nullptr;
 NetSettings g_NetPlaySettings;
 
+// How long a poll waits on the other pads before sending the local frames again
+static constexpr std::chrono::milliseconds PAD_FRAMES_RESEND_INTERVAL{10};
+
 // called from ---GUI--- thread
 NetPlayClient::~NetPlayClient()
 {
@@ -335,6 +341,62 @@ unsigned int NetPlayClient::OnData(sf::Packet& packet)
   }
   break;
 
+  case NP_MSG_PAD_FRAMES:
+  {
+    std::vector<NetPlay::PadFramesEntry> entries;
+    if (!NetPlay::ReadPadFramesEntries(packet, &entries))
+      break;
+
+    {
+      std::lock_guard<std::recursive_mutex> lkf(m_crit.pad_frames);
+      for (const NetPlay::PadFramesEntry& entry : entries)
+      {
+        // Trusting server for good map value (>=0 && <4)
+        auto& buffer = m_pad_buffer.at(entry.map);
+        NetPlay::PadFrames& frames = m_pad_frames.at(entry.map);
+        // With rollback, the frames are read by their number instead
+        const auto on_new = [&buffer](const GCPadStatus& pad) {
+          if (!g_NetPlaySettings.m_RollbackFrames)
+            buffer.Push(pad);
+        };
+        if (!frames.Receive(entry, on_new) && frames.TakeRequest())
+        {
+          sf::Packet request_packet;
+          request_packet << static_cast<MessageId>(NP_MSG_PAD_FRAMES_REQUEST);
+          request_packet << entry.map << frames.End();
+          Send(request_packet);
+        }
+      }
+    }
+    m_gc_pad_event.Set();
+  }
+  break;
+
+  case NP_MSG_PAD_FRAMES_REQUEST:
+  {
+    PadMapping map = 0;
+    FrameNum first = 0;
+    packet >> map >> first;
+
+    std::lock_guard<std::recursive_mutex> lkf(m_crit.pad_frames);
+    // The server fell further behind than the history, the game can't go on
+    if (!m_pad_frames.at(map).HasFrom(first))
+    {
+      ERROR_LOG(NETPLAY, "The server asked for pad %d frame %u, which is no longer kept", map,
+                first);
+      m_dialog->OnDesync(first, m_local_player->name);
+      sf::Packet stop_packet;
+      stop_packet << static_cast<MessageId>(NP_MSG_STOP_GAME);
+      Send(stop_packet);
+      break;
+    }
+
+    sf::Packet entries;
+    const u8 entry_count = m_pad_frames.at(map).WriteEntries(entries, map, first);
+    Send(NetPlay::MakePadFramesPacket(entry_count, entries));
+  }
+  break;
+
   case NP_MSG_WIIMOTE_DATA:
   {
     PadMapping map = 0;
@@ -427,6 +489,8 @@ unsigned int NetPlayClient::OnData(sf::Packet& packet)
       g_NetPlaySettings.m_EXIDevice[0] = static_cast<ExpansionInterface::TEXIDevices>(tmp);
       packet >> tmp;
       g_NetPlaySettings.m_EXIDevice[1] = static_cast<ExpansionInterface::TEXIDevices>(tmp);
+      packet >> g_NetPlaySettings.m_PadRedundancy;
+      packet >> g_NetPlaySettings.m_RollbackFrames;
 
       u32 time_low, time_high;
       packet >> time_low;
@@ -566,10 +630,9 @@ unsigned int NetPlayClient::OnData(sf::Packet& packet)
   return 0;
 }
 
-void NetPlayClient::Send(const sf::Packet& packet)
+void NetPlayClient::Send(const sf::Packet& packet, u32 flags)
 {
-  ENetPacket* epac =
-      enet_packet_create(packet.getData(), packet.getDataSize(), ENET_PACKET_FLAG_RELIABLE);
+  ENetPacket* epac = enet_packet_create(packet.getData(), packet.getDataSize(), flags);
   enet_peer_send(m_server, 0, epac);
 }
 
@@ -620,11 +683,11 @@ void NetPlayClient::Disconnect()
   m_server = nullptr;
 }
 
-void NetPlayClient::SendAsync(sf::Packet&& packet)
+void NetPlayClient::SendAsync(sf::Packet&& packet, u32 flags)
 {
   {
     std::lock_guard<std::recursive_mutex> lkq(m_crit.async_queue_write);
-    m_async_queue.Push(std::move(packet));
+    m_async_queue.Push(std::make_pair(std::move(packet), flags));
   }
   ENetUtil::WakeupThread(m_client);
 }
@@ -641,7 +704,7 @@ void NetPlayClient::ThreadFunc()
     net = enet_host_service(m_client, &netEvent, 250);
     while (!m_async_queue.Empty())
     {
-      Send(m_async_queue.Front());
+      Send(m_async_queue.Front().first, m_async_queue.Front().second);
       m_async_queue.Pop();
     }
     if (net > 0)
@@ -758,6 +821,26 @@ void NetPlayClient::SendPadState(const int in_game_pad, const GCPadStatus& pad)
   SendAsync(std::move(packet));
 }
 
+// called from ---CPU--- thread
+void NetPlayClient::SendPadFrames()
+{
+  sf::Packet entries;
+  u8 entry_count = 0;
+  {
+    std::lock_guard<std::recursive_mutex> lkf(m_crit.pad_frames);
+    const int num_local_pads = NumLocalPads();
+    for (int local_pad = 0; local_pad < num_local_pads; local_pad++)
+    {
+      const PadMapping ingame_pad = static_cast<PadMapping>(LocalPadToInGamePad(local_pad));
+      entry_count += m_pad_frames[ingame_pad].WriteNewest(entries, ingame_pad,
+                                                          g_NetPlaySettings.m_PadRedundancy);
+    }
+  }
+
+  if (entry_count > 0)
+    SendAsync(NetPlay::MakePadFramesPacket(entry_count, entries), ENET_PACKET_FLAG_UNSEQUENCED);
+}
+
 // called from ---CPU--- thread
 void NetPlayClient::SendWiimoteState(const int in_game_pad, const NetWiimote& nw)
 {
@@ -891,6 +974,11 @@ void NetPlayClient::ClearBuffers()
     while (m_wiimote_buffer[i].Size())
       m_wiimote_buffer[i].Pop();
   }
+
+  std::lock_guard<std::recursive_mutex> lkf(m_crit.pad_frames);
+  for (NetPlay::PadFrames& frames : m_pad_frames)
+    frames.Clear();
+  m_rollback_checked.fill(0);
 }
 
 // called from ---NETPLAY--- thread
@@ -942,6 +1030,27 @@ void NetPlayClient::OnConnectFailed(u8 reason)
   }
 }
 
+static GCPadStatus GetLocalPadStatus(int local_pad)
+{
+  switch (SConfig::GetInstance().m_SIDevice[local_pad])
+  {
+  case SerialInterface::SIDEVICE_WIIU_ADAPTER:
+    return GCAdapter::Input(local_pad);
+  case SerialInterface::SIDEVICE_GC_CONTROLLER:
+  default:
+    return Pad::GetStatus(local_pad);
+  }
+}
+
+// Only the fields that go over the network
+static bool IsSamePadStatus(const GCPadStatus& a, const GCPadStatus& b)
+{
+  return a.button == b.button && a.analogA == b.analogA && a.analogB == b.analogB &&
+         a.stickX == b.stickX && a.stickY == b.stickY && a.substickX == b.substickX &&
+         a.substickY == b.substickY && a.triggerLeft == b.triggerLeft &&
+         a.triggerRight == b.triggerRight;
+}
+
 // called from ---CPU--- thread
 bool NetPlayClient::GetNetPads(const int pad_nb, GCPadStatus* pad_status)
 {
@@ -966,21 +1075,15 @@ bool NetPlayClient::GetNetPads(const int pad_nb, GCPadStatus* pad_status)
   // will be polled as well. To reduce latency, we poll all local
   // controllers at once and then send the status to the other
   // clients.
+  if (g_NetPlaySettings.m_RollbackFrames)
+    return GetRollbackPads(pad_nb, pad_status);
+
   if (IsFirstInGamePad(pad_nb))
   {
     const int num_local_pads = NumLocalPads();
     for (int local_pad = 0; local_pad < num_local_pads; local_pad++)
     {
-      switch (SConfig::GetInstance().m_SIDevice[local_pad])
-      {
-      case SerialInterface::SIDEVICE_WIIU_ADAPTER:
-        *pad_status = GCAdapter::Input(local_pad);
-        break;
-      case SerialInterface::SIDEVICE_GC_CONTROLLER:
-      default:
-        *pad_status = Pad::GetStatus(local_pad);
-        break;
-      }
+      *pad_status = GetLocalPadStatus(local_pad);
 
       int ingame_pad = LocalPadToInGamePad(local_pad);
 
@@ -992,9 +1095,21 @@ bool NetPlayClient::GetNetPads(const int pad_nb, GCPadStatus* pad_status)
         m_pad_buffer[ingame_pad].Push(*pad_status);
 
         // send
-        SendPadState(ingame_pad, *pad_status);
+        if (g_NetPlaySettings.m_PadRedundancy)
+        {
+          std::lock_guard<std::recursive_mutex> lkf(m_crit.pad_frames);
+          m_pad_frames[ingame_pad].Push(*pad_status);
+        }
+        else
+        {
+          SendPadState(ingame_pad, *pad_status);
+        }
       }
     }
+
+    // All the local pads go in one packet, with the frames the others may have missed
+    if (g_NetPlaySettings.m_PadRedundancy)
+      SendPadFrames();
   }
 
   // Now, we either use the data pushed earlier, or wait for the
@@ -1006,7 +1121,11 @@ bool NetPlayClient::GetNetPads(const int pad_nb, GCPadStatus* pad_status)
       return false;
     }
 
-    m_gc_pad_event.Wait();
+    if (!g_NetPlaySettings.m_PadRedundancy)
+      m_gc_pad_event.Wait();
+    // Nothing is resent on its own, the others may be stuck waiting for a lost packet as well
+    else if (!m_gc_pad_event.WaitFor(PAD_FRAMES_RESEND_INTERVAL))
+      SendPadFrames();
   }
 
   m_pad_buffer[pad_nb].Pop(*pad_status);
@@ -1024,6 +1143,129 @@ bool NetPlayClient::GetNetPads(const int pad_nb, GCPadStatus* pad_status)
   return true;
 }
 
+// With rollback, the local pads are not delayed by the pad buffer. The inputs of the others that
+// did not arrive yet are predicted to stay the same, and the frames are run again with the real
+// ones once they arrive. Only the frames too old to be rolled back are waited for.
+// called from ---CPU--- thread
+bool NetPlayClient::GetRollbackPads(const int pad_nb, GCPadStatus* pad_status)
+{
+  if (IsFirstInGamePad(pad_nb))
+  {
+    const FrameNum frame = Rollback::BeginFrame();
+    if (!Rollback::IsResimulating())
+    {
+      {
+        std::lock_guard<std::recursive_mutex> lkf(m_crit.pad_frames);
+        const int num_local_pads = NumLocalPads();
+        for (int local_pad = 0; local_pad < num_local_pads; local_pad++)
+          m_pad_frames[LocalPadToInGamePad(local_pad)].Push(GetLocalPadStatus(local_pad));
+      }
+      SendPadFrames();
+
+      if (!WaitForRollbackFrames(frame))
+        return false;
+      CheckRollbackPredictions(frame);
+    }
+
+    std::lock_guard<std::recursive_mutex> lkf(m_crit.pad_frames);
+    for (size_t i = 0; i < m_rollback_pads.size(); i++)
+    {
+      const NetPlay::PadFrames& frames = m_pad_frames[i];
+      GCPadStatus& pad = m_rollback_pads[i];
+      if (frames.End() > frame)
+      {
+        pad = frames.Get(frame);
+      }
+      else if (frames.End() > 0)
+      {
+        pad = frames.Get(frames.End() - 1);
+      }
+      else
+      {
+        pad = {};
+        pad.stickX = GCPadStatus::MAIN_STICK_CENTER_X;
+        pad.stickY = GCPadStatus::MAIN_STICK_CENTER_Y;
+        pad.substickX = GCPadStatus::C_STICK_CENTER_X;
+        pad.substickY = GCPadStatus::C_STICK_CENTER_Y;
+      }
+      m_rollback_used[i][frame % NetPlay::PadFrames::HISTORY_SIZE] = pad;
+    }
+  }
+
+  *pad_status = m_rollback_pads[pad_nb];
+
+  // The frames that run again were recorded the first time
+  if (Rollback::IsResimulating())
+    return true;
+
+  if (Movie::IsRecordingInput())
+  {
+    Movie::RecordInput(pad_status, pad_nb);
+    Movie::InputUpdate();
+  }
+  else
+  {
+    Movie::CheckPadStatus(pad_status, pad_nb);
+  }
+
+  return true;
+}
+
+// The state before the oldest frame that may still be wrong has to be kept
+// called from ---CPU--- thread
+bool NetPlayClient::WaitForRollbackFrames(const FrameNum frame)
+{
+  const u32 max_frames = Rollback::GetMaxFrames();
+  // The first frame is never predicted, there is nothing to predict it from
+  const FrameNum needed_end = frame >= max_frames ? frame - max_frames + 1 : 1;
+  const auto has_needed_frames = [this, needed_end] {
+    std::lock_guard<std::recursive_mutex> lkf(m_crit.pad_frames);
+    for (size_t i = 0; i < m_pad_frames.size(); i++)
+    {
+      if (m_pad_map[i] > 0 && m_pad_frames[i].End() < needed_end)
+        return false;
+    }
+    return true;
+  };
+
+  while (!has_needed_frames())
+  {
+    if (!m_is_running.IsSet())
+      return false;
+
+    if (!m_gc_pad_event.WaitFor(PAD_FRAMES_RESEND_INTERVAL))
+      SendPadFrames();
+  }
+  return true;
+}
+
+// Compares the frames received since the last check with the inputs they ran with
+// called from ---CPU--- thread
+void NetPlayClient::CheckRollbackPredictions(const FrameNum frame)
+{
+  std::lock_guard<std::recursive_mutex> lkf(m_crit.pad_frames);
+  bool mispredicted = false;
+  FrameNum earliest = frame;
+  for (size_t i = 0; i < m_pad_frames.size(); i++)
+  {
+    const FrameNum end = std::min(m_pad_frames[i].End(), frame);
+    for (FrameNum checked = m_rollback_checked[i]; checked < end; checked++)
+    {
+      if (!IsSamePadStatus(m_pad_frames[i].Get(checked),
+                           m_rollback_used[i][checked % NetPlay::PadFrames::HISTORY_SIZE]))
+      {
+        earliest = std::min(earliest, checked);
+        mispredicted = true;
+        break;
+      }
+    }
+    m_rollback_checked[i] = std::max(m_rollback_checked[i], end);
+  }
+
+  if (mispredicted)
+    Rollback::Mispredicted(earliest);
+}
+
 // called from ---CPU--- thread
 bool NetPlayClient::WiimoteUpdate(int _number, u8* data, const u8 size, u8 reporting_mode)
 {
@@ -10,11 +10,13 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 #include "Common/CommonTypes.h"
 #include "Common/Event.h"
 #include "Common/FifoQueue.h"
 #include "Common/TraversalClient.h"
+#include "Core/NetPlayPadFrames.h"
 #include "Core/NetPlayProto.h"
 #include "InputCommon/GCPadStatus.h"
 
@@ -64,7 +66,7 @@ class NetPlayClient : public TraversalClientClient
 {
 public:
   void ThreadFunc();
-  void SendAsync(sf::Packet&& packet);
+  void SendAsync(sf::Packet&& packet, u32 flags = ENET_PACKET_FLAG_RELIABLE);
 
   NetPlayClient(const std::string& address, const u16 port, NetPlayUI* dialog,
                 const std::string& name, const NetTraversalConfig& traversal_config);
@@ -106,12 +108,20 @@ protected:
     std::recursive_mutex game;
     // lock order
     std::recursive_mutex players;
+    std::recursive_mutex pad_frames;
     std::recursive_mutex async_queue_write;
   } m_crit;
 
-  Common::FifoQueue<sf::Packet, false> m_async_queue;
+  // Packets and their ENet flags
+  Common::FifoQueue<std::pair<sf::Packet, u32>, false> m_async_queue;
 
   std::array<Common::FifoQueue<GCPadStatus>, 4> m_pad_buffer;
+  // With pad redundancy, the frames sent for the local pads and received for the others
+  std::array<NetPlay::PadFrames, 4> m_pad_frames;
+  // With rollback, the inputs each frame ran with, to find out which ones were mispredicted
+  std::array<std::array<GCPadStatus, NetPlay::PadFrames::HISTORY_SIZE>, 4> m_rollback_used;
+  std::array<FrameNum, 4> m_rollback_checked{};
+  std::array<GCPadStatus, 4> m_rollback_pads{};
   std::array<Common::FifoQueue<NetWiimote>, 4> m_wiimote_buffer;
 
   NetPlayUI* m_dialog = nullptr;
@@ -153,9 +163,13 @@ private:
 
   void UpdateDevices();
   void SendPadState(int in_game_pad, const GCPadStatus& np);
+  void SendPadFrames();
+  bool GetRollbackPads(int pad_nb, GCPadStatus* pad_status);
+  bool WaitForRollbackFrames(FrameNum frame);
+  void CheckRollbackPredictions(FrameNum frame);
   void SendWiimoteState(int in_game_pad, const NetWiimote& nw);
   unsigned int OnData(sf::Packet& packet);
-  void Send(const sf::Packet& packet);
+  void Send(const sf::Packet& packet, u32 flags = ENET_PACKET_FLAG_RELIABLE);
   void Disconnect();
   bool Connect();
   void ComputeMD5(const std::string& file_identifier);
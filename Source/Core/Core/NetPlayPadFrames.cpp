@@ -0,0 +1,108 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Core/NetPlayPadFrames.h"
+
+#include <algorithm>
+
+namespace NetPlay
+{
+// An entry has a u8 frame count
+static constexpr u32 MAX_ENTRY_FRAMES = 0xFF;
+
+bool ReadPadFramesEntries(sf::Packet& packet, std::vector<PadFramesEntry>* entries)
+{
+  u8 entry_count = 0;
+  packet >> entry_count;
+  entries->resize(entry_count);
+  for (PadFramesEntry& entry : *entries)
+  {
+    u8 frame_count = 0;
+    packet >> entry.map >> entry.first >> frame_count;
+    entry.pads.resize(frame_count);
+    for (GCPadStatus& pad : entry.pads)
+    {
+      pad = {};
+      packet >> pad.button >> pad.analogA >> pad.analogB >> pad.stickX >> pad.stickY >>
+          pad.substickX >> pad.substickY >> pad.triggerLeft >> pad.triggerRight;
+    }
+  }
+  return static_cast<bool>(packet);
+}
+
+sf::Packet MakePadFramesPacket(u8 entry_count, const sf::Packet& entries)
+{
+  sf::Packet packet;
+  packet << static_cast<MessageId>(NP_MSG_PAD_FRAMES);
+  packet << entry_count;
+  packet.append(entries.getData(), entries.getDataSize());
+  return packet;
+}
+
+void PadFrames::Clear()
+{
+  m_end = 0;
+  m_requested = false;
+}
+
+void PadFrames::Push(const GCPadStatus& pad)
+{
+  m_frames[m_end % HISTORY_SIZE] = pad;
+  m_end++;
+}
+
+u8 PadFrames::WriteEntries(sf::Packet& packet, PadMapping map, FrameNum first) const
+{
+  // The frames before that are overwritten
+  if (m_end > HISTORY_SIZE)
+    first = std::max(first, m_end - HISTORY_SIZE);
+
+  u8 entry_count = 0;
+  while (first < m_end)
+  {
+    const u8 frame_count = static_cast<u8>(std::min(m_end - first, MAX_ENTRY_FRAMES));
+    packet << map << first << frame_count;
+    for (FrameNum frame = first; frame < first + frame_count; frame++)
+    {
+      const GCPadStatus& pad = m_frames[frame % HISTORY_SIZE];
+      packet << pad.button << pad.analogA << pad.analogB << pad.stickX << pad.stickY
+             << pad.substickX << pad.substickY << pad.triggerLeft << pad.triggerRight;
+    }
+    first += frame_count;
+    entry_count++;
+  }
+  return entry_count;
+}
+
+u8 PadFrames::WriteNewest(sf::Packet& packet, PadMapping map, u32 count) const
+{
+  count = std::min(count, MAX_ENTRY_FRAMES);
+  return WriteEntries(packet, map, m_end > count ? m_end - count : 0);
+}
+
+bool PadFrames::Receive(const PadFramesEntry& entry,
+                        const std::function<void(const GCPadStatus&)>& on_new)
+{
+  if (entry.first > m_end)
+    return false;
+
+  for (size_t i = m_end - entry.first; i < entry.pads.size(); i++)
+  {
+    Push(entry.pads[i]);
+    if (on_new)
+      on_new(entry.pads[i]);
+  }
+  return true;
+}
+
+bool PadFrames::TakeRequest()
+{
+  if (m_requested && m_requested_end == m_end)
+    return false;
+
+  m_requested = true;
+  m_requested_end = m_end;
+  return true;
+}
+}
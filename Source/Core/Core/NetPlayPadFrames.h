@@ -0,0 +1,79 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <SFML/Network/Packet.hpp>
+#include <array>
+#include <functional>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Core/NetPlayProto.h"
+#include "InputCommon/GCPadStatus.h"
+
+// With a pad redundancy of N, the pad states are sent unreliably in NP_MSG_PAD_FRAMES packets
+// instead of one reliable NP_MSG_PAD_DATA per state. Every packet carries the newest N frames
+// of each pad of the sender, numbered from the start of the game, so a lost or late packet is
+// made up by the next one instead of holding back the following packets until ENet resends it.
+// A receiver that still finds a gap asks for the missing frames with a reliable
+// NP_MSG_PAD_FRAMES_REQUEST, which is answered with a reliable NP_MSG_PAD_FRAMES.
+//
+// NP_MSG_PAD_FRAMES: u8 entry count, then for each entry:
+//   PadMapping in-game pad, FrameNum first frame, u8 frame count, GCPadStatus of each frame
+// NP_MSG_PAD_FRAMES_REQUEST: PadMapping in-game pad, FrameNum first missing frame
+// A request for frames the sender no longer has ends the game with a desync, since no one can
+// give the receiver the inputs it needs to keep going.
+namespace NetPlay
+{
+struct PadFramesEntry
+{
+  PadMapping map;
+  FrameNum first;
+  std::vector<GCPadStatus> pads;
+};
+
+// Returns false if the packet is too short
+bool ReadPadFramesEntries(sf::Packet& packet, std::vector<PadFramesEntry>* entries);
+// Makes a NP_MSG_PAD_FRAMES packet out of entries written by PadFrames
+sf::Packet MakePadFramesPacket(u8 entry_count, const sf::Packet& entries);
+
+// The recent frames of one in-game pad
+class PadFrames
+{
+public:
+  // Enough for a request to come back while the game keeps going
+  static constexpr u32 HISTORY_SIZE = 1024;
+
+  // The number the next frame will get
+  FrameNum End() const { return m_end; }
+  void Clear();
+  void Push(const GCPadStatus& pad);
+  // The frame has to be one of the last HISTORY_SIZE ones
+  const GCPadStatus& Get(FrameNum frame) const { return m_frames[frame % HISTORY_SIZE]; }
+  // False once the frame is overwritten, a request for it can never be answered then
+  bool HasFrom(FrameNum first) const
+  {
+    return m_end <= HISTORY_SIZE || first >= m_end - HISTORY_SIZE;
+  }
+
+  // Appends entries with the frames from first to the newest one, for a NP_MSG_PAD_FRAMES
+  // packet. Returns the number of entries.
+  u8 WriteEntries(sf::Packet& packet, PadMapping map, FrameNum first) const;
+  u8 WriteNewest(sf::Packet& packet, PadMapping map, u32 count) const;
+
+  // Keeps the frames of the entry that were not received yet, and passes them to on_new.
+  // Returns false if frames before the entry are missing, the entry is dropped then.
+  bool Receive(const PadFramesEntry& entry,
+               const std::function<void(const GCPadStatus&)>& on_new = {});
+  // True the first time it is called for a given gap, to send a single request for it
+  bool TakeRequest();
+
+private:
+  std::array<GCPadStatus, HISTORY_SIZE> m_frames;
+  FrameNum m_end = 0;
+  FrameNum m_requested_end = 0;
+  bool m_requested = false;
+};
+}
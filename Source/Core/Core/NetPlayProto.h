@@ -25,6 +25,10 @@ struct NetSettings
   bool m_OCEnable;
   float m_OCFactor;
   ExpansionInterface::TEXIDevices m_EXIDevice[2];
+  // Frames of redundancy in the pad packets, 0 sends every pad state reliably on its own
+  u32 m_PadRedundancy;
+  // Frames of rollback, 0 hides the latency with the pad buffer only
+  u32 m_RollbackFrames;
 };
 
 struct NetTraversalConfig
@@ -60,6 +64,8 @@ enum
   NP_MSG_PAD_DATA = 0x60,
   NP_MSG_PAD_MAPPING = 0x61,
   NP_MSG_PAD_BUFFER = 0x62,
+  NP_MSG_PAD_FRAMES = 0x63,
+  NP_MSG_PAD_FRAMES_REQUEST = 0x64,
 
   NP_MSG_WIIMOTE_DATA = 0x70,
   NP_MSG_WIIMOTE_MAPPING = 0x71,
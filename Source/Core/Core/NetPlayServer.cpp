@@ -540,6 +540,80 @@ unsigned int NetPlayServer::OnData(sf::Packet& packet, Client& player)
   }
   break;
 
+  case NP_MSG_PAD_FRAMES:
+  {
+    std::lock_guard<std::recursive_mutex> lkg(m_crit.game);
+    // if this is pad data from the last game still being received, ignore it
+    if (player.current_game != m_current_game)
+      break;
+
+    std::vector<NetPlay::PadFramesEntry> entries;
+    if (!NetPlay::ReadPadFramesEntries(packet, &entries))
+      return 1;
+
+    sf::Packet relay_entries;
+    u8 relay_entry_count = 0;
+    for (const NetPlay::PadFramesEntry& entry : entries)
+    {
+      // If the data is not from the correct player,
+      // then disconnect them.
+      if (entry.map < 0 || entry.map >= 4 || m_pad_map[entry.map] != player.pid)
+        return 1;
+
+      NetPlay::PadFrames& frames = m_pad_frames[entry.map];
+      if (!frames.Receive(entry) && frames.TakeRequest())
+      {
+        sf::Packet spac;
+        spac << (MessageId)NP_MSG_PAD_FRAMES_REQUEST;
+        spac << entry.map << frames.End();
+        Send(player.socket, spac);
+      }
+    }
+
+    // Relay the newest frames, the other clients may have missed different ones
+    for (PadMapping map = 0; map < 4; map++)
+    {
+      if (m_pad_map[map] == player.pid)
+        relay_entry_count += m_pad_frames[map].WriteNewest(relay_entries, map,
+                                                           m_settings.m_PadRedundancy);
+    }
+    if (relay_entry_count > 0)
+    {
+      SendToClients(NetPlay::MakePadFramesPacket(relay_entry_count, relay_entries), player.pid,
+                    ENET_PACKET_FLAG_UNSEQUENCED);
+    }
+  }
+  break;
+
+  case NP_MSG_PAD_FRAMES_REQUEST:
+  {
+    std::lock_guard<std::recursive_mutex> lkg(m_crit.game);
+    PadMapping map = 0;
+    FrameNum first = 0;
+    packet >> map >> first;
+    if (map < 0 || map >= 4)
+      return 1;
+
+    // The player fell further behind than the history, its game can't go on
+    if (!m_pad_frames[map].HasFrom(first))
+    {
+      ERROR_LOG(NETPLAY, "Player %d asked for pad %d frame %u, which is no longer kept",
+                player.pid, map, first);
+      sf::Packet spac;
+      spac << (MessageId)NP_MSG_DESYNC_DETECTED;
+      spac << static_cast<int>(player.pid);
+      spac << first;
+      SendToClients(spac);
+      m_desync_detected = true;
+      return 1;
+    }
+
+    sf::Packet entries;
+    const u8 entry_count = m_pad_frames[map].WriteEntries(entries, map, first);
+    Send(player.socket, NetPlay::MakePadFramesPacket(entry_count, entries));
+  }
+  break;
+
   case NP_MSG_WIIMOTE_DATA:
   {
     // if this is Wiimote data from the last game still being received, ignore it
@@ -802,6 +876,23 @@ bool NetPlayServer::StartGame()
   // no change, just update with clients
   AdjustPadBufferSize(m_target_buffer_size);
 
+  for (NetPlay::PadFrames& frames : m_pad_frames)
+    frames.Clear();
+  // Rollback only numbers and replays the GameCube pads, a resimulated frame would take new
+  // Wiimote reports from the buffers and desync
+  if (m_settings.m_RollbackFrames &&
+      std::any_of(m_wiimote_map.begin(), m_wiimote_map.end(),
+                  [](PadMapping mapping) { return mapping > 0; }))
+  {
+    WARN_LOG(NETPLAY, "Rollback is disabled, it does not support Wiimotes");
+    if (m_dialog)
+      m_dialog->AppendChat(GetStringT("Rollback is disabled, it does not support Wiimotes."));
+    m_settings.m_RollbackFrames = 0;
+  }
+  // Rollback predicts the inputs of the numbered frames
+  if (m_settings.m_RollbackFrames && !m_settings.m_PadRedundancy)
+    m_settings.m_PadRedundancy = 1;
+
   if (SConfig::GetInstance().bEnableCustomRTC)
     g_netplay_initial_rtc = SConfig::GetInstance().m_customRTCValue;
   else
@@ -826,6 +917,8 @@ bool NetPlayServer::StartGame()
   spac << m_settings.m_OCFactor;
   spac << m_settings.m_EXIDevice[0];
   spac << m_settings.m_EXIDevice[1];
+  spac << m_settings.m_PadRedundancy;
+  spac << m_settings.m_RollbackFrames;
   spac << (u32)g_netplay_initial_rtc;
   spac << (u32)(g_netplay_initial_rtc >> 32);
 
@@ -837,21 +930,20 @@ bool NetPlayServer::StartGame()
 }
 
 // called from multiple threads
-void NetPlayServer::SendToClients(const sf::Packet& packet, const PlayerId skip_pid)
+void NetPlayServer::SendToClients(const sf::Packet& packet, const PlayerId skip_pid, u32 flags)
 {
   for (auto& p : m_players)
   {
     if (p.second.pid && p.second.pid != skip_pid)
     {
-      Send(p.second.socket, packet);
+      Send(p.second.socket, packet, flags);
     }
   }
 }
 
-void NetPlayServer::Send(ENetPeer* socket, const sf::Packet& packet)
+void NetPlayServer::Send(ENetPeer* socket, const sf::Packet& packet, u32 flags)
 {
-  ENetPacket* epac =
-      enet_packet_create(packet.getData(), packet.getDataSize(), ENET_PACKET_FLAG_RELIABLE);
+  ENetPacket* epac = enet_packet_create(packet.getData(), packet.getDataSize(), flags);
   enet_peer_send(socket, 0, epac);
 }
 
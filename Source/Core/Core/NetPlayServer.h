@@ -5,6 +5,7 @@
 #pragma once
 
 #include <SFML/Network/Packet.hpp>
+#include <array>
 #include <map>
 #include <mutex>
 #include <queue>
@@ -15,6 +16,7 @@
 #include "Common/FifoQueue.h"
 #include "Common/Timer.h"
 #include "Common/TraversalClient.h"
+#include "Core/NetPlayPadFrames.h"
 #include "Core/NetPlayProto.h"
 
 enum class PlayerGameStatus;
@@ -74,8 +76,9 @@ private:
     bool operator==(const Client& other) const { return this == &other; }
   };
 
-  void SendToClients(const sf::Packet& packet, const PlayerId skip_pid = 0);
-  void Send(ENetPeer* socket, const sf::Packet& packet);
+  void SendToClients(const sf::Packet& packet, const PlayerId skip_pid = 0,
+                     u32 flags = ENET_PACKET_FLAG_RELIABLE);
+  void Send(ENetPeer* socket, const sf::Packet& packet, u32 flags = ENET_PACKET_FLAG_RELIABLE);
   unsigned int OnConnect(ENetPeer* socket);
   unsigned int OnDisconnect(const Client& player);
   unsigned int OnData(sf::Packet& packet, Client& player);
@@ -98,6 +101,8 @@ private:
   unsigned int m_target_buffer_size = 0;
   PadMappingArray m_pad_map;
   PadMappingArray m_wiimote_map;
+  // The frames received for each in-game pad, with pad redundancy
+  std::array<NetPlay::PadFrames, 4> m_pad_frames;
 
   std::map<PlayerId, Client> m_players;
 
@@ -23,6 +23,7 @@
 #include "Core/Core.h"
 #include "Core/PowerPC/JitCommon/JitBase.h"
 #include "Core/PowerPC/PPCSymbolDB.h"
+#include "Core/PowerPC/SamplingProfiler.h"
 #include "Core/PowerPC/PowerPC.h"
 
 #ifdef _WIN32
@@ -144,6 +145,8 @@ void JitBaseBlockCache::FinalizeBlock(JitBlock& block, bool block_link,
     JitRegister::Register(block.checkedEntry, block.codeSize, "JIT_PPC_%08x",
                           block.physicalAddress);
   }
+  if (SamplingProfiler::IsRunning())
+    SamplingProfiler::AddBlock(block.checkedEntry, block.codeSize, block.effectiveAddress);
 }
 
 JitBlock* JitBaseBlockCache::GetBlockFromStartAddress(u32 addr, u32 msr)
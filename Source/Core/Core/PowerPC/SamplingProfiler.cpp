@@ -0,0 +1,467 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Core/PowerPC/SamplingProfiler.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#include "Common/CommonTypes.h"
+#include "Common/Event.h"
+#include "Common/File.h"
+#include "Common/Flag.h"
+#include "Common/Logging/Log.h"
+#include "Common/StringUtil.h"
+#include "Common/Swap.h"
+#include "Common/Thread.h"
+
+#include "Core/HW/Memmap.h"
+#include "Core/MachineContext.h"
+#include "Core/PowerPC/PPCSymbolDB.h"
+#include "Core/PowerPC/PowerPC.h"
+
+namespace SamplingProfiler
+{
+std::atomic<u32> g_hle_address{0};
+
+constexpr u32 MAX_STACK_DEPTH = 16;
+// Many times what is taken between two drains
+constexpr u32 RING_SIZE = 1024;
+
+struct RawSample
+{
+  uintptr_t host_pc;
+  u32 guest_pc;
+  u32 hle_address;
+  u32 lr;
+  u32 depth;
+  std::array<u32, MAX_STACK_DEPTH> stack;
+};
+
+// Single producer (the sampled thread), single consumer (the sampler thread)
+struct ThreadBuffer
+{
+  u32 index;
+#ifdef _WIN32
+  HANDLE handle;
+#else
+  pthread_t thread;
+#endif
+  std::array<RawSample, RING_SIZE> samples;
+  std::atomic<u32> read{0};
+  std::atomic<u32> write{0};
+  std::atomic<u32> dropped{0};
+};
+
+enum class Location : u32
+{
+  Block,
+  HLE,
+  Host,
+};
+
+struct BlockRange
+{
+  u32 size;
+  u32 guest_address;
+};
+
+static Common::Flag s_running;
+static Common::Event s_stop_event;
+static std::thread s_sampler_thread;
+static std::chrono::microseconds s_interval;
+
+// Host code of the JIT blocks compiled while running, by start address
+static std::mutex s_blocks_lock;
+static std::map<uintptr_t, BlockRange> s_blocks;
+
+// Also protects s_names and s_counts
+static std::mutex s_threads_lock;
+static std::vector<std::unique_ptr<ThreadBuffer>> s_threads;
+static std::vector<std::string> s_names;
+// Thread, Location, location address, LR, then the stack from the innermost frame
+static std::map<std::vector<u32>, u64> s_counts;
+static u64 s_dropped = 0;
+
+#ifndef _WIN32
+enum class SignalState : int
+{
+  Idle,
+  Pending,
+  Claimed,
+};
+
+// The thread a SIGPROF is sent to. The handler claims it, so the sampler can give up on a
+// signal that takes too long to arrive without the buffer being freed under the handler.
+static std::atomic<ThreadBuffer*> s_signal_target{nullptr};
+static std::atomic<SignalState> s_signal_state{SignalState::Idle};
+#endif
+
+// Only reads plain RAM, as this runs in a signal handler: no MMU, no MMIO
+static bool ReadStackWord(u32 address, u32* value)
+{
+  if (address & 3)
+    return false;
+
+  const u32 physical = address & 0x3FFFFFFF;
+  const u8* ptr;
+  if (Memory::m_pRAM && physical < Memory::REALRAM_SIZE)
+    ptr = Memory::m_pRAM + physical;
+  else if (Memory::m_pEXRAM && physical >= 0x10000000 &&
+           physical - 0x10000000 < Memory::EXRAM_SIZE)
+    ptr = Memory::m_pEXRAM + (physical - 0x10000000);
+  else
+    return false;
+
+  u32 raw;
+  std::memcpy(&raw, ptr, sizeof(raw));
+  *value = Common::swap32(raw);
+  return true;
+}
+
+// Follows the back chain: [r1] is the frame of the caller, which holds the saved LR at +4
+static void Capture(RawSample* sample, uintptr_t host_pc)
+{
+  sample->host_pc = host_pc;
+  sample->guest_pc = PowerPC::ppcState.pc;
+  sample->hle_address = g_hle_address.load(std::memory_order_relaxed);
+  sample->lr = PowerPC::ppcState.spr[SPR_LR];
+
+  u32 depth = 0;
+  u32 frame;
+  if (ReadStackWord(PowerPC::ppcState.gpr[1], &frame))
+  {
+    u32 return_address;
+    while (depth < MAX_STACK_DEPTH && frame != 0 && ReadStackWord(frame + 4, &return_address))
+    {
+      sample->stack[depth++] = return_address;
+      u32 next;
+      // The stack grows down, anything else is garbage
+      if (!ReadStackWord(frame, &next) || next <= frame)
+        break;
+      frame = next;
+    }
+  }
+  sample->depth = depth;
+}
+
+static void Push(ThreadBuffer* buffer, uintptr_t host_pc)
+{
+  const u32 write = buffer->write.load(std::memory_order_relaxed);
+  if (write - buffer->read.load(std::memory_order_acquire) >= RING_SIZE)
+  {
+    buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  Capture(&buffer->samples[write % RING_SIZE], host_pc);
+  buffer->write.store(write + 1, std::memory_order_release);
+}
+
+#ifndef _WIN32
+static uintptr_t GetHostPC(void* raw_context)
+{
+#if defined(_M_GENERIC)
+  return 0;
+#else
+  ucontext_t* context = static_cast<ucontext_t*>(raw_context);
+#if defined(__APPLE__) && _M_X86_64
+  return context->uc_mcontext->__ss.__rip;
+#elif defined(__APPLE__)
+  return context->uc_mcontext->__ss.__pc;
+#elif defined(__OpenBSD__)
+  return context->CTX_PC;
+#else
+  return context->uc_mcontext.CTX_PC;
+#endif
+#endif
+}
+
+static void SignalHandler(int sig, siginfo_t* info, void* raw_context)
+{
+  SignalState expected = SignalState::Pending;
+  if (!s_signal_state.compare_exchange_strong(expected, SignalState::Claimed))
+    return;
+  Push(s_signal_target.load(), GetHostPC(raw_context));
+  s_signal_state.store(SignalState::Idle);
+}
+#endif
+
+static void SampleThread(ThreadBuffer* buffer)
+{
+#ifdef _WIN32
+  if (SuspendThread(buffer->handle) == static_cast<DWORD>(-1))
+    return;
+  CONTEXT context;
+  context.ContextFlags = CONTEXT_CONTROL;
+  if (GetThreadContext(buffer->handle, &context))
+    Push(buffer, static_cast<uintptr_t>(context.CTX_PC));
+  ResumeThread(buffer->handle);
+#else
+  s_signal_target.store(buffer);
+  s_signal_state.store(SignalState::Pending);
+  if (pthread_kill(buffer->thread, SIGPROF) != 0)
+  {
+    s_signal_state.store(SignalState::Idle);
+    return;
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+  while (s_signal_state.load() != SignalState::Idle)
+  {
+    SignalState expected = SignalState::Pending;
+    if (std::chrono::steady_clock::now() > deadline &&
+        s_signal_state.compare_exchange_strong(expected, SignalState::Idle))
+    {
+      break;
+    }
+    std::this_thread::yield();
+  }
+#endif
+}
+
+static u32 ResolveBlock(uintptr_t host_pc)
+{
+  std::lock_guard<std::mutex> lk(s_blocks_lock);
+  auto it = s_blocks.upper_bound(host_pc);
+  if (it == s_blocks.begin())
+    return 0;
+  --it;
+  return host_pc - it->first < it->second.size ? it->second.guest_address : 0;
+}
+
+// Called with s_threads_lock held
+static void Drain(ThreadBuffer* buffer)
+{
+  const u32 write = buffer->write.load(std::memory_order_acquire);
+  std::vector<u32> key;
+  for (u32 i = buffer->read.load(std::memory_order_relaxed); i != write; i++)
+  {
+    const RawSample& sample = buffer->samples[i % RING_SIZE];
+    key.assign({buffer->index, static_cast<u32>(Location::Host), sample.guest_pc, sample.lr});
+    if (sample.hle_address)
+    {
+      key[1] = static_cast<u32>(Location::HLE);
+      key[2] = sample.hle_address;
+    }
+    else if (const u32 block = ResolveBlock(sample.host_pc))
+    {
+      key[1] = static_cast<u32>(Location::Block);
+      key[2] = block;
+    }
+    key.insert(key.end(), sample.stack.begin(), sample.stack.begin() + sample.depth);
+    s_counts[key]++;
+  }
+  buffer->read.store(write, std::memory_order_release);
+  s_dropped += buffer->dropped.exchange(0, std::memory_order_relaxed);
+}
+
+static void SamplerThread()
+{
+  Common::SetCurrentThreadName("Sampling profiler");
+  while (!s_stop_event.WaitFor(s_interval))
+  {
+    std::lock_guard<std::mutex> lk(s_threads_lock);
+    for (auto& buffer : s_threads)
+      SampleThread(buffer.get());
+    for (auto& buffer : s_threads)
+      Drain(buffer.get());
+  }
+}
+
+void Start(u32 samples_per_second)
+{
+  if (s_running.IsSet())
+    return;
+
+  s_counts.clear();
+  s_names.clear();
+  s_dropped = 0;
+  s_interval = std::chrono::microseconds(1000000 / std::max(samples_per_second, 1u));
+
+#ifndef _WIN32
+  struct sigaction sa;
+  sa.sa_handler = nullptr;
+  sa.sa_sigaction = &SignalHandler;
+  sa.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGPROF, &sa, nullptr);
+#endif
+
+  s_running.Set();
+  s_stop_event.Reset();
+  s_sampler_thread = std::thread(SamplerThread);
+  INFO_LOG(POWERPC, "Sampling profiler started, %u samples per second", samples_per_second);
+}
+
+void Stop()
+{
+  if (!s_running.TestAndClear())
+    return;
+
+  s_stop_event.Set();
+  s_sampler_thread.join();
+  {
+    std::lock_guard<std::mutex> lk(s_threads_lock);
+    for (auto& buffer : s_threads)
+      Drain(buffer.get());
+  }
+#ifndef _WIN32
+  // A signal given up on by SampleThread can still be delivered, and the default action of
+  // SIGPROF terminates the process
+  signal(SIGPROF, SIG_IGN);
+#endif
+  {
+    std::lock_guard<std::mutex> lk(s_blocks_lock);
+    s_blocks.clear();
+  }
+  INFO_LOG(POWERPC, "Sampling profiler stopped, %" PRIu64 " samples dropped", s_dropped);
+}
+
+bool IsRunning()
+{
+  return s_running.IsSet();
+}
+
+void RegisterThread(const char* name)
+{
+  if (!s_running.IsSet())
+    return;
+
+  auto buffer = std::make_unique<ThreadBuffer>();
+#ifdef _WIN32
+  buffer->handle = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION,
+                              FALSE, GetCurrentThreadId());
+  if (!buffer->handle)
+    return;
+#else
+  buffer->thread = pthread_self();
+#endif
+
+  std::lock_guard<std::mutex> lk(s_threads_lock);
+  // A thread that comes back, like the CPU thread of the next boot, keeps its stacks
+  auto name_it = std::find(s_names.begin(), s_names.end(), name);
+  buffer->index = static_cast<u32>(name_it - s_names.begin());
+  if (name_it == s_names.end())
+    s_names.emplace_back(name);
+  s_threads.push_back(std::move(buffer));
+}
+
+void UnregisterThread()
+{
+  std::lock_guard<std::mutex> lk(s_threads_lock);
+  auto it = std::find_if(s_threads.begin(), s_threads.end(), [](const auto& buffer) {
+#ifdef _WIN32
+    return GetThreadId(buffer->handle) == GetCurrentThreadId();
+#else
+    return pthread_equal(buffer->thread, pthread_self()) != 0;
+#endif
+  });
+  if (it == s_threads.end())
+    return;
+
+  // No sample is in flight while the lock is held
+  Drain(it->get());
+#ifdef _WIN32
+  CloseHandle((*it)->handle);
+#endif
+  s_threads.erase(it);
+}
+
+void AddBlock(const void* code, u32 size, u32 guest_address)
+{
+  if (!s_running.IsSet())
+    return;
+
+  const uintptr_t start = reinterpret_cast<uintptr_t>(code);
+  std::lock_guard<std::mutex> lk(s_blocks_lock);
+  // The code of cleared blocks gets reused
+  auto it = s_blocks.lower_bound(start);
+  if (it != s_blocks.begin())
+  {
+    auto prev = std::prev(it);
+    if (start - prev->first < prev->second.size)
+      it = prev;
+  }
+  while (it != s_blocks.end() && it->first - start < size)
+    it = s_blocks.erase(it);
+  s_blocks.emplace(start, BlockRange{size, guest_address});
+}
+
+static std::string GetFunctionName(u32 address)
+{
+  std::string name;
+  if (const Symbol* symbol = g_symbolDB.GetSymbolFromAddr(address))
+    name = symbol->function_name.empty() ? symbol->name : symbol->function_name;
+  else
+    name = StringFromFormat("%08x", address);
+  // ';' separates the frames
+  std::replace(name.begin(), name.end(), ';', ':');
+  return name;
+}
+
+bool WriteCollapsedStacks(const std::string& filename)
+{
+  // Stacks that only differ by addresses within the same functions are merged
+  std::map<std::string, u64> lines;
+  for (const auto& entry : s_counts)
+  {
+    const std::vector<u32>& key = entry.first;
+    const Location location = static_cast<Location>(key[1]);
+    const u32 address = key[2];
+    const u32 lr = key[3];
+    const std::string function = GetFunctionName(address);
+
+    std::string line = s_names[key[0]];
+    for (size_t i = key.size(); i > 4; i--)
+      line += ';' + GetFunctionName(key[i - 1] - 4);
+    // The LR is the caller of a function that did not save it yet, it is stale otherwise
+    if (lr && (key.size() == 4 || key[4] != lr))
+    {
+      const std::string caller = GetFunctionName(lr - 4);
+      if (caller != function)
+        line += ';' + caller;
+    }
+    line += ';' + function;
+    switch (location)
+    {
+    case Location::Block:
+      line += StringFromFormat(";[block %08x]", address);
+      break;
+    case Location::HLE:
+      line += ";[HLE]";
+      break;
+    case Location::Host:
+      line += ";[host]";
+      break;
+    }
+    lines[line] += entry.second;
+  }
+
+  File::IOFile f(filename, "w");
+  if (!f)
+  {
+    ERROR_LOG(POWERPC, "Failed to open %s", filename.c_str());
+    return false;
+  }
+  for (const auto& line : lines)
+    fprintf(f.GetHandle(), "%s %" PRIu64 "\n", line.first.c_str(), line.second);
+  return true;
+}
+}
@@ -0,0 +1,47 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "Common/CommonTypes.h"
+
+// Statistical profiler for the emulated code. A sampler thread interrupts the registered threads
+// at a fixed rate and records where the host was: in a JIT block, in an HLE function or in the
+// rest of the emulator. Each sample also gets the guest call stack, walked from the back chain of
+// the emulated stack, and the result is written in the collapsed stack format read by the
+// flamegraph tools, with the names from g_symbolDB.
+//
+// The samples go through a lock-free ring buffer per thread, filled from the signal handler (or
+// while the thread is suspended on Windows) and aggregated by the sampler thread.
+namespace SamplingProfiler
+{
+void Start(u32 samples_per_second = 1000);
+void Stop();
+bool IsRunning();
+
+// Called by the threads that run guest code, before and after. The name is the root of the
+// stacks of the thread and has to stay valid.
+void RegisterThread(const char* name);
+void UnregisterThread();
+
+// Maps the host code of a JIT block to its guest address
+void AddBlock(const void* code, u32 size, u32 guest_address);
+
+// Set around HLE functions, which replace guest code
+extern std::atomic<u32> g_hle_address;
+inline void EnterHLE(u32 address)
+{
+  g_hle_address.store(address, std::memory_order_relaxed);
+}
+inline void LeaveHLE()
+{
+  g_hle_address.store(0, std::memory_order_relaxed);
+}
+
+// Writes the samples taken since Start, one "frame;frame;...;frame count" line per stack
+bool WriteCollapsedStacks(const std::string& filename);
+}
@@ -0,0 +1,374 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Core/Rewind.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <lzo/lzo1x.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/Config/Config.h"
+#include "Common/Logging/Log.h"
+#include "Common/StringUtil.h"
+#include "Common/Thread.h"
+
+#include "Core/Config/MainSettings.h"
+#include "Core/Core.h"
+#include "Core/HW/Memmap.h"
+#include "Core/Movie.h"
+#include "Core/NetPlayClient.h"
+#include "Core/State.h"
+
+#include "VideoCommon/Fifo.h"
+#include "VideoCommon/OnScreenDisplay.h"
+
+namespace Rewind
+{
+// A capture is the state without the emulated memory, plus the memory pages written since the
+// previous capture, found by the dirty page tracking of Memory. Without dirty tracking every page
+// is reported, which makes it as large as a full state.
+struct Capture
+{
+  std::vector<u8> state;
+  std::vector<u32> page_offsets;
+  std::vector<u8> pages;
+
+  void Clear()
+  {
+    state.clear();
+    page_offsets.clear();
+    pages.clear();
+  }
+};
+
+// Every entry holds the difference between a captured state and the one captured before it:
+// the XOR of both states followed by the XOR of the pages that changed, LZO compressed.
+// The XOR is mostly zeros and compresses to a fraction of its size.
+// Only the newest state and memory image are kept uncompressed, stepping back applies the newest
+// delta to them.
+struct DeltaEntry
+{
+  std::vector<u8> compressed;
+  std::vector<u32> page_offsets;
+  size_t state_delta_size;
+  size_t previous_state_size;
+};
+
+// The worker holds the history lock while it takes a capture and adds it, so StepBack never sees
+// a capture that was taken out of the pending slot but not added yet.
+static std::mutex s_history_lock;
+static std::deque<DeltaEntry> s_history;
+static std::vector<u8> s_newest_state;
+static std::vector<u8> s_newest_memory;
+static size_t s_history_size = 0;
+static size_t s_history_budget = 0;
+static u32 s_page_size = 0;
+
+// Single slot between the CPU thread and the worker. When the worker is still busy with the
+// previous capture the new one is merged into it, so the CPU thread never waits for the worker.
+// The pages are incremental and can't be dropped, the newest copy of a page wins.
+static std::mutex s_pending_lock;
+static std::condition_variable s_pending_cv;
+static Capture s_pending;
+static std::unordered_map<u32, size_t> s_pending_pages;
+static bool s_has_pending = false;
+static bool s_worker_exit = false;
+static std::thread s_worker;
+
+// Only accessed by the CPU thread
+static Capture s_capture;
+static u32 s_frames_since_capture = 0;
+static u32 s_interval = 0;
+static bool s_tracking_started = false;
+
+static void XorStates(const std::vector<u8>& a, const std::vector<u8>& b, std::vector<u8>& out)
+{
+  const std::vector<u8>& longer = a.size() > b.size() ? a : b;
+  const size_t common = std::min(a.size(), b.size());
+  out.resize(longer.size());
+  size_t i = 0;
+  for (; i + sizeof(u64) <= common; i += sizeof(u64))
+  {
+    u64 va, vb;
+    std::memcpy(&va, &a[i], sizeof(u64));
+    std::memcpy(&vb, &b[i], sizeof(u64));
+    va ^= vb;
+    std::memcpy(&out[i], &va, sizeof(u64));
+  }
+  for (; i < common; i++)
+    out[i] = a[i] ^ b[i];
+  // The shorter state is padded with zeros
+  if (longer.size() > common)
+    std::memcpy(&out[common], &longer[common], longer.size() - common);
+}
+
+static void XorPage(u8* dst, const u8* src, size_t size)
+{
+  for (size_t i = 0; i < size; i += sizeof(u64))
+  {
+    u64 vd, vs;
+    std::memcpy(&vd, dst + i, sizeof(u64));
+    std::memcpy(&vs, src + i, sizeof(u64));
+    vd ^= vs;
+    std::memcpy(dst + i, &vd, sizeof(u64));
+  }
+}
+
+// Called with the history lock held
+static void AddCapture(Capture& capture)
+{
+  static std::vector<u8> delta;
+  static std::unique_ptr<u8[]> wrkmem(new u8[LZO1X_1_MEM_COMPRESS]);
+
+  if (s_newest_state.empty())
+  {
+    s_newest_memory.assign(Memory::GetTrackedMemorySize(), 0);
+    for (size_t i = 0; i < capture.page_offsets.size(); i++)
+    {
+      std::memcpy(&s_newest_memory[capture.page_offsets[i]], &capture.pages[i * s_page_size],
+                  s_page_size);
+    }
+    s_newest_state.swap(capture.state);
+    return;
+  }
+
+  XorStates(capture.state, s_newest_state, delta);
+  const size_t state_delta_size = delta.size();
+  delta.resize(state_delta_size + capture.pages.size());
+  for (size_t i = 0; i < capture.page_offsets.size(); i++)
+  {
+    u8* page_delta = &delta[state_delta_size + i * s_page_size];
+    u8* newest_page = &s_newest_memory[capture.page_offsets[i]];
+    std::memcpy(page_delta, &capture.pages[i * s_page_size], s_page_size);
+    XorPage(page_delta, newest_page, s_page_size);
+    std::memcpy(newest_page, &capture.pages[i * s_page_size], s_page_size);
+  }
+
+  DeltaEntry entry;
+  entry.state_delta_size = state_delta_size;
+  entry.previous_state_size = s_newest_state.size();
+  entry.page_offsets = capture.page_offsets;
+  entry.compressed.resize(delta.size() + delta.size() / 16 + 64 + 3);
+  lzo_uint out_len = 0;
+  if (lzo1x_1_compress(delta.data(), delta.size(), entry.compressed.data(), &out_len,
+                       wrkmem.get()) != LZO_E_OK)
+  {
+    // The newest state moves on anyway, the history before it is unusable now
+    ERROR_LOG(CORE, "Internal LZO Error - rewind state compression failed");
+    s_history.clear();
+    s_history_size = 0;
+  }
+  else
+  {
+    entry.compressed.resize(out_len);
+    entry.compressed.shrink_to_fit();
+
+    s_history_size += entry.compressed.size() + entry.page_offsets.size() * sizeof(u32);
+    s_history.push_back(std::move(entry));
+    while (s_history_size > s_history_budget && !s_history.empty())
+    {
+      s_history_size -= s_history.front().compressed.size() +
+                        s_history.front().page_offsets.size() * sizeof(u32);
+      s_history.pop_front();
+    }
+  }
+  s_newest_state.swap(capture.state);
+}
+
+// Called with the history lock held
+static bool TakePending(Capture& capture)
+{
+  std::lock_guard<std::mutex> lk(s_pending_lock);
+  if (!s_has_pending)
+    return false;
+  std::swap(capture, s_pending);
+  s_pending.Clear();
+  s_pending_pages.clear();
+  s_has_pending = false;
+  return true;
+}
+
+static void WorkerThread()
+{
+  Common::SetCurrentThreadName("Rewind Worker");
+
+  Capture capture;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lk(s_pending_lock);
+      s_pending_cv.wait(lk, [] { return s_has_pending || s_worker_exit; });
+      if (s_worker_exit)
+        return;
+    }
+    std::lock_guard<std::mutex> lk(s_history_lock);
+    if (TakePending(capture))
+      AddCapture(capture);
+  }
+}
+
+void Init()
+{
+  s_interval = static_cast<u32>(std::max(Config::Get(Config::MAIN_REWIND_INTERVAL), 1));
+  s_history_budget = static_cast<size_t>(std::max(Config::Get(Config::MAIN_REWIND_BUFFER_SIZE), 1)) * 1024 * 1024;
+  s_frames_since_capture = 0;
+  s_tracking_started = false;
+  // Rewinding would desync NetPlay, and the dirty pages belong to rollback then
+  if (!Config::Get(Config::MAIN_REWIND_ENABLE) || NetPlay::IsNetPlayRunning())
+    return;
+
+  s_worker_exit = false;
+  s_worker = std::thread(WorkerThread);
+}
+
+void Shutdown()
+{
+  if (s_worker.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lk(s_pending_lock);
+      s_worker_exit = true;
+    }
+    s_pending_cv.notify_one();
+    s_worker.join();
+  }
+
+  std::lock_guard<std::mutex> lk(s_history_lock);
+  s_history.clear();
+  s_history_size = 0;
+  std::vector<u8>().swap(s_newest_state);
+  std::vector<u8>().swap(s_newest_memory);
+  s_pending = Capture();
+  s_pending_pages.clear();
+  s_capture = Capture();
+  s_has_pending = false;
+  s_tracking_started = false;
+}
+
+void FrameUpdate()
+{
+  if (!s_worker.joinable() || ++s_frames_since_capture < s_interval)
+    return;
+  s_frames_since_capture = 0;
+
+  // Rewinding would desync the movie
+  if (Movie::IsMovieActive())
+    return;
+
+  if (!s_tracking_started)
+  {
+    if (!Memory::StartDirtyTracking())
+      WARN_LOG(CORE, "Dirty page tracking is not available, rewind captures the whole memory");
+    s_page_size = Memory::GetDirtyPageSize();
+    s_tracking_started = true;
+  }
+
+  // The GPU thread writes to the video state and to RAM, it has to be stopped for the capture.
+  // The CPU thread is running, so only the GPU thread is paused, the way Core::PauseAndLock does.
+  s_capture.Clear();
+  Fifo::PauseAndLock(true, false);
+  State::SaveToBufferWithoutMemory(s_capture.state);
+  Memory::CollectDirtyPages([](u32 offset, const u8* data) {
+    s_capture.page_offsets.push_back(offset);
+    s_capture.pages.insert(s_capture.pages.end(), data, data + s_page_size);
+  });
+  Fifo::PauseAndLock(false, true);
+
+  {
+    std::lock_guard<std::mutex> lk(s_pending_lock);
+    if (!s_has_pending)
+    {
+      std::swap(s_pending, s_capture);
+      for (size_t i = 0; i < s_pending.page_offsets.size(); i++)
+        s_pending_pages[s_pending.page_offsets[i]] = i;
+      s_has_pending = true;
+    }
+    else
+    {
+      s_pending.state.swap(s_capture.state);
+      for (size_t i = 0; i < s_capture.page_offsets.size(); i++)
+      {
+        const u8* page = &s_capture.pages[i * s_page_size];
+        auto result =
+            s_pending_pages.emplace(s_capture.page_offsets[i], s_pending.page_offsets.size());
+        if (result.second)
+        {
+          s_pending.page_offsets.push_back(s_capture.page_offsets[i]);
+          s_pending.pages.insert(s_pending.pages.end(), page, page + s_page_size);
+        }
+        else
+        {
+          std::memcpy(&s_pending.pages[result.first->second * s_page_size], page, s_page_size);
+        }
+      }
+    }
+  }
+  s_pending_cv.notify_one();
+}
+
+bool StepBack()
+{
+  if (!s_worker.joinable())
+    return false;
+
+  bool rewound = false;
+  Core::RunAsCPUThread([&] {
+    std::lock_guard<std::mutex> lk(s_history_lock);
+    // The newest image has to match the memory before it can be restored
+    Capture capture;
+    if (TakePending(capture))
+      AddCapture(capture);
+
+    if (s_history.empty())
+    {
+      OSD::AddMessage("Nothing to rewind");
+      return;
+    }
+
+    const DeltaEntry& entry = s_history.back();
+    std::vector<u8> delta(entry.state_delta_size + entry.page_offsets.size() * s_page_size);
+    lzo_uint new_len = delta.size();
+    if (lzo1x_decompress_safe(entry.compressed.data(), entry.compressed.size(), delta.data(),
+                              &new_len, nullptr) != LZO_E_OK ||
+        new_len != delta.size())
+    {
+      ERROR_LOG(CORE, "Internal LZO Error - rewind state decompression failed");
+      return;
+    }
+    for (size_t i = 0; i < entry.page_offsets.size(); i++)
+    {
+      XorPage(&s_newest_memory[entry.page_offsets[i]],
+              &delta[entry.state_delta_size + i * s_page_size], s_page_size);
+    }
+    delta.resize(entry.state_delta_size);
+    s_newest_state.resize(entry.state_delta_size, 0);
+    XorStates(s_newest_state, delta, s_newest_state);
+    s_newest_state.resize(entry.previous_state_size);
+    s_history_size -= entry.compressed.size() + entry.page_offsets.size() * sizeof(u32);
+    s_history.pop_back();
+
+    Memory::RestoreTrackedMemory(s_newest_memory.data());
+    State::LoadFromBufferWithoutMemory(s_newest_state);
+    s_frames_since_capture = 0;
+    rewound = true;
+    OSD::AddMessage(StringFromFormat("Rewound, %zu steps left", s_history.size()));
+  });
+  return rewound;
+}
+
+size_t GetAvailableSteps()
+{
+  std::lock_guard<std::mutex> lk(s_history_lock);
+  return s_history.size();
+}
+}
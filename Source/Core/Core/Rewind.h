@@ -0,0 +1,26 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+// Rewind support: a ring of recent savestates kept in memory.
+
+#pragma once
+
+#include <cstddef>
+
+namespace Rewind
+{
+void Init();
+void Shutdown();
+
+// Called by the CPU thread from VI at the end of every field, captures a state every
+// RewindInterval fields
+void FrameUpdate();
+
+// Loads the state captured before the last one and drops the newer history.
+// Returns false if there is nothing to go back to.
+bool StepBack();
+
+// Number of states StepBack can go back to
+size_t GetAvailableSteps();
+}
@@ -0,0 +1,283 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "Core/Rollback.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/Logging/Log.h"
+#include "Common/StringUtil.h"
+
+#include "Core/CoreTiming.h"
+#include "Core/HW/Memmap.h"
+#include "Core/NetPlayClient.h"
+#include "Core/NetPlayProto.h"
+#include "Core/State.h"
+
+#include "VideoCommon/Fifo.h"
+#include "VideoCommon/OnScreenDisplay.h"
+#include "VideoCommon/VideoConfig.h"
+
+namespace Rollback
+{
+// Going back further than that costs more than a second of emulation on every misprediction
+static constexpr u32 MAX_ROLLBACK_FRAMES = 30;
+
+// A snapshot is the state right after the first pad poll of a frame, without the emulated memory
+// and the GameCube ARAM. They are an undo log instead: the pages written since the previous
+// snapshot, with their content at the previous snapshot. s_memory holds them at the newest
+// snapshot, so going back only touches the pages written since the target snapshot.
+struct Snapshot
+{
+  u32 frame;
+  std::vector<u8> state;
+  std::vector<u32> page_offsets;
+  std::vector<u8> old_pages;
+};
+
+using Clock = std::chrono::steady_clock;
+
+static CoreTiming::EventType* s_event;
+static u32 s_max_frames = 0;
+
+// Only accessed by the CPU thread
+static std::vector<Snapshot> s_snapshots;
+static std::vector<u8> s_memory;
+static std::vector<u32> s_restored_pages;
+static u32 s_page_size = 0;
+static bool s_tracking_started = false;
+static bool s_has_snapshot = false;
+static u32 s_first_snapshot = 0;
+static u32 s_newest_snapshot = 0;
+
+static u32 s_frame = 0;
+static bool s_rollback_pending = false;
+static u32 s_rollback_target = 0;
+static bool s_resimulating = false;
+static u32 s_resimulation_end = 0;
+
+// Instrumentation
+static Clock::time_point s_resimulation_start;
+static u32 s_depth = 0;
+static u32 s_max_depth = 0;
+static u64 s_rollback_count = 0;
+static u64 s_resimulated_frames = 0;
+static Clock::duration s_resimulation_time;
+
+static Snapshot& GetSnapshot(u32 frame)
+{
+  return s_snapshots[frame % s_snapshots.size()];
+}
+
+static bool HasSnapshot(u32 frame)
+{
+  return s_has_snapshot && frame >= s_first_snapshot && frame <= s_newest_snapshot &&
+         s_newest_snapshot - frame < s_snapshots.size() && GetSnapshot(frame).frame == frame;
+}
+
+static void SaveSnapshot(u32 frame)
+{
+  Snapshot& snapshot = GetSnapshot(frame);
+  snapshot.frame = frame;
+  snapshot.page_offsets.clear();
+  snapshot.old_pages.clear();
+  State::SaveToBufferWithoutMemory(snapshot.state);
+  Memory::CollectDirtyPages([&snapshot](u32 offset, const u8* data) {
+    snapshot.page_offsets.push_back(offset);
+    snapshot.old_pages.insert(snapshot.old_pages.end(), &s_memory[offset],
+                              &s_memory[offset] + s_page_size);
+    std::memcpy(&s_memory[offset], data, s_page_size);
+  });
+
+  if (!s_has_snapshot)
+  {
+    s_first_snapshot = frame;
+    s_has_snapshot = true;
+  }
+  s_newest_snapshot = frame;
+}
+
+static void LoadSnapshot(u32 frame)
+{
+  // The pages written since the newest snapshot go back to s_memory as well
+  s_restored_pages.clear();
+  Memory::CollectDirtyPages([](u32 offset, const u8*) { s_restored_pages.push_back(offset); });
+  for (u32 undo = s_newest_snapshot; undo > frame; undo--)
+  {
+    const Snapshot& snapshot = GetSnapshot(undo);
+    for (size_t i = 0; i < snapshot.page_offsets.size(); i++)
+    {
+      std::memcpy(&s_memory[snapshot.page_offsets[i]], &snapshot.old_pages[i * s_page_size],
+                  s_page_size);
+      s_restored_pages.push_back(snapshot.page_offsets[i]);
+    }
+  }
+  for (u32 offset : s_restored_pages)
+    Memory::RestoreTrackedPage(offset, &s_memory[offset]);
+
+  State::LoadFromBufferWithoutMemory(GetSnapshot(frame).state);
+  s_newest_snapshot = frame;
+}
+
+static void EndResimulation()
+{
+  s_resimulating = false;
+  const Clock::duration elapsed = Clock::now() - s_resimulation_start;
+  s_resimulated_frames += s_depth;
+  s_resimulation_time += elapsed;
+
+  const double frame_ms =
+      std::chrono::duration<double, std::milli>(elapsed).count() / std::max(s_depth, 1u);
+  const double average_ms =
+      std::chrono::duration<double, std::milli>(s_resimulation_time).count() /
+      std::max<u64>(s_resimulated_frames, 1);
+  INFO_LOG(NETPLAY, "Rolled back %u frames, %.2f ms per frame", s_depth, frame_ms);
+  if (g_ActiveConfig.bShowNetPlayPing)
+  {
+    OSD::AddTypedMessage(OSD::MessageType::NetPlayRollback,
+                         StringFromFormat("Rollback: %u frames (max %u, %" PRIu64
+                                          " total), %.2f ms per frame (avg %.2f)",
+                                          s_depth, s_max_depth, s_rollback_count, frame_ms,
+                                          average_ms),
+                         OSD::Duration::NORMAL, OSD::Color::CYAN);
+  }
+}
+
+static bool RollBack(u32 target, u32 polled_frame)
+{
+  if (target == 0 || target > polled_frame || !HasSnapshot(target - 1))
+  {
+    ERROR_LOG(NETPLAY, "Can't roll back to frame %u from frame %u", target, polled_frame);
+    return false;
+  }
+
+  // A rollback while running the frames again extends the current one
+  if (!s_resimulating)
+  {
+    s_resimulation_start = Clock::now();
+    s_resimulation_end = polled_frame + 1;
+    s_resimulating = true;
+    s_depth = 0;
+  }
+  s_depth += polled_frame + 1 - target;
+  s_max_depth = std::max(s_max_depth, s_resimulation_end - target);
+  s_rollback_count++;
+
+  LoadSnapshot(target - 1);
+  s_frame = target;
+  return true;
+}
+
+static void SnapshotOrRollBack(u32 polled_frame)
+{
+  if (s_rollback_pending)
+  {
+    s_rollback_pending = false;
+    if (RollBack(s_rollback_target, polled_frame))
+      return;
+  }
+
+  SaveSnapshot(polled_frame);
+  s_frame = polled_frame + 1;
+  if (s_resimulating && s_frame >= s_resimulation_end)
+    EndResimulation();
+}
+
+static void RollbackCallback(u64 userdata, s64 cycles_late)
+{
+  // In dual core the GPU thread writes to the video state and to RAM while the snapshot is taken
+  // or loaded. The CPU thread is running, so only the GPU thread is paused.
+  Fifo::PauseAndLock(true, false);
+  SnapshotOrRollBack(static_cast<u32>(userdata));
+  Fifo::PauseAndLock(false, true);
+}
+
+void Init()
+{
+  s_event = CoreTiming::RegisterEvent("NetPlayRollback", RollbackCallback);
+  s_max_frames = NetPlay::IsNetPlayRunning() ?
+                     std::min(g_NetPlaySettings.m_RollbackFrames, MAX_ROLLBACK_FRAMES) :
+                     0;
+  // One more than the depth, the state before the oldest frame that may be wrong is needed
+  s_snapshots.resize(s_max_frames ? s_max_frames + 1 : 0);
+  for (Snapshot& snapshot : s_snapshots)
+    snapshot.frame = 0;
+  s_tracking_started = false;
+  s_has_snapshot = false;
+  s_frame = 0;
+  s_rollback_pending = false;
+  s_resimulating = false;
+  s_max_depth = 0;
+  s_rollback_count = 0;
+  s_resimulated_frames = 0;
+  s_resimulation_time = Clock::duration::zero();
+}
+
+void Shutdown()
+{
+  if (s_rollback_count > 0)
+  {
+    INFO_LOG(NETPLAY, "%" PRIu64 " rollbacks, %" PRIu64 " frames run again, at most %u at once",
+             s_rollback_count, s_resimulated_frames, s_max_depth);
+  }
+
+  std::vector<Snapshot>().swap(s_snapshots);
+  std::vector<u8>().swap(s_memory);
+  std::vector<u32>().swap(s_restored_pages);
+  s_max_frames = 0;
+  s_resimulating = false;
+}
+
+u32 GetMaxFrames()
+{
+  return s_max_frames;
+}
+
+u32 BeginFrame()
+{
+  if (!s_tracking_started && s_max_frames > 0)
+  {
+    s_tracking_started = true;
+    if (Memory::StartDirtyTracking())
+    {
+      s_page_size = Memory::GetDirtyPageSize();
+      s_memory.assign(Memory::GetTrackedMemorySize(), 0);
+    }
+    else
+    {
+      // Every snapshot would copy the whole memory. The frames are still numbered for NetPlay,
+      // but nothing is predicted: every frame waits for the inputs of the others.
+      ERROR_LOG(NETPLAY, "Dirty page tracking is not available, rollback is disabled");
+      OSD::AddMessage("Rollback needs fastmem, waiting for every input instead", 10000);
+      s_max_frames = 0;
+      std::vector<Snapshot>().swap(s_snapshots);
+    }
+  }
+
+  if (s_max_frames == 0)
+    return s_frame++;
+
+  // Runs right after this poll, as its own event so nothing else on the stack depends on the
+  // state when it is loaded
+  CoreTiming::ScheduleEvent(0, s_event, s_frame);
+  return s_frame;
+}
+
+void Mispredicted(u32 frame)
+{
+  if (!s_rollback_pending || frame < s_rollback_target)
+    s_rollback_target = frame;
+  s_rollback_pending = true;
+}
+
+bool IsResimulating()
+{
+  return s_resimulating;
+}
+}
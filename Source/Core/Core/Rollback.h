@@ -0,0 +1,31 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+// NetPlay rollback support: recent per-frame states to go back to when a predicted input was wrong.
+
+#pragma once
+
+#include "Common/CommonTypes.h"
+
+namespace Rollback
+{
+void Init();
+void Shutdown();
+
+// The number of frames a rollback can go back, 0 when rollback is off. It drops to 0 at the first
+// frame when dirty page tracking is not available, the frames are still numbered then.
+u32 GetMaxFrames();
+
+// Called by NetPlay at the first pad poll of each frame, returns the number of the frame.
+// The state right after the poll is captured, so the frame after it can be run again.
+u32 BeginFrame();
+
+// Called by NetPlay when the inputs used for a frame turn out to be wrong. Once the current poll
+// is done the state goes back to the one before that frame, and the frames since then run again.
+void Mispredicted(u32 frame);
+
+// True while the frames after a rollback run again, nothing is presented, played or throttled
+// then
+bool IsResimulating();
+}
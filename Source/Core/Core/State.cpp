@@ -4,8 +4,11 @@
 
 #include "Core/State.h"
 
+#include <algorithm>
+#include <cstring>
 #include <lzo/lzo1x.h>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -21,6 +24,7 @@
 #include "Common/ScopeGuard.h"
 #include "Common/StringUtil.h"
 #include "Common/Thread.h"
+#include "Common/ThreadPool.h"
 #include "Common/Timer.h"
 #include "Common/Version.h"
 
@@ -29,6 +33,7 @@
 #include "Core/CoreTiming.h"
 #include "Core/GeckoCode.h"
 #include "Core/HW/HW.h"
+#include "Core/HW/Memmap.h"
 #include "Core/HW/Wiimote.h"
 #include "Core/Host.h"
 #include "Core/Movie.h"
@@ -51,12 +56,10 @@ static const u32 IN_LEN = 128 * 1024u;
 
 static const u32 OUT_LEN = IN_LEN + (IN_LEN / 16) + 64 + 3;
 
-static unsigned char __LZO_MMODEL out[OUT_LEN];
-
-#define HEAP_ALLOC(var, size)                                                                      \
-  lzo_align_t __LZO_MMODEL var[((size) + (sizeof(lzo_align_t) - 1)) / sizeof(lzo_align_t)]
-
-static HEAP_ALLOC(wrkmem, LZO1X_1_MEM_COMPRESS);
+// The compressed state is a sequence of [u32 size][lzo data] chunks, every chunk but the last
+// one decompresses to IN_LEN bytes. The chunks are independent, so they are compressed and
+// decompressed in parallel, in bands of this many chunks.
+static const int CHUNKS_PER_BAND = 8;
 
 static std::string g_last_filename;
 
@@ -231,6 +234,35 @@ void SaveToBuffer(std::vector<u8>& buffer)
   });
 }
 
+void SaveToBufferWithoutMemory(std::vector<u8>& buffer)
+{
+  Core::RunAsCPUThread([&] {
+    Memory::SetStateIncludesMemory(false);
+    u8* ptr = nullptr;
+    PointerWrap p(&ptr, PointerWrap::MODE_MEASURE);
+
+    DoState(p);
+    const size_t buffer_size = reinterpret_cast<size_t>(ptr);
+    buffer.resize(buffer_size);
+
+    ptr = &buffer[0];
+    p.SetMode(PointerWrap::MODE_WRITE);
+    DoState(p);
+    Memory::SetStateIncludesMemory(true);
+  });
+}
+
+void LoadFromBufferWithoutMemory(std::vector<u8>& buffer)
+{
+  Core::RunAsCPUThread([&] {
+    Memory::SetStateIncludesMemory(false);
+    u8* ptr = &buffer[0];
+    PointerWrap p(&ptr, PointerWrap::MODE_READ);
+    DoState(p);
+    Memory::SetStateIncludesMemory(true);
+  });
+}
+
 void VerifyBuffer(std::vector<u8>& buffer)
 {
   Core::RunAsCPUThread([&] {
@@ -355,33 +387,47 @@ static void CompressAndDumpState(CompressAndDumpState_args save_args)
 
   if (header.size != 0)  // non-zero header size means the state is compressed
   {
-    lzo_uint i = 0;
-    while (true)
+    // Every chunk is compressed to its own slot of the output buffer, the slots are packed
+    // afterwards and the whole state is written at once
+    const int num_chunks = static_cast<int>(std::max<size_t>((buffer_size + IN_LEN - 1) / IN_LEN, 1));
+    const size_t slot_size = sizeof(u32) + OUT_LEN;
+    std::vector<u8> compressed(num_chunks * slot_size);
+    std::vector<u32> compressed_sizes(num_chunks);
+    // The workers only record the result of each chunk, failures are reported on this thread
+    std::vector<int> results(num_chunks, LZO_E_OK);
+    Common::LoopWorker::Loop(
+        [&](int lower, int upper) {
+          auto wrkmem = std::make_unique<u8[]>(LZO1X_1_MEM_COMPRESS);
+          for (int chunk = lower; chunk < upper; chunk++)
+          {
+            const size_t offset = static_cast<size_t>(chunk) * IN_LEN;
+            const lzo_uint cur_len = static_cast<lzo_uint>(std::min<size_t>(buffer_size - offset, IN_LEN));
+            u8* slot = &compressed[chunk * slot_size];
+            lzo_uint out_len = 0;
+            results[chunk] = lzo1x_1_compress(buffer_data + offset, cur_len, slot + sizeof(u32),
+                                              &out_len, wrkmem.get());
+
+            const u32 size = static_cast<u32>(out_len);
+            std::memcpy(slot, &size, sizeof(u32));
+            compressed_sizes[chunk] = size;
+          }
+        },
+        0, num_chunks, CHUNKS_PER_BAND);
+
+    if (std::any_of(results.begin(), results.end(), [](int res) { return res != LZO_E_OK; }))
     {
-      lzo_uint32 cur_len = 0;
-      lzo_uint out_len = 0;
-
-      if ((i + IN_LEN) >= buffer_size)
-      {
-        cur_len = (lzo_uint32)(buffer_size - i);
-      }
-      else
-      {
-        cur_len = IN_LEN;
-      }
-
-      if (lzo1x_1_compress(buffer_data + i, cur_len, out, &out_len, wrkmem) != LZO_E_OK)
-        PanicAlertT("Internal LZO Error - compression failed");
-
-      // The size of the data to write is 'out_len'
-      f.WriteArray((lzo_uint32*)&out_len, 1);
-      f.WriteBytes(out, out_len);
-
-      if (cur_len != IN_LEN)
-        break;
+      PanicAlertT("Internal LZO Error - compression failed");
+      return;
+    }
 
-      i += cur_len;
+    size_t compressed_size = 0;
+    for (int chunk = 0; chunk < num_chunks; chunk++)
+    {
+      const size_t chunk_size = sizeof(u32) + compressed_sizes[chunk];
+      std::memmove(&compressed[compressed_size], &compressed[chunk * slot_size], chunk_size);
+      compressed_size += chunk_size;
     }
+    f.WriteBytes(compressed.data(), compressed_size);
   }
   else  // uncompressed
   {
@@ -489,27 +535,67 @@ static void LoadFileStateData(const std::string& filename, std::vector<u8>& ret_
 
     buffer.resize(header.size);
 
-    lzo_uint i = 0;
-    while (true)
+    std::vector<u8> compressed(static_cast<size_t>(f.GetSize() - sizeof(StateHeader)));
+    if (!f.ReadBytes(compressed.data(), compressed.size()))
     {
-      lzo_uint32 cur_len = 0;  // number of bytes to read
-      lzo_uint new_len = 0;    // number of bytes to write
+      PanicAlertT("Internal LZO Error - failed to read the compressed state");
+      return;
+    }
 
-      if (!f.ReadArray(&cur_len, 1))
+    // Find the chunks first, then decompress them independently
+    std::vector<std::pair<size_t, u32>> chunks;
+    for (size_t offset = 0; offset + sizeof(u32) <= compressed.size();)
+    {
+      u32 cur_len;
+      std::memcpy(&cur_len, &compressed[offset], sizeof(u32));
+      offset += sizeof(u32);
+      if (cur_len > compressed.size() - offset)
         break;
+      chunks.emplace_back(offset, cur_len);
+      offset += cur_len;
+    }
 
-      f.ReadBytes(out, cur_len);
-      const int res = lzo1x_decompress(out, cur_len, &buffer[i], &new_len, nullptr);
-      if (res != LZO_E_OK)
-      {
-        // This doesn't seem to happen anymore.
-        PanicAlertT("Internal LZO Error - decompression failed (%d) (%li, %li) \n"
-                    "Try loading the state again",
-                    res, i, new_len);
-        return;
-      }
-
-      i += new_len;
+    // The workers only record the result of each chunk, failures are reported on this thread
+    struct ChunkResult
+    {
+      int res = LZO_E_OK;
+      lzo_uint len = 0;
+      bool ok = true;
+    };
+    std::vector<ChunkResult> results(chunks.size());
+    Common::LoopWorker::Loop(
+        [&](int lower, int upper) {
+          for (int chunk = lower; chunk < upper; chunk++)
+          {
+            // Old states end with an empty chunk when the size is a multiple of IN_LEN
+            const size_t i = static_cast<size_t>(chunk) * IN_LEN;
+            if (i >= buffer.size())
+              continue;
+            const lzo_uint expected_len = static_cast<lzo_uint>(std::min<size_t>(buffer.size() - i, IN_LEN));
+            lzo_uint new_len = expected_len;
+            const int res = lzo1x_decompress_safe(&compressed[chunks[chunk].first], chunks[chunk].second,
+                                                  &buffer[i], &new_len, nullptr);
+            if (res != LZO_E_OK || new_len != expected_len)
+              results[chunk] = {res, new_len, false};
+          }
+        },
+        0, static_cast<int>(chunks.size()), CHUNKS_PER_BAND);
+
+    const auto failed = std::find_if(results.begin(), results.end(),
+                                     [](const ChunkResult& result) { return !result.ok; });
+    if (failed != results.end())
+    {
+      // This doesn't seem to happen anymore.
+      PanicAlertT("Internal LZO Error - decompression failed (%d) (%zu, %lu) \n"
+                  "Try loading the state again",
+                  failed->res, static_cast<size_t>(failed - results.begin()) * IN_LEN,
+                  static_cast<unsigned long>(failed->len));
+      return;
+    }
+    if (chunks.size() * IN_LEN < buffer.size())
+    {
+      PanicAlertT("Internal LZO Error - the state is truncated");
+      return;
     }
   }
   else  // uncompressed
@@ -52,6 +52,10 @@ void VerifyAt(const std::string& filename);
 void SaveToBuffer(std::vector<u8>& buffer);
 void LoadFromBuffer(std::vector<u8>& buffer);
 void VerifyBuffer(std::vector<u8>& buffer);
+// Same as above, but leave out the emulated memory and the GameCube ARAM, which are then tracked
+// with Memory::CollectDirtyPages and restored with Memory::RestoreTrackedMemory
+void SaveToBufferWithoutMemory(std::vector<u8>& buffer);
+void LoadFromBufferWithoutMemory(std::vector<u8>& buffer);
 
 void LoadLastSaved(int i = 1);
 void SaveFirstSaved();
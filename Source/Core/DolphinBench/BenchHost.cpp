@@ -0,0 +1,90 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "DolphinBench/BenchHost.h"
+
+#include <string>
+#include <utility>
+
+#include "Core/Host.h"
+
+static std::function<void(int)> s_message_handler;
+static std::function<void()> s_update_main_frame_handler;
+
+namespace BenchHost
+{
+void SetMessageHandler(std::function<void(int)> handler)
+{
+  s_message_handler = std::move(handler);
+}
+
+void SetUpdateMainFrameHandler(std::function<void()> handler)
+{
+  s_update_main_frame_handler = std::move(handler);
+}
+}
+
+void Host_NotifyMapLoaded()
+{
+}
+
+void Host_RefreshDSPDebuggerWindow()
+{
+}
+
+void Host_Message(int id)
+{
+  if (s_message_handler)
+    s_message_handler(id);
+}
+
+void* Host_GetRenderHandle()
+{
+  return nullptr;
+}
+
+void Host_UpdateTitle(const std::string& title)
+{
+}
+
+void Host_UpdateDisasmDialog()
+{
+}
+
+void Host_UpdateMainFrame()
+{
+  if (s_update_main_frame_handler)
+    s_update_main_frame_handler();
+}
+
+void Host_RequestRenderWindowSize(int width, int height)
+{
+}
+
+bool Host_UINeedsControllerState()
+{
+  return false;
+}
+
+bool Host_RendererHasFocus()
+{
+  return false;
+}
+
+bool Host_RendererIsFullscreen()
+{
+  return false;
+}
+
+void Host_ShowVideoConfig(void*, const std::string&)
+{
+}
+
+void Host_YieldToUI()
+{
+}
+
+void Host_UpdateProgressDialog(const char* caption, int position, int total)
+{
+}
@@ -0,0 +1,17 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+// Host_* callbacks shared by the bench executables. They do nothing, except for the handlers
+// a bench that runs the core sets.
+
+#pragma once
+
+#include <functional>
+
+namespace BenchHost
+{
+// Set before the core starts, called by Host_Message and Host_UpdateMainFrame
+void SetMessageHandler(std::function<void(int)> handler);
+void SetUpdateMainFrameHandler(std::function<void()> handler);
+}
@@ -0,0 +1,264 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+// Replays a FIFO log without a window and without throttling, and writes how long each frame
+// spent in the main stages of GPU emulation as JSON, to compare builds on a fixed set of logs.
+
+#include <OptionParser.h>
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AudioCommon/AudioCommon.h"
+#include "Common/CommonTypes.h"
+#include "Common/Event.h"
+#include "Common/Flag.h"
+#include "Common/Version.h"
+
+#include "Core/Boot/Boot.h"
+#include "Core/BootManager.h"
+#include "Core/ConfigManager.h"
+#include "Core/Core.h"
+#include "Core/FifoPlayer/FifoPlayer.h"
+#include "Core/Host.h"
+
+#include "DolphinBench/BenchHost.h"
+
+#include "UICommon/UICommon.h"
+
+#include "VideoCommon/FrameProfiler.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct FrameSample
+{
+  u32 frame;
+  u64 total_ns;
+  FrameProfiler::StageTimes stages;
+};
+
+static Common::Flag s_running{true};
+static Common::Event s_update_main_frame_event;
+
+// Only accessed by the CPU thread while the core runs
+static std::vector<FrameSample> s_samples;
+static bool s_frame_started = false;
+static u32 s_frame = 0;
+static Clock::time_point s_frame_start;
+
+static void EndFrame()
+{
+  const Clock::time_point now = Clock::now();
+  const FrameProfiler::StageTimes stages = FrameProfiler::TakeFrameTimes();
+  // What runs before the first frame is setup, not part of any frame
+  if (s_frame_started)
+  {
+    const u64 total_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - s_frame_start).count();
+    s_samples.push_back({s_frame, total_ns, stages});
+  }
+  s_frame_start = now;
+}
+
+// Called before each frame is written, the previous one is done by then
+static void FrameWritten()
+{
+  EndFrame();
+  s_frame = FifoPlayer::GetInstance().GetCurrentFrameNum();
+  s_frame_started = true;
+}
+
+// Sent by the FifoPlayer right after the last frame
+static void Stopped()
+{
+  if (s_frame_started)
+  {
+    EndFrame();
+    s_frame_started = false;
+  }
+  s_running.Clear();
+  s_update_main_frame_event.Set();
+}
+
+static std::string EscapeJSON(const std::string& str)
+{
+  std::string result;
+  for (char c : str)
+  {
+    if (c == '"' || c == '\\')
+    {
+      result += '\\';
+      result += c;
+    }
+    else if (static_cast<unsigned char>(c) < 0x20)
+    {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      result += escaped;
+    }
+    else
+    {
+      result += c;
+    }
+  }
+  return result;
+}
+
+static void WriteStageTimes(FILE* file, const FrameProfiler::StageTimes& stages)
+{
+  for (size_t i = 1; i < FrameProfiler::NUM_STAGES; i++)
+  {
+    std::fprintf(file, ", \"%s_ns\": %" PRIu64,
+                 FrameProfiler::GetStageName(static_cast<FrameProfiler::Stage>(i)), stages[i]);
+  }
+}
+
+static void WriteReport(FILE* file, const std::string& dff_path, const std::string& backend)
+{
+  u64 total_ns = 0;
+  u64 max_frame_ns = 0;
+  FrameProfiler::StageTimes stage_totals{};
+  for (const FrameSample& sample : s_samples)
+  {
+    total_ns += sample.total_ns;
+    max_frame_ns = std::max(max_frame_ns, sample.total_ns);
+    for (size_t i = 0; i < FrameProfiler::NUM_STAGES; i++)
+      stage_totals[i] += sample.stages[i];
+  }
+
+  std::fprintf(file, "{\n");
+  std::fprintf(file, "  \"file\": \"%s\",\n", EscapeJSON(dff_path).c_str());
+  std::fprintf(file, "  \"video_backend\": \"%s\",\n", EscapeJSON(backend).c_str());
+  std::fprintf(file, "  \"version\": \"%s\",\n", EscapeJSON(Common::scm_rev_str).c_str());
+  std::fprintf(file, "  \"summary\": {\"frame_count\": %zu, \"total_ns\": %" PRIu64,
+               s_samples.size(), total_ns);
+  std::fprintf(file, ", \"mean_frame_ns\": %" PRIu64 ", \"max_frame_ns\": %" PRIu64,
+               s_samples.empty() ? 0 : total_ns / s_samples.size(), max_frame_ns);
+  WriteStageTimes(file, stage_totals);
+  std::fprintf(file, "},\n");
+  std::fprintf(file, "  \"frames\": [");
+  for (size_t i = 0; i < s_samples.size(); i++)
+  {
+    const FrameSample& sample = s_samples[i];
+    std::fprintf(file, "%s\n    {\"frame\": %u, \"total_ns\": %" PRIu64, i ? "," : "",
+                 sample.frame, sample.total_ns);
+    WriteStageTimes(file, sample.stages);
+    std::fprintf(file, "}");
+  }
+  std::fprintf(file, "\n  ]\n}\n");
+}
+
+int main(int argc, char* argv[])
+{
+  optparse::OptionParser parser;
+  parser.usage("usage: %prog [options]... FILE.dff").version(Common::scm_rev_str);
+  parser.add_option("-u", "--user").action("store").help("User folder path");
+  parser.add_option("-o", "--output")
+      .action("store")
+      .metavar("<file>")
+      .help("Write the report to a file instead of the standard output");
+  parser.set_defaults("video_backend", "Software Renderer");
+  parser.add_option("-v", "--video_backend")
+      .action("store")
+      .help("Video backend to replay with [default: %default]");
+
+  optparse::Values& options = parser.parse_args(argc, argv);
+  const std::vector<std::string> args = parser.args();
+  if (args.size() != 1)
+  {
+    parser.print_help();
+    return 1;
+  }
+  const std::string dff_path = args.front();
+  const std::string video_backend = static_cast<const char*>(options.get("video_backend"));
+
+  std::string user_directory;
+  if (options.is_set("user"))
+    user_directory = static_cast<const char*>(options.get("user"));
+
+  UICommon::SetUserDirectory(user_directory);
+  UICommon::Init();
+
+  // Everything on one thread, as fast as it goes, played once. The settings are saved on
+  // shutdown, so they are put back before that.
+  SConfig& config = SConfig::GetInstance();
+  const std::string saved_video_backend = config.m_strVideoBackend;
+  const std::string saved_audio_backend = config.sBackend;
+  const bool saved_cpu_thread = config.bCPUThread;
+  const bool saved_loop_fifo_replay = config.bLoopFifoReplay;
+  const float saved_emulation_speed = config.m_EmulationSpeed;
+  config.m_strVideoBackend = video_backend;
+  config.sBackend = BACKEND_NULLSOUND;
+  config.bCPUThread = false;
+  config.bLoopFifoReplay = false;
+  config.m_EmulationSpeed = 0.0f;
+
+  BenchHost::SetMessageHandler([](int id) {
+    if (id == WM_USER_STOP)
+      Stopped();
+  });
+  BenchHost::SetUpdateMainFrameHandler([] { s_update_main_frame_event.Set(); });
+  Core::SetOnStateChangedCallback([](Core::State state) {
+    if (state == Core::State::Uninitialized)
+      s_running.Clear();
+  });
+
+  FrameProfiler::SetEnabled(true);
+  FifoPlayer::GetInstance().SetFrameWrittenCallback(FrameWritten);
+
+  int result = 0;
+  if (BootManager::BootCore(BootParameters::GenerateFromFile(dff_path)))
+  {
+    while (s_running.IsSet())
+    {
+      Core::HostDispatchJobs();
+      s_update_main_frame_event.WaitFor(std::chrono::milliseconds(100));
+    }
+    Core::Stop();
+    Core::Shutdown();
+  }
+  else
+  {
+    std::fprintf(stderr, "Could not replay %s\n", dff_path.c_str());
+    result = 1;
+  }
+
+  FifoPlayer::GetInstance().SetFrameWrittenCallback(nullptr);
+  FrameProfiler::SetEnabled(false);
+
+  config.m_strVideoBackend = saved_video_backend;
+  config.sBackend = saved_audio_backend;
+  config.bCPUThread = saved_cpu_thread;
+  config.bLoopFifoReplay = saved_loop_fifo_replay;
+  config.m_EmulationSpeed = saved_emulation_speed;
+  UICommon::Shutdown();
+
+  if (result != 0)
+    return result;
+  if (s_samples.empty())
+  {
+    std::fprintf(stderr, "No frame was replayed\n");
+    return 1;
+  }
+
+  FILE* file = stdout;
+  if (options.is_set("output"))
+  {
+    file = std::fopen(static_cast<const char*>(options.get("output")), "w");
+    if (!file)
+    {
+      std::fprintf(stderr, "Could not open %s\n", static_cast<const char*>(options.get("output")));
+      return 1;
+    }
+  }
+  WriteReport(file, dff_path, video_backend);
+  if (file != stdout)
+    std::fclose(file);
+
+  return 0;
+}
@@ -20,11 +20,13 @@
 #include <QSpinBox>
 #include <QTextEdit>
 
+#include <algorithm>
 #include <sstream>
 
 #include "Common/CommonPaths.h"
 #include "Common/Config/Config.h"
 #include "Common/TraversalClient.h"
+#include "Core/Config/NetplaySettings.h"
 #include "Core/Config/SYSCONFSettings.h"
 #include "Core/ConfigManager.h"
 #include "Core/Core.h"
@@ -236,6 +238,10 @@ void NetPlayDialog::OnStart()
   settings.m_OCFactor = instance.m_OCFactor;
   settings.m_EXIDevice[0] = instance.m_EXIDevice[0];
   settings.m_EXIDevice[1] = instance.m_EXIDevice[1];
+  settings.m_PadRedundancy =
+      static_cast<u32>(std::max(Config::Get(Config::NETPLAY_PAD_REDUNDANCY), 0));
+  settings.m_RollbackFrames =
+      static_cast<u32>(std::max(Config::Get(Config::NETPLAY_ROLLBACK_FRAMES), 0));
 
   Settings::Instance().GetNetPlayServer()->SetNetSettings(settings);
   Settings::Instance().GetNetPlayServer()->StartGame();
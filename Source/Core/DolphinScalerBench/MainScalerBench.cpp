@@ -0,0 +1,138 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+// Scales a synthetic texture with every TextureScaler filter, once per thread count, and writes
+// the throughput in output Mpixels per second as JSON, to compare builds and thread pool sizes.
+
+#include <OptionParser.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/ThreadPool.h"
+#include "Common/Version.h"
+
+#include "VideoCommon/TextureScalerCommon.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct ScalerFilter
+{
+  const char* name;
+  int type;
+  bool deposterize;
+};
+
+static const ScalerFilter s_filters[] = {
+    {"xBRZ", TextureScaler::XBRZ, false},
+    {"Hybrid", TextureScaler::HYBRID, false},
+    {"Bicubic", TextureScaler::BICUBIC, false},
+    {"HybridBicubic", TextureScaler::HYBRID_BICUBIC, false},
+    {"Jinc", TextureScaler::JINC, false},
+    {"JincSharper", TextureScaler::JINC_SHARPER, false},
+    {"Smoothstep", TextureScaler::SMOOTHSTEP, false},
+    {"ThreePoint", TextureScaler::THREE_POINT, false},
+    {"DDT", TextureScaler::DDT, false},
+    {"DDTSharp", TextureScaler::DDT_SHARP, false},
+    {"Deposterize+xBRZ", TextureScaler::XBRZ, true},
+};
+
+// Posterized gradients with some noise, close enough to real game textures
+static std::vector<u32> MakeTexture(int width, int height)
+{
+  std::vector<u32> texture(width * height);
+  std::mt19937 rng(0x1234);
+  for (int y = 0; y < height; ++y)
+  {
+    for (int x = 0; x < width; ++x)
+    {
+      u32 r = (x & 0xF0) | (rng() & 3);
+      u32 g = (y & 0xF0) | (rng() & 3);
+      u32 b = ((x ^ y) & 0xE0);
+      u32 a = ((x / 16 + y / 16) & 1) ? 0xFF : 0x80;
+      texture[y * width + x] = (a << 24) | (b << 16) | (g << 8) | r;
+    }
+  }
+  return texture;
+}
+
+int main(int argc, char* argv[])
+{
+  optparse::OptionParser parser;
+  parser.usage("usage: %prog [options]...").version(Common::scm_rev_str);
+  parser.add_option("-o", "--output")
+      .action("store")
+      .metavar("<file>")
+      .help("Write the report to a file instead of the standard output");
+  parser.set_defaults("size", "256");
+  parser.add_option("-s", "--size")
+      .action("store")
+      .help("Width and height of the source texture [default: %default]");
+  parser.set_defaults("factor", "3");
+  parser.add_option("-f", "--factor")
+      .action("store")
+      .help("Scaling factor, from 2 to 5 [default: %default]");
+  parser.set_defaults("iterations", "3");
+  parser.add_option("-i", "--iterations")
+      .action("store")
+      .help("Times the texture is scaled per filter and thread count [default: %default]");
+
+  optparse::Values& options = parser.parse_args(argc, argv);
+  const int size = std::max(1, std::atoi(options.get("size")));
+  const int factor = std::min(std::max(2, std::atoi(options.get("factor"))), 5);
+  const int iterations = std::max(1, std::atoi(options.get("iterations")));
+
+  // Powers of two up to the pool size, and the pool plus the calling thread
+  std::vector<int> thread_counts;
+  const int max_threads = static_cast<int>(Common::ThreadPool::GetThreadCount()) + 1;
+  for (int threads = 1; threads < max_threads; threads *= 2)
+    thread_counts.push_back(threads);
+  thread_counts.push_back(max_threads);
+
+  FILE* file = stdout;
+  if (options.is_set("output"))
+    file = std::fopen(static_cast<const char*>(options.get("output")), "w");
+  if (!file)
+  {
+    std::fprintf(stderr, "Could not write the report\n");
+    return 1;
+  }
+
+  std::vector<u32> texture = MakeTexture(size, size);
+  TextureScaler scaler;
+  const double mpixels = double(size) * size * factor * factor * iterations / 1e6;
+
+  std::fprintf(file, "{\n");
+  std::fprintf(file, "  \"version\": \"%s\",\n", Common::scm_rev_str.c_str());
+  std::fprintf(file, "  \"size\": %d,\n", size);
+  std::fprintf(file, "  \"factor\": %d,\n", factor);
+  std::fprintf(file, "  \"iterations\": %d,\n", iterations);
+  std::fprintf(file, "  \"filters\": {");
+  for (size_t i = 0; i < sizeof(s_filters) / sizeof(s_filters[0]); ++i)
+  {
+    const ScalerFilter& filter = s_filters[i];
+    std::fprintf(file, "%s\n    \"%s\": {", i ? "," : "", filter.name);
+    for (size_t j = 0; j < thread_counts.size(); ++j)
+    {
+      scaler.SetMaxThreads(thread_counts[j]);
+      const Clock::time_point start = Clock::now();
+      for (int k = 0; k < iterations; ++k)
+        scaler.Scale(texture.data(), size, size, filter.type, factor, filter.deposterize);
+      const std::chrono::duration<double> elapsed = Clock::now() - start;
+      std::fprintf(file, "%s\"%d\": %.2f", j ? ", " : "", thread_counts[j],
+                   elapsed.count() > 0 ? mpixels / elapsed.count() : 0.0);
+    }
+    std::fprintf(file, "}");
+  }
+  std::fprintf(file, "\n  }\n}\n");
+
+  if (file != stdout)
+    std::fclose(file);
+  return 0;
+}
@@ -0,0 +1,212 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+// Generates the vertex and pixel shaders of the UIDs recorded in the shader usage profiles, as
+// many times as asked, and writes how many shaders were generated per second as JSON. This is
+// what a shader cache miss costs before the compiler runs, to compare builds on a fixed corpus.
+
+#include <OptionParser.h>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/FileSearch.h"
+#include "Common/FileUtil.h"
+#include "Common/StringUtil.h"
+#include "Common/Version.h"
+
+#include "UICommon/UICommon.h"
+
+#include "VideoCommon/ObjectUsageProfiler.h"
+#include "VideoCommon/PixelShaderGen.h"
+#include "VideoCommon/ShaderGenCommon.h"
+#include "VideoCommon/VertexShaderGen.h"
+#include "VideoCommon/VideoConfig.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Nothing is kept about the objects, only the keys are read
+struct UidInfo
+{
+};
+
+struct StageResult
+{
+  size_t uid_count = 0;
+  u64 shader_count = 0;
+  u64 total_ns = 0;
+  u64 total_bytes = 0;
+};
+
+static std::string EscapeJSON(const std::string& str)
+{
+  std::string result;
+  for (char c : str)
+  {
+    if (c == '"' || c == '\\')
+    {
+      result += '\\';
+      result += c;
+    }
+    else if (static_cast<unsigned char>(c) < 0x20)
+    {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      result += escaped;
+    }
+    else
+    {
+      result += c;
+    }
+  }
+  return result;
+}
+
+// The global profiles gather the shaders of every game, by category
+template <typename Uid, typename UidHasher>
+static void ReadUids(const std::string& path, pKey_t version, std::vector<Uid>* uids)
+{
+  ObjectUsageProfiler<Uid, pKey_t, UidInfo, UidHasher> profiler(version);
+  std::string filename;
+  SplitPath(path, nullptr, &filename, nullptr);
+  profiler.ReadFromFile(path, StringBeginsWith(filename, "Ishiiruka."));
+  profiler.ForEachMostUsed([uids](const Uid& uid) { uids->push_back(uid); });
+}
+
+template <typename Uid, typename Generate>
+static StageResult Run(const std::vector<Uid>& uids, u32 iterations, Generate generate)
+{
+  StageResult result;
+  result.uid_count = uids.size();
+  // Reused like the buffers of the backends, so only the first shaders grow it
+  ShaderCode code;
+  const ShaderHostConfig host_config = ShaderHostConfig::GetCurrent();
+  const Clock::time_point start = Clock::now();
+  for (u32 i = 0; i < iterations; i++)
+  {
+    for (const Uid& uid : uids)
+    {
+      code.clear();
+      generate(code, uid.GetUidData(), host_config);
+      result.total_bytes += code.size();
+    }
+  }
+  result.total_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+  result.shader_count = static_cast<u64>(uids.size()) * iterations;
+  return result;
+}
+
+static void WriteStage(FILE* file, const char* name, const StageResult& result)
+{
+  const double seconds = result.total_ns / 1e9;
+  std::fprintf(file, "  \"%s\": {\"uid_count\": %zu, \"shader_count\": %" PRIu64, name,
+               result.uid_count, result.shader_count);
+  std::fprintf(file, ", \"total_ns\": %" PRIu64 ", \"shaders_per_second\": %.1f", result.total_ns,
+               seconds > 0 ? result.shader_count / seconds : 0.0);
+  std::fprintf(file, ", \"bytes_per_shader\": %" PRIu64 "}",
+               result.shader_count ? result.total_bytes / result.shader_count : 0);
+}
+
+int main(int argc, char* argv[])
+{
+  optparse::OptionParser parser;
+  parser.usage("usage: %prog [options]... [FILE.usage]...").version(Common::scm_rev_str);
+  parser.add_option("-u", "--user").action("store").help("User folder path");
+  parser.add_option("-o", "--output")
+      .action("store")
+      .metavar("<file>")
+      .help("Write the report to a file instead of the standard output");
+  parser.set_defaults("iterations", "10");
+  parser.add_option("-i", "--iterations")
+      .action("store")
+      .help("Times each shader is generated [default: %default]");
+  parser.set_defaults("api", "vulkan");
+  parser.add_option("-a", "--api")
+      .action("store")
+      .choices({"vulkan", "opengl", "d3d11"})
+      .help("Shading language to generate: vulkan, opengl or d3d11 [default: %default]");
+
+  optparse::Values& options = parser.parse_args(argc, argv);
+  const u32 iterations = static_cast<u32>(std::strtoul(options.get("iterations"), nullptr, 10));
+  const std::string api = static_cast<const char*>(options.get("api"));
+
+  std::string user_directory;
+  if (options.is_set("user"))
+    user_directory = static_cast<const char*>(options.get("user"));
+
+  UICommon::SetUserDirectory(user_directory);
+  UICommon::Init();
+
+  // Without files, the profiles of every game played with this user folder
+  std::vector<std::string> paths = parser.args();
+  if (paths.empty())
+    paths = Common::DoFileSearch({File::GetUserPath(D_SHADERUIDCACHE_IDX)}, {".usage"});
+
+  std::vector<VertexShaderUid> vs_uids;
+  std::vector<PixelShaderUid> ps_uids;
+  for (const std::string& path : paths)
+  {
+    if (StringEndsWith(path, ".vs.usage"))
+    {
+      ReadUids<VertexShaderUid, VertexShaderUid::ShaderUidHasher>(
+          path, VERTEXSHADERGEN_UID_VERSION, &vs_uids);
+    }
+    else if (StringEndsWith(path, ".ps.usage"))
+    {
+      ReadUids<PixelShaderUid, PixelShaderUid::ShaderUidHasher>(
+          path, PIXELSHADERGEN_UID_VERSION, &ps_uids);
+    }
+  }
+
+  int result = 0;
+  if (vs_uids.empty() && ps_uids.empty())
+  {
+    std::fprintf(stderr, "No shader UIDs found\n");
+    result = 1;
+  }
+  else
+  {
+    g_Config.Refresh();
+    if (api == "opengl")
+      g_Config.backend_info.APIType = API_OPENGL;
+    else if (api == "d3d11")
+      g_Config.backend_info.APIType = API_D3D11;
+    else
+      g_Config.backend_info.APIType = API_VULKAN;
+    UpdateActiveConfig();
+
+    const StageResult vs_result = Run(vs_uids, iterations, GenerateVertexShaderCode);
+    const StageResult ps_result = Run(ps_uids, iterations, GeneratePixelShaderCode);
+
+    FILE* file = stdout;
+    if (options.is_set("output"))
+      file = std::fopen(static_cast<const char*>(options.get("output")), "w");
+    if (file)
+    {
+      std::fprintf(file, "{\n");
+      std::fprintf(file, "  \"api\": \"%s\",\n", EscapeJSON(api).c_str());
+      std::fprintf(file, "  \"version\": \"%s\",\n", EscapeJSON(Common::scm_rev_str).c_str());
+      std::fprintf(file, "  \"iterations\": %u,\n", iterations);
+      WriteStage(file, "vs", vs_result);
+      std::fprintf(file, ",\n");
+      WriteStage(file, "ps", ps_result);
+      std::fprintf(file, "\n}\n");
+      if (file != stdout)
+        std::fclose(file);
+    }
+    else
+    {
+      std::fprintf(stderr, "Could not write the report\n");
+      result = 1;
+    }
+  }
+
+  UICommon::Shutdown();
+  return result;
+}
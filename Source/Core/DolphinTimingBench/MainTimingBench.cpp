@@ -0,0 +1,215 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+// Runs the same schedule/remove/advance sequence on CoreTiming's timing wheel and on the binary
+// heap CoreTiming used before it, and writes the cost per operation of both as JSON.
+
+#include <OptionParser.h>
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/Version.h"
+
+#include "Core/Core.h"
+#include "Core/CoreTiming.h"
+#include "Core/PowerPC/PowerPC.h"
+
+#include "UICommon/UICommon.h"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int EVENT_TYPES = 64;
+constexpr s64 MAX_SLICE_LENGTH = 20000;  // Copied from CoreTiming internals
+
+struct QueueResult
+{
+  u64 operations = 0;
+  u64 fired = 0;
+  u64 total_ns = 0;
+};
+
+static std::vector<CoreTiming::EventType*> s_types;
+static std::vector<s64> s_periods;
+static size_t s_next_period = 0;
+static u64 s_fired = 0;
+
+static s64 NextPeriod()
+{
+  return s_periods[s_next_period++ % s_periods.size()];
+}
+
+// Reschedules itself, like most of the hardware timers do
+static void PeriodicCallback(u64 userdata, s64 lateness)
+{
+  s_fired++;
+  CoreTiming::ScheduleEvent(NextPeriod() - lateness, s_types[userdata], userdata);
+}
+
+// The binary heap CoreTiming used before the timing wheel
+struct HeapEvent
+{
+  s64 time;
+  u64 fifo_order;
+  int type;
+};
+
+static bool operator>(const HeapEvent& left, const HeapEvent& right)
+{
+  return std::tie(left.time, left.fifo_order) > std::tie(right.time, right.fifo_order);
+}
+
+// Every operation cancels and reschedules an event, every fourth one ends the slice
+static QueueResult RunWheel(u32 operations)
+{
+  s_next_period = 0;
+  s_fired = 0;
+
+  // Enter slice 0
+  CoreTiming::Advance();
+
+  const Clock::time_point start = Clock::now();
+  for (u32 i = 0; i < operations; i++)
+  {
+    const int type = i % EVENT_TYPES;
+    CoreTiming::RemoveEvent(s_types[type]);
+    CoreTiming::ScheduleEvent(NextPeriod(), s_types[type], type);
+    if (i % 4 == 3)
+    {
+      PowerPC::ppcState.downcount = 0;
+      CoreTiming::Advance();
+    }
+  }
+
+  QueueResult result;
+  result.total_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+  result.operations = operations;
+  result.fired = s_fired;
+  return result;
+}
+
+static QueueResult RunHeap(u32 operations)
+{
+  std::vector<HeapEvent> heap;
+  s64 global_timer = 0;
+  s64 slice_length = MAX_SLICE_LENGTH;
+  u64 fifo_order = 0;
+  s_next_period = 0;
+
+  QueueResult result;
+  const Clock::time_point start = Clock::now();
+  for (u32 i = 0; i < operations; i++)
+  {
+    const int type = i % EVENT_TYPES;
+    auto itr = std::remove_if(heap.begin(), heap.end(),
+                              [&](const HeapEvent& e) { return e.type == type; });
+    if (itr != heap.end())
+    {
+      heap.erase(itr, heap.end());
+      std::make_heap(heap.begin(), heap.end(), std::greater<HeapEvent>());
+    }
+    heap.push_back({global_timer + NextPeriod(), fifo_order++, type});
+    std::push_heap(heap.begin(), heap.end(), std::greater<HeapEvent>());
+    if (i % 4 == 3)
+    {
+      global_timer += slice_length;
+      while (!heap.empty() && heap.front().time <= global_timer)
+      {
+        HeapEvent ev = heap.front();
+        std::pop_heap(heap.begin(), heap.end(), std::greater<HeapEvent>());
+        heap.back() = {ev.time + NextPeriod(), fifo_order++, ev.type};
+        std::push_heap(heap.begin(), heap.end(), std::greater<HeapEvent>());
+        result.fired++;
+      }
+      slice_length = std::min<s64>(heap.front().time - global_timer, MAX_SLICE_LENGTH);
+    }
+  }
+  result.total_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+  result.operations = operations;
+  return result;
+}
+
+static void WriteQueue(FILE* file, const char* name, const QueueResult& result)
+{
+  std::fprintf(file, "  \"%s\": {\"operations\": %" PRIu64 ", \"fired\": %" PRIu64, name,
+               result.operations, result.fired);
+  std::fprintf(file, ", \"total_ns\": %" PRIu64 ", \"ns_per_operation\": %.2f}", result.total_ns,
+               result.operations ? double(result.total_ns) / result.operations : 0.0);
+}
+
+int main(int argc, char* argv[])
+{
+  optparse::OptionParser parser;
+  parser.usage("usage: %prog [options]...").version(Common::scm_rev_str);
+  parser.add_option("-u", "--user").action("store").help("User folder path");
+  parser.add_option("-o", "--output")
+      .action("store")
+      .metavar("<file>")
+      .help("Write the report to a file instead of the standard output");
+  parser.set_defaults("operations", "1000000");
+  parser.add_option("-n", "--operations")
+      .action("store")
+      .help("Events rescheduled on each queue [default: %default]");
+
+  optparse::Values& options = parser.parse_args(argc, argv);
+  const u32 operations = static_cast<u32>(std::strtoul(options.get("operations"), nullptr, 10));
+
+  std::string user_directory;
+  if (options.is_set("user"))
+    user_directory = static_cast<const char*>(options.get("user"));
+
+  UICommon::SetUserDirectory(user_directory);
+  UICommon::Init();
+  Core::DeclareAsCPUThread();
+  PowerPC::Init(PowerPC::CORE_INTERPRETER);
+  CoreTiming::Init();
+
+  s_types.clear();
+  for (int i = 0; i < EVENT_TYPES; i++)
+    s_types.push_back(CoreTiming::RegisterEvent("bench" + std::to_string(i), PeriodicCallback));
+
+  std::mt19937 rng(0);
+  s_periods.resize(4096);
+  for (s64& period : s_periods)
+    period = 1000 + rng() % 100000;
+
+  const QueueResult wheel_result = RunWheel(operations);
+  const QueueResult heap_result = RunHeap(operations);
+
+  CoreTiming::Shutdown();
+  PowerPC::Shutdown();
+  Core::UndeclareAsCPUThread();
+  UICommon::Shutdown();
+
+  FILE* file = stdout;
+  if (options.is_set("output"))
+  {
+    file = std::fopen(static_cast<const char*>(options.get("output")), "w");
+    if (!file)
+    {
+      std::fprintf(stderr, "Could not open %s\n", static_cast<const char*>(options.get("output")));
+      return 1;
+    }
+  }
+  std::fprintf(file, "{\n");
+  std::fprintf(file, "  \"version\": \"%s\",\n", Common::scm_rev_str.c_str());
+  WriteQueue(file, "timing_wheel", wheel_result);
+  std::fprintf(file, ",\n");
+  WriteQueue(file, "binary_heap", heap_result);
+  std::fprintf(file, "\n}\n");
+  if (file != stdout)
+    std::fclose(file);
+
+  return 0;
+}
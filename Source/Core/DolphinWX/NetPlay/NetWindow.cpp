@@ -38,6 +38,7 @@
 #include "Common/MsgHandler.h"
 #include "Common/StringUtil.h"
 
+#include "Core/Config/NetplaySettings.h"
 #include "Core/Config/SYSCONFSettings.h"
 #include "Core/ConfigManager.h"
 #include "Core/HW/EXI/EXI_Device.h"
@@ -328,6 +329,10 @@ void NetPlayDialog::GetNetSettings(NetSettings& settings)
   settings.m_OCFactor = instance.m_OCFactor;
   settings.m_EXIDevice[0] = instance.m_EXIDevice[0];
   settings.m_EXIDevice[1] = instance.m_EXIDevice[1];
+  settings.m_PadRedundancy =
+      static_cast<u32>(std::max(Config::Get(Config::NETPLAY_PAD_REDUNDANCY), 0));
+  settings.m_RollbackFrames =
+      static_cast<u32>(std::max(Config::Get(Config::NETPLAY_ROLLBACK_FRAMES), 0));
 }
 
 std::string NetPlayDialog::FindGame(const std::string& target_game)
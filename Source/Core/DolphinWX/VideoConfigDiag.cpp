@@ -32,6 +32,7 @@
 #include "DolphinWX/VideoConfigDiag.h"
 #include "DolphinWX/WxUtils.h"
 #include "UICommon/VideoUtils.h"
+#include "VideoCommon/HiresTextures.h"
 #include "VideoCommon/PostProcessing.h"
 #include "VideoCommon/RenderBase.h"
 #include "VideoCommon/VideoBackendBase.h"
@@ -178,6 +179,7 @@ static wxString predictiveFifo_desc = _("Generate a secondary fifo to predict re
 static wxString load_hires_textures_desc = _("Load custom textures from User/Load/Textures/<game_id>/\n\nIf unsure, leave this unchecked.");
 static wxString load_hires_material_maps_desc = _("Load custom material maps from User/Load/Textures/<game_id>/\nUsed to Enable Advanced lighting, Requires Pixel Lighting and Hires Textures Enabled\nIf unsure, leave this unchecked.");
 static wxString cache_hires_textures_desc = _("Cache custom textures to system RAM on startup.\nThis can require exponentially more RAM but fixes possible stuttering.\n\nIf unsure, leave this unchecked.");
+static wxString build_texture_pack_desc = _("Packs the custom textures of the running game into User/Load/Textures/<game_id>.htp.\nThe pack is memory mapped and replaces the texture directory on the next boot, which loads much faster.");
 static wxString cache_hires_textures_gpu_desc = _("Cache custom textures to GPU RAM after loading.\nThis can require exponentially more RAM but fixes stuttering the second time the texture is required.\n\nIf unsure, leave this unchecked.");
 static wxString dump_efb_desc = _("Dump the contents of EFB copies to User/Dump/Textures/\n\nIf unsure, leave this unchecked.");
 static wxString internal_resolution_frame_dumping_desc = _(
@@ -214,7 +216,10 @@ static wxString Tessellation_round_desc = _("Select the intensity of the roundin
 static wxString Tessellation_displacement_desc = _("Select the intensity of the displacement effect when using custom materials.");
 static wxString scaling_factor_desc = _("Multiplier applied to the texture size.");
 static wxString texture_deposterize_desc = _("Decrease some gradient's artifacts caused by scaling.");
+static wxString texture_scaling_cache_desc = _("Store scaled textures on disk and reuse them in later sessions instead of scaling them again.\nReduces stuttering in areas that were visited before, at the cost of disk space.\n\nIf unsure, leave this unchecked.");
+static wxString texture_scaling_async_desc = _("Scale textures on a background thread. New textures are shown at native resolution until the scaled version is ready.\nReduces stuttering with high scaling factors.\n\nIf unsure, leave this unchecked.");
 static wxString stereoshader_desc = _("Selects which shader will be used to transform the two images when stereoscopy is enabled.");
+static wxString display_list_cache_desc = _("Caches the converted vertices of display lists and reuses them when the same display list is called again.\nThe display list and the vertex arrays it references are verified on every call.\nSpeeds up games that draw most of their geometry from display lists.\n\nIf unsure, leave this unchecked.");
 static wxString forcedLogivOp_desc = _("Force Logic blending support.\nBy default dx11/12 supports logic op blending only on UINT formats, but in some drivers UNORM is also supported but is not detectable.\nThis option will allow you to test if your driver really supports logic blending, but it will crash the emulator if enabled in a platform that does not support it.\n\nIf unsure, leave this unchecked.");
 static wxString backend_multithreading_desc =
 _("Enables multi-threading in the video backend, which may result in performance "
@@ -525,6 +530,8 @@ VideoConfigDiag::VideoConfigDiag(wxWindow* parent, const std::string &title)
       szr_texturescaling->Add(factor_slider, 1, wxEXPAND | wxRIGHT, 0);
       const wxString sf_choices[] = { wxT("1x"), wxT("2x"), wxT("3x"), wxT("4x"), wxT("5x") };
       szr_texturescaling->Add(label_TextureScale = new wxStaticText(page_enh, wxID_ANY, sf_choices[vconfig.iTexScalingFactor - 1]), 1, wxRIGHT | wxTOP | wxBOTTOM, 5);
+      szr_texturescaling->Add(CreateCheckBox(page_enh, _("Asynchronous Scaling"), (texture_scaling_async_desc), Config::GFX_ENHANCE_TEXTURE_SCALING_ASYNC), 1, wxALIGN_CENTER_VERTICAL);
+      szr_texturescaling->Add(CreateCheckBox(page_enh, _("Cache Scaled Textures"), (texture_scaling_cache_desc), Config::GFX_ENHANCE_TEXTURE_SCALING_CACHE), 1, wxALIGN_CENTER_VERTICAL);
 
       wxStaticBoxSizer* const group_scaling = new wxStaticBoxSizer(wxVERTICAL, page_enh, _("Texture Scaling"));
       group_scaling->Add(szr_texturescaling, 1, wxEXPAND | wxLEFT | wxRIGHT | wxBOTTOM, 5);
@@ -901,6 +908,7 @@ VideoConfigDiag::VideoConfigDiag(wxWindow* parent, const std::string &title)
           Config::GFX_HACK_VERTEX_ROUDING);
       szr_other->Add(vertex_rounding_checkbox);
       szr_other->Add(Forced_LogicOp = CreateCheckBox(page_hacks, _("Force Logic Blending"), (forcedLogivOp_desc), Config::GFX_HACK_FORCE_LOGICOP_BLEND));
+      szr_other->Add(CreateCheckBox(page_hacks, _("Cache Display Lists"), (display_list_cache_desc), Config::GFX_HACK_DISPLAY_LIST_CACHE));
       //szr_other->Add(Predictive_FIFO = CreateCheckBox(page_hacks, _("Predictive FIFO"), (predictiveFifo_desc), vconfig.bPredictiveFifo));
       //szr_other->Add(Wait_For_Shaders = CreateCheckBox(page_hacks, _("Wait for Shader Compilation"), (waitforshadercompilation_desc), vconfig.bWaitForShaderCompilation));
       szr_other->Add(Async_Shader_compilation = CreateCheckBox(page_hacks, _("Full Async Shader Compilation"), (fullAsyncShaderCompilation_desc), Config::GFX_HACK_FULL_ASYNC_SHADER_COMPILATION));
@@ -967,6 +975,11 @@ VideoConfigDiag::VideoConfigDiag(wxWindow* parent, const std::string &title)
       szr_utility->Add(CreateCheckBox(page_advanced, _("Frame Dumps Use FFV1"), (use_ffv1_desc), Config::GFX_USE_FFV1));
 #endif
 
+      button_build_texture_pack = new wxButton(page_advanced, wxID_ANY, _("Build Texture Pack"));
+      button_build_texture_pack->Bind(wxEVT_BUTTON, &VideoConfigDiag::Event_BuildTexturePack, this);
+      RegisterControl(button_build_texture_pack, build_texture_pack_desc);
+      szr_utility->Add(button_build_texture_pack);
+
       wxStaticBoxSizer* const group_utility = new wxStaticBoxSizer(wxVERTICAL, page_advanced, _("Utility"));
       szr_advanced->Add(group_utility, 0, wxEXPAND | wxALL, 5);
       group_utility->Add(szr_utility, 1, wxEXPAND | wxLEFT | wxRIGHT | wxBOTTOM, 5);
@@ -1336,6 +1349,11 @@ void VideoConfigDiag::Event_PPShaderAdd(wxCommandEvent& ev)
   ReloadPostProcessingShaders();
 }
 
+void VideoConfigDiag::Event_BuildTexturePack(wxCommandEvent& ev)
+{
+  HiresTexture::BuildPack();
+}
+
 void VideoConfigDiag::Event_ScalingShader(wxCommandEvent& ev)
 {
   const int sel = ev.GetInt();
@@ -1523,6 +1541,7 @@ void VideoConfigDiag::OnUpdateUI(wxUpdateUIEvent& ev)
 
   // custom textures
   cache_hires_textures->Enable(vconfig.bHiresTextures);
+  button_build_texture_pack->Enable(vconfig.bHiresTextures && Core::IsRunning());
   hires_texturemaps->Enable(vconfig.bHiresTextures && vconfig.bEnablePixelLighting);
   hires_texturemaps->Show(vconfig.backend_info.bSupportsNormalMaps);
 
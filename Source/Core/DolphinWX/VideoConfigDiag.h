@@ -116,6 +116,7 @@ protected:
   void Event_PPShaderListOptions(wxCommandEvent& ev);
   void Event_PPShaderListRemove(wxCommandEvent& ev);
   void Event_PPShaderAdd(wxCommandEvent& ev);
+  void Event_BuildTexturePack(wxCommandEvent& ev);
   void Event_ScalingShader(wxCommandEvent& ev);
   void Event_ConfigureScalingShader(wxCommandEvent &ev);
   void Event_StereoShader(wxCommandEvent& ev);
@@ -211,6 +212,7 @@ protected:
   SettingCheckBox* shaderprecompile;
 
   wxButton* button_config_scalingshader;
+  wxButton* button_build_texture_pack;
 
   wxCheckBox* progressive_scan_checkbox;
   wxCheckBox* vertex_rounding_checkbox;
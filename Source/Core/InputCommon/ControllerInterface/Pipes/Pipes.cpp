@@ -2,12 +2,15 @@
 // Licensed under GPLv2+
 // Refer to the license.txt file included.
 
+#include <algorithm>
 #include <array>
 #include <cstdlib>
+#include <cstring>
 #include <fcntl.h>
 #include <iostream>
 #include <locale>
 #include <map>
+#include <poll.h>
 #include <sstream>
 #include <string>
 #include <sys/stat.h>
@@ -31,6 +34,18 @@ static const std::array<std::string, 2> s_shoulder_tokens{{"L", "R"}};
 
 static const std::array<std::string, 2> s_axis_tokens{{"MAIN", "C"}};
 
+// The axes of BinaryPacket, in order
+static const std::array<std::string, 6> s_binary_axis_tokens{
+    {"MAIN X", "MAIN Y", "C X", "C Y", "L", "R"}};
+
+// Upper bound of a single wait for a lockstep packet, keep_waiting is checked in between
+static constexpr int LOCKSTEP_POLL_TIMEOUT_MS = 100;
+
+static std::mutex s_devices_mutex;
+static std::vector<PipeDevice*> s_devices;
+// Only accessed by the CPU thread
+static u64 s_lockstep_poll = 0;
+
 static double StringToDouble(const std::string& text)
 {
   std::istringstream is(text);
@@ -64,6 +79,33 @@ void PopulateDevices()
   }
 }
 
+void WaitForLockstepInput(const std::function<bool()>& keep_waiting)
+{
+  const u64 poll_id = ++s_lockstep_poll;
+  while (true)
+  {
+    int fd = -1;
+    {
+      std::lock_guard<std::mutex> lk(s_devices_mutex);
+      for (PipeDevice* device : s_devices)
+      {
+        if (!device->TryLockstepPacket(poll_id))
+        {
+          fd = device->GetFd();
+          break;
+        }
+      }
+    }
+    if (fd < 0 || !keep_waiting())
+      return;
+
+    // The device may be removed and its descriptor closed during the wait, the timeout bounds
+    // it and the devices are looked up again afterwards
+    pollfd fds = {fd, POLLIN, 0};
+    poll(&fds, 1, LOCKSTEP_POLL_TIMEOUT_MS);
+  }
+}
+
 PipeDevice::PipeDevice(int fd, const std::string& name) : m_fd(fd), m_name(name)
 {
   for (const auto& tok : s_button_tokens)
@@ -81,34 +123,149 @@ PipeDevice::PipeDevice(int fd, const std::string& name) : m_fd(fd), m_name(name)
     AddAxis(tok + " X", 0.5);
     AddAxis(tok + " Y", 0.5);
   }
+
+  for (const auto& tok : s_button_tokens)
+    m_button_list.push_back(m_buttons[tok]);
+  for (size_t i = 0; i < s_binary_axis_tokens.size(); i++)
+    m_axis_list[i] = {m_axes[s_binary_axis_tokens[i] + " +"], m_axes[s_binary_axis_tokens[i] + " -"]};
+
+  std::lock_guard<std::mutex> lk(s_devices_mutex);
+  s_devices.push_back(this);
 }
 
 PipeDevice::~PipeDevice()
 {
+  {
+    std::lock_guard<std::mutex> lk(s_devices_mutex);
+    s_devices.erase(std::find(s_devices.begin(), s_devices.end(), this));
+  }
   close(m_fd);
 }
 
 void PipeDevice::UpdateInput()
 {
-  // Read any pending characters off the pipe. If we hit a newline,
-  // then dequeue a command off the front of m_buf and parse it.
-  char buf[32];
+  // Skip this update rather than wait for a lockstep poll to get its packet
+  std::unique_lock<std::mutex> lk(m_mutex, std::try_to_lock);
+  if (!lk.owns_lock())
+    return;
+
+  ReadPending();
+  if (m_format == Format::Unknown && !m_buf.empty())
+    m_format = static_cast<u8>(m_buf[0]) == BINARY_MAGIC ? Format::Binary : Format::Text;
+
+  if (m_format == Format::Text)
+    ParseCommands();
+  // In lockstep mode the packets are only applied by the SI polls
+  else if (m_format == Format::Binary && !m_lockstep)
+    ParsePackets();
+}
+
+bool PipeDevice::TryLockstepPacket(u64 poll_id)
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  if (!m_lockstep || m_lockstep_poll == poll_id)
+    return true;
+
+  const bool open = ReadPending();
+  size_t pos = 0;
+  const bool parsed = ParsePacket(&pos);
+  m_buf.erase(0, pos);
+  if (parsed)
+  {
+    m_lockstep_poll = poll_id;
+    return true;
+  }
+  // Nobody is going to send the next packet
+  if (!open)
+    m_lockstep = false;
+  return !m_lockstep;
+}
+
+// Returns false once the writer has closed the pipe
+bool PipeDevice::ReadPending()
+{
+  char buf[1024];
   ssize_t bytes_read = read(m_fd, buf, sizeof buf);
   while (bytes_read > 0)
   {
     m_buf.append(buf, bytes_read);
     bytes_read = read(m_fd, buf, sizeof buf);
   }
-  std::size_t newline = m_buf.find("\n");
+  return bytes_read != 0;
+}
+
+void PipeDevice::ParseCommands()
+{
+  // Dequeue the commands off the front of m_buf up to the last newline and parse them.
+  size_t start = 0;
+  size_t newline = m_buf.find('\n');
   while (newline != std::string::npos)
   {
-    std::string command = m_buf.substr(0, newline);
-    ParseCommand(command);
-    m_buf.erase(0, newline + 1);
-    newline = m_buf.find("\n");
+    ParseCommand(m_buf.substr(start, newline - start));
+    start = newline + 1;
+    newline = m_buf.find('\n', start);
+  }
+  m_buf.erase(0, start);
+}
+
+void PipeDevice::ParsePackets()
+{
+  size_t pos = 0;
+  while (!m_lockstep && ParsePacket(&pos))
+  {
+  }
+  m_buf.erase(0, pos);
+}
+
+// A magic byte in the middle of a packet, after the stream lost its alignment, rarely starts
+// something with the unused bits and the reserved bytes cleared
+static bool IsValidPacket(const BinaryPacket& packet)
+{
+  return (packet.flags & ~FLAG_LOCKSTEP) == 0 && (packet.buttons >> s_button_tokens.size()) == 0 &&
+         packet.reserved[0] == 0 && packet.reserved[1] == 0;
+}
+
+// Applies the next valid packet from *pos if it is complete and moves *pos past it
+bool PipeDevice::ParsePacket(size_t* pos)
+{
+  while (true)
+  {
+    while (*pos < m_buf.size() && static_cast<u8>(m_buf[*pos]) != BINARY_MAGIC)
+      ++*pos;
+    if (m_buf.size() - *pos < sizeof(BinaryPacket))
+      return false;
+
+    BinaryPacket packet;
+    std::memcpy(&packet, m_buf.data() + *pos, sizeof(packet));
+    if (!IsValidPacket(packet))
+    {
+      // Look for the next packet from the byte after this magic
+      ++*pos;
+      continue;
+    }
+    *pos += sizeof(packet);
+    ApplyPacket(packet);
+    return true;
   }
 }
 
+void PipeDevice::ApplyPacket(const BinaryPacket& packet)
+{
+  const u16 buttons = packet.buttons;
+  for (size_t i = 0; i < m_button_list.size(); i++)
+    m_button_list[i]->SetState((buttons >> i) & 1 ? 1.0 : 0.0);
+
+  const std::array<u8, 6> axes{
+      {packet.main_x, packet.main_y, packet.c_x, packet.c_y, packet.trigger_l, packet.trigger_r}};
+  for (size_t i = 0; i < 4; i++)
+    SetAxis(m_axis_list[i], axes[i] / 255.0);
+  // Like SET {L, R}, the triggers only use the upper half of their axis
+  for (size_t i = 4; i < 6; i++)
+    SetAxis(m_axis_list[i], axes[i] / 510.0 + 0.5);
+
+  m_lockstep = (packet.flags & FLAG_LOCKSTEP) != 0;
+}
+
 void PipeDevice::AddAxis(const std::string& name, double value)
 {
   // Dolphin uses separate axes for left/right, which complicates things.
@@ -122,16 +279,20 @@ void PipeDevice::AddAxis(const std::string& name, double value)
 }
 
 void PipeDevice::SetAxis(const std::string& entry, double value)
+{
+  auto search_hi = m_axes.find(entry + " +");
+  auto search_lo = m_axes.find(entry + " -");
+  if (search_hi != m_axes.end() && search_lo != m_axes.end())
+    SetAxis(AxisInputs{search_hi->second, search_lo->second}, value);
+}
+
+void PipeDevice::SetAxis(const AxisInputs& axis, double value)
 {
   value = MathUtil::Clamp(value, 0.0, 1.0);
   double hi = std::max(0.0, value - 0.5) * 2.0;
   double lo = (0.5 - std::min(0.5, value)) * 2.0;
-  auto search_hi = m_axes.find(entry + " +");
-  if (search_hi != m_axes.end())
-    search_hi->second->SetState(hi);
-  auto search_lo = m_axes.find(entry + " -");
-  if (search_lo != m_axes.end())
-    search_lo->second->SetState(lo);
+  axis.hi->SetState(hi);
+  axis.lo->SetState(lo);
 }
 
 void PipeDevice::ParseCommand(const std::string& command)
@@ -4,10 +4,15 @@
 
 #pragma once
 
+#include <array>
+#include <functional>
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "Common/CommonTypes.h"
+
 namespace ciface
 {
 namespace Pipes
@@ -21,8 +26,49 @@ namespace Pipes
 // {PRESS, RELEASE} {A, B, X, Y, Z, START, L, R, D_UP, D_DOWN, D_LEFT, D_RIGHT}
 // SET {L, R} [0, 1]
 // SET {MAIN, C} [0, 1] [0, 1]
+//
+// A pipe whose first byte is BINARY_MAGIC uses the binary format instead, a stream of
+// BinaryPacket, each one holding the full controller state. Bit n of buttons is the nth
+// button of the list above. The sticks and triggers are 0 to 255, with the sticks
+// centered at 128. A packet with an unknown flag, a button bit past the list or a
+// reserved byte that isn't 0 is malformed, bytes are then skipped until the next
+// BINARY_MAGIC.
+//
+// A packet with FLAG_LOCKSTEP set puts the pipe in lockstep mode. Each SI poll then
+// waits for the next packet and applies exactly one, so the game sees every packet once
+// and in order. A packet without the flag, or closing the pipe, leaves lockstep mode.
+// A poll that gives up waiting, because the emulation is stopping or pausing, keeps the
+// previous state and the pipe stays in lockstep mode.
+
+constexpr u8 BINARY_MAGIC = 0xB1;
+
+enum BinaryFlags : u8
+{
+  FLAG_LOCKSTEP = 1 << 0,
+};
+
+#pragma pack(push, 1)
+struct BinaryPacket
+{
+  u8 magic;
+  u8 flags;
+  u16 buttons;  // Little endian, like every host
+  u8 main_x;
+  u8 main_y;
+  u8 c_x;
+  u8 c_y;
+  u8 trigger_l;
+  u8 trigger_r;
+  u8 reserved[2];
+};
+#pragma pack(pop)
+static_assert(sizeof(BinaryPacket) == 12, "BinaryPacket is part of the pipe protocol");
 
 void PopulateDevices();
+// Called at every SI poll, blocks until each pipe in lockstep mode has its next packet or
+// keep_waiting returns false. It is checked between waits, which are bounded, and no lock is
+// held while waiting, so the devices can be refreshed meanwhile.
+void WaitForLockstepInput(const std::function<bool()>& keep_waiting);
 
 class PipeDevice : public Core::Device
 {
@@ -31,6 +77,9 @@ public:
   ~PipeDevice();
 
   void UpdateInput() override;
+  // Returns false while the device waits for the packet of the given poll
+  bool TryLockstepPacket(u64 poll_id);
+  int GetFd() const { return m_fd; }
   std::string GetName() const override { return m_name; }
   std::string GetSource() const override { return "Pipe"; }
 private:
@@ -46,15 +95,44 @@ private:
     ControlState m_state;
   };
 
+  enum class Format
+  {
+    Unknown,
+    Text,
+    Binary,
+  };
+
+  // The two halves of an axis
+  struct AxisInputs
+  {
+    PipeInput* hi;
+    PipeInput* lo;
+  };
+
   void AddAxis(const std::string& name, double value);
+  bool ReadPending();
+  void ParseCommands();
   void ParseCommand(const std::string& command);
+  void ParsePackets();
+  bool ParsePacket(size_t* pos);
+  void ApplyPacket(const BinaryPacket& packet);
   void SetAxis(const std::string& entry, double value);
+  static void SetAxis(const AxisInputs& axis, double value);
 
   const int m_fd;
   const std::string m_name;
+  // Guards the state below, UpdateInput is called from the hotkey threads as well
+  std::mutex m_mutex;
   std::string m_buf;
+  Format m_format = Format::Unknown;
+  bool m_lockstep = false;
+  // The last poll that applied a packet
+  u64 m_lockstep_poll = 0;
   std::map<std::string, PipeInput*> m_buttons;
   std::map<std::string, PipeInput*> m_axes;
+  // In the order of the binary format
+  std::vector<PipeInput*> m_button_list;
+  std::array<AxisInputs, 6> m_axis_list;
 };
 }
 }
@@ -19,7 +19,7 @@ class CommandLineConfigLayerLoader final : public Config::ConfigLayerLoader
 {
 public:
   CommandLineConfigLayerLoader(const std::list<std::string>& args, const std::string& video_backend,
-                               const std::string& audio_backend)
+                               const std::string& audio_backend, const std::string& profile)
       : ConfigLayerLoader(Config::LayerType::CommandLine)
   {
     if (video_backend.size())
@@ -29,6 +29,9 @@ public:
       m_values.emplace_back(
           std::make_tuple("Dolphin", "Core", "DSPHLE", audio_backend == "HLE" ? "True" : "False"));
 
+    if (profile.size())
+      m_values.emplace_back(std::make_tuple("Dolphin", "Core", "SamplingProfile", profile));
+
     // Arguments are in the format of <System>.<Section>.<Key>=Value
     for (const auto& arg : args)
     {
@@ -100,6 +103,11 @@ std::unique_ptr<optparse::OptionParser> CreateParser(ParserOptions options)
   parser->add_option("-a", "--audio_emulation")
       .choices({"HLE", "LLE"})
       .help("Choose audio emulation from [%choices]");
+  parser->set_defaults("profile", "");
+  parser->add_option("-p", "--profile")
+      .action("store")
+      .metavar("<file>")
+      .help("Sample the emulated code and write its stacks to a file, in collapsed stack format");
 
   return parser;
 }
@@ -109,11 +117,12 @@ optparse::Values& ParseArguments(optparse::OptionParser* parser, int argc, char*
   optparse::Values& options = parser->parse_args(argc, argv);
 
   const std::list<std::string>& config_args = options.all("config");
-  if (config_args.size())
+  const std::string profile = static_cast<const char*>(options.get("profile"));
+  if (config_args.size() || profile.size())
   {
     Config::AddLayer(std::make_unique<CommandLineConfigLayerLoader>(
         config_args, static_cast<const char*>(options.get("video_backend")),
-        static_cast<const char*>(options.get("audio_emulation"))));
+        static_cast<const char*>(options.get("audio_emulation")), profile));
   }
   return options;
 }
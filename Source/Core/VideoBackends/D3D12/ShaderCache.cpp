@@ -62,13 +62,13 @@ VUSBytecodeCache vus_bytecode_cache;
 static std::vector<D3DBlob*> s_static_blob_list;
 static std::vector<D3DBlob*> s_host_blob_list;
 
-static LinearDiskCache<TessellationShaderUid, u8> s_hs_disk_cache;
-static LinearDiskCache<TessellationShaderUid, u8> s_ds_disk_cache;
-static LinearDiskCache<GeometryShaderUid, u8> s_gs_disk_cache;
-static LinearDiskCache<PixelShaderUid, u8> s_ps_disk_cache;
-static LinearDiskCache<VertexShaderUid, u8> s_vs_disk_cache;
-static LinearDiskCache<UberShader::PixelUberShaderUid, u8> s_pus_disk_cache;
-static LinearDiskCache<UberShader::VertexUberShaderUid, u8> s_vus_disk_cache;
+static ShaderDiskCache<TessellationShaderUid, u8> s_hs_disk_cache;
+static ShaderDiskCache<TessellationShaderUid, u8> s_ds_disk_cache;
+static ShaderDiskCache<GeometryShaderUid, u8> s_gs_disk_cache;
+static ShaderDiskCache<PixelShaderUid, u8> s_ps_disk_cache;
+static ShaderDiskCache<VertexShaderUid, u8> s_vs_disk_cache;
+static ShaderDiskCache<UberShader::PixelUberShaderUid, u8> s_pus_disk_cache;
+static ShaderDiskCache<UberShader::VertexUberShaderUid, u8> s_vus_disk_cache;
 
 static ByteCodeCacheEntry* s_last_domain_shader_bytecode;
 static ByteCodeCacheEntry* s_last_hull_shader_bytecode;
@@ -89,96 +89,14 @@ static bool s_use_vertex_uber_shader = false;
 
 static HLSLAsyncCompiler *s_compiler;
 
-class PixelShaderCacheInserter final : public LinearDiskCacheReader<PixelShaderUid, u8>
+// The shaders are loaded from the disk caches when they are first used
+template <typename Uid>
+static D3DBlob* LookupByteCode(ShaderDiskCache<Uid, u8>& disk_cache, const Uid& uid)
 {
-public:
-  void Read(const PixelShaderUid &key, const u8* value, u32 value_size)
-  {
-    PixelShaderUid uid = key;
-    uid.ClearHASH();
-    uid.CalculateUIDHash();
-    D3DBlob* blob = new D3DBlob(value_size, value);
-    ShaderCache::InsertPSByteCode(uid, blob);
-  }
-};
-
-class PixelUberShaderCacheInserter final : public LinearDiskCacheReader<UberShader::PixelUberShaderUid, u8>
-{
-public:
-  void Read(const UberShader::PixelUberShaderUid &key, const u8* value, u32 value_size)
-  {
-    D3DBlob* blob = new D3DBlob(value_size, value);
-    UberShader::PixelUberShaderUid uid = key;
-    uid.ClearHASH();
-    uid.CalculateUIDHash();
-    ShaderCache::InsertPUSByteCode(uid, blob);
-  }
-};
-
-class VertexShaderCacheInserter final : public LinearDiskCacheReader<VertexShaderUid, u8>
-{
-public:
-  void Read(const VertexShaderUid &key, const u8* value, u32 value_size)
-  {
-    VertexShaderUid uid = key;
-    uid.ClearHASH();
-    uid.CalculateUIDHash();
-    D3DBlob* blob = new D3DBlob(value_size, value);
-    ShaderCache::InsertVSByteCode(uid, blob);
-  }
-};
-
-class VertexUberShaderCacheInserter final : public LinearDiskCacheReader<UberShader::VertexUberShaderUid, u8>
-{
-public:
-  void Read(const UberShader::VertexUberShaderUid &key, const u8* value, u32 value_size)
-  {
-    D3DBlob* blob = new D3DBlob(value_size, value);
-    UberShader::VertexUberShaderUid uid = key;
-    uid.ClearHASH();
-    uid.CalculateUIDHash();
-    ShaderCache::InsertVUSByteCode(uid, blob);
-  }
-};
-
-class GeometryShaderCacheInserter : public LinearDiskCacheReader<GeometryShaderUid, u8>
-{
-public:
-  void Read(const GeometryShaderUid &key, const u8* value, u32 value_size)
-  {
-    GeometryShaderUid uid = key;
-    uid.ClearHASH();
-    uid.CalculateUIDHash();
-    D3DBlob* blob = new D3DBlob(value_size, value);
-    ShaderCache::InsertGSByteCode(uid, blob);
-  }
-};
-
-class DShaderCacheInserter final : public LinearDiskCacheReader<TessellationShaderUid, u8>
-{
-public:
-  void Read(const TessellationShaderUid &key, const u8* value, u32 value_size)
-  {
-    TessellationShaderUid uid = key;
-    uid.ClearHASH();
-    uid.CalculateUIDHash();
-    D3DBlob* blob = new D3DBlob(value_size, value);
-    ShaderCache::InsertDSByteCode(uid, blob);
-  }
-};
-
-class HShaderCacheInserter final : public LinearDiskCacheReader<TessellationShaderUid, u8>
-{
-public:
-  void Read(const TessellationShaderUid &key, const u8* value, u32 value_size)
-  {
-    TessellationShaderUid uid = key;
-    uid.ClearHASH();
-    uid.CalculateUIDHash();
-    D3DBlob* blob = new D3DBlob(value_size, value);
-    ShaderCache::InsertHSByteCode(uid, blob);
-  }
-};
+  u32 size;
+  const u8* bytecode = disk_cache.Lookup(uid, &size);
+  return bytecode ? new D3DBlob(size, bytecode) : nullptr;
+}
 
 bool ShaderCache::UsePixelUberShader()
 {
@@ -409,21 +327,12 @@ void ShaderCache::LoadHostBasedFromDisk()
   std::string vs_cache_filename = GetDiskShaderCacheFileName(API_D3D11, "vs", true, true);
   std::string gs_cache_filename = GetDiskShaderCacheFileName(API_D3D11, "gs", false, true);
 
-  PixelUberShaderCacheInserter pus_inserter;
-  s_pus_disk_cache.OpenAndRead(pus_cache_filename, pus_inserter);
-
-  VertexUberShaderCacheInserter vus_inserter;
-  s_vus_disk_cache.OpenAndRead(vus_cache_filename, vus_inserter);
-
-
-  PixelShaderCacheInserter ps_inserter;
-  s_ps_disk_cache.OpenAndRead(ps_cache_filename, ps_inserter);
-
-  VertexShaderCacheInserter vs_inserter;
-  s_vs_disk_cache.OpenAndRead(vs_cache_filename, vs_inserter);
-
-  GeometryShaderCacheInserter gs_inserter;
-  s_gs_disk_cache.OpenAndRead(gs_cache_filename, gs_inserter);
+  // Only the keys are read
+  s_pus_disk_cache.Open(pus_cache_filename);
+  s_vus_disk_cache.Open(vus_cache_filename);
+  s_ps_disk_cache.Open(ps_cache_filename);
+  s_vs_disk_cache.Open(vs_cache_filename);
+  s_gs_disk_cache.Open(gs_cache_filename);
 }
 
 void ShaderCache::LoadFromDisk()
@@ -431,12 +340,9 @@ void ShaderCache::LoadFromDisk()
   std::string ds_cache_filename = GetDiskShaderCacheFileName(API_D3D11, "ds", false, false);
   std::string hs_cache_filename = GetDiskShaderCacheFileName(API_D3D11, "hs", false, false);
 
-
-  DShaderCacheInserter ds_inserter;
-  s_ds_disk_cache.OpenAndRead(ds_cache_filename, ds_inserter);
-
-  HShaderCacheInserter hs_inserter;
-  s_hs_disk_cache.OpenAndRead(hs_cache_filename, hs_inserter);
+  // Only the keys are read
+  s_ds_disk_cache.Open(ds_cache_filename);
+  s_hs_disk_cache.Open(hs_cache_filename);
 }
 
 void ShaderCache::Reload()
@@ -581,6 +487,12 @@ void ShaderCache::HandleGSUIDChange(const GeometryShaderUid &gs_uid, std::functi
     s_last_geometry_shader_bytecode = &s_pass_entry;
     return;
   }
+  if (D3DBlob* blob = LookupByteCode(s_gs_disk_cache, gs_uid))
+  {
+    PushHostByteCode(entry, blob);
+    if (oncompilationfinished) oncompilationfinished();
+    return;
+  }
 
   ByteCodeCacheEntry* entry = &gs_bytecode_cache[gs_uid];
   s_last_geometry_shader_bytecode = entry;
@@ -639,6 +551,12 @@ void ShaderCache::HandlePSUIDChange(const PixelShaderUid &ps_uid, bool forcecomp
   {
     return;
   }
+  if (D3DBlob* blob = LookupByteCode(s_ps_disk_cache, ps_uid))
+  {
+    PushHostByteCode(entry, blob);
+    if (oncompilationfinished) oncompilationfinished();
+    return;
+  }
   s_last_pixel_shader_bytecode = entry;
   if (entry->m_initialized.test_and_set())
   {
@@ -694,6 +612,12 @@ void ShaderCache::HandlePUSUIDChange(const UberShader::PixelUberShaderUid &ps_ui
     if (oncompilationfinished) oncompilationfinished();
     return;
   }
+  if (D3DBlob* blob = LookupByteCode(s_pus_disk_cache, ps_uid))
+  {
+    PushHostByteCode(entry, blob);
+    if (oncompilationfinished) oncompilationfinished();
+    return;
+  }
   // Need to compile a new shader
   ShaderCompilerWorkUnit *wunit = s_compiler->NewUnit();
   wunit->GenerateCodeHandler = [ps_uid](ShaderCompilerWorkUnit* wunit)
@@ -739,6 +663,12 @@ void ShaderCache::HandleVSUIDChange(const VertexShaderUid& vs_uid, bool forcecom
   {
     return;
   }
+  if (D3DBlob* blob = LookupByteCode(s_vs_disk_cache, vs_uid))
+  {
+    PushHostByteCode(entry, blob);
+    if (oncompilationfinished) oncompilationfinished();
+    return;
+  }
   s_last_vertex_shader_bytecode = entry;
   // Compile only when we have a new instance
   if (entry->m_initialized.test_and_set())
@@ -792,6 +722,12 @@ void ShaderCache::HandleVUSUIDChange(const UberShader::VertexUberShaderUid& vs_u
     if (oncompilationfinished) oncompilationfinished();
     return;
   }
+  if (D3DBlob* blob = LookupByteCode(s_vus_disk_cache, vs_uid))
+  {
+    PushHostByteCode(entry, blob);
+    if (oncompilationfinished) oncompilationfinished();
+    return;
+  }
   ShaderCompilerWorkUnit *wunit = s_compiler->NewUnit();
   wunit->GenerateCodeHandler = [vs_uid](ShaderCompilerWorkUnit* wunit)
   {
@@ -852,6 +788,24 @@ void ShaderCache::HandleTSUIDChange(const TessellationShaderUid& ts_uid, std::fu
     return;
   }
   hentry->m_initialized.test_and_set();
+  u32 domain_size, hull_size;
+  const u8* domain = s_ds_disk_cache.Lookup(ts_uid, &domain_size);
+  const u8* hull = s_hs_disk_cache.Lookup(ts_uid, &hull_size);
+  if (domain && hull)
+  {
+    PushStaticByteCode(dentry, new D3DBlob(domain_size, domain));
+    PushStaticByteCode(hentry, new D3DBlob(hull_size, hull));
+    s_last_tessellation_shader_uid = ts_uid;
+    s_last_domain_shader_bytecode = dentry;
+    s_last_hull_shader_bytecode = hentry;
+    // Once for each stage, like the compiled ones
+    if (oncompilationfinished)
+    {
+      oncompilationfinished();
+      oncompilationfinished();
+    }
+    return;
+  }
 
   // Need to compile a new shader
   ShaderCode code;
@@ -1208,35 +1162,57 @@ const UberShader::VertexUberShaderUid& ShaderCache::GetActiveVertexUberShaderUid
 
 static const D3D12_SHADER_BYTECODE empty = { 0 };
 
+// The PSO disk cache asks for shaders that weren't used yet, these are loaded from the shader disk caches
+
 D3D12_SHADER_BYTECODE ShaderCache::GetDomainShaderFromUid(const TessellationShaderUid& uid)
 {
   auto it = ts_bytecode_cache->GetInfoIfexists(uid);
-  if (it != nullptr)
+  if (it != nullptr && it->first.m_compiled)
     return it->first.m_shader_bytecode;
+  if (D3DBlob* blob = LookupByteCode(s_ds_disk_cache, uid))
+  {
+    InsertDSByteCode(uid, blob);
+    return ts_bytecode_cache->GetInfoIfexists(uid)->first.m_shader_bytecode;
+  }
 
   return empty;
 }
 D3D12_SHADER_BYTECODE ShaderCache::GetHullShaderFromUid(const TessellationShaderUid& uid)
 {
   auto it = ts_bytecode_cache->GetInfoIfexists(uid);
-  if (it != nullptr)
+  if (it != nullptr && it->second.m_compiled)
     return it->second.m_shader_bytecode;
+  if (D3DBlob* blob = LookupByteCode(s_hs_disk_cache, uid))
+  {
+    InsertHSByteCode(uid, blob);
+    return ts_bytecode_cache->GetInfoIfexists(uid)->second.m_shader_bytecode;
+  }
 
   return empty;
 }
 D3D12_SHADER_BYTECODE ShaderCache::GetGeometryShaderFromUid(const GeometryShaderUid& uid)
 {
   auto it = gs_bytecode_cache.find(uid);
-  if (it != gs_bytecode_cache.end())
+  if (it != gs_bytecode_cache.end() && it->second.m_compiled)
     return it->second.m_shader_bytecode;
+  if (D3DBlob* blob = LookupByteCode(s_gs_disk_cache, uid))
+  {
+    InsertGSByteCode(uid, blob);
+    return gs_bytecode_cache[uid].m_shader_bytecode;
+  }
 
   return empty;
 }
 D3D12_SHADER_BYTECODE ShaderCache::GetPixelShaderFromUid(const PixelShaderUid& uid)
 {
   auto it = ps_bytecode_cache->GetInfoIfexists(uid);
-  if (it != nullptr)
+  if (it != nullptr && it->m_compiled)
     return it->m_shader_bytecode;
+  if (D3DBlob* blob = LookupByteCode(s_ps_disk_cache, uid))
+  {
+    InsertPSByteCode(uid, blob);
+    return ps_bytecode_cache->GetInfoIfexists(uid)->m_shader_bytecode;
+  }
 
   return empty;
 }
@@ -1244,8 +1220,13 @@ D3D12_SHADER_BYTECODE ShaderCache::GetPixelShaderFromUid(const PixelShaderUid& u
 D3D12_SHADER_BYTECODE ShaderCache::GetVertexShaderFromUid(const VertexShaderUid& uid)
 {
   auto it = vs_bytecode_cache->GetInfoIfexists(uid);
-  if (it != nullptr)
+  if (it != nullptr && it->m_compiled)
     return it->m_shader_bytecode;
+  if (D3DBlob* blob = LookupByteCode(s_vs_disk_cache, uid))
+  {
+    InsertVSByteCode(uid, blob);
+    return vs_bytecode_cache->GetInfoIfexists(uid)->m_shader_bytecode;
+  }
 
   return empty;
 }
@@ -1253,8 +1234,13 @@ D3D12_SHADER_BYTECODE ShaderCache::GetVertexShaderFromUid(const VertexShaderUid&
 D3D12_SHADER_BYTECODE ShaderCache::GetPixelUberShaderFromUid(const UberShader::PixelUberShaderUid& uid)
 {
   auto it = pus_bytecode_cache.find(uid);
-  if (it != pus_bytecode_cache.end())
+  if (it != pus_bytecode_cache.end() && it->second.m_compiled)
     return it->second.m_shader_bytecode;
+  if (D3DBlob* blob = LookupByteCode(s_pus_disk_cache, uid))
+  {
+    InsertPUSByteCode(uid, blob);
+    return pus_bytecode_cache[uid].m_shader_bytecode;
+  }
 
   return empty;
 }
@@ -1262,8 +1248,13 @@ D3D12_SHADER_BYTECODE ShaderCache::GetPixelUberShaderFromUid(const UberShader::P
 D3D12_SHADER_BYTECODE ShaderCache::GetVertexUberShaderFromUid(const UberShader::VertexUberShaderUid& uid)
 {
   auto it = vus_bytecode_cache.find(uid);
-  if (it != vus_bytecode_cache.end())
+  if (it != vus_bytecode_cache.end() && it->second.m_compiled)
     return it->second.m_shader_bytecode;
+  if (D3DBlob* blob = LookupByteCode(s_vus_disk_cache, uid))
+  {
+    InsertVUSByteCode(uid, blob);
+    return vus_bytecode_cache[uid].m_shader_bytecode;
+  }
 
   return empty;
 }
@@ -38,7 +38,7 @@ static HLSLAsyncCompiler *s_compiler;
 D3D::GeometryShaderPtr ClearGeometryShader;
 D3D::GeometryShaderPtr CopyGeometryShader;
 
-LinearDiskCache<GeometryShaderUid, u8> g_gs_disk_cache;
+ShaderDiskCache<GeometryShaderUid, u8> g_gs_disk_cache;
 
 ID3D11GeometryShader* GeometryShaderCache::GetClearGeometryShader()
 {
@@ -63,19 +63,6 @@ D3D::BufferDescriptor  GeometryShaderCache::GetConstantBuffer()
   return gscbuf->GetDescriptor();
 }
 
-// this class will load the precompiled shaders into our cache
-class GeometryShaderCacheInserter : public LinearDiskCacheReader<GeometryShaderUid, u8>
-{
-public:
-  void Read(const GeometryShaderUid &key, const u8* value, u32 value_size)
-  {
-    GeometryShaderUid uid = key;
-    uid.ClearHASH();
-    uid.CalculateUIDHash();
-    GeometryShaderCache::InsertByteCode(uid, value, value_size);
-  }
-};
-
 const char* gs_clear_shader_code = R"hlsl(
 struct VSOUTPUT
 {
@@ -174,9 +161,8 @@ void GeometryShaderCache::Init()
 
 void  GeometryShaderCache::LoadFromDisk()
 {
-  std::string cache_filename = GetDiskShaderCacheFileName(API_D3D11, "gs", false, true);
-  GeometryShaderCacheInserter inserter;
-  g_gs_disk_cache.OpenAndRead(cache_filename, inserter);
+  // Only the keys are read, the shaders are loaded when they are first used
+  g_gs_disk_cache.Open(GetDiskShaderCacheFileName(API_D3D11, "gs", false, true));
 }
 
 static size_t shader_count = 0;
@@ -252,6 +238,11 @@ void GeometryShaderCache::CompileGShader(const GeometryShaderUid& uid, std::func
     if (oncompilationfinished) oncompilationfinished();
     return;
   }
+  if (LoadShaderFromDisk(uid, entry))
+  {
+    if (oncompilationfinished) oncompilationfinished();
+    return;
+  }
 
   // Need to compile a new shader
   ShaderCompilerWorkUnit *wunit = s_compiler->NewUnit();
@@ -339,6 +330,18 @@ bool GeometryShaderCache::TestShader()
   return s_last_entry->shader != nullptr && s_last_entry->compiled;
 }
 
+bool GeometryShaderCache::LoadShaderFromDisk(const GeometryShaderUid& uid, GSCacheEntry* entry)
+{
+  u32 size;
+  const u8* bytecode = g_gs_disk_cache.Lookup(uid, &size);
+  if (!bytecode)
+    return false;
+  PushByteCode(bytecode, size, entry);
+  // Bytecode the driver rejects falls through to a fresh compile
+  entry->compiled = entry->shader != nullptr;
+  return entry->compiled;
+}
+
 void GeometryShaderCache::PushByteCode(const void* bytecode, unsigned int bytecodelen, GeometryShaderCache::GSCacheEntry* entry)
 {
   entry->shader = std::move(D3D::CreateGeometryShaderFromByteCode(bytecode, bytecodelen));
@@ -352,11 +355,4 @@ void GeometryShaderCache::PushByteCode(const void* bytecode, unsigned int byteco
   }
 }
 
-void GeometryShaderCache::InsertByteCode(const GeometryShaderUid &uid, const void* bytecode, u32 bytecodelen)
-{
-  GSCacheEntry* entry = &s_geometry_shaders[uid];
-  entry->initialized.test_and_set();
-  PushByteCode(bytecode, bytecodelen, entry);
-}
-
 }  // DX11
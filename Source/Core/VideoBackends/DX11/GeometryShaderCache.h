@@ -26,7 +26,6 @@ public:
     const XFMemory &xfr,
     const u32 components);
   static bool TestShader();
-  static void InsertByteCode(const GeometryShaderUid &uid, const void* bytecode, u32 bytecodelen);
 
   static ID3D11GeometryShader* GetClearGeometryShader();
   static ID3D11GeometryShader* GetCopyGeometryShader();
@@ -56,6 +55,7 @@ private:
     }
   };
   static inline void PushByteCode(const void* bytecode, unsigned int bytecodelen, GSCacheEntry* entry);
+  static bool LoadShaderFromDisk(const GeometryShaderUid& uid, GSCacheEntry* entry);
   typedef std::unordered_map<GeometryShaderUid, GSCacheEntry, GeometryShaderUid::ShaderUidHasher> GSCache;
 
   static GSCache s_geometry_shaders;
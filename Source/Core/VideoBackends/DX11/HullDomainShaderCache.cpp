@@ -36,8 +36,8 @@ static HLSLAsyncCompiler *s_compiler;
 
 std::unique_ptr<D3D::ConstantStreamBuffer> hdscbuf;
 
-LinearDiskCache<TessellationShaderUid, u8> g_hs_disk_cache;
-LinearDiskCache<TessellationShaderUid, u8> g_ds_disk_cache;
+ShaderDiskCache<TessellationShaderUid, u8> g_hs_disk_cache;
+ShaderDiskCache<TessellationShaderUid, u8> g_ds_disk_cache;
 
 D3D::BufferDescriptor  HullDomainShaderCache::GetConstantBuffer()
 {
@@ -51,31 +51,6 @@ D3D::BufferDescriptor  HullDomainShaderCache::GetConstantBuffer()
   return hdscbuf->GetDescriptor();
 }
 
-// this class will load the precompiled shaders into our cache
-class HullShaderCacheInserter : public LinearDiskCacheReader<TessellationShaderUid, u8>
-{
-public:
-  void Read(const TessellationShaderUid &key, const u8* value, u32 value_size)
-  {
-    TessellationShaderUid uid = key;
-    uid.ClearHASH();
-    uid.CalculateUIDHash();
-    HullDomainShaderCache::InsertByteCode(uid, value, value_size, false);
-  }
-};
-
-class DomainShaderCacheInserter : public LinearDiskCacheReader<TessellationShaderUid, u8>
-{
-public:
-  void Read(const TessellationShaderUid &key, const u8* value, u32 value_size)
-  {
-    TessellationShaderUid uid = key;
-    uid.ClearHASH();
-    uid.CalculateUIDHash();
-    HullDomainShaderCache::InsertByteCode(uid, value, value_size, true);
-  }
-};
-
 void HullDomainShaderCache::Init()
 {
   s_compiler = &HLSLAsyncCompiler::getInstance();
@@ -101,13 +76,12 @@ void HullDomainShaderCache::Init()
 
   std::string h_cache_filename = StringFromFormat("%sIDX11-%s-hs.cache", File::GetUserPath(D_SHADERCACHE_IDX).c_str(),
     SConfig::GetInstance().GetGameID().c_str());
-  HullShaderCacheInserter hinserter;
-  g_hs_disk_cache.OpenAndRead(h_cache_filename, hinserter);
+  // Only the keys are read, the shaders are loaded when they are first used
+  g_hs_disk_cache.Open(h_cache_filename);
 
   std::string d_cache_filename = StringFromFormat("%sIDX11-%s-ds.cache", File::GetUserPath(D_SHADERCACHE_IDX).c_str(),
     SConfig::GetInstance().GetGameID().c_str());
-  DomainShaderCacheInserter dinserter;
-  g_ds_disk_cache.OpenAndRead(d_cache_filename, dinserter);
+  g_ds_disk_cache.Open(d_cache_filename);
   SETSTAT(stats.numDomainShadersCreated, 0);
   SETSTAT(stats.numDomainShadersAlive, 0);
   SETSTAT(stats.numHullShadersCreated, 0);
@@ -185,6 +159,16 @@ void HullDomainShaderCache::CompileHDShader(const TessellationShaderUid& uid, st
     if (oncompilationfinished) oncompilationfinished();
     return;
   }
+  if (LoadShaderFromDisk(uid, entry))
+  {
+    // Once for each stage, like the compiled ones
+    if (oncompilationfinished)
+    {
+      oncompilationfinished();
+      oncompilationfinished();
+    }
+    return;
+  }
 
   // Need to compile a new shader
   ShaderCode code;
@@ -315,6 +299,22 @@ bool HullDomainShaderCache::TestShader()
   return s_last_entry->hcompiled && s_last_entry->dcompiled;
 }
 
+bool HullDomainShaderCache::LoadShaderFromDisk(const TessellationShaderUid& uid, HDCacheEntry* entry)
+{
+  u32 hull_size, domain_size;
+  const u8* hull = g_hs_disk_cache.Lookup(uid, &hull_size);
+  const u8* domain = g_ds_disk_cache.Lookup(uid, &domain_size);
+  if (!hull || !domain)
+    return false;
+  PushByteCode(hull, hull_size, entry, false);
+  PushByteCode(domain, domain_size, entry, true);
+  // Bytecode the driver rejects falls through to a fresh compile of both stages
+  const bool created = entry->hullshader && entry->domainshader;
+  entry->hcompiled = created;
+  entry->dcompiled = created;
+  return created;
+}
+
 void HullDomainShaderCache::PushByteCode(const void* bytecode, unsigned int bytecodelen, HullDomainShaderCache::HDCacheEntry* entry, bool isdomain)
 {
   if (isdomain)
@@ -343,11 +343,4 @@ void HullDomainShaderCache::PushByteCode(const void* bytecode, unsigned int byte
   }
 }
 
-void HullDomainShaderCache::InsertByteCode(const TessellationShaderUid &uid, const void* bytecode, u32 bytecodelen, bool isdomain)
-{
-  HDCacheEntry* entry = &s_hulldomain_shaders->GetOrAdd(uid);
-  entry->initialized.test_and_set();
-  PushByteCode(bytecode, bytecodelen, entry, isdomain);
-}
-
 }  // DX11
@@ -25,10 +25,6 @@ public:
     const PrimitiveType primitiveType,
     const u32 components);
   static bool TestShader();
-  static void InsertByteCode(
-    const TessellationShaderUid &uid,
-    const void* bytecode,
-    u32 bytecodelen, bool isdomain);
   static D3D::BufferDescriptor GetConstantBuffer();
   static ID3D11HullShader* GetActiveHullShader()
   {
@@ -61,6 +57,7 @@ private:
     const void* bytecode,
     unsigned int bytecodelen,
     HDCacheEntry* entry, bool isdomain);
+  static bool LoadShaderFromDisk(const TessellationShaderUid& uid, HDCacheEntry* entry);
   typedef ObjectUsageProfiler<TessellationShaderUid, pKey_t, HDCacheEntry, TessellationShaderUid::ShaderUidHasher> HDCache;
 
   static HDCache* s_hulldomain_shaders;
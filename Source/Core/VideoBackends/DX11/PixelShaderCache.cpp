@@ -34,8 +34,8 @@ UberShader::PixelUberShaderUid PixelShaderCache::s_last_uber_uid;
 
 static HLSLAsyncCompiler *s_compiler;
 static bool s_previous_per_pixel_lighting = false;
-LinearDiskCache<PixelShaderUid, u8> g_ps_disk_cache;
-LinearDiskCache<UberShader::PixelUberShaderUid, u8> g_pus_disk_cache;
+ShaderDiskCache<PixelShaderUid, u8> g_ps_disk_cache;
+ShaderDiskCache<UberShader::PixelUberShaderUid, u8> g_pus_disk_cache;
 
 D3D::PixelShaderPtr s_ColorMatrixProgram[2];
 D3D::PixelShaderPtr s_ColorCopyProgram[3];
@@ -451,32 +451,6 @@ D3D::BufferDescriptor PixelShaderCache::GetConstantBuffer()
   return pscbuf->GetDescriptor();
 }
 
-// this class will load the precompiled shaders into our cache
-class PixelShaderCacheInserter : public LinearDiskCacheReader<PixelShaderUid, u8>
-{
-public:
-  void Read(const PixelShaderUid &key, const u8 *value, u32 value_size)
-  {
-    PixelShaderUid uid = key;
-    uid.ClearHASH();
-    uid.CalculateUIDHash();
-    PixelShaderCache::InsertByteCode(uid, value, value_size);
-  }
-};
-
-// this class will load the precompiled shaders into our cache
-class PixelUberShaderCacheInserter : public LinearDiskCacheReader<UberShader::PixelUberShaderUid, u8>
-{
-public:
-  void Read(const UberShader::PixelUberShaderUid &key, const u8 *value, u32 value_size)
-  {
-    UberShader::PixelUberShaderUid uid = key;
-    uid.ClearHASH();
-    uid.CalculateUIDHash();
-    PixelShaderCache::InsertByteCode(uid, value, value_size);
-  }
-};
-
 void PixelShaderCache::Init()
 {
   s_compiler = &HLSLAsyncCompiler::getInstance();
@@ -553,12 +527,9 @@ void PixelShaderCache::LoadFromDisk()
     "Ishiiruka.ps",
     StringFromFormat("%s.ps", SConfig::GetInstance().GetGameID().c_str())
   );
-  std::string cache_filename = GetDiskShaderCacheFileName(API_D3D11, "ups", false, true);
-  PixelUberShaderCacheInserter uinserter;
-  g_pus_disk_cache.OpenAndRead(cache_filename, uinserter);
-  cache_filename = GetDiskShaderCacheFileName(API_D3D11, "ps", true, true);
-  PixelShaderCacheInserter inserter;
-  g_ps_disk_cache.OpenAndRead(cache_filename, inserter);
+  // Only the keys are read, the shaders are loaded when they are first used
+  g_pus_disk_cache.Open(GetDiskShaderCacheFileName(API_D3D11, "ups", false, true));
+  g_ps_disk_cache.Open(GetDiskShaderCacheFileName(API_D3D11, "ps", true, true));
 }
 static size_t shader_count = 0;
 void PixelShaderCache::CompileShaders()
@@ -704,6 +675,11 @@ void PixelShaderCache::CompileUberShader(const UberShader::PixelUberShaderUid& u
     if (oncompilationfinished) oncompilationfinished();
     return;
   }
+  if (LoadShaderFromDisk(g_pus_disk_cache, uid, entry))
+  {
+    if (oncompilationfinished) oncompilationfinished();
+    return;
+  }
   // Need to compile a new shader
 
   ShaderCompilerWorkUnit *wunit = s_compiler->NewUnit();
@@ -770,6 +746,11 @@ void PixelShaderCache::CompilePShader(const PixelShaderUid& uid, const ShaderHos
     if (oncompilationfinished) oncompilationfinished();
     return;
   }
+  if (LoadShaderFromDisk(g_ps_disk_cache, uid, entry))
+  {
+    if (oncompilationfinished) oncompilationfinished();
+    return;
+  }
   // Need to compile a new shader
 
   ShaderCompilerWorkUnit *wunit = s_compiler->NewUnit();
@@ -882,6 +863,19 @@ bool PixelShaderCache::TestShader()
   return s_last_entry->shader != nullptr && s_last_entry->compiled;
 }
 
+template <typename Uid>
+bool PixelShaderCache::LoadShaderFromDisk(ShaderDiskCache<Uid, u8>& cache, const Uid& uid, PSCacheEntry* entry)
+{
+  u32 size;
+  const u8* bytecode = cache.Lookup(uid, &size);
+  if (!bytecode)
+    return false;
+  PushByteCode(bytecode, size, entry);
+  // Bytecode the driver rejects falls through to a fresh compile
+  entry->compiled = entry->shader != nullptr;
+  return entry->compiled;
+}
+
 void PixelShaderCache::PushByteCode(const void* bytecode, u32 bytecodelen, PixelShaderCache::PSCacheEntry* entry)
 {
   entry->shader = std::move(D3D::CreatePixelShaderFromByteCode(bytecode, bytecodelen));
@@ -895,18 +889,4 @@ void PixelShaderCache::PushByteCode(const void* bytecode, u32 bytecodelen, Pixel
   }
 }
 
-void PixelShaderCache::InsertByteCode(const PixelShaderUid &uid, const void* bytecode, u32 bytecodelen)
-{
-  PSCacheEntry* entry = &s_pixel_shaders->GetOrAdd(uid);
-  entry->initialized.test_and_set();
-  PushByteCode(bytecode, bytecodelen, entry);
-}
-
-void PixelShaderCache::InsertByteCode(const UberShader::PixelUberShaderUid &uid, const void* bytecode, u32 bytecodelen)
-{
-  PSCacheEntry* entry = &s_pixel_uber_shaders[uid];
-  entry->initialized.test_and_set();
-  PushByteCode(bytecode, bytecodelen, entry);
-}
-
 }  // DX11
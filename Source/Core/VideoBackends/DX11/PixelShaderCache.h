@@ -45,8 +45,6 @@ public:
   static ID3D11PixelShader* GetDepthResolveProgram();
   static void InvalidateMSAAShaders();
   static void Reload();
-  static void InsertByteCode(const PixelShaderUid &uid, const void* bytecode, u32 bytecodelen);
-  static void InsertByteCode(const UberShader::PixelUberShaderUid &uid, const void* bytecode, u32 bytecodelen);
 private:
   static void LoadFromDisk();
   static void CompileShaders();
@@ -70,6 +68,8 @@ private:
     }
   };
   static inline void PushByteCode(const void* bytecode, u32 bytecodelen, PSCacheEntry* entry);
+  template <typename Uid>
+  static bool LoadShaderFromDisk(ShaderDiskCache<Uid, u8>& cache, const Uid& uid, PSCacheEntry* entry);
   typedef ObjectUsageProfiler<PixelShaderUid, pKey_t, PSCacheEntry, PixelShaderUid::ShaderUidHasher> PSCache;
   typedef std::unordered_map<UberShader::PixelUberShaderUid, PSCacheEntry, UberShader::PixelUberShaderUid::ShaderUidHasher> PUSCache;
   static PSCache* s_pixel_shaders;
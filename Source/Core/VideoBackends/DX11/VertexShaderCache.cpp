@@ -37,8 +37,8 @@ static D3D::VertexShaderPtr s_clear_vertex_shader;
 static D3D::InputLayoutPtr s_simple_layout;
 static D3D::InputLayoutPtr s_clear_layout;
 
-LinearDiskCache<VertexShaderUid, u8> g_vs_disk_cache;
-LinearDiskCache<UberShader::VertexUberShaderUid, u8> g_vus_disk_cache;
+ShaderDiskCache<VertexShaderUid, u8> g_vs_disk_cache;
+ShaderDiskCache<UberShader::VertexUberShaderUid, u8> g_vus_disk_cache;
 
 ID3D11VertexShader* VertexShaderCache::GetSimpleVertexShader()
 {
@@ -72,25 +72,6 @@ D3D::BufferDescriptor VertexShaderCache::GetConstantBuffer()
   return vscbuf->GetDescriptor();
 }
 
-// this class will load the precompiled shaders into our cache
-class VertexShaderCacheInserter : public LinearDiskCacheReader<VertexShaderUid, u8>
-{
-public:
-  void Read(const VertexShaderUid &key, const u8 *value, u32 value_size)
-  {
-    VertexShaderCache::InsertByteCode(key, D3DBlob(value_size, value));
-  }
-};
-
-class VertexUberShaderCacheInserter : public LinearDiskCacheReader<UberShader::VertexUberShaderUid, u8>
-{
-public:
-  void Read(const UberShader::VertexUberShaderUid &key, const u8 *value, u32 value_size)
-  {
-    VertexShaderCache::InsertByteCode(key, D3DBlob(value_size, value));
-  }
-};
-
 const char* simple_shader_code = R"hlsl(
 struct VSOUTPUT
 {
@@ -210,12 +191,9 @@ void VertexShaderCache::LoadFromDisk()
     "Ishiiruka.vs",
     StringFromFormat("%s.vs", SConfig::GetInstance().GetGameID().c_str())
   );
-  std::string cache_filename = GetDiskShaderCacheFileName(API_D3D11, "uvs", false, true);
-  VertexUberShaderCacheInserter uinserter;
-  g_vus_disk_cache.OpenAndRead(cache_filename, uinserter);
-  cache_filename = GetDiskShaderCacheFileName(API_D3D11, "vs", true, true);
-  VertexShaderCacheInserter inserter;
-  g_vs_disk_cache.OpenAndRead(cache_filename, inserter);
+  // Only the keys are read, the shaders are loaded when they are first used
+  g_vus_disk_cache.Open(GetDiskShaderCacheFileName(API_D3D11, "uvs", false, true));
+  g_vs_disk_cache.Open(GetDiskShaderCacheFileName(API_D3D11, "vs", true, true));
 }
 
 static size_t shader_count = 0;
@@ -343,6 +321,11 @@ void VertexShaderCache::CompileUberShader(const UberShader::VertexUberShaderUid&
     if (oncompilationfinished) oncompilationfinished();
     return;
   }
+  if (LoadShaderFromDisk(g_vus_disk_cache, uid, entry))
+  {
+    if (oncompilationfinished) oncompilationfinished();
+    return;
+  }
   // Need to compile a new shader
 
   ShaderCompilerWorkUnit *wunit = s_compiler->NewUnit();
@@ -410,6 +393,11 @@ void VertexShaderCache::CompileVShader(const VertexShaderUid& uid, const ShaderH
     if (oncompilationfinished) oncompilationfinished();
     return;
   }
+  if (LoadShaderFromDisk(g_vs_disk_cache, uid, entry))
+  {
+    if (oncompilationfinished) oncompilationfinished();
+    return;
+  }
 
   ShaderCompilerWorkUnit *wunit = s_compiler->NewUnit();
   wunit->GenerateCodeHandler = [uid, hostconfig](ShaderCompilerWorkUnit* wunit)
@@ -523,6 +511,19 @@ bool VertexShaderCache::TestShader()
 }
 
 
+template <typename Uid>
+bool VertexShaderCache::LoadShaderFromDisk(ShaderDiskCache<Uid, u8>& cache, const Uid& uid, VSCacheEntry* entry)
+{
+  u32 size;
+  const u8* bytecode = cache.Lookup(uid, &size);
+  if (!bytecode)
+    return false;
+  PushByteCode(D3DBlob(size, bytecode), entry);
+  // Bytecode the driver rejects falls through to a fresh compile
+  entry->compiled = entry->shader != nullptr;
+  return entry->compiled;
+}
+
 void VertexShaderCache::PushByteCode(D3DBlob&& bcodeblob, VSCacheEntry* entry)
 {
   entry->shader = std::move(D3D::CreateVertexShaderFromByteCode(bcodeblob));
@@ -536,17 +537,4 @@ void VertexShaderCache::PushByteCode(D3DBlob&& bcodeblob, VSCacheEntry* entry)
     SETSTAT(stats.numVertexShadersAlive, static_cast<int>(s_vshaders->size()));
   }
 }
-
-void VertexShaderCache::InsertByteCode(const VertexShaderUid &uid, D3DBlob&& bcodeblob)
-{
-  VSCacheEntry* entry = &s_vshaders->GetOrAdd(uid);
-  entry->initialized.test_and_set();
-  PushByteCode(std::move(bcodeblob), entry);
-}
-void VertexShaderCache::InsertByteCode(const UberShader::VertexUberShaderUid &uid, D3DBlob&& bcodeblob)
-{
-  VSCacheEntry* entry = &s_vuber_shaders[uid];
-  entry->initialized.test_and_set();
-  PushByteCode(std::move(bcodeblob), entry);
-}
 }  // namespace DX11
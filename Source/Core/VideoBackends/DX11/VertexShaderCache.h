@@ -32,8 +32,6 @@ public:
   static ID3D11InputLayout* GetSimpleInputLayout();
   static ID3D11InputLayout* GetClearInputLayout();
   static void Reload();
-  static void InsertByteCode(const VertexShaderUid &uid, D3DBlob&& bcodeblob);
-  static void InsertByteCode(const UberShader::VertexUberShaderUid &uid, D3DBlob&& bcodeblob);
 private:
   static void Clear();
   static void LoadFromDisk();
@@ -65,6 +63,8 @@ private:
     }
   };
   static inline void PushByteCode(D3DBlob&& bcodeblob, VSCacheEntry* entry);
+  template <typename Uid>
+  static bool LoadShaderFromDisk(ShaderDiskCache<Uid, u8>& cache, const Uid& uid, VSCacheEntry* entry);
   typedef ObjectUsageProfiler<VertexShaderUid, pKey_t, VSCacheEntry, VertexShaderUid::ShaderUidHasher> VSCache;
   typedef std::unordered_map<UberShader::VertexUberShaderUid, VSCacheEntry, UberShader::VertexUberShaderUid::ShaderUidHasher> VUSCache;
   static VSCache* s_vshaders;
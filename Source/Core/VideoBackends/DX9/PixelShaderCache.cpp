@@ -33,7 +33,7 @@ const PixelShaderCache::PSCacheEntry *PixelShaderCache::s_last_entry[PSRM_DEPTH_
 PixelShaderUid PixelShaderCache::s_last_uid[PSRM_DEPTH_ONLY + 1];
 
 static HLSLAsyncCompiler *s_compiler;
-static LinearDiskCache<PixelShaderUid, u8> g_ps_disk_cache;
+static ShaderDiskCache<PixelShaderUid, u8> g_ps_disk_cache;
 static std::set<u32> s_unique_shaders;
 ObjectUsageProfiler<PixelShaderUid, pKey_t, PixelShaderCache::PSCacheEntry, PixelShaderUid::ShaderUidHasher>* PixelShaderCache::s_pshaders = nullptr;
 
@@ -56,18 +56,6 @@ static LPDIRECT3DPIXELSHADER9 s_clear_program = NULL;
 static LPDIRECT3DPIXELSHADER9 s_rgba6_to_rgb8 = NULL;
 static LPDIRECT3DPIXELSHADER9 s_rgb8_to_rgba6 = NULL;
 
-class PixelShaderCacheInserter : public LinearDiskCacheReader<PixelShaderUid, u8>
-{
-public:
-  void Read(const PixelShaderUid &key, const u8 *value, u32 value_size)
-  {
-    PixelShaderUid uid = key;
-    uid.ClearHASH();
-    uid.CalculateUIDHash();
-    PixelShaderCache::InsertByteCode(uid, value, value_size);
-  }
-};
-
 LPDIRECT3DPIXELSHADER9 PixelShaderCache::GetColorMatrixProgram(int SSAAMode)
 {
   return s_copy_program[COPY_TYPE_MATRIXCOLOR][DEPTH_CONVERSION_TYPE_NONE][SSAAMode % MAX_SSAA_SHADERS];
@@ -314,9 +302,8 @@ void PixelShaderCache::LoadFromDisk()
     "Ishiiruka.ps.dx9",
     StringFromFormat("%s.ps.dx9", SConfig::GetInstance().GetGameID().c_str())
   );
-  std::string cache_filename = GetDiskShaderCacheFileName(API_D3D9, "ps", true, true);
-  PixelShaderCacheInserter inserter;
-  g_ps_disk_cache.OpenAndRead(cache_filename, inserter);
+  // Only the keys are read, the shaders are loaded when they are first used
+  g_ps_disk_cache.Open(GetDiskShaderCacheFileName(API_D3D9, "ps", true, true));
 }
 
 static size_t shader_count = 0;
@@ -450,6 +437,11 @@ void PixelShaderCache::CompilePShader(const PixelShaderUid& uid, PIXEL_SHADER_RE
     if (oncompilationfinished) oncompilationfinished();
     return;
   }
+  if (LoadShaderFromDisk(uid, entry))
+  {
+    if (oncompilationfinished) oncompilationfinished();
+    return;
+  }
   // Need to compile a new shader
   const ShaderHostConfig& hostconfig = ShaderHostConfig::GetCurrent();
   ShaderCompilerWorkUnit *wunit = s_compiler->NewUnit();
@@ -533,6 +525,18 @@ bool PixelShaderCache::SetShader(PIXEL_SHADER_RENDER_MODE render_mode)
   return false;
 }
 
+bool PixelShaderCache::LoadShaderFromDisk(const PixelShaderUid& uid, PSCacheEntry* entry)
+{
+  u32 size;
+  const u8* bytecode = g_ps_disk_cache.Lookup(uid, &size);
+  if (!bytecode)
+    return false;
+  PushByteCode(uid, bytecode, size, entry);
+  // Bytecode the driver rejects falls through to a fresh compile
+  entry->compiled = entry->shader != nullptr;
+  return entry->compiled;
+}
+
 void PixelShaderCache::PushByteCode(const PixelShaderUid &uid, const u8 *bytecode, int bytecodelen, PixelShaderCache::PSCacheEntry* entry)
 {
   entry->shader = D3D::CreatePixelShaderFromByteCode(bytecode, bytecodelen);
@@ -543,11 +547,4 @@ void PixelShaderCache::PushByteCode(const PixelShaderUid &uid, const u8 *bytecod
     SETSTAT(stats.numPixelShadersAlive, static_cast<int>(s_pshaders->size()));
   }
 }
-
-void PixelShaderCache::InsertByteCode(const PixelShaderUid &uid, const u8 *bytecode, int bytecodelen)
-{
-  PixelShaderCache::PSCacheEntry *entry = &s_pshaders->GetOrAdd(uid);
-  entry->initialized.test_and_set();
-  PushByteCode(uid, bytecode, bytecodelen, entry);
-}
 }  // namespace DX9
@@ -30,7 +30,6 @@ public:
     const XFMemory &xfr,
     const BPMemory &bpm);
   static bool SetShader(PIXEL_SHADER_RENDER_MODE render_mode);
-  static void InsertByteCode(const PixelShaderUid &uid, const u8 *bytecode, int bytecodelen);
   static void Reload();
   static LPDIRECT3DPIXELSHADER9 GetColorMatrixProgram(int SSAAMode);
   static LPDIRECT3DPIXELSHADER9 GetColorCopyProgram(int SSAAMode);
@@ -57,6 +56,7 @@ private:
   };
 
   static inline void PushByteCode(const PixelShaderUid &uid, const u8 *bytecode, int bytecodelen, PSCacheEntry* entry);
+  static bool LoadShaderFromDisk(const PixelShaderUid& uid, PSCacheEntry* entry);
   static ObjectUsageProfiler<PixelShaderUid, pKey_t, PixelShaderCache::PSCacheEntry, PixelShaderUid::ShaderUidHasher>* s_pshaders;
   static const PSCacheEntry *s_last_entry[PSRM_DEPTH_ONLY + 1];
   static PixelShaderUid s_last_uid[PSRM_DEPTH_ONLY + 1];
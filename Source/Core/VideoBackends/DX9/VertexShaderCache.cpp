@@ -33,7 +33,7 @@ static HLSLAsyncCompiler *s_compiler;
 static LPDIRECT3DVERTEXSHADER9 s_simple_vertex_shaders[MAX_SSAA_SHADERS];
 static LPDIRECT3DVERTEXSHADER9 s_clear_vertex_shader;
 
-LinearDiskCache<VertexShaderUid, u8> g_vs_disk_cache;
+ShaderDiskCache<VertexShaderUid, u8> g_vs_disk_cache;
 
 LPDIRECT3DVERTEXSHADER9 VertexShaderCache::GetSimpleVertexShader(int level)
 {
@@ -45,19 +45,6 @@ LPDIRECT3DVERTEXSHADER9 VertexShaderCache::GetClearVertexShader()
   return s_clear_vertex_shader;
 }
 
-// this class will load the precompiled shaders into our cache
-class VertexShaderCacheInserter : public LinearDiskCacheReader<VertexShaderUid, u8>
-{
-public:
-  void Read(const VertexShaderUid &key, const u8 *value, u32 value_size)
-  {
-    VertexShaderUid uid = key;
-    uid.ClearHASH();
-    uid.CalculateUIDHash();
-    VertexShaderCache::InsertByteCode(key, value, value_size);
-  }
-};
-
 void VertexShaderCache::Init()
 {
   s_compiler = &HLSLAsyncCompiler::getInstance();
@@ -149,9 +136,8 @@ void VertexShaderCache::LoadFromDisk()
     "Ishiiruka.vs",
     StringFromFormat("%s.vs", SConfig::GetInstance().GetGameID().c_str())
   );
-  std::string cache_filename = GetDiskShaderCacheFileName(API_D3D9, "vs", true, true);
-  VertexShaderCacheInserter inserter;
-  g_vs_disk_cache.OpenAndRead(cache_filename, inserter);
+  // Only the keys are read, the shaders are loaded when they are first used
+  g_vs_disk_cache.Open(GetDiskShaderCacheFileName(API_D3D9, "vs", true, true));
 }
 
 void VertexShaderCache::CompileShaders()
@@ -242,6 +228,8 @@ void VertexShaderCache::CompileVShader(const VertexShaderUid& uid)
   {
     return;
   }
+  if (LoadShaderFromDisk(uid, entry))
+    return;
   ShaderCompilerWorkUnit *wunit = s_compiler->NewUnit();
   const ShaderHostConfig& hostconfig = ShaderHostConfig::GetCurrent();
   wunit->GenerateCodeHandler = [uid, hostconfig](ShaderCompilerWorkUnit* wunit)
@@ -314,6 +302,18 @@ bool VertexShaderCache::TestShader()
   return false;
 }
 
+bool VertexShaderCache::LoadShaderFromDisk(const VertexShaderUid& uid, VSCacheEntry* entry)
+{
+  u32 size;
+  const u8* bytecode = g_vs_disk_cache.Lookup(uid, &size);
+  if (!bytecode)
+    return false;
+  PushByteCode(uid, bytecode, size, entry);
+  // Bytecode the driver rejects falls through to a fresh compile
+  entry->compiled = entry->shader != nullptr;
+  return entry->compiled;
+}
+
 void VertexShaderCache::PushByteCode(const VertexShaderUid &uid, const u8 *bytecode, int bytecodelen, VertexShaderCache::VSCacheEntry* entry)
 {
   entry->shader = D3D::CreateVertexShaderFromByteCode(bytecode, bytecodelen);
@@ -325,11 +325,4 @@ void VertexShaderCache::PushByteCode(const VertexShaderUid &uid, const u8 *bytec
   }
 }
 
-void VertexShaderCache::InsertByteCode(const VertexShaderUid &uid, const u8 *bytecode, int bytecodelen)
-{
-  VSCacheEntry *entry = &s_vshaders->GetOrAdd(uid);
-  entry->initialized.test_and_set();
-  PushByteCode(uid, bytecode, bytecodelen, entry);
-}
-
 }  // namespace DX9
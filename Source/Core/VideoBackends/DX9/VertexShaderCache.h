@@ -26,7 +26,6 @@ public:
   static bool TestShader();
   static LPDIRECT3DVERTEXSHADER9 GetSimpleVertexShader(int level);
   static LPDIRECT3DVERTEXSHADER9 GetClearVertexShader();
-  static void InsertByteCode(const VertexShaderUid &uid, const u8 *bytecode, int bytecodelen);
   static void Reload();
 private:
   struct VSCacheEntry
@@ -47,6 +46,7 @@ private:
   };
 
   static inline void PushByteCode(const VertexShaderUid &uid, const u8 *bytecode, int bytecodelen, VSCacheEntry* entry);
+  static bool LoadShaderFromDisk(const VertexShaderUid& uid, VSCacheEntry* entry);
   static ObjectUsageProfiler<VertexShaderUid, pKey_t, VSCacheEntry, VertexShaderUid::ShaderUidHasher>* s_vshaders;
   static const VSCacheEntry *s_last_entry;
   static VertexShaderUid s_last_uid;
@@ -2,6 +2,7 @@
 // Licensed under GPLv2+
 // Refer to the license.txt file included.
 
+#include <cstring>
 #include <string>
 
 #include "Common/Align.h"
@@ -40,8 +41,8 @@ u32 ProgramShaderCache::s_last_VAO = INVALID_VAO;
 static std::unique_ptr<StreamBuffer> s_buffer;
 static int num_failures = 0;
 
-static LinearDiskCache<SHADERUID, u8> g_program_disk_cache;
-static LinearDiskCache<UBERSHADERUID, u8> g_uber_program_disk_cache;
+static ShaderDiskCache<SHADERUID, u8> g_program_disk_cache;
+static ShaderDiskCache<UBERSHADERUID, u8> g_uber_program_disk_cache;
 static GLuint CurrentProgram = 0;
 
 ProgramShaderCache::PCache* ProgramShaderCache::pshaders;
@@ -241,6 +242,15 @@ SHADER* ProgramShaderCache::CompileShader(const SHADERUID& uid)
   last_entry[render_mode] = &newentry;
   newentry.in_cache = 0;
 
+  u32 binary_size;
+  const u8* binary = g_program_disk_cache.Lookup(uid, &binary_size);
+  if (binary && LoadProgramBinary(newentry.shader, binary, binary_size))
+  {
+    newentry.in_cache = 1;
+    GFX_DEBUGGER_PAUSE_AT(NEXT_PIXEL_SHADER_CHANGE, true);
+    return &last_entry[render_mode]->shader;
+  }
+
   ShaderCode vcode;
   ShaderCode pcode;
   ShaderCode gcode;
@@ -278,6 +288,14 @@ SHADER* ProgramShaderCache::CompileUberShader(const UBERSHADERUID& uid)
   last_uber_entry = &newentry;
   newentry.in_cache = 0;
 
+  u32 binary_size;
+  const u8* binary = g_uber_program_disk_cache.Lookup(uid, &binary_size);
+  if (binary && LoadProgramBinary(newentry.shader, binary, binary_size))
+  {
+    newentry.in_cache = 1;
+    return &last_uber_entry->shader;
+  }
+
   ShaderCode vcode;
   ShaderCode pcode;
   ShaderCode gcode;
@@ -661,16 +679,11 @@ void ProgramShaderCache::LoadFromDisk()
     }
     else
     {
-      std::string cache_filename = GetDiskShaderCacheFileName(API_OPENGL, "program", true, true);
-      ProgramShaderCacheInserter inserter;
-      g_program_disk_cache.OpenAndRead(cache_filename, inserter);
+      // Only the keys are read, the programs are loaded when they are first used
+      g_program_disk_cache.Open(GetDiskShaderCacheFileName(API_OPENGL, "program", true, true));
 
       if (g_ActiveConfig.backend_info.bSupportsUberShaders)
-      {
-        cache_filename = GetDiskShaderCacheFileName(API_OPENGL, "uprogram", false, true);
-        ProgramUberShaderCacheInserter uinserter;
-        g_uber_program_disk_cache.OpenAndRead(cache_filename, uinserter);
-      }
+        g_uber_program_disk_cache.Open(GetDiskShaderCacheFileName(API_OPENGL, "uprogram", false, true));
 
     }
     SETSTAT(stats.numPixelShadersAlive, pshaders->size());
@@ -1031,55 +1044,29 @@ u32 ProgramShaderCache::GetUniformBufferAlignment()
   return s_ubo_align;
 }
 
-void ProgramShaderCache::ProgramShaderCacheInserter::Read(const SHADERUID& key, const u8* value, u32 value_size)
-{
-  const u8 *binary = value + sizeof(GLenum);
-  GLenum *prog_format = (GLenum*)value;
-  GLint binary_size = value_size - sizeof(GLenum);
-
-  PCacheEntry& entry = pshaders->GetOrAdd(key);
-  entry.in_cache = 1;
-  entry.shader.glprogid = glCreateProgram();
-  glProgramBinary(entry.shader.glprogid, *prog_format, binary, binary_size);
-
-  GLint success;
-  glGetProgramiv(entry.shader.glprogid, GL_LINK_STATUS, &success);
-
-  if (success)
-  {
-    entry.shader.SetProgramVariables();
-  }
-  else
-  {
-    glDeleteProgram(entry.shader.glprogid);
-    entry.shader.glprogid = 0;
-  }
-}
-
-void ProgramShaderCache::ProgramUberShaderCacheInserter::Read(const UBERSHADERUID& key, const u8* value, u32 value_size)
+bool ProgramShaderCache::LoadProgramBinary(SHADER& shader, const u8* value, u32 value_size)
 {
+  if (value_size < sizeof(GLenum))
+    return false;
   const u8 *binary = value + sizeof(GLenum);
-  GLenum *prog_format = (GLenum*)value;
+  GLenum prog_format;
+  std::memcpy(&prog_format, value, sizeof(GLenum));
   GLint binary_size = value_size - sizeof(GLenum);
 
-  PCacheEntry& entry = pushaders[key];
-  entry.in_cache = 1;
-  entry.shader.glprogid = glCreateProgram();
-  glProgramBinary(entry.shader.glprogid, *prog_format, binary, binary_size);
+  shader.glprogid = glCreateProgram();
+  glProgramBinary(shader.glprogid, prog_format, binary, binary_size);
 
   GLint success;
-  glGetProgramiv(entry.shader.glprogid, GL_LINK_STATUS, &success);
+  glGetProgramiv(shader.glprogid, GL_LINK_STATUS, &success);
 
   if (success)
   {
-    entry.shader.SetProgramVariables();
-  }
-  else
-  {
-    glDeleteProgram(entry.shader.glprogid);
-    entry.shader.glprogid = 0;
+    shader.SetProgramVariables();
+    return true;
   }
+  glDeleteProgram(shader.glprogid);
+  shader.glprogid = 0;
+  return false;
 }
 
-
 } // namespace OGL
@@ -9,7 +9,6 @@
 #include <unordered_map>
 
 #include "Common/GL/GLUtil.h"
-#include "Common/LinearDiskCache.h"
 
 #include "VideoCommon/GeometryShaderGen.h"
 #include "VideoCommon/ObjectUsageProfiler.h"
@@ -38,6 +37,20 @@ public:
     GeometryShaderUid::ShaderUidHasher gshasher;
     hash = vshasher(vuid) ^ pshasher(puid) ^ gshasher(guid);
   }
+  // The disk cache stores the hashes with the uid, these are calculated again on load
+  void ClearHASH()
+  {
+    vuid.ClearHASH();
+    puid.ClearHASH();
+    guid.ClearHASH();
+  }
+  void CalculateUIDHash()
+  {
+    vuid.CalculateUIDHash();
+    puid.CalculateUIDHash();
+    guid.CalculateUIDHash();
+    CalculateHash();
+  }
   bool operator <(const SHADERUID& r) const
   {
     return std::tie(vuid, puid, guid) < std::tie(r.vuid, r.puid, r.guid);
@@ -71,6 +84,20 @@ public:
     GeometryShaderUid::ShaderUidHasher gshasher;
     hash = vshasher(vuid) ^ pshasher(puid) ^ gshasher(guid);
   }
+  // The disk cache stores the hashes with the uid, these are calculated again on load
+  void ClearHASH()
+  {
+    vuid.ClearHASH();
+    puid.ClearHASH();
+    guid.ClearHASH();
+  }
+  void CalculateUIDHash()
+  {
+    vuid.CalculateUIDHash();
+    puid.CalculateUIDHash();
+    guid.CalculateUIDHash();
+    CalculateHash();
+  }
   bool operator <(const UBERSHADERUID& r) const
   {
     return std::tie(vuid, puid, guid) < std::tie(r.vuid, r.puid, r.guid);
@@ -155,17 +182,7 @@ private:
   static void CompileShaders();
   static void CompileUberShaders();
 
-  class ProgramShaderCacheInserter : public LinearDiskCacheReader<SHADERUID, u8>
-  {
-  public:
-    void Read(const SHADERUID &key, const u8 *value, u32 value_size) override;
-  };
-
-  class ProgramUberShaderCacheInserter : public LinearDiskCacheReader<UBERSHADERUID, u8>
-  {
-  public:
-    void Read(const UBERSHADERUID &key, const u8 *value, u32 value_size) override;
-  };
+  static bool LoadProgramBinary(SHADER& shader, const u8* value, u32 value_size);
 
   static PCache* pshaders;
   static UberPCache pushaders;
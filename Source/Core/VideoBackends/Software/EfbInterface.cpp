@@ -4,7 +4,9 @@
 
 #include <algorithm>
 
+#include "Common/CPUDetect.h"
 #include "Common/CommonTypes.h"
+#include "Common/Intrinsics.h"
 #include "Common/Logging/Log.h"
 #include "Common/Swap.h"
 
@@ -20,6 +22,13 @@ namespace EfbInterface
 {
 u32 perf_values[PQ_NUM_MEMBERS];
 
+static bool s_simd_enabled = true;
+
+void SetSIMDEnabled(bool enabled)
+{
+  s_simd_enabled = enabled;
+}
+
 static inline u32 GetColorOffset(u16 x, u16 y)
 {
   return (x + y * EFB_WIDTH) * 3;
@@ -30,6 +39,20 @@ static inline u32 GetDepthOffset(u16 x, u16 y)
   return (x + y * EFB_WIDTH) * 3 + DEPTH_BUFFER_START;
 }
 
+// Pixels are 3 bytes. They are accessed byte exact, a 4 byte access would also touch the first
+// byte of the next pixel, which may belong to a tile another thread is shading.
+static inline u32 LoadPixel(u32 offset)
+{
+  return efb[offset] | (efb[offset + 1] << 8) | (efb[offset + 2] << 16);
+}
+
+static inline void StorePixel(u32 offset, u32 val)
+{
+  efb[offset] = static_cast<u8>(val);
+  efb[offset + 1] = static_cast<u8>(val >> 8);
+  efb[offset + 2] = static_cast<u8>(val >> 16);
+}
+
 static void SetPixelAlphaOnly(u32 offset, u8 a)
 {
   switch (bpmem.zcontrol.pixel_format)
@@ -42,10 +65,9 @@ static void SetPixelAlphaOnly(u32 offset, u8 a)
   case PEControl::RGBA6_Z24:
   {
     u32 a32 = a;
-    u32 *dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xffffffc0;
+    u32 val = LoadPixel(offset) & 0x00ffffc0;
     val |= (a32 >> 2) & 0x0000003f;
-    *dst = val;
+    StorePixel(offset, val);
   }
   break;
   default:
@@ -61,31 +83,26 @@ static void SetPixelColorOnly(u32 offset, u8 *rgb)
   case PEControl::Z24:
   {
     u32 src = *(u32*)rgb;
-    u32 *dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff000000;
-    val |= src >> 8;
-    *dst = val;
+    u32 val = src >> 8;
+    StorePixel(offset, val);
   }
   break;
   case PEControl::RGBA6_Z24:
   {
     u32 src = *(u32*)rgb;
-    u32 *dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff00003f;
+    u32 val = LoadPixel(offset) & 0x0000003f;
     val |= (src >> 4) & 0x00000fc0; // blue
     val |= (src >> 6) & 0x0003f000; // green
     val |= (src >> 8) & 0x00fc0000; // red
-    *dst = val;
+    StorePixel(offset, val);
   }
   break;
   case PEControl::RGB565_Z16:
   {
     INFO_LOG(VIDEO, "RGB565_Z16 is not supported correctly yet");
     u32 src = *(u32*)rgb;
-    u32 *dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff000000;
-    val |= src >> 8;
-    *dst = val;
+    u32 val = src >> 8;
+    StorePixel(offset, val);
   }
   break;
   default:
@@ -101,32 +118,26 @@ static void SetPixelAlphaColor(u32 offset, u8 *color)
   case PEControl::Z24:
   {
     u32 src = *(u32*)color;
-    u32 *dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff000000;
-    val |= src >> 8;
-    *dst = val;
+    u32 val = src >> 8;
+    StorePixel(offset, val);
   }
   break;
   case PEControl::RGBA6_Z24:
   {
     u32 src = *(u32*)color;
-    u32 *dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff000000;
-    val |= (src >> 2) & 0x0000003f; // alpha
+    u32 val = (src >> 2) & 0x0000003f; // alpha
     val |= (src >> 4) & 0x00000fc0; // blue
     val |= (src >> 6) & 0x0003f000; // green
     val |= (src >> 8) & 0x00fc0000; // red
-    *dst = val;
+    StorePixel(offset, val);
   }
   break;
   case PEControl::RGB565_Z16:
   {
     INFO_LOG(VIDEO, "RGB565_Z16 is not supported correctly yet");
     u32 src = *(u32*)color;
-    u32 *dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff000000;
-    val |= src >> 8;
-    *dst = val;
+    u32 val = src >> 8;
+    StorePixel(offset, val);
   }
   break;
   default:
@@ -141,7 +152,7 @@ static void GetPixelColor(u32 offset, u8 *color)
   case PEControl::RGB8_Z24:
   case PEControl::Z24:
   {
-    u32 src = *(u32*)&efb[offset];
+    u32 src = LoadPixel(offset);
     u32 *dst = (u32*)color;
     u32 val = 0xff | ((src & 0x00ffffff) << 8);
     *dst = val;
@@ -149,7 +160,7 @@ static void GetPixelColor(u32 offset, u8 *color)
   break;
   case PEControl::RGBA6_Z24:
   {
-    u32 src = *(u32*)&efb[offset];
+    u32 src = LoadPixel(offset);
     color[ALP_C] = Convert6To8(src & 0x3f);
     color[BLU_C] = Convert6To8((src >> 6) & 0x3f);
     color[GRN_C] = Convert6To8((src >> 12) & 0x3f);
@@ -159,7 +170,7 @@ static void GetPixelColor(u32 offset, u8 *color)
   case PEControl::RGB565_Z16:
   {
     INFO_LOG(VIDEO, "RGB565_Z16 is not supported correctly yet");
-    u32 src = *(u32*)&efb[offset];
+    u32 src = LoadPixel(offset);
     u32 *dst = (u32*)color;
     u32 val = 0xff | ((src & 0x00ffffff) << 8);
     *dst = val;
@@ -178,19 +189,15 @@ static void SetPixelDepth(u32 offset, u32 depth)
   case PEControl::RGBA6_Z24:
   case PEControl::Z24:
   {
-    u32 *dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff000000;
-    val |= depth & 0x00ffffff;
-    *dst = val;
+    u32 val = depth & 0x00ffffff;
+    StorePixel(offset, val);
   }
   break;
   case PEControl::RGB565_Z16:
   {
     INFO_LOG(VIDEO, "RGB565_Z16 is not supported correctly yet");
-    u32 *dst = (u32*)&efb[offset];
-    u32 val = *dst & 0xff000000;
-    val |= depth & 0x00ffffff;
-    *dst = val;
+    u32 val = depth & 0x00ffffff;
+    StorePixel(offset, val);
   }
   break;
   default:
@@ -208,13 +215,13 @@ static u32 GetPixelDepth(u32 offset)
   case PEControl::RGBA6_Z24:
   case PEControl::Z24:
   {
-    depth = (*(u32*)&efb[offset]) & 0x00ffffff;
+    depth = LoadPixel(offset);
   }
   break;
   case PEControl::RGB565_Z16:
   {
     INFO_LOG(VIDEO, "RGB565_Z16 is not supported correctly yet");
-    depth = (*(u32*)&efb[offset]) & 0x00ffffff;
+    depth = LoadPixel(offset);
   }
   break;
   default:
@@ -392,6 +399,39 @@ static void SubtractBlend(u8 *srcClr, u8 *dstClr)
   }
 }
 
+#ifdef _M_X86
+// Same as BlendColor, with one component per lane
+FUNCTION_TARGET_SSR41
+static void BlendColorSSE41(u8 *srcClr, u8 *dstClr)
+{
+  u32 srcFactor = GetSourceFactor(srcClr, dstClr, bpmem.blendmode.srcfactor);
+  u32 dstFactor = GetDestinationFactor(srcClr, dstClr, bpmem.blendmode.dstfactor);
+
+  __m128i src = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(*(u32*)srcClr));
+  __m128i dst = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(*(u32*)dstClr));
+  __m128i sf = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(srcFactor));
+  __m128i df = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(dstFactor));
+
+  // add MSB of factors to make their range 0 -> 256
+  sf = _mm_add_epi32(sf, _mm_srli_epi32(sf, 7));
+  df = _mm_add_epi32(df, _mm_srli_epi32(df, 7));
+
+  __m128i color = _mm_add_epi32(_mm_mullo_epi32(src, sf), _mm_mullo_epi32(dst, df));
+  color = _mm_srli_epi32(color, 8);
+  // at most 510, the second pack clamps to 255
+  color = _mm_packus_epi32(color, color);
+  color = _mm_packus_epi16(color, color);
+  *(u32*)dstClr = _mm_cvtsi128_si32(color);
+}
+
+static void SubtractBlendSSE2(u8 *srcClr, u8 *dstClr)
+{
+  __m128i src = _mm_cvtsi32_si128(*(u32*)srcClr);
+  __m128i dst = _mm_cvtsi32_si128(*(u32*)dstClr);
+  *(u32*)dstClr = _mm_cvtsi128_si32(_mm_subs_epu8(dst, src));
+}
+#endif
+
 void BlendTev(u16 x, u16 y, u8 *color)
 {
   u32 dstClr;
@@ -403,10 +443,19 @@ void BlendTev(u16 x, u16 y, u8 *color)
 
   if (bpmem.blendmode.blendenable)
   {
-    if (bpmem.blendmode.subtract)
-      SubtractBlend(color, dstClrPtr);
+#ifdef _M_X86
+    if (s_simd_enabled && bpmem.blendmode.subtract && cpu_info.bSSE2)
+      SubtractBlendSSE2(color, dstClrPtr);
+    else if (s_simd_enabled && !bpmem.blendmode.subtract && cpu_info.bSSE4_1)
+      BlendColorSSE41(color, dstClrPtr);
     else
-      BlendColor(color, dstClrPtr);
+#endif
+    {
+      if (bpmem.blendmode.subtract)
+        SubtractBlend(color, dstClrPtr);
+      else
+        BlendColor(color, dstClrPtr);
+    }
   }
   else if (bpmem.blendmode.logicopenable)
   {
@@ -41,6 +41,8 @@ enum
 
 // does full blending of an incoming pixel
 void BlendTev(u16 x, u16 y, u8 *color);
+// Whether blending may use the SSE4.1 code when the CPU has it, which gives the same results
+void SetSIMDEnabled(bool enabled);
 
 // compare z at location x,y
 // writes it if it passes
@@ -61,16 +63,15 @@ void CopyToXFB(yuv422_packed* xfb_in_ram, u32 fbWidth, u32 fbHeight, const EFBRe
 void BypassXFB(u8* texture, u32 fbWidth, u32 fbHeight, const EFBRectangle& sourceRc, float Gamma);
 
 extern u32 perf_values[PQ_NUM_MEMBERS];
-inline void IncPerfCounterQuadCount(PerfQueryType type)
+inline void IncPerfCounterQuadCount(PerfQueryType type, u32 pixels = 1)
 {
   // NOTE: hardware doesn't process individual pixels but quads instead.
   // Current software renderer architecture works on pixels though, so
   // we have this "quad" hack here to only increment the registers on
   // every fourth rendered pixel
   static u32 quad[PQ_NUM_MEMBERS];
-  if (++quad[type] != 3)
-    return;
-  quad[type] = 0;
-  ++perf_values[type];
+  quad[type] += pixels;
+  perf_values[type] += quad[type] / 3;
+  quad[type] %= 3;
 }
 }
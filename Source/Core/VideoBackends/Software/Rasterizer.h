@@ -14,6 +14,12 @@ void Init();
 
 void DrawTriangleFrontFace(OutputVertexData *v0, OutputVertexData *v1, OutputVertexData *v2);
 
+// Draws the triangles that were queued since the last flush. Those are shaded in screen tiles
+// on the worker threads, so the pipeline state has to stay the same until then.
+void Flush();
+// Whether batches may be shaded in tiles on the thread pool, which gives the same results
+void SetTilesEnabled(bool enabled);
+
 void SetScissor();
 
 void SetTevReg(int reg, int comp, bool konst, s16 color);
@@ -24,7 +30,7 @@ struct Slope
   float dfdy;
   float f0;
 
-  float GetValue(float dx, float dy)
+  float GetValue(float dx, float dy) const
   {
     return f0 + (dfdx * dx) + (dfdy * dy);
   }
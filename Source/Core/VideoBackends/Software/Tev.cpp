@@ -2,10 +2,15 @@
 // Licensed under GPLv2+
 // Refer to the license.txt file included.
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <iterator>
 
+#include "Common/CPUDetect.h"
 #include "Common/ChunkFile.h"
 #include "Common/CommonTypes.h"
+#include "Common/Intrinsics.h"
 #include "VideoBackends/Software/DebugUtil.h"
 #include "VideoBackends/Software/EfbInterface.h"
 #include "VideoBackends/Software/Tev.h"
@@ -23,8 +28,30 @@
 #define ALLOW_TEV_DUMPS 0
 #endif
 
+static bool s_simd_enabled = true;
+
+void Tev::SetSIMDEnabled(bool enabled)
+{
+  s_simd_enabled = enabled;
+}
+
+void Tev::Counters::Reset()
+{
+  rasterizedPixels = 0;
+  tevPixelsIn = 0;
+  tevPixelsOut = 0;
+  std::fill(std::begin(perfPixels), std::end(perfPixels), 0);
+  bbox[BoundingBox::LEFT] = 0xFFFF;
+  bbox[BoundingBox::RIGHT] = 0;
+  bbox[BoundingBox::TOP] = 0xFFFF;
+  bbox[BoundingBox::BOTTOM] = 0;
+}
+
 void Tev::Init()
 {
+  counters.Reset();
+  ResetInputs();
+
   FixedConstants[0] = 0;
   FixedConstants[1] = 32;
   FixedConstants[2] = 64;
@@ -337,6 +364,118 @@ void Tev::DrawAlphaCompare(TevStageCombiner::AlphaCombiner& ac, const InputRegTy
   }
 }
 
+void Tev::DrawCombiners(TevStageCombiner::ColorCombiner& cc, TevStageCombiner::AlphaCombiner& ac)
+{
+  // combine inputs
+  InputRegType inputs[4];
+  for (int i = 0; i < 3; i++)
+  {
+    inputs[BLU_C + i].a = *m_ColorInputLUT[cc.a][i];
+    inputs[BLU_C + i].b = *m_ColorInputLUT[cc.b][i];
+    inputs[BLU_C + i].c = *m_ColorInputLUT[cc.c][i];
+    inputs[BLU_C + i].d = *m_ColorInputLUT[cc.d][i];
+  }
+  inputs[ALP_C].a = *m_AlphaInputLUT[ac.a];
+  inputs[ALP_C].b = *m_AlphaInputLUT[ac.b];
+  inputs[ALP_C].c = *m_AlphaInputLUT[ac.c];
+  inputs[ALP_C].d = *m_AlphaInputLUT[ac.d];
+
+  if (cc.bias != 3)
+    DrawColorRegular(cc, inputs);
+  else
+    DrawColorCompare(cc, inputs);
+
+  if (cc.clamp)
+  {
+    Reg[cc.dest][RED_C] = Clamp255(Reg[cc.dest][RED_C]);
+    Reg[cc.dest][GRN_C] = Clamp255(Reg[cc.dest][GRN_C]);
+    Reg[cc.dest][BLU_C] = Clamp255(Reg[cc.dest][BLU_C]);
+  }
+  else
+  {
+    Reg[cc.dest][RED_C] = Clamp1024(Reg[cc.dest][RED_C]);
+    Reg[cc.dest][GRN_C] = Clamp1024(Reg[cc.dest][GRN_C]);
+    Reg[cc.dest][BLU_C] = Clamp1024(Reg[cc.dest][BLU_C]);
+  }
+
+  if (ac.bias != 3)
+    DrawAlphaRegular(ac, inputs);
+  else
+    DrawAlphaCompare(ac, inputs);
+
+  if (ac.clamp)
+    Reg[ac.dest][ALP_C] = Clamp255(Reg[ac.dest][ALP_C]);
+  else
+    Reg[ac.dest][ALP_C] = Clamp1024(Reg[ac.dest][ALP_C]);
+}
+
+#ifdef _M_X86
+FUNCTION_TARGET_SSR41
+void Tev::DrawRegularSSE41(const TevStageCombiner::ColorCombiner& cc,
+                           const TevStageCombiner::AlphaCombiner& ac)
+{
+  // The lanes follow the ABGR order of the registers. The inputs are cut to the widths of
+  // InputRegType, and each lane does what DrawColorRegular or DrawAlphaRegular does.
+  const __m128i mask = _mm_set1_epi32(0xff);
+  const __m128i a = _mm_and_si128(
+      _mm_setr_epi32(*m_AlphaInputLUT[ac.a], *m_ColorInputLUT[cc.a][BLU_INP],
+                     *m_ColorInputLUT[cc.a][GRN_INP], *m_ColorInputLUT[cc.a][RED_INP]),
+      mask);
+  const __m128i b = _mm_and_si128(
+      _mm_setr_epi32(*m_AlphaInputLUT[ac.b], *m_ColorInputLUT[cc.b][BLU_INP],
+                     *m_ColorInputLUT[cc.b][GRN_INP], *m_ColorInputLUT[cc.b][RED_INP]),
+      mask);
+  __m128i c = _mm_and_si128(
+      _mm_setr_epi32(*m_AlphaInputLUT[ac.c], *m_ColorInputLUT[cc.c][BLU_INP],
+                     *m_ColorInputLUT[cc.c][GRN_INP], *m_ColorInputLUT[cc.c][RED_INP]),
+      mask);
+  __m128i d = _mm_setr_epi32(*m_AlphaInputLUT[ac.d], *m_ColorInputLUT[cc.d][BLU_INP],
+                             *m_ColorInputLUT[cc.d][GRN_INP], *m_ColorInputLUT[cc.d][RED_INP]);
+  d = _mm_srai_epi32(_mm_slli_epi32(d, 21), 21);
+
+  const s32 color_scale = 1 << m_ScaleLShiftLUT[cc.shift];
+  const s32 alpha_scale = 1 << m_ScaleLShiftLUT[ac.shift];
+  const __m128i scale = _mm_setr_epi32(alpha_scale, color_scale, color_scale, color_scale);
+  const __m128i bias = _mm_setr_epi32(m_BiasLUT[ac.bias], m_BiasLUT[cc.bias], m_BiasLUT[cc.bias],
+                                      m_BiasLUT[cc.bias]);
+  const s32 color_round = (cc.shift == 3) ? 0 : (cc.op == 1) ? 127 : 128;
+  const s32 alpha_round = (ac.shift != 3) ? 0 : (ac.op == 1) ? 127 : 128;
+  const __m128i round = _mm_setr_epi32(alpha_round, color_round, color_round, color_round);
+  // alpha is negated before the division, color after it
+  const s32 color_negate = cc.op ? -1 : 0;
+  const __m128i negate_before = _mm_setr_epi32(ac.op ? -1 : 0, 0, 0, 0);
+  const __m128i negate_after = _mm_setr_epi32(0, color_negate, color_negate, color_negate);
+  const s32 color_halve = m_ScaleRShiftLUT[cc.shift] ? -1 : 0;
+  const __m128i halve =
+      _mm_setr_epi32(m_ScaleRShiftLUT[ac.shift] ? -1 : 0, color_halve, color_halve, color_halve);
+  const s32 color_min = cc.clamp ? 0 : -1024;
+  const s32 color_max = cc.clamp ? 255 : 1023;
+  const __m128i min = _mm_setr_epi32(ac.clamp ? 0 : -1024, color_min, color_min, color_min);
+  const __m128i max = _mm_setr_epi32(ac.clamp ? 255 : 1023, color_max, color_max, color_max);
+
+  c = _mm_add_epi32(c, _mm_srli_epi32(c, 7));
+
+  __m128i temp = _mm_add_epi32(_mm_mullo_epi32(a, _mm_sub_epi32(_mm_set1_epi32(256), c)),
+                               _mm_mullo_epi32(b, c));
+  temp = _mm_mullo_epi32(temp, scale);
+  temp = _mm_add_epi32(temp, round);
+  temp = _mm_sub_epi32(_mm_xor_si128(temp, negate_before), negate_before);
+  temp = _mm_srai_epi32(temp, 8);
+  temp = _mm_sub_epi32(_mm_xor_si128(temp, negate_after), negate_after);
+
+  __m128i result = _mm_add_epi32(_mm_mullo_epi32(_mm_add_epi32(d, bias), scale), temp);
+  result = _mm_blendv_epi8(result, _mm_srai_epi32(result, 1), halve);
+  result = _mm_min_epi32(_mm_max_epi32(result, min), max);
+
+  alignas(16) s32 output[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(output), result);
+  Reg[cc.dest][BLU_C] = output[BLU_C];
+  Reg[cc.dest][GRN_C] = output[GRN_C];
+  Reg[cc.dest][RED_C] = output[RED_C];
+  Reg[ac.dest][ALP_C] = output[ALP_C];
+}
+#endif
+
 static bool AlphaCompare(int alpha, int ref, AlphaTest::CompareMode comp)
 {
   switch (comp)
@@ -511,7 +650,10 @@ void Tev::Draw()
   _assert_(Position[0] >= 0 && Position[0] < EFB_WIDTH);
   _assert_(Position[1] >= 0 && Position[1] < EFB_HEIGHT);
 
-  INCSTAT(stats.thisFrame.tevPixelsIn);
+  counters.tevPixelsIn++;
+
+  // The registers written by the stages only hold for this pixel
+  std::memcpy(Reg, LoadedReg, sizeof(Reg));
 
   for (unsigned int stageNum = 0; stageNum < bpmem.genMode.numindstages.Value(); stageNum++)
   {
@@ -579,6 +721,12 @@ void Tev::Draw()
       TexColor[BLU_C] = texel[bpmem.tevksel[swaptable].swap1];
       TexColor[ALP_C] = texel[bpmem.tevksel[swaptable].swap2];
     }
+    else
+    {
+      // White, as in the hardware backends, rather than the texel of some earlier stage or pixel
+      for (s16& comp : TexColor)
+        comp = 255;
+    }
 
     // set konst for this stage
     int kc = kSel.getKC(stageOdd);
@@ -591,47 +739,12 @@ void Tev::Draw()
     // set color
     SetRasColor(order.getColorChan(stageOdd), ac.rswap * 2);
 
-    // combine inputs
-    InputRegType inputs[4];
-    for (int i = 0; i < 3; i++)
-    {
-      inputs[BLU_C + i].a = *m_ColorInputLUT[cc.a][i];
-      inputs[BLU_C + i].b = *m_ColorInputLUT[cc.b][i];
-      inputs[BLU_C + i].c = *m_ColorInputLUT[cc.c][i];
-      inputs[BLU_C + i].d = *m_ColorInputLUT[cc.d][i];
-    }
-    inputs[ALP_C].a = *m_AlphaInputLUT[ac.a];
-    inputs[ALP_C].b = *m_AlphaInputLUT[ac.b];
-    inputs[ALP_C].c = *m_AlphaInputLUT[ac.c];
-    inputs[ALP_C].d = *m_AlphaInputLUT[ac.d];
-
-    if (cc.bias != 3)
-      DrawColorRegular(cc, inputs);
-    else
-      DrawColorCompare(cc, inputs);
-
-    if (cc.clamp)
-    {
-      Reg[cc.dest][RED_C] = Clamp255(Reg[cc.dest][RED_C]);
-      Reg[cc.dest][GRN_C] = Clamp255(Reg[cc.dest][GRN_C]);
-      Reg[cc.dest][BLU_C] = Clamp255(Reg[cc.dest][BLU_C]);
-    }
+#ifdef _M_X86
+    if (cc.bias != 3 && ac.bias != 3 && s_simd_enabled && cpu_info.bSSE4_1)
+      DrawRegularSSE41(cc, ac);
     else
-    {
-      Reg[cc.dest][RED_C] = Clamp1024(Reg[cc.dest][RED_C]);
-      Reg[cc.dest][GRN_C] = Clamp1024(Reg[cc.dest][GRN_C]);
-      Reg[cc.dest][BLU_C] = Clamp1024(Reg[cc.dest][BLU_C]);
-    }
-
-    if (ac.bias != 3)
-      DrawAlphaRegular(ac, inputs);
-    else
-      DrawAlphaCompare(ac, inputs);
-
-    if (ac.clamp)
-      Reg[ac.dest][ALP_C] = Clamp255(Reg[ac.dest][ALP_C]);
-    else
-      Reg[ac.dest][ALP_C] = Clamp1024(Reg[ac.dest][ALP_C]);
+#endif
+      DrawCombiners(cc, ac);
 
 #if ALLOW_TEV_DUMPS
     if (g_ActiveConfig.bDumpTevStages)
@@ -763,19 +876,19 @@ void Tev::Draw()
     if (late_ztest && bpmem.zmode.testenable)
     {
       // TODO: Check against hw if these values get incremented even if depth testing is disabled
-      EfbInterface::IncPerfCounterQuadCount(PQ_ZCOMP_INPUT);
+      counters.perfPixels[PQ_ZCOMP_INPUT]++;
 
       if (!EfbInterface::ZCompare(Position[0], Position[1], Position[2]))
         return;
 
-      EfbInterface::IncPerfCounterQuadCount(PQ_ZCOMP_OUTPUT);
+      counters.perfPixels[PQ_ZCOMP_OUTPUT]++;
     }
   }
   // branchless bounding box update
-  BoundingBox::coords[BoundingBox::LEFT] = std::min((u16)Position[0], BoundingBox::coords[BoundingBox::LEFT]);
-  BoundingBox::coords[BoundingBox::RIGHT] = std::max((u16)Position[0], BoundingBox::coords[BoundingBox::RIGHT]);
-  BoundingBox::coords[BoundingBox::TOP] = std::min((u16)Position[1], BoundingBox::coords[BoundingBox::TOP]);
-  BoundingBox::coords[BoundingBox::BOTTOM] = std::max((u16)Position[1], BoundingBox::coords[BoundingBox::BOTTOM]);
+  counters.bbox[BoundingBox::LEFT] = std::min((u16)Position[0], counters.bbox[BoundingBox::LEFT]);
+  counters.bbox[BoundingBox::RIGHT] = std::max((u16)Position[0], counters.bbox[BoundingBox::RIGHT]);
+  counters.bbox[BoundingBox::TOP] = std::min((u16)Position[1], counters.bbox[BoundingBox::TOP]);
+  counters.bbox[BoundingBox::BOTTOM] = std::max((u16)Position[1], counters.bbox[BoundingBox::BOTTOM]);
 
   // if we are only calculating the bounding box,
   // there's no need to actually draw anything
@@ -802,8 +915,8 @@ void Tev::Draw()
   }
 #endif
 
-  INCSTAT(stats.thisFrame.tevPixelsOut);
-  EfbInterface::IncPerfCounterQuadCount(PQ_BLEND_INPUT);
+  counters.tevPixelsOut++;
+  counters.perfPixels[PQ_BLEND_INPUT]++;
 
   EfbInterface::BlendTev(Position[0], Position[1], output);
 }
@@ -816,7 +929,20 @@ void Tev::SetRegColor(int reg, int comp, bool konst, s16 color)
   }
   else
   {
-    Reg[reg][comp] = color;
+    LoadedReg[reg][comp] = color;
   }
 }
 
+void Tev::ResetInputs()
+{
+  std::memset(Color, 0, sizeof(Color));
+  std::memset(Uv, 0, sizeof(Uv));
+  std::memset(IndirectTex, 0, sizeof(IndirectTex));
+}
+
+void Tev::CopyRegisters(const Tev& other)
+{
+  std::memcpy(LoadedReg, other.LoadedReg, sizeof(LoadedReg));
+  std::memcpy(KonstantColors, other.KonstantColors, sizeof(KonstantColors));
+}
+
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "VideoCommon/BPMemory.h"
+#include "VideoCommon/PerfQueryBase.h"
 
 class Tev
 {
@@ -24,6 +25,8 @@ class Tev
 
   // color order: ABGR
   s16 Reg[4][4];
+  // The register values loaded by the game, every pixel starts with them
+  s16 LoadedReg[4][4];
   s16 KonstantColors[4][4];
   s16 TexColor[4];
   s16 RasColor[4];
@@ -63,10 +66,29 @@ class Tev
   void DrawColorCompare(TevStageCombiner::ColorCombiner& cc, const InputRegType inputs[4]);
   void DrawAlphaRegular(TevStageCombiner::AlphaCombiner& ac, const InputRegType inputs[4]);
   void DrawAlphaCompare(TevStageCombiner::AlphaCombiner& ac, const InputRegType inputs[4]);
+  void DrawCombiners(TevStageCombiner::ColorCombiner& cc, TevStageCombiner::AlphaCombiner& ac);
+  // Both regular combiners at once, with one component per lane
+  void DrawRegularSSE41(const TevStageCombiner::ColorCombiner& cc,
+                        const TevStageCombiner::AlphaCombiner& ac);
 
   void Indirect(unsigned int stageNum, s32 s, s32 t);
 
 public:
+  // What the pixels change outside of their own EFB pixel, kept apart so several Tev instances
+  // can draw at once and added to the globals by the rasterizer
+  struct Counters
+  {
+    u32 rasterizedPixels;
+    u32 tevPixelsIn;
+    u32 tevPixelsOut;
+    u32 perfPixels[PQ_NUM_MEMBERS];
+    u16 bbox[4];
+
+    void Reset();
+  };
+
+  Counters counters;
+
   s32 Position[3];
   u8 Color[2][4]; // must be RGBA for correct swap table ordering
   TextureCoordinateType Uv[8];
@@ -87,5 +109,14 @@ public:
 
   void Draw();
 
+  // Clears the inputs the pixels of a triangle may not set, so they don't depend on which pixels
+  // this instance shaded before
+  void ResetInputs();
+
   void SetRegColor(int reg, int comp, bool konst, s16 color);
+  // Takes the loaded and konstant registers of another instance
+  void CopyRegisters(const Tev& other);
+
+  // Whether the stages may use the SSE4.1 code when the CPU has it, which gives the same results
+  static void SetSIMDEnabled(bool enabled);
 };
@@ -5,7 +5,9 @@
 #include "VideoBackends/Vulkan/ShaderCache.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <functional>
 #include <sstream>
 #include <type_traits>
 #include <xxhash.h>
@@ -14,6 +16,7 @@
 #include "Common/CommonFuncs.h"
 #include "Common/LinearDiskCache.h"
 #include "Common/MsgHandler.h"
+#include "Common/StringUtil.h"
 
 #include "Core/ConfigManager.h"
 #include "Core/Host.h"
@@ -605,56 +608,6 @@ void ShaderCache::SavePipelineCache()
   disk_cache.Close();
 }
 
-/// Cache inserter that is called back when reading from the file
-template <typename Uid, typename UidHasher>
-struct ShaderUsageCacheReader : public LinearDiskCacheReader<Uid, u32>
-{
-  ShaderUsageCacheReader(ObjectUsageProfiler<Uid, pKey_t, ShaderCache::vkShaderItem, UidHasher>* shader_map) : m_shader_map(shader_map) {}
-  void Read(const Uid& key, const u32* value, u32 value_size) override
-  {
-    // We don't insert null modules into the shader map since creation could succeed later on.
-    // e.g. we're generating bad code, but fix this in a later version, and for some reason
-    // the cache is not invalidated.
-    VkShaderModule module = Util::CreateShaderModule(value, value_size);
-    if (module == VK_NULL_HANDLE)
-      return;
-    Uid item = key;
-    item.ClearHASH();
-    item.CalculateUIDHash();
-    ShaderCache::vkShaderItem& it = m_shader_map->GetOrAdd(key);
-    it.initialized.test_and_set();
-    it.compiled = true;
-    it.module = module;
-  }
-
-  ObjectUsageProfiler<Uid, pKey_t, ShaderCache::vkShaderItem, UidHasher>* m_shader_map;
-};
-
-template <typename Uid, typename UidHasher>
-struct ShaderCacheReader : public LinearDiskCacheReader<Uid, u32>
-{
-  ShaderCacheReader(std::unordered_map<Uid, ShaderCache::vkShaderItem, UidHasher>& shader_map) : m_shader_map(shader_map) {}
-  void Read(const Uid& key, const u32* value, u32 value_size) override
-  {
-    // We don't insert null modules into the shader map since creation could succeed later on.
-    // e.g. we're generating bad code, but fix this in a later version, and for some reason
-    // the cache is not invalidated.
-    VkShaderModule module = Util::CreateShaderModule(value, value_size);
-    if (module == VK_NULL_HANDLE)
-      return;
-    Uid item = key;
-    item.ClearHASH();
-    item.CalculateUIDHash();
-    ShaderCache::vkShaderItem& it = m_shader_map[key];
-    it.initialized.test_and_set();
-    it.compiled = true;
-    it.module = module;
-  }
-
-  std::unordered_map<Uid, ShaderCache::vkShaderItem, UidHasher>& m_shader_map;
-};
-
-
 void ShaderCache::LoadShaderCaches(bool forcecompile)
 {
   pKey_t gameid = (pKey_t)GetMurmurHash3(reinterpret_cast<const u8*>(SConfig::GetInstance().GetGameID().data()), (u32)SConfig::GetInstance().GetGameID().size(), 0);
@@ -671,24 +624,15 @@ void ShaderCache::LoadShaderCaches(bool forcecompile)
     StringFromFormat("%s.ps", SConfig::GetInstance().GetGameID().c_str())
   ));
 
-  ShaderUsageCacheReader<VertexShaderUid, VertexShaderUid::ShaderUidHasher> vs_reader(m_vs_cache.shader_map.get());
-  m_vs_cache.disk_cache.OpenAndRead(GetDiskShaderCacheFileName(API_VULKAN, "vs", true, true), vs_reader);
-
-  ShaderUsageCacheReader<PixelShaderUid, PixelShaderUid::ShaderUidHasher> ps_reader(m_ps_cache.shader_map.get());
-  m_ps_cache.disk_cache.OpenAndRead(GetDiskShaderCacheFileName(API_VULKAN, "ps", true, true), ps_reader);
-
+  // Only the keys are read, the shaders are loaded when they are first used
+  m_vs_cache.disk_cache.Open(GetDiskShaderCacheFileName(API_VULKAN, "vs", true, true));
+  m_ps_cache.disk_cache.Open(GetDiskShaderCacheFileName(API_VULKAN, "ps", true, true));
   if (g_vulkan_context->SupportsGeometryShaders())
-  {
-    ShaderCacheReader<GeometryShaderUid, GeometryShaderUid::ShaderUidHasher> gs_reader(m_gs_cache.shader_map);
-    m_gs_cache.disk_cache.OpenAndRead(GetDiskShaderCacheFileName(API_VULKAN, "gs", true, true), gs_reader);
-  }
-
-  ShaderCacheReader<UberShader::VertexUberShaderUid, UberShader::VertexUberShaderUid::ShaderUidHasher> uber_vs_reader(m_vus_cache.shader_map);
-  m_vus_cache.disk_cache.OpenAndRead(
-      GetDiskShaderCacheFileName(API_TYPE::API_VULKAN, "UVS", false, true), uber_vs_reader);
-  ShaderCacheReader<UberShader::PixelUberShaderUid, UberShader::PixelUberShaderUid::ShaderUidHasher> uber_ps_reader(m_pus_cache.shader_map);
-  m_pus_cache.disk_cache.OpenAndRead(
-      GetDiskShaderCacheFileName(API_TYPE::API_VULKAN, "UPS", false, true), uber_ps_reader);
+    m_gs_cache.disk_cache.Open(GetDiskShaderCacheFileName(API_VULKAN, "gs", true, true));
+  m_vus_cache.disk_cache.Open(
+      GetDiskShaderCacheFileName(API_TYPE::API_VULKAN, "UVS", false, true));
+  m_pus_cache.disk_cache.Open(
+      GetDiskShaderCacheFileName(API_TYPE::API_VULKAN, "UPS", false, true));
   if (g_ActiveConfig.CanPrecompileUberShaders())
   {
     CompileUberShaders();
@@ -697,6 +641,8 @@ void ShaderCache::LoadShaderCaches(bool forcecompile)
   {
     CompileShaders();
   }
+  m_vs_cache.shader_map->BeginSession();
+  m_ps_cache.shader_map->BeginSession();
 
   SETSTAT(stats.numVertexShadersCreated, static_cast<int>(m_vs_cache.shader_map->size()));
   SETSTAT(stats.numVertexShadersAlive, static_cast<int>(m_vs_cache.shader_map->size()));
@@ -704,95 +650,148 @@ void ShaderCache::LoadShaderCaches(bool forcecompile)
   SETSTAT(stats.numPixelShadersAlive, static_cast<int>(m_ps_cache.shader_map->size()));
 }
 
-void ShaderCache::CompileUberShaders()
+// Progress of a precompilation pass, shown with the compilation rate
+class ShaderCache::CompileProgress
 {
-  int shader_count = 0;
-  UberShader::EnumerateVertexUberShaderUids([&](const UberShader::VertexUberShaderUid& uid, size_t total) {
-    vkShaderItem& it = m_vus_cache.shader_map[uid];
-    if (!it.initialized.test_and_set())
+public:
+  CompileProgress(const std::string& caption, const char* name)
+      : m_caption(caption), m_name(name), m_start(Clock::now())
+  {
+  }
+
+  ~CompileProgress()
+  {
+    if (m_done > 0)
     {
-      CompileVertexUberShaderForUid(uid, it);
+      NOTICE_LOG(VIDEO, "Precompiled %zu %s in %.2f s, %.1f per second", m_done, m_name,
+                 GetSeconds(), GetRate());
     }
-    shader_count++;
-    Host_UpdateProgressDialog(GetStringT("Compiling Vertex Uber shaders...").c_str(),
-      static_cast<int>(shader_count), static_cast<int>(total));
-  });  
-  Host_UpdateProgressDialog("", -1, -1);
-  shader_count = 0;
-  UberShader::EnumeratePixelUberShaderUids([&](const UberShader::PixelUberShaderUid& uid, size_t total) {
-    vkShaderItem& it = m_pus_cache.shader_map[uid];
-    if (!it.initialized.test_and_set())
+  }
+
+  void SetTotal(size_t total) { m_total = total; }
+  void Done()
+  {
+    m_done++;
+    if ((m_done & 7) == 0 || m_done == m_total)
     {
-      CompilePixelUberShaderForUid(uid, it);
+      Host_UpdateProgressDialog(
+          StringFromFormat("%s (%.0f/s)", m_caption.c_str(), GetRate()).c_str(),
+          static_cast<int>(m_done), static_cast<int>(m_total));
     }
-    shader_count++;
-    Host_UpdateProgressDialog(GetStringT("Compiling Pixel Uber shaders...").c_str(),
-      static_cast<int>(shader_count), static_cast<int>(total));    
-  });
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  double GetSeconds() const
+  {
+    return std::chrono::duration<double>(Clock::now() - m_start).count();
+  }
+  double GetRate() const { return m_done / std::max(GetSeconds(), 0.001); }
+
+  std::string m_caption;
+  const char* m_name;
+  Clock::time_point m_start;
+  size_t m_done = 0;
+  size_t m_total = 0;
+};
+
+void ShaderCache::CompileUberShaders()
+{
+  ShaderCompiler::AsyncCompiler& compiler = ShaderCompiler::AsyncCompiler::GetInstance();
+  {
+    CompileProgress progress(GetStringT("Compiling Vertex Uber shaders..."), "vertex uber shaders");
+    UberShader::EnumerateVertexUberShaderUids([&](const UberShader::VertexUberShaderUid& uid, size_t total) {
+      progress.SetTotal(total);
+      vkShaderItem& it = m_vus_cache.shader_map[uid];
+      if (!it.initialized.test_and_set())
+        CompileVertexUberShaderForUid(uid, it, &progress);
+      else
+        progress.Done();
+    });
+    compiler.WaitForFinish();
+  }
+  Host_UpdateProgressDialog("", -1, -1);
+  {
+    CompileProgress progress(GetStringT("Compiling Pixel Uber shaders..."), "pixel uber shaders");
+    UberShader::EnumeratePixelUberShaderUids([&](const UberShader::PixelUberShaderUid& uid, size_t total) {
+      progress.SetTotal(total);
+      vkShaderItem& it = m_pus_cache.shader_map[uid];
+      if (!it.initialized.test_and_set())
+        CompilePixelUberShaderForUid(uid, it, &progress);
+      else
+        progress.Done();
+    });
+    compiler.WaitForFinish();
+  }
   Host_UpdateProgressDialog("", -1, -1);
 }
 
 void ShaderCache::CompileShaders()
 {
   pKey_t gameid = (pKey_t)GetMurmurHash3(reinterpret_cast<const u8*>(SConfig::GetInstance().GetGameID().data()), (u32)SConfig::GetInstance().GetGameID().size(), 0);
-  int shader_count = 0;
-  m_vs_cache.shader_map->ForEachMostUsedByCategory(gameid,
-    [&](const VertexShaderUid& uid, size_t total)
+  ShaderCompiler::AsyncCompiler& compiler = ShaderCompiler::AsyncCompiler::GetInstance();
   {
-    VertexShaderUid item = uid;
-    item.ClearHASH();
-    item.CalculateUIDHash();
-    vkShaderItem& it = m_vs_cache.shader_map->GetOrAdd(item);
-    if (!it.initialized.test_and_set())
+    CompileProgress progress(GetStringT("Compiling Vertex shaders..."), "vertex shaders");
+    m_vs_cache.shader_map->ForEachMostUsedByCategory(gameid,
+      [&](const VertexShaderUid& uid, size_t total)
     {
-      CompileVertexShaderForUid(item, it);
-      Host_UpdateProgressDialog(GetStringT("Compiling Vertex shaders...").c_str(),
-        static_cast<int>(shader_count), static_cast<int>(total));
+      progress.SetTotal(total);
+      VertexShaderUid item = uid;
+      item.ClearHASH();
+      item.CalculateUIDHash();
+      vkShaderItem& it = m_vs_cache.shader_map->GetOrAdd(item);
+      if (!it.initialized.test_and_set())
+        CompileVertexShaderForUid(item, it, &progress);
+      else
+        progress.Done();
+    },
+      [](vkShaderItem& entry)
+    {
+      return !entry.compiled;
     }
-  },
-    [](vkShaderItem& entry)
-  {
-    return !entry.compiled;
+    , true);
+    compiler.WaitForFinish();
   }
-  , true);
-  shader_count = 0;
-  m_ps_cache.shader_map->ForEachMostUsedByCategory(gameid,
-    [&](const PixelShaderUid& uid, size_t total)
   {
-    PixelShaderUid item = uid;
-    item.ClearHASH();
-    item.CalculateUIDHash();
-    vkShaderItem& it = m_ps_cache.shader_map->GetOrAdd(item);
-    if (!it.initialized.test_and_set())
+    CompileProgress progress(GetStringT("Compiling Pixel shaders..."), "pixel shaders");
+    m_ps_cache.shader_map->ForEachMostUsedByCategory(gameid,
+      [&](const PixelShaderUid& uid, size_t total)
+    {
+      progress.SetTotal(total);
+      PixelShaderUid item = uid;
+      item.ClearHASH();
+      item.CalculateUIDHash();
+      vkShaderItem& it = m_ps_cache.shader_map->GetOrAdd(item);
+      if (!it.initialized.test_and_set())
+        CompilePixelShaderForUid(item, it, &progress);
+      else
+        progress.Done();
+    },
+      [](vkShaderItem& entry)
     {
-      CompilePixelShaderForUid(item, it);
-      Host_UpdateProgressDialog(GetStringT("Compiling Pixel shaders...").c_str(),
-        static_cast<int>(shader_count), static_cast<int>(total));
+      return !entry.compiled;
     }
-  },
-    [](vkShaderItem& entry)
-  {
-    return !entry.compiled;
+    , true);
+    compiler.WaitForFinish();
   }
-  , true);
 
   if (g_vulkan_context->SupportsGeometryShaders())
   {
-    shader_count = 0;
+    CompileProgress progress(GetStringT("Compiling Geometry shaders..."), "geometry shaders");
     EnumerateGeometryShaderUids([&](const GeometryShaderUid& uid, size_t total)
     {
+      progress.SetTotal(total);
       GeometryShaderUid item = uid;
       item.ClearHASH();
       item.CalculateUIDHash();
       vkShaderItem& it = m_gs_cache.shader_map[item];
-      shader_count++;
       if (!it.initialized.test_and_set())
-      {
-        CompileGeometryShaderForUid(item, it);
-        Host_UpdateProgressDialog(GetStringT("Compiling Geometry shaders...").c_str(),
-          static_cast<int>(shader_count), static_cast<int>(total));
-      }
+        CompileGeometryShaderForUid(item, it, &progress);
+      else
+        progress.Done();
     });
+    compiler.WaitForFinish();
   }
   Host_UpdateProgressDialog("", -1, -1);
 }
@@ -836,6 +835,17 @@ static void DestroyShaderCache(T& cache)
 
 void ShaderCache::DestroyShaderCaches()
 {
+  // The background compiles refer to the items
+  ShaderCompiler::AsyncCompiler::GetInstance().WaitForFinish();
+  SETSTAT(stats.numPendingShaderCompiles, 0);
+
+  if (g_ActiveConfig.bBackgroundShaderCompiling)
+  {
+    NOTICE_LOG(VIDEO, "Vertex shader prediction: %s",
+               m_vs_cache.shader_map->GetPredictionStats().c_str());
+    NOTICE_LOG(VIDEO, "Pixel shader prediction: %s",
+               m_ps_cache.shader_map->GetPredictionStats().c_str());
+  }
   m_vs_cache.shader_map->Persist([](VertexShaderUid &uid) {
     uid.ClearHASH();
     uid.CalculateUIDHash();
@@ -859,132 +869,204 @@ void ShaderCache::DestroyShaderCaches()
   SETSTAT(stats.numVertexShadersAlive, 0);
 }
 
-void ShaderCache::CompileVertexShaderForUid(const VertexShaderUid& uid, ShaderCache::vkShaderItem& it)
+// Creates the module from the disk cache, the values are only read for the shaders that are used
+template <typename DiskCache, typename Uid>
+static bool LoadShaderFromDisk(DiskCache& cache, const Uid& uid, ShaderCache::vkShaderItem& it)
 {
-  // Not in the cache, so compile the shader.
-  ShaderCompiler::SPIRVCodeVector spv;
-  VkShaderModule module = VK_NULL_HANDLE;
-  ShaderCode source_code;
-  GenerateVertexShaderCode(source_code, uid.GetUidData(), ShaderHostConfig::GetCurrent());
-  if (ShaderCompiler::CompileVertexShader(&spv, source_code.data(),
-    source_code.size()))
-  {
-    module = Util::CreateShaderModule(spv.data(), spv.size());
-
-    // Append to shader cache if it created successfully.
-    if (module != VK_NULL_HANDLE)
-    {
-      m_vs_cache.disk_cache.Append(uid, spv.data(), static_cast<u32>(spv.size()));
-      INCSTAT(stats.numVertexShadersCreated);
-      INCSTAT(stats.numVertexShadersAlive);
-    }
-  }
+  u32 size;
+  const u32* spirv = cache.Lookup(uid, &size);
+  if (!spirv)
+    return false;
+  // We compile the shader again when the module can't be created since creation could succeed
+  // later on. e.g. we're generating bad code, but fix this in a later version, and for some
+  // reason the cache is not invalidated.
+  VkShaderModule module = Util::CreateShaderModule(spirv, size);
+  if (module == VK_NULL_HANDLE)
+    return false;
   it.compiled = true;
-  // We still insert null entries to prevent further compilation attempts.
   it.module = module;
+  return true;
 }
 
-void ShaderCache::CompileVertexUberShaderForUid(const UberShader::VertexUberShaderUid& uid, ShaderCache::vkShaderItem& it)
+void ShaderCache::CompileShaderForItem(ShaderCompiler::ShaderStage stage, vkShaderItem& it,
+  std::function<void(ShaderCode&)> generate,
+  std::function<void(const ShaderCompiler::SPIRVCodeVector&)> on_created,
+  CompileProgress* progress, bool background)
 {
-  // Not in the cache, so compile the shader.
-  ShaderCompiler::SPIRVCodeVector spv;
-  VkShaderModule module = VK_NULL_HANDLE;
-  ShaderCode source_code;
-  UberShader::GenVertexShader(source_code, API_VULKAN, ShaderHostConfig::GetCurrent(), uid.GetUidData());
-  if (ShaderCompiler::CompileVertexShader(&spv, source_code.data(),
-    source_code.size()))
-  {
-    module = Util::CreateShaderModule(spv.data(), spv.size());
+  const auto queued = std::chrono::steady_clock::now();
+  auto finish = [this, &it, on_created, progress, background, queued](ShaderCompiler::CompileUnit* unit) {
+    VkShaderModule module = VK_NULL_HANDLE;
+    if (unit->success)
+    {
+      module = Util::CreateShaderModule(unit->spirv.data(), unit->spirv.size());
 
-    // Append to shader cache if it created successfully.
-    if (module != VK_NULL_HANDLE)
+      // Append to shader cache if it created successfully.
+      if (module != VK_NULL_HANDLE)
+        on_created(unit->spirv);
+    }
+    it.compiled = true;
+    // We still insert null entries to prevent further compilation attempts.
+    it.module = module;
+    if (progress)
+      progress->Done();
+    if (background)
     {
-      m_vus_cache.disk_cache.Append(uid, spv.data(), static_cast<u32>(spv.size()));
+      m_background_compile_seconds +=
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - queued).count();
+      m_background_compile_count++;
     }
+  };
+
+  // Not in the cache, so compile the shader. Precompiled shaders and the ones compiled in the
+  // background are generated and compiled on the thread pool, only the module is created here.
+  if (!progress && !background)
+  {
+    ShaderCompiler::CompileUnit unit;
+    unit.stage = stage;
+    unit.GenerateCodeHandler = std::move(generate);
+    unit.Run();
+    finish(&unit);
+    return;
   }
-  it.compiled = true;
-  // We still insert null entries to prevent further compilation attempts.
-  it.module = module;
+
+  ShaderCompiler::AsyncCompiler& compiler = ShaderCompiler::AsyncCompiler::GetInstance();
+  ShaderCompiler::CompileUnit* unit = background ? compiler.TryNewUnit() : compiler.NewUnit();
+  if (!unit)
+  {
+    it.initialized.clear();
+    return;
+  }
+  unit->stage = stage;
+  unit->GenerateCodeHandler = std::move(generate);
+  unit->ResultHandler = std::move(finish);
+  compiler.CompileAsync(unit);
+  if (background)
+    SETSTAT(stats.numPendingShaderCompiles, compiler.GetPendingCount());
 }
 
-void ShaderCache::CompileGeometryShaderForUid(const GeometryShaderUid& uid, ShaderCache::vkShaderItem& it)
+void ShaderCache::ProcBackgroundCompilationResults()
 {
-  // Not in the cache, so compile the shader.
-  ShaderCompiler::SPIRVCodeVector spv;
-  VkShaderModule module = VK_NULL_HANDLE;
-  ShaderCode source_code;
-  GenerateGeometryShaderCode(source_code, uid.GetUidData(), ShaderHostConfig::GetCurrent());
-  if (ShaderCompiler::CompileGeometryShader(&spv, source_code.data(),
-    source_code.size()))
+  ShaderCompiler::AsyncCompiler& compiler = ShaderCompiler::AsyncCompiler::GetInstance();
+  compiler.ProcCompilationResults();
+  SETSTAT(stats.numPendingShaderCompiles, compiler.GetPendingCount());
+  if (m_background_compile_count > 0)
   {
-    module = Util::CreateShaderModule(spv.data(), spv.size());
+    SETSTAT_FT(stats.backgroundShaderCompileLatency,
+               1000.0 * m_background_compile_seconds / m_background_compile_count);
+  }
+}
 
-    // Append to shader cache if it created successfully.
-    if (module != VK_NULL_HANDLE)
-      m_gs_cache.disk_cache.Append(uid, spv.data(), static_cast<u32>(spv.size()));
+void ShaderCache::CompileVertexShaderForUid(const VertexShaderUid& uid, ShaderCache::vkShaderItem& it, CompileProgress* progress, bool background)
+{
+  if (LoadShaderFromDisk(m_vs_cache.disk_cache, uid, it))
+  {
+    if (progress)
+      progress->Done();
+    return;
   }
-  it.compiled = true;
-  // We still insert null entries to prevent further compilation attempts.
-  it.module = module;
+  const ShaderHostConfig host_config = ShaderHostConfig::GetCurrent();
+  CompileShaderForItem(ShaderCompiler::ShaderStage::Vertex, it,
+    [uid, host_config](ShaderCode& code) {
+      GenerateVertexShaderCode(code, uid.GetUidData(), host_config);
+    },
+    [this, uid](const ShaderCompiler::SPIRVCodeVector& spv) {
+      m_vs_cache.disk_cache.Append(uid, spv.data(), static_cast<u32>(spv.size()));
+      INCSTAT(stats.numVertexShadersCreated);
+      INCSTAT(stats.numVertexShadersAlive);
+    }, progress, background);
 }
 
-void ShaderCache::CompilePixelShaderForUid(const PixelShaderUid& uid, ShaderCache::vkShaderItem& it)
+void ShaderCache::CompileVertexUberShaderForUid(const UberShader::VertexUberShaderUid& uid, ShaderCache::vkShaderItem& it, CompileProgress* progress)
 {
-  // Not in the cache, so compile the shader.
-  ShaderCompiler::SPIRVCodeVector spv;
-  VkShaderModule module = VK_NULL_HANDLE;
-  ShaderCode source_code;
-  GeneratePixelShaderCode(source_code, uid.GetUidData(), ShaderHostConfig::GetCurrent());
-  if (ShaderCompiler::CompileFragmentShader(&spv, source_code.data(),
-    source_code.size()))
+  if (LoadShaderFromDisk(m_vus_cache.disk_cache, uid, it))
   {
-    module = Util::CreateShaderModule(spv.data(), spv.size());
+    if (progress)
+      progress->Done();
+    return;
+  }
+  const ShaderHostConfig host_config = ShaderHostConfig::GetCurrent();
+  CompileShaderForItem(ShaderCompiler::ShaderStage::Vertex, it,
+    [uid, host_config](ShaderCode& code) {
+      UberShader::GenVertexShader(code, API_VULKAN, host_config, uid.GetUidData());
+    },
+    [this, uid](const ShaderCompiler::SPIRVCodeVector& spv) {
+      m_vus_cache.disk_cache.Append(uid, spv.data(), static_cast<u32>(spv.size()));
+    }, progress);
+}
 
-    // Append to shader cache if it created successfully.
-    if (module != VK_NULL_HANDLE)
-    {
+void ShaderCache::CompileGeometryShaderForUid(const GeometryShaderUid& uid, ShaderCache::vkShaderItem& it, CompileProgress* progress)
+{
+  if (LoadShaderFromDisk(m_gs_cache.disk_cache, uid, it))
+  {
+    if (progress)
+      progress->Done();
+    return;
+  }
+  const ShaderHostConfig host_config = ShaderHostConfig::GetCurrent();
+  CompileShaderForItem(ShaderCompiler::ShaderStage::Geometry, it,
+    [uid, host_config](ShaderCode& code) {
+      GenerateGeometryShaderCode(code, uid.GetUidData(), host_config);
+    },
+    [this, uid](const ShaderCompiler::SPIRVCodeVector& spv) {
+      m_gs_cache.disk_cache.Append(uid, spv.data(), static_cast<u32>(spv.size()));
+    }, progress);
+}
+
+void ShaderCache::CompilePixelShaderForUid(const PixelShaderUid& uid, ShaderCache::vkShaderItem& it, CompileProgress* progress, bool background)
+{
+  if (LoadShaderFromDisk(m_ps_cache.disk_cache, uid, it))
+  {
+    if (progress)
+      progress->Done();
+    return;
+  }
+  const ShaderHostConfig host_config = ShaderHostConfig::GetCurrent();
+  CompileShaderForItem(ShaderCompiler::ShaderStage::Fragment, it,
+    [uid, host_config](ShaderCode& code) {
+      GeneratePixelShaderCode(code, uid.GetUidData(), host_config);
+    },
+    [this, uid](const ShaderCompiler::SPIRVCodeVector& spv) {
       m_ps_cache.disk_cache.Append(uid, spv.data(), static_cast<u32>(spv.size()));
       INCSTAT(stats.numPixelShadersCreated);
       INCSTAT(stats.numPixelShadersAlive);
-    }
-  }
-  it.compiled = true;
-  // We still insert null entries to prevent further compilation attempts.
-  it.module = module;
+    }, progress, background);
 }
 
-void ShaderCache::CompilePixelUberShaderForUid(const UberShader::PixelUberShaderUid& uid, ShaderCache::vkShaderItem& it)
+void ShaderCache::CompilePixelUberShaderForUid(const UberShader::PixelUberShaderUid& uid, ShaderCache::vkShaderItem& it, CompileProgress* progress)
 {
-  // Not in the cache, so compile the shader.
-  ShaderCompiler::SPIRVCodeVector spv;
-  VkShaderModule module = VK_NULL_HANDLE;
-  ShaderCode source_code;
-  UberShader::GenPixelShader(source_code, API_VULKAN, ShaderHostConfig::GetCurrent(), uid.GetUidData());
-  if (ShaderCompiler::CompileFragmentShader(&spv, source_code.data(),
-    source_code.size()))
+  if (LoadShaderFromDisk(m_pus_cache.disk_cache, uid, it))
   {
-    module = Util::CreateShaderModule(spv.data(), spv.size());
-
-    // Append to shader cache if it created successfully.
-    if (module != VK_NULL_HANDLE)
-    {
+    if (progress)
+      progress->Done();
+    return;
+  }
+  const ShaderHostConfig host_config = ShaderHostConfig::GetCurrent();
+  CompileShaderForItem(ShaderCompiler::ShaderStage::Fragment, it,
+    [uid, host_config](ShaderCode& code) {
+      UberShader::GenPixelShader(code, API_VULKAN, host_config, uid.GetUidData());
+    },
+    [this, uid](const ShaderCompiler::SPIRVCodeVector& spv) {
       m_pus_cache.disk_cache.Append(uid, spv.data(), static_cast<u32>(spv.size()));
       INCSTAT(stats.numPixelShadersCreated);
       INCSTAT(stats.numPixelShadersAlive);
-    }
-  }
-  it.compiled = true;
-  // We still insert null entries to prevent further compilation attempts.
-  it.module = module;
+    }, progress);
 }
 
-VkShaderModule ShaderCache::GetVertexShaderForUid(const VertexShaderUid& uid)
+VkShaderModule ShaderCache::GetVertexShaderForUid(const VertexShaderUid& uid, bool background)
 {
   vkShaderItem& it = m_vs_cache.shader_map->GetOrAdd(uid);
   if (it.initialized.test_and_set())
     return it.module;
 
-  CompileVertexShaderForUid(uid, it);
+  CompileVertexShaderForUid(uid, it, nullptr, background);
+  if (background)
+  {
+    m_vs_cache.shader_map->ForEachPredicted(uid, PREDICTION_SECONDS,
+      [this](const VertexShaderUid& predicted, vkShaderItem& item) {
+      if (!item.initialized.test_and_set())
+        CompileVertexShaderForUid(predicted, item, nullptr, true);
+    });
+  }
   return it.module;
 }
 
@@ -999,13 +1081,21 @@ VkShaderModule ShaderCache::GetGeometryShaderForUid(const GeometryShaderUid& uid
   return it.module;
 }
 
-VkShaderModule ShaderCache::GetPixelShaderForUid(const PixelShaderUid& uid)
+VkShaderModule ShaderCache::GetPixelShaderForUid(const PixelShaderUid& uid, bool background)
 {
   vkShaderItem& it = m_ps_cache.shader_map->GetOrAdd(uid);
   if (it.initialized.test_and_set())
     return it.module;
 
-  CompilePixelShaderForUid(uid, it);
+  CompilePixelShaderForUid(uid, it, nullptr, background);
+  if (background)
+  {
+    m_ps_cache.shader_map->ForEachPredicted(uid, PREDICTION_SECONDS,
+      [this](const PixelShaderUid& predicted, vkShaderItem& item) {
+      if (!item.initialized.test_and_set())
+        CompilePixelShaderForUid(predicted, item, nullptr, true);
+    });
+  }
   return it.module;
 }
 
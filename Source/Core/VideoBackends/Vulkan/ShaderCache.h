@@ -6,6 +6,7 @@
 
 #include <array>
 #include <cstddef>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -133,9 +134,13 @@ public:
   std::string GetUtilityShaderHeader() const;
 
   // Accesses ShaderGen shader caches
-  VkShaderModule GetVertexShaderForUid(const VertexShaderUid& uid);
+  // In background mode a missing shader is queued to the thread pool, and VK_NULL_HANDLE is
+  // returned until ProcBackgroundCompilationResults has created its module. The shaders that
+  // were first used within PREDICTION_SECONDS after it in the previous sessions are queued too.
+  VkShaderModule GetVertexShaderForUid(const VertexShaderUid& uid, bool background = false);
   VkShaderModule GetGeometryShaderForUid(const GeometryShaderUid& uid);
-  VkShaderModule GetPixelShaderForUid(const PixelShaderUid& uid);
+  VkShaderModule GetPixelShaderForUid(const PixelShaderUid& uid, bool background = false);
+  void ProcBackgroundCompilationResults();
 
   // Ubershader caches
   VkShaderModule GetVertexUberShaderForUid(const UberShader::VertexUberShaderUid& uid);
@@ -213,7 +218,7 @@ private:
   public:
     typedef ObjectUsageProfiler<Uid, pKey_t, vkShaderItem, UidHasher> cache_type;
     std::unique_ptr<cache_type> shader_map{};
-    LinearDiskCache<Uid, u32> disk_cache{};
+    ShaderDiskCache<Uid, u32> disk_cache{};
     ShaderUsageModuleCache() {}
   };
 
@@ -223,7 +228,7 @@ private:
   public:
     typedef std::unordered_map<Uid, vkShaderItem, UidHasher> cache_type;
     cache_type shader_map{};
-    LinearDiskCache<Uid, u32> disk_cache{};
+    ShaderDiskCache<Uid, u32> disk_cache{};
     ShaderModuleCache() {}
   };
 
@@ -240,13 +245,29 @@ private:
   VUShaderCache m_vus_cache;
   PUShaderCache m_pus_cache;
 
-  void CompileVertexShaderForUid(const VertexShaderUid& uid, vkShaderItem& it);
-  void CompileGeometryShaderForUid(const GeometryShaderUid& uid, vkShaderItem& it);
-  void CompilePixelShaderForUid(const PixelShaderUid& uid, vkShaderItem& it);
-  void CompileVertexUberShaderForUid(const UberShader::VertexUberShaderUid& uid, vkShaderItem& it);
-  void CompilePixelUberShaderForUid(const UberShader::PixelUberShaderUid& uid, vkShaderItem& it);
+  class CompileProgress;
+
+  // With a progress, the shader is compiled on the thread pool and the module is created by
+  // AsyncCompiler::WaitForFinish or a later NewUnit. In background mode it is compiled on the
+  // thread pool as well, unless all the units are busy, in which case the item is left
+  // uninitialized to be queued again on its next use. Otherwise it is compiled right away.
+  void CompileShaderForItem(ShaderCompiler::ShaderStage stage, vkShaderItem& it,
+    std::function<void(ShaderCode&)> generate,
+    std::function<void(const ShaderCompiler::SPIRVCodeVector&)> on_created,
+    CompileProgress* progress, bool background = false);
+  void CompileVertexShaderForUid(const VertexShaderUid& uid, vkShaderItem& it, CompileProgress* progress = nullptr, bool background = false);
+  void CompileGeometryShaderForUid(const GeometryShaderUid& uid, vkShaderItem& it, CompileProgress* progress = nullptr);
+  void CompilePixelShaderForUid(const PixelShaderUid& uid, vkShaderItem& it, CompileProgress* progress = nullptr, bool background = false);
+  void CompileVertexUberShaderForUid(const UberShader::VertexUberShaderUid& uid, vkShaderItem& it, CompileProgress* progress = nullptr);
+  void CompilePixelUberShaderForUid(const UberShader::PixelUberShaderUid& uid, vkShaderItem& it, CompileProgress* progress = nullptr);
   
 
+  static constexpr u32 PREDICTION_SECONDS = 3;
+
+  // Time from queuing to module creation of the background compiles
+  double m_background_compile_seconds = 0.0;
+  size_t m_background_compile_count = 0;
+
   std::unordered_map<PipelineInfo, std::pair<VkPipeline, bool>, PipelineInfoHash>
       m_pipeline_objects;
   std::unordered_map<ComputePipelineInfo, VkPipeline, ComputePipelineInfoHash>
@@ -5,6 +5,8 @@
 #include "VideoBackends/Vulkan/ShaderCompiler.h"
 #include "VideoBackends/Vulkan/VulkanContext.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstdlib>
 #include <fstream>
@@ -164,7 +166,7 @@ bool CompileShaderToSPV(SPIRVCodeVector* out_code, EShLanguage stage, const char
   shader->setStringsWithLengths(&pass_source_code, &pass_source_code_length, 1);
 
   auto DumpBadShader = [&](const char* msg) {
-    static int counter = 0;
+    static std::atomic<int> counter{0};
     std::string filename = StringFromFormat(
       "%sbad_%s_%04i.txt", File::GetUserPath(D_DUMP_IDX).c_str(), stage_filename, counter++);
 
@@ -232,7 +234,7 @@ bool CompileShaderToSPV(SPIRVCodeVector* out_code, EShLanguage stage, const char
   // Dump source code of shaders out to file if enabled.
   if (g_ActiveConfig.iLog & CONF_SAVESHADERS)
   {
-    static int counter = 0;
+    static std::atomic<int> counter{0};
     std::string filename = StringFromFormat("%s%s_%04i.txt", File::GetUserPath(D_DUMP_IDX).c_str(),
       stage_filename, counter++);
 
@@ -275,7 +277,7 @@ void CopyGLSLToSPVVector(SPIRVCodeVector* out_code, const char* stage_filename,
 
   if (g_ActiveConfig.iLog & CONF_SAVESHADERS)
   {
-    static int counter = 0;
+    static std::atomic<int> counter{0};
     std::string filename = StringFromFormat("%s%s_%04i.txt", File::GetUserPath(D_DUMP_IDX).c_str(),
       stage_filename, counter++);
 
@@ -295,20 +297,18 @@ void CopyGLSLToSPVVector(SPIRVCodeVector* out_code, const char* stage_filename,
 
 bool InitializeGlslang()
 {
-  static bool glslang_initialized = false;
-  if (glslang_initialized)
-    return true;
-
-  if (!glslang::InitializeProcess())
-  {
-    PanicAlert("Failed to initialize glslang shader compiler");
-    return false;
-  }
-
-  std::atexit([]() { glslang::FinalizeProcess(); });
+  // Shaders are compiled from several threads
+  static const bool glslang_initialized = [] {
+    if (!glslang::InitializeProcess())
+    {
+      PanicAlert("Failed to initialize glslang shader compiler");
+      return false;
+    }
 
-  glslang_initialized = true;
-  return true;
+    std::atexit([]() { glslang::FinalizeProcess(); });
+    return true;
+  }();
+  return glslang_initialized;
 }
 
 const TBuiltInResource* GetCompilerResourceLimits()
@@ -467,5 +467,134 @@ bool CompileComputeShader(SPIRVCodeVector* out_code, const char* source_code,
     COMPUTE_SHADER_HEADER, sizeof(COMPUTE_SHADER_HEADER) - 1);
 }
 
+void CompileUnit::Run()
+{
+  if (GenerateCodeHandler)
+    GenerateCodeHandler(code);
+
+  switch (stage)
+  {
+  case ShaderStage::Vertex:
+    success = CompileVertexShader(&spirv, code.data(), code.size());
+    break;
+  case ShaderStage::Geometry:
+    success = CompileGeometryShader(&spirv, code.data(), code.size());
+    break;
+  case ShaderStage::Fragment:
+    success = CompileFragmentShader(&spirv, code.data(), code.size());
+    break;
+  }
+}
+
+void CompileUnit::Clear()
+{
+  code.clear();
+  spirv.clear();
+  success = false;
+  GenerateCodeHandler = {};
+  ResultHandler = {};
+}
+
+AsyncCompiler::AsyncCompiler()
+    : m_capacity(std::max<size_t>(4 * (Common::ThreadPool::GetThreadCount() + 1), 16)),
+      m_input(m_capacity + 1), m_output(m_capacity + 1)
+{
+  for (size_t i = 0; i < m_capacity; i++)
+  {
+    m_units.push_back(std::make_unique<CompileUnit>());
+    m_repository.push_back(m_units.back().get());
+  }
+  Common::ThreadPool::RegisterWorker(this);
+}
+
+AsyncCompiler::~AsyncCompiler()
+{
+  Common::ThreadPool::UnregisterWorker(this);
+}
+
+AsyncCompiler& AsyncCompiler::GetInstance()
+{
+  // The pool threads may still look at the worker, so it lives as long as the pool
+  static AsyncCompiler instance;
+  return instance;
+}
+
+bool AsyncCompiler::NextTask(size_t ID)
+{
+  CompileUnit* unit = nullptr;
+  if (!m_input.try_pop(unit))
+    return false;
+
+  unit->Run();
+  m_output.push(unit);
+  return true;
+}
+
+CompileUnit* AsyncCompiler::NewUnit()
+{
+  u32 loop_count = 0;
+  while (m_in_progress >= m_capacity)
+  {
+    ProcCompilationResults();
+    if (m_in_progress >= m_capacity)
+      HelpOrYield(&loop_count);
+  }
+  CompileUnit* unit = m_repository.front();
+  m_repository.pop_front();
+  return unit;
+}
+
+CompileUnit* AsyncCompiler::TryNewUnit()
+{
+  ProcCompilationResults();
+  if (m_in_progress >= m_capacity)
+    return nullptr;
+  CompileUnit* unit = m_repository.front();
+  m_repository.pop_front();
+  return unit;
+}
+
+void AsyncCompiler::CompileAsync(CompileUnit* unit)
+{
+  // glslang has to be set up before the workers use it
+  InitializeGlslang();
+  m_in_progress++;
+  m_input.push(unit);
+  Common::ThreadPool::NotifyWorkPending();
+}
+
+void AsyncCompiler::ProcCompilationResults()
+{
+  CompileUnit* unit = nullptr;
+  while (m_output.try_pop(unit))
+  {
+    if (unit->ResultHandler)
+      unit->ResultHandler(unit);
+    unit->Clear();
+    m_repository.push_back(unit);
+    m_in_progress--;
+  }
+}
+
+void AsyncCompiler::WaitForFinish()
+{
+  u32 loop_count = 0;
+  while (m_in_progress > 0)
+  {
+    ProcCompilationResults();
+    if (m_in_progress > 0)
+      HelpOrYield(&loop_count);
+  }
+}
+
+// The owner thread compiles too instead of only waiting for the pool
+void AsyncCompiler::HelpOrYield(u32* loop_count)
+{
+  if (NextTask(0))
+    *loop_count = 0;
+  else
+    Common::cYield((*loop_count)++);
+}
+
 }  // namespace ShaderCompiler
 }  // namespace Vulkan
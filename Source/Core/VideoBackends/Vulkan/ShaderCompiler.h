@@ -5,9 +5,15 @@
 #pragma once
 
 #include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <vector>
 
 #include "Common/CommonTypes.h"
+#include "Common/ThreadPool.h"
+
+#include "VideoCommon/ShaderGenCommon.h"
 
 namespace Vulkan
 {
@@ -33,5 +39,60 @@ bool CompileFragmentShader(SPIRVCodeVector* out_code, const char* source_code,
 bool CompileComputeShader(SPIRVCodeVector* out_code, const char* source_code,
   size_t source_code_length);
 
+enum class ShaderStage
+{
+  Vertex,
+  Geometry,
+  Fragment
+};
+
+// A shader that is generated and compiled to SPIR-V by the worker threads of Common::ThreadPool.
+// The result handler runs on the thread that owns the compiler, for what has to stay there.
+class CompileUnit
+{
+public:
+  ShaderStage stage = ShaderStage::Vertex;
+  ShaderCode code;
+  SPIRVCodeVector spirv;
+  bool success = false;
+  std::function<void(ShaderCode&)> GenerateCodeHandler;
+  std::function<void(CompileUnit*)> ResultHandler;
+  // Generates and compiles the shader on the calling thread
+  void Run();
+  void Clear();
+};
+
+// Generation and compilation fan out over the thread pool, with a bounded number of units in
+// flight. The owner thread runs the result handlers and helps with the compilation while it
+// waits.
+class AsyncCompiler final : Common::IWorker
+{
+public:
+  static AsyncCompiler& GetInstance();
+  ~AsyncCompiler();
+  bool NextTask(size_t ID) override;
+  // Waits for a free unit when all of them are in flight
+  CompileUnit* NewUnit();
+  // Returns nullptr instead of waiting
+  CompileUnit* TryNewUnit();
+  void CompileAsync(CompileUnit* unit);
+  void ProcCompilationResults();
+  void WaitForFinish();
+  size_t GetPendingCount() const { return m_in_progress; }
+
+private:
+  AsyncCompiler();
+  AsyncCompiler(const AsyncCompiler&) = delete;
+  void operator=(const AsyncCompiler&) = delete;
+  void HelpOrYield(u32* loop_count);
+
+  size_t m_capacity;
+  size_t m_in_progress = 0;
+  std::vector<std::unique_ptr<CompileUnit>> m_units;
+  std::deque<CompileUnit*> m_repository;
+  Common::OneToManyQueue<CompileUnit*, Common::CircularQueue<CompileUnit*>> m_input;
+  Common::ManyToOneQueue<CompileUnit*, Common::CircularQueue<CompileUnit*>> m_output;
+};
+
 }  // namespace ShaderCompiler
 }  // namespace Vulkan
@@ -415,17 +415,29 @@ bool StateTracker::CheckForShaderChanges(PrimitiveType gx_primitive_type, u32 co
   bool use_ubershaders = g_ActiveConfig.bDisableSpecializedShaders;
   if (!use_ubershaders)
   {
-    if (vs_uid != m_vs_uid)
+    // In background mode, the ubershaders are used until both specialized shaders are ready.
+    // They are looked up again on each draw until then.
+    const bool background = g_ActiveConfig.bBackgroundShaderCompiling;
+    if (background)
+      g_shader_cache->ProcBackgroundCompilationResults();
+
+    if (vs_uid != m_vs_uid || (background && m_vs == VK_NULL_HANDLE))
     {
-      m_pipeline_state.vs = g_shader_cache->GetVertexShaderForUid(vs_uid);
+      m_vs = g_shader_cache->GetVertexShaderForUid(vs_uid, background);
       m_vs_uid = vs_uid;
-      changed = true;
     }
 
-    if (ps_uid != m_ps_uid)
+    if (ps_uid != m_ps_uid || (background && m_ps == VK_NULL_HANDLE))
     {
-      m_pipeline_state.ps = g_shader_cache->GetPixelShaderForUid(ps_uid);
+      m_ps = g_shader_cache->GetPixelShaderForUid(ps_uid, background);
       m_ps_uid = ps_uid;
+    }
+
+    use_ubershaders = background && (m_vs == VK_NULL_HANDLE || m_ps == VK_NULL_HANDLE);
+    if (!use_ubershaders && (m_pipeline_state.vs != m_vs || m_pipeline_state.ps != m_ps))
+    {
+      m_pipeline_state.vs = m_vs;
+      m_pipeline_state.ps = m_ps;
       changed = true;
     }
   }
@@ -501,6 +513,8 @@ void StateTracker::ClearShaders()
   std::memset(&m_uber_vs_uid, 0xFF, sizeof(m_uber_vs_uid));
   std::memset(&m_uber_ps_uid, 0xFF, sizeof(m_uber_ps_uid));
 
+  m_vs = VK_NULL_HANDLE;
+  m_ps = VK_NULL_HANDLE;
   m_pipeline_state.vs = VK_NULL_HANDLE;
   m_pipeline_state.gs = VK_NULL_HANDLE;
   m_pipeline_state.ps = VK_NULL_HANDLE;
@@ -57,6 +57,7 @@ public:
 
   bool CheckForShaderChanges(PrimitiveType gx_primitive_type, u32 components, PIXEL_SHADER_RENDER_MODE dstalpha_mode);
   void ClearShaders();
+  bool IsUsingUberShaders() const { return m_using_ubershaders; }
 
   void UpdateVertexShaderConstants();
   void UpdateGeometryShaderConstants();
@@ -225,6 +226,9 @@ private:
   UberShader::VertexUberShaderUid m_uber_vs_uid = {};
   UberShader::PixelUberShaderUid m_uber_ps_uid = {};
   bool m_using_ubershaders = false;
+  // Specialized shaders of the uids, VK_NULL_HANDLE while they are compiled in the background
+  VkShaderModule m_vs = VK_NULL_HANDLE;
+  VkShaderModule m_ps = VK_NULL_HANDLE;
 
   // pipeline state
   PipelineInfo m_pipeline_state = {};
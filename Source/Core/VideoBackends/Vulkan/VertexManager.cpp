@@ -184,6 +184,9 @@ void VertexManager::vFlush(bool use_dst_alpha)
   // Execute the draw
   vkCmdDrawIndexed(g_command_buffer_mgr->GetCurrentCommandBuffer(), index_count, 1,
     m_current_draw_base_index, m_current_draw_base_vertex, 0);
+  INCSTAT(stats.thisFrame.numDrawCalls);
+  if (StateTracker::GetInstance()->IsUsingUberShaders())
+    INCSTAT(stats.thisFrame.numUberShaderDraws);
   if (PerfQueryBase::ShouldEmulate())
     static_cast<PerfQuery*>(g_perf_query.get())->EndQuery();
 
@@ -0,0 +1,65 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include "VideoCommon/FrameProfiler.h"
+
+#include <chrono>
+
+namespace FrameProfiler
+{
+using Clock = std::chrono::steady_clock;
+
+bool g_enabled = false;
+
+static StageTimes s_times{};
+static Stage s_current = Stage::None;
+static Clock::time_point s_stage_start;
+
+void SetEnabled(bool enabled)
+{
+  g_enabled = enabled;
+  s_times.fill(0);
+  s_current = Stage::None;
+}
+
+const char* GetStageName(Stage stage)
+{
+  static const char* const names[NUM_STAGES] = {"none", "opcode_decoder", "vertex_loader",
+                                                "texture_decode", "flush"};
+  return names[static_cast<size_t>(stage)];
+}
+
+static void ChargeCurrentStage(Clock::time_point now)
+{
+  if (s_current != Stage::None)
+  {
+    s_times[static_cast<size_t>(s_current)] +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - s_stage_start).count();
+  }
+  s_stage_start = now;
+}
+
+StageTimes TakeFrameTimes()
+{
+  // A stage that is still running is split between both frames
+  ChargeCurrentStage(Clock::now());
+  const StageTimes times = s_times;
+  s_times.fill(0);
+  return times;
+}
+
+Stage EnterStage(Stage stage)
+{
+  ChargeCurrentStage(Clock::now());
+  const Stage previous = s_current;
+  s_current = stage;
+  return previous;
+}
+
+void LeaveStage(Stage previous)
+{
+  ChargeCurrentStage(Clock::now());
+  s_current = previous;
+}
+}
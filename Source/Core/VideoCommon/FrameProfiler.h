@@ -0,0 +1,63 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include "Common/CommonTypes.h"
+
+// Wall time spent in the main stages of GPU emulation, split into frames by the caller.
+// Nested stages are not counted in the stage around them, so a flush while decoding opcodes
+// counts as a flush only. The stages have to run on a single thread, like with the CPU thread
+// disabled.
+namespace FrameProfiler
+{
+enum class Stage
+{
+  None,
+  OpcodeDecoder,
+  VertexLoader,
+  TextureDecode,
+  Flush,
+  Count
+};
+
+constexpr size_t NUM_STAGES = static_cast<size_t>(Stage::Count);
+
+// Nanoseconds spent in each stage
+using StageTimes = std::array<u64, NUM_STAGES>;
+
+extern bool g_enabled;
+
+void SetEnabled(bool enabled);
+const char* GetStageName(Stage stage);
+// Returns the time spent in each stage since the previous call
+StageTimes TakeFrameTimes();
+
+Stage EnterStage(Stage stage);
+void LeaveStage(Stage previous);
+
+class Scope
+{
+public:
+  explicit Scope(Stage stage, bool active = true) : m_active(active && g_enabled)
+  {
+    if (m_active)
+      m_previous = EnterStage(stage);
+  }
+  ~Scope()
+  {
+    if (m_active)
+      LeaveStage(m_previous);
+  }
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+private:
+  bool m_active;
+  Stage m_previous = Stage::None;
+};
+}
@@ -1,52 +1,589 @@
-// Copyright (C) 2003-2009 Dolphin Project.
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
 
-// This program is free software: you can redistribute it and/or modify
-// it under the terms of the GNU General Public License as published by
-// the Free Software Foundation, version 2.0.
+// The output of the vertex loader depends on the vertex format, the matrix indices and the
+// vertex arrays at the time of the draw, which are all outside of the display list. So every
+// recorded draw keeps that state and is only replayed when it still matches, otherwise its
+// vertices are converted again from the display list. The display list itself and the array
+// ranges its draws read are hashed on every call, so changes to emulated RAM invalidate it.
 
-// This program is distributed in the hope that it will be useful,
-// but WITHOUT ANY WARRANTY; without even the implied warranty of
-// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-// GNU General Public License 2.0 for more details.
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
 
-// A copy of the GPL 2.0 should have been included with the program.
-// If not, see http://www.gnu.org/licenses/
+#include "Common/CommonTypes.h"
+#include "Common/Hash.h"
+#include "Common/Swap.h"
+#include "Core/HW/Memmap.h"
+#include "VideoCommon/BPMemory.h"
+#include "VideoCommon/CPMemory.h"
+#include "VideoCommon/DataReader.h"
+#include "VideoCommon/GenericDLCache.h"
+#include "VideoCommon/OpcodeDecoding.h"
+#include "VideoCommon/VertexLoaderManager.h"
+#include "VideoCommon/VertexManagerBase.h"
+#include "VideoCommon/XFMemory.h"
 
-// Official SVN repository and contact information can be found at
-// http://code.google.com/p/dolphin-emu/
+namespace DLCache
+{
+namespace
+{
+// Display lists that were not called for this many frames are dropped
+constexpr u32 MAX_AGE_FRAMES = 300;
+// Upper bound for the recorded vertex data of all display lists
+constexpr size_t MAX_CACHE_SIZE = 64 * 1024 * 1024;
+// Display lists whose vertex arrays keep changing are not recorded more often than this
+constexpr u32 MAX_RECORDINGS = 4;
 
-// TODO: Handle cache-is-full condition :p
+// An indexed vertex array as it was set up when a draw was recorded
+struct ArrayState
+{
+  u32 array;
+  u32 base;
+  u32 stride;
+};
 
+// Memory the vertex loader read through the indexed arrays
+struct MemoryRange
+{
+  u32 address;
+  u32 size;
+  u64 hash;
+};
 
-#include "Common.h"
-#include "DLCache.h"
+struct CachedDraw
+{
+  u32 count;
+  u32 final_count;
+  u32 data_offset;
+  u64 vtx_desc;
+  u32 vat[3];
+  u32 matrix_index_a;
+  u32 matrix_index_b;
+  u32 arrays_begin;
+  u32 arrays_end;
+  // False if the draw was skipped when it was recorded, it is always converted again then
+  bool has_data;
+};
 
-namespace DLCache
+// Either a span of commands that is executed again, or a draw
+struct CachedOp
+{
+  u32 offset;
+  u32 size;
+  s32 draw;
+};
+
+struct CachedDisplayList
+{
+  u64 hash = 0;
+  u32 last_frame = 0;
+  u32 recordings = 0;
+  bool recorded = false;
+  bool uncacheable = false;
+  // Set while the display list is executed, nested calls interpret it instead
+  bool executing = false;
+  std::vector<CachedOp> ops;
+  std::vector<CachedDraw> draws;
+  std::vector<ArrayState> arrays;
+  std::vector<MemoryRange> ranges;
+  std::vector<u8> vertex_data;
+
+  void Reset()
+  {
+    recorded = false;
+    ops.clear();
+    draws.clear();
+    arrays.clear();
+    ranges.clear();
+    vertex_data.clear();
+    vertex_data.shrink_to_fit();
+  }
+};
+
+// An attribute of the raw vertex that is read through an array
+struct IndexedAttribute
+{
+  u32 array;
+  u32 offset;
+  u32 index_size;
+  u32 num_indices;
+  u32 element_size;
+};
+
+// Sizes of the component formats and of the color formats
+const u8 s_format_sizes[8] = {1, 1, 2, 2, 4, 0, 0, 0};
+const u8 s_color_sizes[8] = {2, 3, 4, 2, 3, 4, 0, 0};
+
+std::unordered_map<u64, CachedDisplayList> s_cache;
+size_t s_cache_size;
+u32 s_frame;
+}  // namespace
+
+static u64 GetKey(u32 address, u32 size)
 {
+  return (static_cast<u64>(size) << 32) | address;
+}
+
+// Fills attributes with the indexed attributes of the raw vertex and returns the size of the vertex
+static u32 GetIndexedAttributes(const TVtxDesc& desc, const VAT& vat,
+                                std::vector<IndexedAttribute>* attributes)
+{
+  const u32 tex_elements[8] = {vat.g0.Tex0CoordElements, vat.g1.Tex1CoordElements,
+                               vat.g1.Tex2CoordElements, vat.g1.Tex3CoordElements,
+                               vat.g1.Tex4CoordElements, vat.g2.Tex5CoordElements,
+                               vat.g2.Tex6CoordElements, vat.g2.Tex7CoordElements};
+  const u32 tex_formats[8] = {vat.g0.Tex0CoordFormat, vat.g1.Tex1CoordFormat,
+                              vat.g1.Tex2CoordFormat, vat.g1.Tex3CoordFormat,
+                              vat.g1.Tex4CoordFormat, vat.g2.Tex5CoordFormat,
+                              vat.g2.Tex6CoordFormat, vat.g2.Tex7CoordFormat};
+
+  // The matrix indices come first and are always direct
+  u32 offset = static_cast<u32>(desc.PosMatIdx + desc.Tex0MatIdx + desc.Tex1MatIdx +
+                                desc.Tex2MatIdx + desc.Tex3MatIdx + desc.Tex4MatIdx +
+                                desc.Tex5MatIdx + desc.Tex6MatIdx + desc.Tex7MatIdx);
+  for (u32 array = ARRAY_POSITION; array < ARRAY_TEXCOORD0 + 8; ++array)
+  {
+    const u32 status = desc.GetVertexArrayStatus(array);
+    if (status == NOT_PRESENT)
+      continue;
+
+    u32 element_size;
+    u32 num_indices = 1;
+    if (array == ARRAY_POSITION)
+    {
+      element_size = (vat.g0.PosElements ? 3 : 2) * s_format_sizes[vat.g0.PosFormat];
+    }
+    else if (array == ARRAY_NORMAL)
+    {
+      element_size = (vat.g0.NormalElements ? 9 : 3) * s_format_sizes[vat.g0.NormalFormat];
+      if (vat.g0.NormalElements && vat.g0.NormalIndex3)
+        num_indices = 3;
+    }
+    else if (array == ARRAY_COLOR || array == ARRAY_COLOR2)
+    {
+      element_size = s_color_sizes[array == ARRAY_COLOR ? vat.g0.Color0Comp : vat.g0.Color1Comp];
+    }
+    else
+    {
+      const u32 tex = array - ARRAY_TEXCOORD0;
+      element_size = (tex_elements[tex] ? 2 : 1) * s_format_sizes[tex_formats[tex]];
+    }
+
+    if (status == DIRECT)
+    {
+      offset += element_size;
+    }
+    else
+    {
+      const u32 index_size = status == INDEX8 ? 1 : 2;
+      attributes->push_back({array, offset, index_size, num_indices, element_size});
+      offset += index_size * num_indices;
+    }
+  }
+  return offset;
+}
+
+// Same setup as OpcodeDecoder::Run does for a draw command
+static VertexLoaderParameters GetDrawParameters(u8 cmd_byte, u32 count, u8* source, size_t buf_size)
+{
+  CPState& state = g_main_cp_state;
+  VertexLoaderParameters parameters;
+  parameters.count = count;
+  parameters.buf_size = buf_size;
+  parameters.primitive = (cmd_byte & OpcodeDecoder::GX_PRIMITIVE_MASK) >> OpcodeDecoder::GX_PRIMITIVE_SHIFT;
+  const u32 vtx_attr_group = cmd_byte & OpcodeDecoder::GX_VAT_MASK;
+  parameters.vtx_attr_group = vtx_attr_group;
+  parameters.needloaderrefresh = (state.attr_dirty & (1u << vtx_attr_group)) != 0;
+  parameters.skip_draw = xfmem.viewport.wd == 0.0f || xfmem.viewport.ht == 0.0f ||
+                         (bpmem.scissorBR.x + 1 - bpmem.scissorTL.x) == 0 ||
+                         (bpmem.scissorBR.y + 1 - bpmem.scissorTL.y) == 0;
+  parameters.VtxDesc = &state.vtx_desc;
+  parameters.VtxAttr = &state.vtx_attr[vtx_attr_group];
+  parameters.source = source;
+  state.attr_dirty &= ~(1 << vtx_attr_group);
+  return parameters;
+}
+
+static u32 RunCommands(u8* start, u32 size)
+{
+  u32 cycles = 0;
+  g_VideoData.SetReadPosition(start, start + size);
+  OpcodeDecoder::Run<false, false>(g_VideoData, &cycles);
+  return cycles;
+}
+
+// Converts the vertices of a draw command, returns false if the display list ends inside of it
+static bool ConvertDraw(VertexLoaderParameters& parameters, u32* cycles, u32* readsize, u32* writesize)
+{
+  if (!VertexLoaderManager::ConvertVertices(parameters, *readsize, *writesize))
+    return false;
+  *cycles += OpcodeDecoder::GX_NOP_CYCLES + OpcodeDecoder::GX_DRAW_PRIMITIVES_CYCLES * parameters.count;
+  g_vertex_manager->IncCurrentBufferPointer(*writesize);
+  return true;
+}
+
+// Size of a command that is not a draw, 0 if it doesn't fit into the remaining bytes
+static u32 GetCommandSize(const u8* command, u32 remaining, bool* cacheable)
+{
+  u32 size;
+  switch (command[0])
+  {
+  case OpcodeDecoder::GX_LOAD_CP_REG:
+    size = 1 + OpcodeDecoder::GX_LOAD_CP_REG_SIZE;
+    break;
+  case OpcodeDecoder::GX_LOAD_XF_REG:
+    if (remaining < 1u + OpcodeDecoder::GX_LOAD_XF_REG_SIZE)
+      return 0;
+    size = 1 + OpcodeDecoder::GX_LOAD_XF_REG_SIZE +
+           ((Common::swap32(command + 1) >> 16 & 15) + 1) * sizeof(u32);
+    break;
+  case OpcodeDecoder::GX_LOAD_INDX_A:
+  case OpcodeDecoder::GX_LOAD_INDX_B:
+  case OpcodeDecoder::GX_LOAD_INDX_C:
+  case OpcodeDecoder::GX_LOAD_INDX_D:
+    size = 1 + OpcodeDecoder::GX_LOAD_INDX_SIZE;
+    break;
+  case OpcodeDecoder::GX_LOAD_BP_REG:
+    size = 1 + OpcodeDecoder::GX_LOAD_BP_REG_SIZE;
+    break;
+  case OpcodeDecoder::GX_NOP:
+  case OpcodeDecoder::GX_UNKNOWN_RESET:
+  case OpcodeDecoder::GX_CMD_UNKNOWN_METRICS:
+  case OpcodeDecoder::GX_CMD_INVL_VC:
+    size = 1;
+    break;
+  default:
+    // Nested display lists and unknown opcodes are left to the interpreter
+    *cacheable = false;
+    size = command[0] == OpcodeDecoder::GX_CMD_CALL_DL ? 1 + OpcodeDecoder::GX_CMD_CALL_DL_SIZE : 1;
+    break;
+  }
+  return size <= remaining ? size : 0;
+}
+
+// Adds the array ranges read by the indexed attributes of a recorded draw
+static bool AddArrayRanges(CachedDisplayList& dl, const std::vector<IndexedAttribute>& attributes,
+                           const u8* vertices, u32 count, u32 vertex_size)
+{
+  for (const IndexedAttribute& attribute : attributes)
+  {
+    u32 min_index = UINT32_MAX;
+    u32 max_index = 0;
+    for (u32 i = 0; i < count; ++i)
+    {
+      const u8* vertex = vertices + i * vertex_size;
+      // The vertex loader skips vertices with an invalid position index
+      if (attributes[0].array == ARRAY_POSITION)
+      {
+        const u8* position = vertex + attributes[0].offset;
+        if (attributes[0].index_size == 1 ? position[0] == 0xFF : Common::swap16(position) == 0xFFFF)
+          continue;
+      }
+      for (u32 j = 0; j < attribute.num_indices; ++j)
+      {
+        const u8* index_ptr = vertex + attribute.offset + j * attribute.index_size;
+        const u32 index = attribute.index_size == 1 ? *index_ptr : Common::swap16(index_ptr);
+        min_index = std::min(min_index, index);
+        max_index = std::max(max_index, index);
+      }
+    }
+    if (min_index > max_index)
+      continue;
+
+    const u32 stride = g_main_cp_state.array_strides[attribute.array];
+    const u32 address = g_main_cp_state.array_bases[attribute.array] + min_index * stride;
+    const u32 size = (max_index - min_index) * stride + std::max(stride, attribute.element_size);
+    const u8* ptr = Memory::GetPointer(address);
+    if (!ptr || !Memory::GetPointer(address + size - 1))
+      return false;
+    dl.ranges.push_back({address, size, 0});
+  }
+  return true;
+}
+
+// Merges overlapping array ranges and hashes them
+static void FinalizeArrayRanges(CachedDisplayList& dl)
+{
+  std::sort(dl.ranges.begin(), dl.ranges.end(),
+            [](const MemoryRange& a, const MemoryRange& b) { return a.address < b.address; });
+  std::vector<MemoryRange> merged;
+  for (const MemoryRange& range : dl.ranges)
+  {
+    if (!merged.empty() && range.address <= merged.back().address + merged.back().size)
+    {
+      const u32 end = std::max(merged.back().address + merged.back().size, range.address + range.size);
+      merged.back().size = end - merged.back().address;
+    }
+    else
+    {
+      merged.push_back(range);
+    }
+  }
+  for (MemoryRange& range : merged)
+    range.hash = GetHash64(Memory::GetPointer(range.address), range.size, 0);
+  dl.ranges = std::move(merged);
+}
+
+// Executes the display list like the interpreter does and records it on the way
+static u32 RecordDisplayList(CachedDisplayList& dl, u8* start, u32 size)
+{
+  dl.Reset();
+  dl.recordings++;
+  bool cacheable = true;
+  u32 cycles = 0;
+  u32 span_start = 0;
+  u32 pos = 0;
+  std::vector<IndexedAttribute> attributes;
+
+  auto flush_span = [&]() {
+    if (pos == span_start)
+      return;
+    cycles += RunCommands(start + span_start, pos - span_start);
+    dl.ops.push_back({span_start, pos - span_start, -1});
+  };
+
+  while (pos < size)
+  {
+    const u8 cmd_byte = start[pos];
+    const bool is_draw = (cmd_byte & OpcodeDecoder::GX_DRAW_PRIMITIVES) == 0x80;
+    if (!is_draw || size - pos < 1u + OpcodeDecoder::GX_DRAW_PRIMITIVES_SIZE ||
+        Common::swap16(start + pos + 1) == 0)
+    {
+      u32 command_size = is_draw ? 1 + OpcodeDecoder::GX_DRAW_PRIMITIVES_SIZE :
+                                   GetCommandSize(start + pos, size - pos, &cacheable);
+      if (command_size == 0 || command_size > size - pos)
+      {
+        // Truncated command, the interpreter reads it anyway
+        cacheable = false;
+        command_size = size - pos;
+      }
+      pos += command_size;
+      continue;
+    }
+
+    flush_span();
+    const u32 count = Common::swap16(start + pos + 1);
+    const u32 data_pos = pos + 1 + OpcodeDecoder::GX_DRAW_PRIMITIVES_SIZE;
+    VertexLoaderParameters parameters =
+        GetDrawParameters(cmd_byte, count, start + data_pos, size - data_pos);
+    u32 readsize = 0;
+    u32 writesize = 0;
+    if (!ConvertDraw(parameters, &cycles, &readsize, &writesize))
+    {
+      // The interpreter stops at a draw that doesn't fit into the display list
+      cacheable = false;
+      span_start = pos = size;
+      break;
+    }
+
+    CachedDraw draw;
+    draw.count = count;
+    draw.final_count = 0;
+    draw.data_offset = static_cast<u32>(dl.vertex_data.size());
+    draw.vtx_desc = g_main_cp_state.vtx_desc.Hex;
+    draw.vat[0] = parameters.VtxAttr->g0.Hex;
+    draw.vat[1] = parameters.VtxAttr->g1.Hex;
+    draw.vat[2] = parameters.VtxAttr->g2.Hex;
+    draw.matrix_index_a = g_main_cp_state.matrix_index_a.Hex;
+    draw.matrix_index_b = g_main_cp_state.matrix_index_b.Hex;
+    draw.has_data = !parameters.skip_draw;
+    attributes.clear();
+    const u32 vertex_size = GetIndexedAttributes(g_main_cp_state.vtx_desc, *parameters.VtxAttr, &attributes);
+    if (vertex_size * count != readsize)
+      cacheable = false;
+    draw.arrays_begin = static_cast<u32>(dl.arrays.size());
+    for (const IndexedAttribute& attribute : attributes)
+    {
+      dl.arrays.push_back({attribute.array, g_main_cp_state.array_bases[attribute.array],
+                           g_main_cp_state.array_strides[attribute.array]});
+    }
+    draw.arrays_end = static_cast<u32>(dl.arrays.size());
+    if (draw.has_data && cacheable)
+    {
+      VertexLoaderBase* loader = VertexLoaderManager::GetLoader(parameters);
+      draw.final_count = writesize / loader->m_native_stride;
+      dl.vertex_data.insert(dl.vertex_data.end(), parameters.destination, parameters.destination + writesize);
+      if (!AddArrayRanges(dl, attributes, start + data_pos, count, vertex_size))
+        cacheable = false;
+    }
+    dl.ops.push_back({pos, 0, static_cast<s32>(dl.draws.size())});
+    dl.draws.push_back(draw);
+    span_start = pos = data_pos + readsize;
+  }
+  flush_span();
+
+  if (cacheable)
+  {
+    FinalizeArrayRanges(dl);
+    dl.recorded = true;
+    s_cache_size += dl.vertex_data.size();
+  }
+  else
+  {
+    dl.Reset();
+    dl.uncacheable = true;
+  }
+  return cycles;
+}
+
+static bool DrawStateMatches(const CachedDisplayList& dl, const CachedDraw& draw,
+                             const VertexLoaderParameters& parameters)
+{
+  if (!draw.has_data || parameters.skip_draw || draw.vtx_desc != g_main_cp_state.vtx_desc.Hex ||
+      draw.vat[0] != parameters.VtxAttr->g0.Hex || draw.vat[1] != parameters.VtxAttr->g1.Hex ||
+      draw.vat[2] != parameters.VtxAttr->g2.Hex ||
+      draw.matrix_index_a != g_main_cp_state.matrix_index_a.Hex ||
+      draw.matrix_index_b != g_main_cp_state.matrix_index_b.Hex)
+  {
+    return false;
+  }
+  for (u32 i = draw.arrays_begin; i < draw.arrays_end; ++i)
+  {
+    const ArrayState& array = dl.arrays[i];
+    if (g_main_cp_state.array_bases[array.array] != array.base ||
+        g_main_cp_state.array_strides[array.array] != array.stride)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static u32 ReplayDisplayList(const CachedDisplayList& dl, u8* start, u32 size)
+{
+  u32 cycles = 0;
+  for (const CachedOp& op : dl.ops)
+  {
+    if (op.draw < 0)
+    {
+      cycles += RunCommands(start + op.offset, op.size);
+      continue;
+    }
+
+    const CachedDraw& draw = dl.draws[op.draw];
+    const u8 cmd_byte = start[op.offset];
+    const u32 data_pos = op.offset + 1 + OpcodeDecoder::GX_DRAW_PRIMITIVES_SIZE;
+    VertexLoaderParameters parameters =
+        GetDrawParameters(cmd_byte, draw.count, start + data_pos, size - data_pos);
+    if (DrawStateMatches(dl, draw, parameters))
+    {
+      VertexLoaderBase* loader = VertexLoaderManager::GetLoader(parameters);
+      const u32 writesize = VertexLoaderManager::AddConvertedVertices(
+          loader, parameters.primitive, draw.count, &dl.vertex_data[draw.data_offset], draw.final_count);
+      g_vertex_manager->IncCurrentBufferPointer(writesize);
+      cycles += OpcodeDecoder::GX_NOP_CYCLES + OpcodeDecoder::GX_DRAW_PRIMITIVES_CYCLES * draw.count;
+    }
+    else
+    {
+      // The state outside of the display list changed, the display list itself is still valid
+      u32 readsize = 0;
+      u32 writesize = 0;
+      ConvertDraw(parameters, &cycles, &readsize, &writesize);
+    }
+  }
+  return cycles;
+}
+
+static bool ArrayRangesMatch(const CachedDisplayList& dl)
+{
+  for (const MemoryRange& range : dl.ranges)
+  {
+    if (GetHash64(Memory::GetPointer(range.address), range.size, 0) != range.hash)
+      return false;
+  }
+  return true;
+}
 
 void Init()
 {
+  Clear();
 }
 
 void Shutdown()
 {
+  Clear();
 }
 
-void Clear() 
+void Clear()
 {
+  s_cache.clear();
+  s_cache_size = 0;
+  s_frame = 0;
 }
 
 void ProgressiveCleanup()
 {
+  // Drop everything that wasn't used in the frame that just ended when the cache grows too
+  // large. The sweep runs before the frame counter moves on, so those lists have an age of 0.
+  const u32 max_age = s_cache_size > MAX_CACHE_SIZE ? 0 : MAX_AGE_FRAMES;
+  if (max_age == 0 || (s_frame % 64) == 0)
+  {
+    for (auto iter = s_cache.begin(); iter != s_cache.end();)
+    {
+      if (s_frame - iter->second.last_frame > max_age && !iter->second.executing)
+      {
+        s_cache_size -= iter->second.vertex_data.size();
+        iter = s_cache.erase(iter);
+      }
+      else
+      {
+        ++iter;
+      }
+    }
+  }
+  s_frame++;
 }
-}  // namespace
 
-// NOTE - outside the namespace on purpose.
-bool HandleDisplayList(u32 address, u32 size)
+bool HandleDisplayList(u32 address, u32 size, u32* cycles)
 {
-	return false;
-}
+  u8* start = Memory::GetPointer(address);
+  if (!start || size == 0)
+    return false;
 
-void IncrementCheckContextId()
-{
+  const u64 hash = GetHash64(start, size, 0);
+  CachedDisplayList& dl = s_cache[GetKey(address, size)];
+  dl.last_frame = s_frame;
+  if (dl.executing)
+    return false;
+  if (dl.hash != hash)
+  {
+    // New or overwritten display list, record it when it is called again
+    s_cache_size -= dl.vertex_data.size();
+    dl.Reset();
+    dl.hash = hash;
+    dl.recordings = 0;
+    dl.uncacheable = false;
+    return false;
+  }
+  if (dl.uncacheable)
+    return false;
+
+  u8* old_read_position = g_VideoData.GetReadPosition();
+  u8* old_end = g_VideoData.GetEnd();
+  dl.executing = true;
+  if (dl.recorded && ArrayRangesMatch(dl))
+  {
+    *cycles = ReplayDisplayList(dl, start, size);
+  }
+  else if (dl.recordings < MAX_RECORDINGS)
+  {
+    s_cache_size -= dl.vertex_data.size();
+    *cycles = RecordDisplayList(dl, start, size);
+  }
+  else
+  {
+    // The vertex arrays change between calls, the interpreter is faster then
+    s_cache_size -= dl.vertex_data.size();
+    dl.Reset();
+    dl.uncacheable = true;
+    dl.executing = false;
+    return false;
+  }
+  dl.executing = false;
+  g_VideoData.SetReadPosition(old_read_position, old_end);
+  return true;
 }
+}  // namespace DLCache
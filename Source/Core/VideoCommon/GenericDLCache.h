@@ -0,0 +1,24 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include "Common/CommonTypes.h"
+
+// Caches the converted vertices of display lists, keyed by address, size and content hash.
+// Register loads inside a cached display list are still executed on every call, only the
+// vertex conversion is replaced by a copy of the recorded output.
+namespace DLCache
+{
+void Init();
+void Shutdown();
+void Clear();
+
+// Ages the cache, called once per frame
+void ProgressiveCleanup();
+
+// Executes the display list through the cache.
+// Returns false if it was not executed and has to be interpreted by the caller.
+bool HandleDisplayList(u32 address, u32 size, u32* cycles);
+}  // namespace DLCache
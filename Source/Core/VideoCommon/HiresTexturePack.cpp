@@ -0,0 +1,235 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstring>
+#include <xxhash.h>
+
+#include "Common/Align.h"
+#include "Common/FileUtil.h"
+#include "Common/Logging/Log.h"
+#include "Common/StringUtil.h"
+
+#include "VideoCommon/HiresTexturePack.h"
+#include "VideoCommon/TextureUtil.h"
+
+namespace
+{
+constexpr u32 PACK_MAGIC = 0x31505448;  // "HTP1"
+constexpr u32 PACK_VERSION = 1;
+// Payloads are aligned so the uploads can use aligned copies
+constexpr u64 PAYLOAD_ALIGNMENT = 64;
+constexpr u32 FLAG_EMISSIVE_IN_COLOR = 1;
+
+struct PackHeader
+{
+  u32 magic;
+  u32 version;
+  u32 entry_count;
+  u32 names_size;
+  u64 index_offset;
+  u64 names_offset;
+};
+
+// Larger than any texture the backends accept, so the payload sizes can't overflow
+constexpr u32 MAX_DIMENSION = 1 << 16;
+constexpr u32 MAX_LEVELS = 17;
+
+u64 HashName(const char* name, size_t length)
+{
+  return XXH64(name, length, 0);
+}
+
+// The bytes the texture cache uploads from the payload: the color levels, then the material
+// levels with the same dimensions. Same layout as TextureUtil::GetTextureSizeInBytes, in 64 bits.
+u64 GetPayloadSize(const HiresTexturePack::IndexEntry& entry)
+{
+  const HostTextureFormat format = static_cast<HostTextureFormat>(entry.format);
+  const u64 block_size = TextureUtil::GetTextureSizeInBytes(4, 4, format);
+  u64 size = 0;
+  for (u32 level = 0; level < entry.levels + entry.nrm_levels; level++)
+  {
+    const u32 level_index = level < entry.levels ? level : level - entry.levels;
+    const u64 width = TextureUtil::CalculateLevelSize(entry.width, level_index);
+    const u64 height = TextureUtil::CalculateLevelSize(entry.height, level_index);
+    size += ((width + 3) >> 2) * ((height + 3) >> 2) * block_size;
+  }
+  return size;
+}
+
+bool IsValidEntry(const HiresTexturePack::IndexEntry& entry, u64 file_size, u64 names_size)
+{
+  if (entry.format == PC_TEX_FMT_NONE || entry.format >= PC_TEX_NUM_FORMATS ||
+      entry.width == 0 || entry.width > MAX_DIMENSION || entry.height == 0 ||
+      entry.height > MAX_DIMENSION || entry.levels == 0 || entry.levels > MAX_LEVELS ||
+      entry.nrm_levels > MAX_LEVELS)
+  {
+    return false;
+  }
+  // The material maps are uploaded with as many levels as the color
+  if (entry.nrm_levels != 0 && entry.nrm_levels < entry.levels)
+    return false;
+  return entry.data_offset <= file_size && entry.data_size <= file_size - entry.data_offset &&
+         GetPayloadSize(entry) <= entry.data_size && entry.name_offset <= names_size &&
+         entry.name_length <= names_size - entry.name_offset;
+}
+}  // namespace
+
+std::unique_ptr<HiresTexturePack> HiresTexturePack::Open(const std::string& filename)
+{
+  std::unique_ptr<HiresTexturePack> pack(new HiresTexturePack());
+  if (!pack->m_file.Open(filename) || pack->m_file.GetSize() < sizeof(PackHeader))
+  {
+    ERROR_LOG(VIDEO, "Failed to map custom texture pack %s", filename.c_str());
+    return nullptr;
+  }
+
+  const u64 file_size = pack->m_file.GetSize();
+  PackHeader header;
+  std::memcpy(&header, pack->m_file.GetData(), sizeof(header));
+  if (header.magic != PACK_MAGIC || header.version != PACK_VERSION ||
+      header.index_offset % alignof(IndexEntry) != 0 || header.index_offset > file_size ||
+      u64(header.entry_count) * sizeof(IndexEntry) > file_size - header.index_offset ||
+      header.names_offset > file_size ||
+      header.names_size > file_size - header.names_offset)
+  {
+    ERROR_LOG(VIDEO, "Invalid custom texture pack %s", filename.c_str());
+    return nullptr;
+  }
+  pack->m_entry_count = header.entry_count;
+  pack->m_index_offset = header.index_offset;
+  pack->m_names_offset = header.names_offset;
+
+  // Validate the index once, so lookups and uploads don't have to
+  const IndexEntry* index = pack->GetIndex();
+  for (size_t i = 0; i < pack->m_entry_count; i++)
+  {
+    if (!IsValidEntry(index[i], file_size, header.names_size))
+    {
+      ERROR_LOG(VIDEO, "Corrupted custom texture pack %s", filename.c_str());
+      return nullptr;
+    }
+  }
+  return pack;
+}
+
+const HiresTexturePack::IndexEntry* HiresTexturePack::GetIndex() const
+{
+  return reinterpret_cast<const IndexEntry*>(m_file.GetData() + m_index_offset);
+}
+
+size_t HiresTexturePack::GetEntryCount() const
+{
+  return m_entry_count;
+}
+
+std::string HiresTexturePack::GetName(size_t index) const
+{
+  const IndexEntry& entry = GetIndex()[index];
+  const u8* name = m_file.GetData() + m_names_offset + entry.name_offset;
+  return std::string(reinterpret_cast<const char*>(name), entry.name_length);
+}
+
+bool HiresTexturePack::Find(const std::string& name, Entry* entry) const
+{
+  const u64 hash = HashName(name.data(), name.size());
+  const IndexEntry* begin = GetIndex();
+  const IndexEntry* end = begin + m_entry_count;
+  const IndexEntry* iter = std::lower_bound(
+      begin, end, hash, [](const IndexEntry& e, u64 value) { return e.name_hash < value; });
+  // Entries with the same hash are adjacent, compare the names to resolve collisions
+  for (; iter != end && iter->name_hash == hash; ++iter)
+  {
+    if (iter->name_length != name.size() ||
+        std::memcmp(m_file.GetData() + m_names_offset + iter->name_offset, name.data(),
+                    name.size()) != 0)
+    {
+      continue;
+    }
+    entry->data = m_file.GetData() + iter->data_offset;
+    entry->size = static_cast<size_t>(iter->data_size);
+    entry->width = iter->width;
+    entry->height = iter->height;
+    entry->levels = iter->levels;
+    entry->nrm_levels = iter->nrm_levels;
+    entry->format = static_cast<HostTextureFormat>(iter->format);
+    entry->emissive_in_color = (iter->flags & FLAG_EMISSIVE_IN_COLOR) != 0;
+    return true;
+  }
+  return false;
+}
+
+HiresTexturePack::Writer::Writer(const std::string& filename)
+    : m_filename(filename), m_temp_filename(filename + ".tmp")
+{
+  File::CreateFullPath(m_filename);
+  m_file.Open(m_temp_filename, "wb");
+  // The header is written last, when the offsets are known
+  PackHeader header = {};
+  m_file.WriteArray(&header, 1);
+}
+
+HiresTexturePack::Writer::~Writer()
+{
+  if (m_file.IsOpen())
+  {
+    m_file.Close();
+    File::Delete(m_temp_filename);
+  }
+}
+
+bool HiresTexturePack::Writer::Add(const std::string& name, const Entry& entry)
+{
+  if (!m_file.IsOpen())
+    return false;
+
+  const u64 offset = Common::AlignUp(m_file.Tell(), PAYLOAD_ALIGNMENT);
+  if (!m_file.Seek(offset, SEEK_SET) || !m_file.WriteBytes(entry.data, entry.size))
+    return false;
+
+  IndexEntry index_entry;
+  index_entry.name_hash = HashName(name.data(), name.size());
+  index_entry.data_offset = offset;
+  index_entry.data_size = entry.size;
+  index_entry.name_offset = static_cast<u32>(m_names.size());
+  index_entry.name_length = static_cast<u32>(name.size());
+  index_entry.width = entry.width;
+  index_entry.height = entry.height;
+  index_entry.levels = entry.levels;
+  index_entry.nrm_levels = entry.nrm_levels;
+  index_entry.format = entry.format;
+  index_entry.flags = entry.emissive_in_color ? FLAG_EMISSIVE_IN_COLOR : 0;
+  m_entries.push_back(index_entry);
+  m_names += name;
+  return true;
+}
+
+bool HiresTexturePack::Writer::Finish()
+{
+  if (!m_file.IsOpen())
+    return false;
+
+  std::sort(m_entries.begin(), m_entries.end(),
+            [](const IndexEntry& a, const IndexEntry& b) { return a.name_hash < b.name_hash; });
+
+  PackHeader header;
+  header.magic = PACK_MAGIC;
+  header.version = PACK_VERSION;
+  header.entry_count = static_cast<u32>(m_entries.size());
+  header.names_size = static_cast<u32>(m_names.size());
+  header.index_offset = Common::AlignUp(m_file.Tell(), PAYLOAD_ALIGNMENT);
+  header.names_offset = header.index_offset + m_entries.size() * sizeof(IndexEntry);
+  bool success = m_file.Seek(header.index_offset, SEEK_SET) &&
+                 m_file.WriteArray(m_entries.data(), m_entries.size()) &&
+                 m_file.WriteBytes(m_names.data(), m_names.size()) &&
+                 m_file.Seek(0, SEEK_SET) && m_file.WriteArray(&header, 1);
+  m_file.Close();
+  if (!success || !File::Rename(m_temp_filename, m_filename))
+  {
+    ERROR_LOG(VIDEO, "Failed to write custom texture pack %s", m_filename.c_str());
+    File::Delete(m_temp_filename);
+    return false;
+  }
+  return true;
+}
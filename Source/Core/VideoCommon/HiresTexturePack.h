@@ -0,0 +1,85 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/File.h"
+#include "VideoCommon/TextureDecoder.h"
+
+// Custom textures packed in a single file, so a game doesn't have to open thousands of
+// images on boot. The payloads are stored already decoded (RGBA or the BCn blocks of the
+// dds files) in the layout HiresTexture uses for its cached data, followed by an index
+// sorted by name hash. The file is memory mapped and the payloads are uploaded straight
+// from the mapping.
+class HiresTexturePack
+{
+public:
+  // On disk layout of the index
+  struct IndexEntry
+  {
+    u64 name_hash;
+    u64 data_offset;
+    u64 data_size;
+    u32 name_offset;
+    u32 name_length;
+    u32 width;
+    u32 height;
+    u32 levels;
+    u32 nrm_levels;
+    u32 format;
+    u32 flags;
+  };
+
+  struct Entry
+  {
+    const u8* data;
+    size_t size;
+    u32 width;
+    u32 height;
+    u32 levels;
+    u32 nrm_levels;
+    HostTextureFormat format;
+    bool emissive_in_color;
+  };
+
+  // Fails if any payload is smaller than the levels the texture cache uploads from it
+  static std::unique_ptr<HiresTexturePack> Open(const std::string& filename);
+
+  // Binary search of the index, the returned data stays valid as long as the pack is open
+  bool Find(const std::string& name, Entry* entry) const;
+  size_t GetEntryCount() const;
+  std::string GetName(size_t index) const;
+
+  // Streams the payloads to a temporary file and moves it in place when finished
+  class Writer
+  {
+  public:
+    explicit Writer(const std::string& filename);
+    ~Writer();
+
+    bool Add(const std::string& name, const Entry& entry);
+    bool Finish();
+
+  private:
+    std::string m_filename;
+    std::string m_temp_filename;
+    File::IOFile m_file;
+    std::vector<IndexEntry> m_entries;
+    std::string m_names;
+  };
+
+private:
+  HiresTexturePack() = default;
+  const IndexEntry* GetIndex() const;
+
+  File::MappedFile m_file;
+  size_t m_entry_count = 0;
+  u64 m_index_offset = 0;
+  u64 m_names_offset = 0;
+};
@@ -3,12 +3,15 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cinttypes>
 #include <cstring>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include <xxhash.h>
@@ -32,6 +35,7 @@
 
 #include "VideoCommon/ImageLoader.h"
 #include "VideoCommon/HiresTextures.h"
+#include "VideoCommon/HiresTexturePack.h"
 #include "VideoCommon/OnScreenDisplay.h"
 #include "VideoCommon/TextureUtil.h"
 #include "VideoCommon/VideoConfig.h"
@@ -79,25 +83,96 @@ struct HiresTextureCacheItem
 
 typedef std::unordered_map<std::string, HiresTextureCacheItem> HiresTextureCache;
 static HiresTextureCache s_textureMap;
+// When a game has a texture pack its texture directory is not scanned
+static std::shared_ptr<HiresTexturePack> s_texturePack;
 
-static std::unordered_map<std::string, std::shared_ptr<HiresTexture>> s_textureCache;
-static std::mutex s_textureCacheMutex;
+// The cache is split into shards with their own lock, so the prefetch workers and
+// the texture cache rarely wait on each other
+struct HiresTextureCacheShard
+{
+  std::mutex lock;
+  std::unordered_map<std::string, std::shared_ptr<HiresTexture>> textures;
+};
+static const size_t TEXTURE_CACHE_SHARDS = 16;
+static std::array<HiresTextureCacheShard, TEXTURE_CACHE_SHARDS> s_textureCache;
 static Common::Flag s_textureCacheAbortLoading;
 
+// Textures found during the session, in the order they were first used.
+// They are saved per game and prefetched first in the next session.
+static std::mutex s_usedTexturesMutex;
+static std::vector<std::string> s_usedTextures;
+static std::unordered_set<std::string> s_usedTexturesSet;
+static std::string s_usedTexturesGameId;
+
 static bool s_check_native_format;
 static bool s_check_new_format;
 static std::atomic<size_t> size_sum;
 static size_t max_mem = 0;
 static std::thread s_prefetcher;
+static Common::Flag s_build_pack_requested;
 
 static const std::string s_format_prefix = "tex1_";
+
+static HiresTextureCacheShard& GetCacheShard(const std::string& basename)
+{
+  return s_textureCache[std::hash<std::string>()(basename) % TEXTURE_CACHE_SHARDS];
+}
+
+static void ClearTextureCache()
+{
+  for (HiresTextureCacheShard& shard : s_textureCache)
+  {
+    std::lock_guard<std::mutex> lk(shard.lock);
+    shard.textures.clear();
+  }
+}
+
+static std::string GetUsedTexturesFileName(const std::string& game_id)
+{
+  return File::GetUserPath(D_CACHE_IDX) + HIRESTEXTURES_USAGE_DIR DIR_SEP + game_id + ".txt";
+}
+
+static void MarkTextureUsed(const std::string& basename)
+{
+  std::lock_guard<std::mutex> lk(s_usedTexturesMutex);
+  if (s_usedTexturesSet.insert(basename).second)
+    s_usedTextures.push_back(basename);
+}
+
+static void SaveUsedTextures()
+{
+  std::lock_guard<std::mutex> lk(s_usedTexturesMutex);
+  if (!s_usedTexturesGameId.empty() && !s_usedTextures.empty())
+  {
+    std::string filename = GetUsedTexturesFileName(s_usedTexturesGameId);
+    File::CreateFullPath(filename);
+    std::string contents;
+    for (const std::string& name : s_usedTextures)
+      contents += name + "\n";
+    File::WriteStringToFile(contents, filename);
+  }
+  s_usedTextures.clear();
+  s_usedTexturesSet.clear();
+  s_usedTexturesGameId.clear();
+}
+
+static std::vector<std::string> LoadUsedTextures(const std::string& game_id)
+{
+  std::string contents;
+  std::vector<std::string> names;
+  if (File::ReadFileToString(GetUsedTexturesFileName(game_id), contents))
+    names = SplitString(contents, '\n');
+  return names;
+}
+
 HiresTexture::HiresTexture() :
   m_format(PC_TEX_FMT_NONE),
   m_height(0),
   m_levels(0),
   m_nrm_levels(0),
   m_cached_data(nullptr),
-  m_cached_data_size(0)
+  m_cached_data_size(0),
+  m_pack_data(nullptr)
 {}
 
 void HiresTexture::Init()
@@ -117,9 +192,12 @@ void HiresTexture::Shutdown()
     s_textureCacheAbortLoading.Set();
     s_prefetcher.join();
   }
+  s_build_pack_requested.Clear();
 
+  SaveUsedTextures();
   s_textureMap.clear();
-  s_textureCache.clear();
+  s_texturePack.reset();
+  ClearTextureCache();
 }
 
 std::string HiresTexture::GetTextureDirectory(const std::string& game_id)
@@ -133,6 +211,17 @@ std::string HiresTexture::GetTextureDirectory(const std::string& game_id)
   return texture_directory;
 }
 
+std::string HiresTexture::GetTexturePackFile(const std::string& game_id)
+{
+  const std::string pack_file = File::GetUserPath(D_HIRESTEXTURES_IDX) + game_id + ".htp";
+
+  // Same as the directories, fall back to a region-free pack
+  if (!File::Exists(pack_file))
+    return File::GetUserPath(D_HIRESTEXTURES_IDX) + game_id.substr(0, 3) + ".htp";
+
+  return pack_file;
+}
+
 void HiresTexture::Update()
 {
   s_check_native_format = false;
@@ -144,22 +233,48 @@ void HiresTexture::Update()
     s_prefetcher.join();
   }
 
+  SaveUsedTextures();
+  s_texturePack.reset();
   if (!g_ActiveConfig.bHiresTextures)
   {
     s_textureMap.clear();
-    s_textureCache.clear();
+    ClearTextureCache();
     size_sum.store(0);
     return;
   }
 
   if (!g_ActiveConfig.bCacheHiresTextures)
   {
-    s_textureCache.clear();
+    ClearTextureCache();
     size_sum.store(0);
   }
 
   s_textureMap.clear();
   const std::string& game_id = SConfig::GetInstance().GetGameID();
+  s_usedTexturesGameId = game_id;
+
+  const std::string pack_file = GetTexturePackFile(game_id);
+  if (File::Exists(pack_file))
+  {
+    s_texturePack = HiresTexturePack::Open(pack_file);
+    if (s_texturePack)
+    {
+      for (size_t i = 0; i < s_texturePack->GetEntryCount(); i++)
+      {
+        const std::string name = s_texturePack->GetName(i);
+        if (name.compare(0, s_format_prefix.length(), s_format_prefix) == 0)
+          s_check_new_format = true;
+        else
+          s_check_native_format = true;
+      }
+      // Everything is already decoded and mapped, nothing to scan or prefetch
+      ClearTextureCache();
+      size_sum.store(0);
+      OSD::AddMessage(StringFromFormat("Custom Texture Pack loaded, %zu textures", s_texturePack->GetEntryCount()), 5000);
+      return;
+    }
+  }
+
   const std::string texture_directory = GetTextureDirectory(game_id);
 
   std::string ddscode(".dds");
@@ -260,17 +375,21 @@ void HiresTexture::Update()
   if (g_ActiveConfig.bCacheHiresTextures && s_textureMap.size() > 0)
   {
     // remove cached but deleted textures
-    auto iter = s_textureCache.begin();
-    while (iter != s_textureCache.end())
+    for (HiresTextureCacheShard& shard : s_textureCache)
     {
-      if (s_textureMap.find(iter->first) == s_textureMap.end())
+      std::lock_guard<std::mutex> lk(shard.lock);
+      auto iter = shard.textures.begin();
+      while (iter != shard.textures.end())
       {
-        size_sum.fetch_sub(iter->second->m_cached_data_size);
-        iter = s_textureCache.erase(iter);
-      }
-      else
-      {
-        iter++;
+        if (s_textureMap.find(iter->first) == s_textureMap.end())
+        {
+          size_sum.fetch_sub(iter->second->m_cached_data_size);
+          iter = shard.textures.erase(iter);
+        }
+        else
+        {
+          iter++;
+        }
       }
     }
     s_textureCacheAbortLoading.Clear();
@@ -283,43 +402,171 @@ void HiresTexture::Prefetch()
   Common::SetCurrentThreadName("Prefetcher");
 
   u32 starttime = Common::Timer::GetTimeMs();
+  const size_t start_size = size_sum.load();
+
+  // Textures used in the last session come first, they are the ones needed right after boot
+  std::vector<const std::string*> queue;
+  queue.reserve(s_textureMap.size());
+  std::unordered_set<std::string> queued;
+  for (const std::string& name : LoadUsedTextures(s_usedTexturesGameId))
+  {
+    auto iter = s_textureMap.find(name);
+    if (iter != s_textureMap.end() && queued.insert(name).second)
+      queue.push_back(&iter->first);
+  }
   for (const auto& entry : s_textureMap)
   {
-    const std::string& base_filename = entry.first;
-
-    std::unique_lock<std::mutex> lk(s_textureCacheMutex);
+    if (queued.find(entry.first) == queued.end())
+      queue.push_back(&entry.first);
+  }
 
-    auto iter = s_textureCache.find(base_filename);
-    if (iter == s_textureCache.end())
+  std::atomic<size_t> next_texture{0};
+  Common::Flag out_of_memory;
+  auto worker = [&]() {
+    Common::SetCurrentThreadName("Prefetch Worker");
+    while (!s_textureCacheAbortLoading.IsSet() && !out_of_memory.IsSet())
     {
-      lk.unlock();
-      HiresTexture* ptr = Load(base_filename, [](size_t requested_size)
+      size_t index = next_texture.fetch_add(1);
+      if (index >= queue.size())
+        return;
+      const std::string& base_filename = *queue[index];
+      HiresTextureCacheShard& shard = GetCacheShard(base_filename);
+      {
+        std::lock_guard<std::mutex> lk(shard.lock);
+        if (shard.textures.find(base_filename) != shard.textures.end())
+          continue;
+      }
+
+      std::shared_ptr<HiresTexture> ptr(Load(base_filename, [](size_t requested_size)
       {
         return new u8[requested_size];
-      }, true);
-      lk.lock();
-      if (ptr != nullptr)
+      }, true));
+      if (!ptr)
+        continue;
+
+      std::lock_guard<std::mutex> lk(shard.lock);
+      // Search may have loaded it in the meantime
+      if (shard.textures.emplace(base_filename, ptr).second &&
+        size_sum.fetch_add(ptr->m_cached_data_size) + ptr->m_cached_data_size > max_mem)
       {
-        size_sum.fetch_add(ptr->m_cached_data_size);
-        iter = s_textureCache.insert(iter, std::make_pair(base_filename, std::shared_ptr<HiresTexture>(ptr)));
+        out_of_memory.Set();
       }
     }
+  };
+
+  // The decoders are mostly cpu bound, leave one core to the emulation
+  size_t num_workers = std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1;
+  num_workers = std::min(num_workers, std::max<size_t>(queue.size(), 1));
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < num_workers; i++)
+    workers.emplace_back(worker);
+  worker();
+  for (std::thread& thread : workers)
+    thread.join();
+
+  if (s_textureCacheAbortLoading.IsSet())
+  {
+    return;
+  }
+
+  if (out_of_memory.IsSet())
+  {
+    Config::SetCurrent(Config::GFX_HIRES_TEXTURES, false);
+
+    OSD::AddMessage(StringFromFormat("Custom Textures prefetching after %.1f MB aborted, not enough RAM available", size_sum / (1024.0 * 1024.0)), 10000);
+    return;
+  }
+  u32 stoptime = Common::Timer::GetTimeMs();
+  double seconds = std::max<u32>(stoptime - starttime, 1) / 1000.0;
+  double loaded_mb = (size_sum.load() - start_size) / (1024.0 * 1024.0);
+  OSD::AddMessage(StringFromFormat("Custom Textures loaded, %.1f MB in %.1f s (%.1f MB/s, %zu threads)",
+    size_sum / (1024.0 * 1024.0), seconds, loaded_mb / seconds, num_workers), 10000);
+}
+
+void HiresTexture::BuildPack()
+{
+  s_build_pack_requested.Set();
+}
+
+// The prefetcher and the texture map belong to the GPU thread
+void HiresTexture::ProcessPackRequest()
+{
+  if (!s_build_pack_requested.TestAndClear())
+    return;
+
+  if (s_prefetcher.joinable())
+  {
+    s_textureCacheAbortLoading.Set();
+    s_prefetcher.join();
+  }
+  if (s_textureMap.empty())
+  {
+    OSD::AddMessage("No loose custom textures to pack", 5000);
+    return;
+  }
+  s_textureCacheAbortLoading.Clear();
+  std::string filename = GetTextureDirectory(SConfig::GetInstance().GetGameID()) + ".htp";
+  std::vector<std::string> names;
+  names.reserve(s_textureMap.size());
+  for (const auto& item : s_textureMap)
+    names.push_back(item.first);
+  s_prefetcher = std::thread(WritePack, filename, std::move(names));
+}
+
+void HiresTexture::WritePack(const std::string& filename, const std::vector<std::string>& names)
+{
+  Common::SetCurrentThreadName("Texture Pack Writer");
 
+  u32 starttime = Common::Timer::GetTimeMs();
+  size_t packed_size = 0;
+  HiresTexturePack::Writer writer(filename);
+  for (const std::string& name : names)
+  {
     if (s_textureCacheAbortLoading.IsSet())
-    {
       return;
-    }
 
-    if (size_sum.load() > max_mem)
+    std::unique_ptr<HiresTexture> texture(Load(name, [](size_t requested_size)
     {
-      Config::SetCurrent(Config::GFX_HIRES_TEXTURES, false);
+      return new u8[requested_size];
+    }, true));
+    if (!texture)
+      continue;
 
-      OSD::AddMessage(StringFromFormat("Custom Textures prefetching after %.1f MB aborted, not enough RAM available", size_sum / (1024.0 * 1024.0)), 10000);
+    // Only store what the texture cache uploads, the load buffer is allocated for the worst case
+    HiresTexturePack::Entry entry;
+    entry.size = 0;
+    for (u32 level = 0; level < texture->m_levels + texture->m_nrm_levels; level++)
+    {
+      u32 level_index = level < texture->m_levels ? level : level - texture->m_levels;
+      entry.size += TextureUtil::GetTextureSizeInBytes(
+        TextureUtil::CalculateLevelSize(texture->m_width, level_index),
+        TextureUtil::CalculateLevelSize(texture->m_height, level_index), texture->m_format);
+    }
+    if (entry.size > texture->m_cached_data_size)
+    {
+      ERROR_LOG(VIDEO, "Custom texture %s has an invalid size, not packed", name.c_str());
+      continue;
+    }
+    entry.data = texture->m_cached_data.get();
+    entry.width = texture->m_width;
+    entry.height = texture->m_height;
+    entry.levels = texture->m_levels;
+    entry.nrm_levels = texture->m_nrm_levels;
+    entry.format = texture->m_format;
+    entry.emissive_in_color = texture->emissive_in_color;
+    if (!writer.Add(name, entry))
+    {
+      OSD::AddMessage(StringFromFormat("Failed to write custom texture pack %s", filename.c_str()), 10000);
       return;
     }
+    packed_size += entry.size;
+  }
+  if (writer.Finish())
+  {
+    u32 stoptime = Common::Timer::GetTimeMs();
+    OSD::AddMessage(StringFromFormat("Custom Texture Pack %s written, %.1f MB in %.1f s. It is used instead of the texture directory from the next boot.",
+      filename.c_str(), packed_size / (1024.0 * 1024.0), (stoptime - starttime) / 1000.0), 10000);
   }
-  u32 stoptime = Common::Timer::GetTimeMs();
-  OSD::AddMessage(StringFromFormat("Custom Textures loaded, %.1f MB in %.1f s", size_sum / (1024.0 * 1024.0), (stoptime - starttime) / 1000.0), 10000);
 }
 
 std::string HiresTexture::GenBaseName(
@@ -612,16 +859,35 @@ std::shared_ptr<HiresTexture> HiresTexture::Search(
   const std::string& basename,
   std::function<u8*(size_t)> request_buffer_delegate)
 {
+  if (s_texturePack)
+  {
+    HiresTexturePack::Entry entry;
+    if (!s_texturePack->Find(basename, &entry))
+      return nullptr;
+    std::shared_ptr<HiresTexture> ptr(new HiresTexture());
+    ptr->m_pack = s_texturePack;
+    ptr->m_pack_data = entry.data;
+    ptr->m_format = entry.format;
+    ptr->m_width = entry.width;
+    ptr->m_height = entry.height;
+    ptr->m_levels = entry.levels;
+    ptr->m_nrm_levels = entry.nrm_levels;
+    ptr->emissive_in_color = entry.emissive_in_color;
+    MarkTextureUsed(basename);
+    return ptr;
+  }
   if (g_ActiveConfig.bCacheHiresTextures)
   {
-    std::unique_lock<std::mutex> lk(s_textureCacheMutex);
+    HiresTextureCacheShard& shard = GetCacheShard(basename);
+    std::unique_lock<std::mutex> lk(shard.lock);
 
-    auto iter = s_textureCache.find(basename);
-    if (iter != s_textureCache.end())
+    auto iter = shard.textures.find(basename);
+    if (iter != shard.textures.end())
     {
       HiresTexture* current = iter->second.get();
       u8* dst = request_buffer_delegate(current->m_cached_data_size);
       memcpy(dst, current->m_cached_data.get(), current->m_cached_data_size);
+      MarkTextureUsed(basename);
       return iter->second;
     }
     lk.unlock();
@@ -634,16 +900,24 @@ std::shared_ptr<HiresTexture> HiresTexture::Search(
       lk.lock();
       if (ptr)
       {
-        s_textureCache[basename] = ptr;
+        // A prefetch worker may have loaded it in the meantime
+        auto inserted = shard.textures.emplace(basename, ptr);
+        if (inserted.second)
+          size_sum.fetch_add(ptr->m_cached_data_size);
+        else
+          ptr = inserted.first->second;
         HiresTexture* current = ptr.get();
-        size_sum.fetch_add(current->m_cached_data_size);
         u8* dst = request_buffer_delegate(current->m_cached_data_size);
         memcpy(dst, current->m_cached_data.get(), current->m_cached_data_size);
+        MarkTextureUsed(basename);
       }
       return ptr;
     }
   }
-  return std::shared_ptr<HiresTexture>(Load(basename, request_buffer_delegate, false));
+  std::shared_ptr<HiresTexture> ptr(Load(basename, request_buffer_delegate, false));
+  if (ptr)
+    MarkTextureUsed(basename);
+  return ptr;
 }
 
 HiresTexture* HiresTexture::Load(const std::string& basename,
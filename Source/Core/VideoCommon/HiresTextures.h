@@ -5,18 +5,26 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include "VideoCommon/TextureDecoder.h"
 #include "VideoCommon/VideoCommon.h"
 
+class HiresTexturePack;
+
 class HiresTexture
 {
 public:
   static void Init();
   static void Update();
   static void Shutdown();
+  // Asks for the loose custom textures of the running game to be written to a texture pack.
+  // Can be called from any thread, the GPU thread starts writing it at the end of the frame.
+  static void BuildPack();
+  // Called by the texture cache on the GPU thread, once per frame
+  static void ProcessPackRequest();
 
   static std::shared_ptr<HiresTexture> Search(const std::string& basename,
     std::function<u8*(size_t)> request_buffer_delegate
@@ -37,10 +45,16 @@ public:
   bool emissive_in_color;
   std::unique_ptr<u8> m_cached_data;
   size_t m_cached_data_size;
+  // Set for textures served from a texture pack, the data has to be uploaded from here
+  // instead of the buffer given to Search
+  const u8* m_pack_data;
 private:
   static HiresTexture* Load(const std::string& base_filename,
     std::function<u8*(size_t)> request_buffer_delegate, bool cacheresult);
   static void Prefetch();
+  static void WritePack(const std::string& filename, const std::vector<std::string>& names);
+  static std::string GetTexturePackFile(const std::string& game_id);
+  std::shared_ptr<HiresTexturePack> m_pack;
   HiresTexture();
   static std::string GetTextureDirectory(const std::string& game_id);
 };
\ No newline at end of file
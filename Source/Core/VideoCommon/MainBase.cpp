@@ -16,6 +16,7 @@
 #include "VideoCommon/CPMemory.h"
 #include "VideoCommon/CommandProcessor.h"
 #include "VideoCommon/Fifo.h"
+#include "VideoCommon/GenericDLCache.h"
 #include "VideoCommon/GeometryShaderManager.h"
 #include "VideoCommon/TessellationShaderManager.h"
 #include "VideoCommon/IndexGenerator.h"
@@ -213,6 +214,7 @@ void VideoBackendBase::InitializeShared()
   PixelEngine::Init();
   BPInit();
   VertexLoaderManager::Init();
+  DLCache::Init();
   IndexGenerator::Init();
   VertexShaderManager::Init();
   GeometryShaderManager::Init();
@@ -242,6 +244,7 @@ void VideoBackendBase::ShutdownShared()
 
 void VideoBackendBase::CleanupShared()
 {
+  DLCache::Shutdown();
   VertexLoaderManager::Shutdown();
 }
 
@@ -31,6 +31,8 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 #include <algorithm>
+#include <chrono>
+#include <climits>
 #include <fstream>
 #include <functional>
 #include <map>
@@ -38,11 +40,17 @@
 #include <unordered_map>
 #include <vector>
 
+#include "Common/CommonTypes.h"
 #include "Common/FileUtil.h"
 #include "Common/StringUtil.h"
 
 typedef uint64_t pKey_t;
 
+// Besides the usage counts, the profile of a game records when each object was first used in the
+// last session it was used in: its scene is the second of the session, and its order the rank of
+// its first use. In the next sessions, the first use of an object predicts the objects of its
+// scene and of the following seconds, so they can be prepared before they are needed.
+
 template <typename Tobj, typename TCaterogry, typename TInfo, typename TobjHasher> class ObjectUsageProfiler
 {
 public:
@@ -80,6 +88,10 @@ public:
     {
       item.usage_count++;
     }
+    if (m_session_started && !item.used_in_session)
+    {
+      RecordFirstUse(item);
+    }
     if (m_categories.size() <= 1)
     {
       return item.info;
@@ -123,6 +135,7 @@ public:
     m_max_category_index = 0;
     m_category_mask = 0;
     m_version = 0;
+    ClearSession();
   }
 
   void Clear(const std::function<void(const Tobj&, TInfo&)>& eachfunc = {})
@@ -141,6 +154,7 @@ public:
     m_max_category_index = 0;
     m_category_mask = 0;
     m_version = 0;
+    ClearSession();
   }
 
   const TInfo* GetInfoIfexists(const Tobj& obj) const
@@ -217,6 +231,70 @@ public:
     }
   }
 
+  // Starts recording the first uses, call once the objects used at startup are prepared
+  void BeginSession()
+  {
+    ClearSession();
+    for (auto& item : m_objects)
+    {
+      item.second.last_scene = item.second.scene;
+      if (item.second.scene != NO_SCENE)
+      {
+        m_scenes[item.second.scene].objects.push_back(&item);
+      }
+    }
+    for (auto& scene : m_scenes)
+    {
+      std::sort(scene.second.objects.begin(), scene.second.objects.end(),
+        [](const std::pair<const Tobj, ObjectMetadata>* a, const std::pair<const Tobj, ObjectMetadata>* b) {
+        return a->second.order < b->second.order;
+      });
+    }
+    m_session_start = std::chrono::steady_clock::now();
+    m_session_started = true;
+  }
+
+  // Calls func for the objects of the recorded scenes from the one of obj to horizon seconds
+  // later that are neither used nor predicted yet in this session, in their first use order
+  void ForEachPredicted(const Tobj& obj, u32 horizon, const std::function<void(const Tobj&, TInfo&)>& func)
+  {
+    auto it = m_objects.find(obj);
+    if (!m_session_started || it == m_objects.end() || it->second.last_scene == NO_SCENE)
+    {
+      return;
+    }
+    const u32 first = it->second.last_scene;
+    const u32 last = first + std::min(horizon, NO_SCENE - 1 - first);
+    for (auto scene = m_scenes.lower_bound(first); scene != m_scenes.end() && scene->first <= last; ++scene)
+    {
+      if (scene->second.predicted)
+      {
+        continue;
+      }
+      scene->second.predicted = true;
+      for (std::pair<const Tobj, ObjectMetadata>* item : scene->second.objects)
+      {
+        if (item->second.used_in_session || item->second.predicted)
+        {
+          continue;
+        }
+        item->second.predicted = true;
+        m_predicted_count++;
+        func(item->first, item->second.info);
+      }
+    }
+  }
+
+  // How well the first uses of this session were predicted
+  std::string GetPredictionStats() const
+  {
+    return StringFromFormat("%zu first uses, %zu predicted before use (%.1f%%), "
+      "%zu predictions (%.1f%% used)",
+      m_first_use_count, m_predicted_hits,
+      100.0 * m_predicted_hits / std::max<size_t>(m_first_use_count, 1),
+      m_predicted_count, 100.0 * m_predicted_hits / std::max<size_t>(m_predicted_count, 1));
+  }
+
   void PersistToFile(const std::string& path, const std::function<void(Tobj&)>& cleanfunc = {}, bool allcategories = false)
   {
     std::ofstream out(path, std::ofstream::binary);
@@ -272,6 +350,16 @@ public:
       }
     }
     bwrite(out, ValidationMask);
+    if (!allcategories)
+    {
+      // Older versions stop reading at the validation mask
+      bwrite(out, SceneMask);
+      for (auto& item : ToStore)
+      {
+        bwrite(out, item.second->scene);
+        bwrite(out, item.second->order);
+      }
+    }
   }
 
   void Persist(const std::function<void(Tobj&)>& cleanfunc = {})
@@ -332,6 +420,8 @@ public:
       return;
     }
     size_t object_count = header & 0xFFFFFFFFul;
+    std::vector<ObjectMetadata*> read_objects;
+    read_objects.reserve(object_count);
     for (size_t i = 0; i < object_count; i++)
     {
       if (input.eof())
@@ -343,6 +433,7 @@ public:
       Tobj key;
       bread(input, key);
       ObjectMetadata& data = m_objects[key];
+      read_objects.push_back(&data);
       if (multicategory)
       {
         bread(input, data.category_count);
@@ -383,6 +474,25 @@ public:
         return;
       }
     }
+    pKey_t scene_mask = 0;
+    bread(input, scene_mask);
+    if (multicategory || !input || scene_mask != SceneMask)
+    {
+      return;
+    }
+    for (ObjectMetadata* data : read_objects)
+    {
+      bread(input, data->scene);
+      bread(input, data->order);
+    }
+    if (!input)
+    {
+      // Truncated, the scenes are only a hint
+      for (ObjectMetadata* data : read_objects)
+      {
+        data->scene = NO_SCENE;
+      }
+    }
   }
 
   void SetStorage(const std::string& storagefile)
@@ -416,15 +526,59 @@ public:
 
 private:
   const pKey_t ValidationMask = 1980092619761005200ull;
+  const pKey_t SceneMask = 0x53434e4553434e45ull;
+  static constexpr u32 NO_SCENE = UINT32_MAX;
   struct ObjectMetadata
   {
     pKey_t category_count;
     pKey_t usage_count;
     std::vector<pKey_t> category_mask;
     TInfo info;
+    // Second and rank of the first use in the last session the object was used in
+    u32 scene = NO_SCENE;
+    u32 order = 0;
+    // Scene when this session started
+    u32 last_scene = NO_SCENE;
+    bool used_in_session = false;
+    bool predicted = false;
     ObjectMetadata() : category_count(0), usage_count(0)
     {}
   };
+  struct SceneMetadata
+  {
+    std::vector<std::pair<const Tobj, ObjectMetadata>*> objects;
+    bool predicted = false;
+  };
+
+  void RecordFirstUse(ObjectMetadata& item)
+  {
+    m_first_use_count++;
+    if (item.predicted)
+    {
+      m_predicted_hits++;
+    }
+    item.used_in_session = true;
+    item.scene = static_cast<u32>(std::min<s64>(
+      std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - m_session_start).count(),
+      NO_SCENE - 1));
+    item.order = m_next_order++;
+  }
+
+  void ClearSession()
+  {
+    m_scenes.clear();
+    for (auto& item : m_objects)
+    {
+      item.second.used_in_session = false;
+      item.second.predicted = false;
+    }
+    m_session_started = false;
+    m_next_order = 0;
+    m_first_use_count = 0;
+    m_predicted_count = 0;
+    m_predicted_hits = 0;
+  }
+
   struct greater
   {
     bool operator()(std::pair<const Tobj, ObjectMetadata>* const &first, std::pair<const Tobj, ObjectMetadata>* const &second) const
@@ -453,6 +607,13 @@ private:
   pKey_t m_category_mask = {};
   pKey_t m_version = {};
   std::string m_storage;
+  std::map<u32, SceneMetadata> m_scenes;
+  std::chrono::steady_clock::time_point m_session_start;
+  bool m_session_started = false;
+  u32 m_next_order = 0;
+  size_t m_first_use_count = 0;
+  size_t m_predicted_count = 0;
+  size_t m_predicted_hits = 0;
   template<typename T>
   inline void bwrite(std::ofstream& out, const T& t)
   {
@@ -22,11 +22,14 @@
 #include "VideoCommon/CPMemory.h"
 #include "VideoCommon/DataReader.h"
 #include "VideoCommon/Fifo.h"
+#include "VideoCommon/FrameProfiler.h"
+#include "VideoCommon/GenericDLCache.h"
 #include "VideoCommon/OpcodeDecoding.h"
 #include "VideoCommon/Statistics.h"
 #include "VideoCommon/VertexLoaderManager.h"
 #include "VideoCommon/VertexManagerBase.h"
 #include "VideoCommon/VideoCommon.h"
+#include "VideoCommon/VideoConfig.h"
 #include "VideoCommon/XFMemory.h"
 
 bool g_bRecordFifoData = false;
@@ -43,6 +46,21 @@ __forceinline void ReadU32xn(u32 *bufx16)
 
 __forceinline u32 InterpretDisplayList(u32 address, u32 size)
 {
+  // The deterministic gpu thread reads display lists from the aux buffer and the fifo
+  // recorder needs every command, both have to go through the interpreter
+  if (g_ActiveConfig.bDisplayListCache && !Fifo::UseDeterministicGPUThread() && !g_bRecordFifoData)
+  {
+    u32 cycles = 0;
+    Statistics::SwapDL();
+    bool handled = DLCache::HandleDisplayList(address, size, &cycles);
+    Statistics::SwapDL();
+    if (handled)
+    {
+      INCSTAT(stats.thisFrame.numDListsCalled);
+      return cycles;
+    }
+  }
+
   u8* startAddress;
 
   if (Fifo::UseDeterministicGPUThread())
@@ -161,6 +179,7 @@ void Init()
 template <bool is_preprocess, bool sizeCheck>
 u8* Run(DataReader& reader, u32* cycles)
 {
+  FrameProfiler::Scope profile_scope(FrameProfiler::Stage::OpcodeDecoder, !is_preprocess);
   u32 totalCycles = 0;
   u8* opcodeStart;
   while (true)
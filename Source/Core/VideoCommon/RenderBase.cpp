@@ -47,6 +47,7 @@
 #include "VideoCommon/Debugger.h"
 #include "VideoCommon/FPSCounter.h"
 #include "VideoCommon/FramebufferManagerBase.h"
+#include "VideoCommon/GenericDLCache.h"
 #include "VideoCommon/GeometryShaderManager.h"
 #include "VideoCommon/ImageWrite.h"
 #include "VideoCommon/OnScreenDisplay.h"
@@ -778,6 +779,7 @@ void Renderer::Swap(u32 xfbAddr, u32 fbWidth, u32 fbStride, u32 fbHeight, const
     m_fps_counter.Update();
 
   frameCount++;
+  DLCache::ProgressiveCleanup();
   GFX_DEBUGGER_PAUSE_AT(NEXT_FRAME, true);
 
   // Begin new frame
@@ -0,0 +1,236 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <ctime>
+#include <lzo/lzo1x.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "Common/CommonPaths.h"
+#include "Common/File.h"
+#include "Common/FileUtil.h"
+#include "Common/Hash.h"
+#include "Common/Logging/Log.h"
+#include "Common/StringUtil.h"
+
+#include "Core/ConfigManager.h"
+
+#include "VideoCommon/ScaledTextureCache.h"
+
+namespace
+{
+constexpr u32 SCALED_TEXTURE_MAGIC = 0x31435453;  // "STC1"
+constexpr u32 SCALED_TEXTURE_VERSION = 1;
+
+struct FileHeader
+{
+  u32 magic;
+  u32 version;
+  u64 source_hash;
+  u32 scaled_size;
+  u32 compressed_size;
+};
+
+// Once over budget, entries are deleted down to this fraction of it,
+// so the folder isn't scanned for the oldest entries on every store
+constexpr u64 EVICTION_TARGET_PERCENT = 90;
+
+struct IndexEntry
+{
+  u64 size;
+  s64 last_use;  // seconds since the epoch, the modification time until used in this session
+};
+
+// Used to give every writer its own temporary file
+std::atomic<u32> s_temp_file_id{0};
+std::atomic<u64> s_max_size{0};
+
+// Every file of the cache folder, by full path. Built by the first store, so the scan
+// happens on a worker and never stalls the GPU thread.
+std::mutex s_index_lock;
+std::unordered_map<std::string, IndexEntry> s_index;
+u64 s_index_size = 0;
+bool s_index_built = false;
+
+void AddIndexEntries(const File::FSTEntry& directory)
+{
+  for (const File::FSTEntry& entry : directory.children)
+  {
+    if (entry.isDirectory)
+    {
+      AddIndexEntries(entry);
+    }
+    else if (!StringEndsWith(entry.virtualName, ".tmp"))
+    {
+      const s64 modified = File::FileInfo(entry.physicalName).GetModificationTime();
+      s_index[entry.physicalName] = {entry.size, modified};
+      s_index_size += entry.size;
+    }
+  }
+}
+
+u64 HashSource(const ScaledTextureCache::Key& key, const u32* source)
+{
+  return GetHash64(reinterpret_cast<const u8*>(source), key.width * key.height * sizeof(u32), 0);
+}
+}  // namespace
+
+void ScaledTextureCache::Init()
+{
+  if (lzo_init() != LZO_E_OK)
+    ERROR_LOG(VIDEO, "Internal LZO Error - lzo_init() failed, scaled texture cache disabled");
+}
+
+void ScaledTextureCache::SetMaxSize(u64 max_size)
+{
+  s_max_size = max_size;
+}
+
+void ScaledTextureCache::BuildIndex()
+{
+  s_index.clear();
+  s_index_size = 0;
+  AddIndexEntries(
+      File::ScanDirectoryTree(File::GetUserPath(D_CACHE_IDX) + SCALEDTEXTURES_DIR, true));
+  s_index_built = true;
+}
+
+void ScaledTextureCache::Evict(u64 max_size)
+{
+  if (max_size == 0 || s_index_size <= max_size)
+    return;
+
+  std::vector<std::unordered_map<std::string, IndexEntry>::iterator> entries;
+  entries.reserve(s_index.size());
+  for (auto it = s_index.begin(); it != s_index.end(); ++it)
+    entries.push_back(it);
+  std::sort(entries.begin(), entries.end(),
+            [](const auto& a, const auto& b) { return a->second.last_use < b->second.last_use; });
+
+  const u64 target_size = max_size / 100 * EVICTION_TARGET_PERCENT;
+  size_t evicted = 0;
+  for (auto it : entries)
+  {
+    if (s_index_size <= target_size)
+      break;
+    // A file that can't be deleted is still dropped from the index, so it isn't retried forever
+    File::Delete(it->first);
+    s_index_size -= it->second.size;
+    s_index.erase(it);
+    evicted++;
+  }
+  INFO_LOG(VIDEO, "Evicted %zu scaled textures to stay under %" PRIu64 " MiB", evicted,
+           max_size >> 20);
+}
+
+std::string ScaledTextureCache::GetFileName(const Key& key)
+{
+  return File::GetUserPath(D_CACHE_IDX) + SCALEDTEXTURES_DIR DIR_SEP +
+         SConfig::GetInstance().GetGameID() + DIR_SEP +
+         StringFromFormat("%016" PRIx64 "_%016" PRIx64 "_%ux%u_%u_%d_%dx%s.stc", key.tex_hash,
+                          key.tlut_hash, key.width, key.height, key.level, key.type, key.factor,
+                          key.deposterize ? "_d" : "");
+}
+
+bool ScaledTextureCache::Load(const Key& key, const u32* source, std::vector<u32>& scaled)
+{
+  const std::string filename = GetFileName(key);
+  File::IOFile file(filename, "rb");
+  if (!file)
+    return false;
+
+  const u32 expected_size = key.width * key.height * key.factor * key.factor * sizeof(u32);
+  FileHeader header;
+  if (!file.ReadArray(&header, 1) || header.magic != SCALED_TEXTURE_MAGIC ||
+      header.version != SCALED_TEXTURE_VERSION || header.scaled_size != expected_size ||
+      header.source_hash != HashSource(key, source))
+  {
+    return false;
+  }
+
+  std::vector<u8> compressed(header.compressed_size);
+  if (!file.ReadBytes(compressed.data(), compressed.size()))
+    return false;
+
+  scaled.resize(expected_size / sizeof(u32));
+  lzo_uint out_len = expected_size;
+  const int res = lzo1x_decompress_safe(compressed.data(), compressed.size(),
+                                        reinterpret_cast<u8*>(scaled.data()), &out_len, nullptr);
+  if (res != LZO_E_OK || out_len != expected_size)
+  {
+    WARN_LOG(VIDEO, "Corrupted scaled texture cache entry %s", filename.c_str());
+    return false;
+  }
+
+  // Loads happen on the GPU thread, which shouldn't wait for a worker scanning the folder.
+  // Missing a use only makes the entry look a little older.
+  std::unique_lock<std::mutex> lk(s_index_lock, std::try_to_lock);
+  if (lk.owns_lock())
+  {
+    auto it = s_index.find(filename);
+    if (it != s_index.end())
+      it->second.last_use = std::time(nullptr);
+  }
+  return true;
+}
+
+void ScaledTextureCache::Store(const Key& key, const u32* source, const u32* scaled)
+{
+  const u32 scaled_size = key.width * key.height * key.factor * key.factor * sizeof(u32);
+  std::vector<u8> compressed(scaled_size + scaled_size / 16 + 64 + 3);
+  auto wrkmem = std::make_unique<u8[]>(LZO1X_1_MEM_COMPRESS);
+  lzo_uint out_len = 0;
+  if (lzo1x_1_compress(reinterpret_cast<const u8*>(scaled), scaled_size, compressed.data(),
+                       &out_len, wrkmem.get()) != LZO_E_OK)
+  {
+    ERROR_LOG(VIDEO, "Internal LZO Error - compression of scaled texture failed");
+    return;
+  }
+
+  FileHeader header;
+  header.magic = SCALED_TEXTURE_MAGIC;
+  header.version = SCALED_TEXTURE_VERSION;
+  header.source_hash = HashSource(key, source);
+  header.scaled_size = scaled_size;
+  header.compressed_size = static_cast<u32>(out_len);
+
+  // Write to a temporary file first, so a reader never sees a partially written entry
+  const std::string filename = GetFileName(key);
+  const std::string temp_filename = filename + StringFromFormat(".%u.tmp", s_temp_file_id++);
+  File::CreateFullPath(filename);
+  {
+    File::IOFile file(temp_filename, "wb");
+    if (!file || !file.WriteArray(&header, 1) || !file.WriteBytes(compressed.data(), out_len))
+    {
+      file.Close();
+      File::Delete(temp_filename);
+      return;
+    }
+  }
+  if (!File::Rename(temp_filename, filename))
+  {
+    File::Delete(temp_filename);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lk(s_index_lock);
+  if (!s_index_built)
+  {
+    // The scan picks up the file that was just written
+    BuildIndex();
+  }
+  else
+  {
+    IndexEntry& entry = s_index[filename];
+    s_index_size -= entry.size;
+    entry.size = sizeof(header) + out_len;
+    s_index_size += entry.size;
+  }
+  s_index[filename].last_use = std::time(nullptr);
+  Evict(s_max_size);
+}
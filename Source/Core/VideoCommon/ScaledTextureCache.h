@@ -0,0 +1,49 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+// Persistent cache of scaled textures, so textures seen in a previous session
+// don't have to go through the texture scaler again.
+// Every texture level is stored in its own LZO compressed file under
+// Cache/ScaledTextures/<GameID>/, named after the texture and tlut hashes.
+// The folder is kept under a size budget shared by all games, the least recently used entries
+// are deleted first, starting with the oldest files of previous sessions.
+class ScaledTextureCache
+{
+public:
+  // Everything that changes the output of the scaler
+  struct Key
+  {
+    u64 tex_hash;
+    u64 tlut_hash;
+    u32 width;  // size of the source level, width is the expanded width
+    u32 height;
+    u32 level;
+    int type;
+    int factor;
+    bool deposterize;
+  };
+
+  static void Init();
+  // Size budget of the whole cache folder in bytes, 0 is unlimited
+  static void SetMaxSize(u64 max_size);
+
+  // Fills scaled with the cached result for source, returns false on a miss.
+  // The texture hashes can be sampled, so the source is verified with a full hash of its pixels.
+  static bool Load(const Key& key, const u32* source, std::vector<u32>& scaled);
+  // Compresses and writes the scaled level, can be called from any thread
+  static void Store(const Key& key, const u32* source, const u32* scaled);
+
+private:
+  static std::string GetFileName(const Key& key);
+  // Both expect the index lock to be held
+  static void BuildIndex();
+  static void Evict(u64 max_size);
+};
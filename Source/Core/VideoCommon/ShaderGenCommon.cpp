@@ -7,6 +7,74 @@
 #include "Common/FileUtil.h"
 #include "Core/ConfigManager.h"
 
+static void AppendUnsigned(std::string* buffer, u32 value, u32 base)
+{
+  char digits[10];
+  char* end = digits + sizeof(digits);
+  char* start = end;
+  do
+  {
+    *--start = "0123456789abcdef"[value % base];
+    value /= base;
+  } while (value != 0);
+  buffer->append(start, end);
+}
+
+void ShaderCode::WriteV(const char* fmt, va_list arglist)
+{
+  const size_t start = m_buffer.size();
+  va_list fallback_args;
+  va_copy(fallback_args, arglist);
+  const char* text = fmt;
+  while (const char* conversion = std::strchr(text, '%'))
+  {
+    m_buffer.append(text, conversion);
+    switch (conversion[1])
+    {
+    case 's':
+    {
+      const char* str = va_arg(arglist, const char*);
+      m_buffer.append(str ? str : "(null)");
+      break;
+    }
+    case 'd':
+    case 'i':
+    {
+      const int value = va_arg(arglist, int);
+      if (value < 0)
+        m_buffer.push_back('-');
+      AppendUnsigned(&m_buffer, value < 0 ? 0u - static_cast<u32>(value) : value, 10);
+      break;
+    }
+    case 'u':
+      AppendUnsigned(&m_buffer, va_arg(arglist, unsigned int), 10);
+      break;
+    case 'x':
+      AppendUnsigned(&m_buffer, va_arg(arglist, unsigned int), 16);
+      break;
+    case 'c':
+      m_buffer.push_back(static_cast<char>(va_arg(arglist, int)));
+      break;
+    case '%':
+      m_buffer.push_back('%');
+      break;
+    case '\0':
+      // Undefined for printf, and StringFromFormatV fails on it
+      m_buffer.push_back('%');
+      va_end(fallback_args);
+      return;
+    default:
+      m_buffer.resize(start);
+      m_buffer += StringFromFormatV(fmt, fallback_args);
+      va_end(fallback_args);
+      return;
+    }
+    text = conversion + 2;
+  }
+  m_buffer.append(text);
+  va_end(fallback_args);
+}
+
 ShaderHostConfig ShaderHostConfig::GetCurrent()
 {
   ShaderHostConfig bits = {};
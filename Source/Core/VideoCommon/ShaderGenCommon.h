@@ -7,6 +7,7 @@
 #include <cstdarg>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <map>
 #include <string>
@@ -14,6 +15,7 @@
 
 #include "Common/CommonTypes.h"
 #include "Common/FileUtil.h"
+#include "Common/LinearDiskCache.h"
 #include "Common/StringUtil.h"
 #include "Common/Logging/Log.h"
 #include "Common/Hash.h"
@@ -112,6 +114,12 @@ private:
   std::size_t HASH;
 };
 
+// The generators write thousands of small fragments per shader, so Write appends them to the
+// buffer without building a string for each: the text between the conversions is copied, and
+// the plain %s, %d, %i, %u, %x, %c and %% conversions are done in place. Any other conversion
+// (flags, width, precision, length or floating point) makes the whole fragment go through
+// StringFromFormatV, and a lone % at the end is written as is. clear() keeps the capacity, to
+// reuse the buffer for the next shader.
 class ShaderCode
 {
 public:
@@ -123,9 +131,10 @@ public:
   {
     va_list arglist;
     va_start(arglist, fmt);
-    m_buffer += StringFromFormatV(fmt, arglist);
+    WriteV(fmt, arglist);
     va_end(arglist);
-}
+  }
+  void WriteV(const char* fmt, va_list arglist);
   void clear()
   {
     m_buffer.clear();
@@ -182,6 +191,23 @@ union ShaderHostConfig
 std::string GetDiskShaderCacheFileName(API_TYPE api_type, const char* type, bool include_gameid,
   bool include_host_config, bool uid = false);
 
+// The uids of a shader disk cache are hashed again, the hash stored with them may be stale
+template <typename Uid>
+struct ShaderDiskCacheUidHasher
+{
+  size_t operator()(const Uid& uid) const
+  {
+    Uid item = uid;
+    item.ClearHASH();
+    item.CalculateUIDHash();
+    return typename Uid::ShaderUidHasher()(item);
+  }
+};
+
+// Opened without reading the values, each shader is looked up when it is first used
+template <typename Uid, typename V>
+using ShaderDiskCache = LinearDiskCache<Uid, V, ShaderDiskCacheUidHasher<Uid>, std::equal_to<Uid>>;
+
 inline void WriteRegister(ShaderCode& object, API_TYPE api_type, const char *prefix, const u32 num)
 {
   if (!(api_type & API_D3D9))
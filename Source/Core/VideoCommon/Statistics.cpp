@@ -2,6 +2,7 @@
 // Licensed under GPLv2+
 // Refer to the license.txt file included.
 
+#include <algorithm>
 #include <cstring>
 #include <string>
 #include <utility>
@@ -58,6 +59,15 @@ std::string Statistics::ToString()
   str += StringFromFormat("dlists called: %i\n", stats.thisFrame.numDListsCalled);
   str += StringFromFormat("Primitive joins: %i\n", stats.thisFrame.numPrimitiveJoins);
   str += StringFromFormat("Draw calls: %i\n", stats.thisFrame.numDrawCalls);
+  if (g_ActiveConfig.bBackgroundShaderCompiling)
+  {
+    str += StringFromFormat("Uber shader draws: %i (%.1f%%)\n", stats.thisFrame.numUberShaderDraws,
+                            100.0 * stats.thisFrame.numUberShaderDraws /
+                                std::max(stats.thisFrame.numDrawCalls, 1));
+    str += StringFromFormat("Shader compiles pending: %i\n", stats.numPendingShaderCompiles);
+    str += StringFromFormat("Shader compile latency: %.2f ms\n",
+                            stats.backgroundShaderCompileLatency);
+  }
   str += StringFromFormat("Primitives: %i\n", stats.thisFrame.numPrims);
   str += StringFromFormat("Primitives (DL): %i\n", stats.thisFrame.numDLPrims);
   str += StringFromFormat("XF loads: %i\n", stats.thisFrame.numXFLoads);
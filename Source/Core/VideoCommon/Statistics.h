@@ -24,6 +24,10 @@ struct Statistics
 
   int numVertexLoaders;
 
+  // Specialized shaders compiled in the background, while the ubershaders are used
+  int numPendingShaderCompiles;
+  float backgroundShaderCompileLatency;  // average, in ms
+
   float proj_0, proj_1, proj_2, proj_3, proj_4, proj_5;
   float gproj_0, gproj_1, gproj_2, gproj_3, gproj_4, gproj_5;
   float gproj_6, gproj_7, gproj_8, gproj_9, gproj_10, gproj_11, gproj_12, gproj_13, gproj_14, gproj_15;
@@ -47,6 +51,7 @@ struct Statistics
 
     int numPrimitiveJoins;
     int numDrawCalls;
+    int numUberShaderDraws;
 
     int numDListsCalled;
 
@@ -2,15 +2,19 @@
 // Licensed under GPLv2+
 // Refer to the license.txt file included.
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "Common/Align.h"
 #include "Common/FileUtil.h"
 #include "Common/MemoryUtil.h"
 #include "Common/StringUtil.h"
+#include "Common/ThreadPool.h"
 
 #include "Core/ConfigManager.h"
 #include "Core/FifoPlayer/FifoPlayer.h"
@@ -18,9 +22,11 @@
 #include "Core/HW/Memmap.h"
 
 #include "VideoCommon/Debugger.h"
+#include "VideoCommon/FrameProfiler.h"
 #include "VideoCommon/FramebufferManagerBase.h"
 #include "VideoCommon/HiresTextures.h"
 #include "VideoCommon/RenderBase.h"
+#include "VideoCommon/ScaledTextureCache.h"
 #include "VideoCommon/Statistics.h"
 #include "VideoCommon/SamplerCommon.h"
 #include "VideoCommon/TextureCacheBase.h"
@@ -34,6 +40,64 @@
 static const u64 MAX_TEXTURE_BINARY_SIZE = 1024 * 1024 * 4; // 1024 x 1024 texel times 8 nibbles per texel
 std::unique_ptr<TextureCacheBase> g_texture_cache;
 
+struct TextureCacheBase::AsyncScaleJob
+{
+  struct Level
+  {
+    u32 width;
+    u32 height;
+    u32 expanded_width;
+    std::vector<u32> data;
+  };
+  // Identifies the entry the result belongs to, the entry itself may be gone when the job is done
+  u32 address;
+  u64 hash;
+  u32 format;
+  u32 native_width;
+  u32 native_height;
+  u32 generation;
+  u64 tex_hash;
+  u64 tlut_hash;
+  int type;
+  int factor;
+  bool deposterize;
+  bool use_disk_cache;
+  std::vector<Level> levels;
+};
+
+struct TextureCacheBase::AsyncScalingState
+{
+  // Shared with the worker, so in flight jobs can outlive the texture cache
+  std::mutex results_lock;
+  std::vector<std::shared_ptr<AsyncScaleJob>> results;
+  std::atomic<bool> has_results{false};
+  // Incremented on every invalidation, results from older generations are dropped
+  std::atomic<u32> generation{0};
+};
+
+// Scales a decoded level, going through the on-disk cache of scaled textures when it is enabled.
+// Returns either the scaler's buffer or cached, which receives cache hits.
+static u32* ScaleLevel(TextureScaler& scaler, const ScaledTextureCache::Key& key, u32* data,
+  std::vector<u32>& cached, bool use_disk_cache)
+{
+  if (use_disk_cache && ScaledTextureCache::Load(key, data, cached))
+    return cached.data();
+
+  u32* scaled = scaler.Scale(data, key.width, key.height, key.type, key.factor, key.deposterize);
+  if (use_disk_cache)
+  {
+    // Compressing and writing the file is left to a worker, the buffers are reused right away
+    const size_t source_size = key.width * key.height;
+    const size_t scaled_size = source_size * key.factor * key.factor;
+    auto source_copy = std::make_shared<std::vector<u32>>(data, data + source_size);
+    auto scaled_copy = std::make_shared<std::vector<u32>>(scaled, scaled + scaled_size);
+    Common::AsyncWorker::ExecuteAsync([key, source_copy, scaled_copy]() {
+      ScaledTextureCache::Store(key, source_copy->data(), scaled_copy->data());
+    });
+  }
+  return scaled;
+}
+
 TextureCacheBase::TCacheEntry::TCacheEntry(std::unique_ptr<HostTexture> tex)  
 {
   textures.emplace_back(std::move(tex));
@@ -71,14 +135,19 @@ TextureCacheBase::TextureCacheBase()
   TexDecoder::SetTexFmtOverlayOptions(backup_config.texfmt_overlay, backup_config.texfmt_overlay_center);
 
   HiresTexture::Init();
+  ScaledTextureCache::Init();
+  ScaledTextureCache::SetMaxSize(static_cast<u64>(std::max(g_ActiveConfig.iTexScalingCacheSize, 0))
+                                 << 20);
   
   texture_pool_memory_usage = 0;
   InvalidateAllBindPoints();
   m_scaler = std::make_unique<TextureScaler>();
+  m_async_scaling = std::make_shared<AsyncScalingState>();
 }
 
 void TextureCacheBase::Invalidate()
 {
+  m_async_scaling->generation.fetch_add(1);
   InvalidateAllBindPoints();
   bound_textures.fill(nullptr);
   auto iter = textures_by_address.begin();
@@ -103,10 +172,13 @@ TextureCacheBase::~TextureCacheBase()
     TextureCacheBase::temp = nullptr;
   }
   m_scaler.reset();
+  m_async_scaling.reset();
 }
 
 void TextureCacheBase::OnConfigChanged(VideoConfig& config)
 {
+  ScaledTextureCache::SetMaxSize(static_cast<u64>(std::max(config.iTexScalingCacheSize, 0)) << 20);
+
   if (config.bHiresTextures != backup_config.hires_textures ||
     config.bCacheHiresTextures != backup_config.cache_hires_textures)
   {
@@ -157,6 +229,8 @@ void TextureCacheBase::SetBackupConfig(const VideoConfig& config)
 
 void TextureCacheBase::Cleanup(s32 _frameCount)
 {
+  HiresTexture::ProcessPackRequest();
+
   s32 texture_kill_threshold = TEXTURE_KILL_THRESHOLD;
   if (texture_pool_memory_usage < (TEXTURE_POOL_MEMORY_LIMIT / 2))
   {
@@ -487,6 +561,8 @@ void TextureCacheBase::BindTextures()
 
 TextureCacheBase::TCacheEntry* TextureCacheBase::Load(const u32 stage)
 {
+  ApplyAsyncScaledTextures();
+
   // if this stage was not invalidated by changes to texture registers, keep the current texture
   if (IsValidBindPoint(stage) && bound_textures[stage])
   {
@@ -760,6 +836,14 @@ TextureCacheBase::TCacheEntry* TextureCacheBase::Load(const u32 stage)
   // how many levels the allocated texture shall have
   const u32 texLevels = hires_tex ? hires_tex->m_levels : tex_levels;
   const bool use_scaling = (g_ActiveConfig.iTexScalingType > 0) && !hires_tex && (width < 384) && (height < 384);
+  const bool async_scaling = use_scaling && g_ActiveConfig.bTexScalingAsync;
+  ScaledTextureCache::Key scale_key;
+  scale_key.tex_hash = tex_hash;
+  scale_key.tlut_hash = full_hash ^ tex_hash;
+  scale_key.type = g_ActiveConfig.iTexScalingType;
+  scale_key.factor = g_ActiveConfig.iTexScalingFactor;
+  scale_key.deposterize = g_ActiveConfig.bTexDeposterize;
+  std::vector<u32> cached_scaled;
   // We can decode on the GPU if it is a supported format and the flag is enabled.
   // Currently we don't decode RGBA8 textures from Tmem, as that would require copying from both
   // banks, and if we're doing an copy we may as well just do the whole thing on the CPU, since
@@ -780,8 +864,11 @@ TextureCacheBase::TCacheEntry* TextureCacheBase::Load(const u32 stage)
 
   if (use_scaling)
   {
-    config.width *= g_ActiveConfig.iTexScalingFactor;
-    config.height *= g_ActiveConfig.iTexScalingFactor;
+    if (!async_scaling)
+    {
+      config.width *= g_ActiveConfig.iTexScalingFactor;
+      config.height *= g_ActiveConfig.iTexScalingFactor;
+    }
     config.pcformat = PC_TEX_FMT_RGBA32;
   }
   TCacheEntry* entry = AllocateCacheEntry(config, materialmap);
@@ -796,15 +883,22 @@ TextureCacheBase::TCacheEntry* TextureCacheBase::Load(const u32 stage)
 
   entry->SetGeneralParameters(address, texture_size, full_format);
   entry->SetDimensions(nativeW, nativeH, tex_levels);
-  entry->SetHiresParams(!!hires_tex, basename, use_scaling, !!hires_tex && hires_tex->emissive_in_color);
+  entry->SetHiresParams(!!hires_tex, basename, use_scaling && !async_scaling, !!hires_tex && hires_tex->emissive_in_color);
   entry->SetHashes(full_hash, tex_hash);
   entry->is_efb_copy = false;
 
+  std::shared_ptr<AsyncScaleJob> scale_job;
+  if (async_scaling)
+  {
+    scale_job = CreateScaleJob(entry);
+  }
+
   // load texture
   if (hires_tex)
   {
-    entry->GetColor()->Load(TextureCacheBase::temp, width, height, expandedWidth, 0);
-    u8 *Bufferptr = TextureCacheBase::temp;
+    // Texture packs are uploaded straight from the mapped file
+    const u8* Bufferptr = hires_tex->m_pack_data ? hires_tex->m_pack_data : TextureCacheBase::temp;
+    entry->GetColor()->Load(Bufferptr, width, height, expandedWidth, 0);
     Bufferptr += TextureUtil::GetTextureSizeInBytes(width, height, pcfmt);
     for (u32 level = 1; level != texLevels; ++level)
     {
@@ -850,22 +944,35 @@ TextureCacheBase::TCacheEntry* TextureCacheBase::Load(const u32 stage)
       u32 twidth = width;
       u32 theight = height;
       u32 texpandedWidth = expandedWidth;
-      if (texformat == GX_TF_RGBA8 && from_tmem)
       {
-        TexDecoder::DecodeRGBA8FromTmem(reinterpret_cast<u32*>(texturedata),
-          src_data, ptr_odd, expandedWidth, expandedHeight);
+        FrameProfiler::Scope profile_scope(FrameProfiler::Stage::TextureDecode);
+        if (texformat == GX_TF_RGBA8 && from_tmem)
+        {
+          TexDecoder::DecodeRGBA8FromTmem(reinterpret_cast<u32*>(texturedata),
+            src_data, ptr_odd, expandedWidth, expandedHeight);
+        }
+        else
+        {
+          TexDecoder::Decode(texturedata, src_data, expandedWidth,
+            expandedHeight, texformat, tlutaddr,
+            static_cast<TlutFormat>(tlutfmt),
+            PC_TEX_FMT_RGBA32 == config.pcformat,
+            config.pcformat >= PC_TEX_FMT_DXT1);
+        }
       }
-      else
+      if (scale_job)
       {
-        TexDecoder::Decode(texturedata, src_data, expandedWidth,
-          expandedHeight, texformat, tlutaddr,
-          static_cast<TlutFormat>(tlutfmt),
-          PC_TEX_FMT_RGBA32 == config.pcformat,
-          config.pcformat >= PC_TEX_FMT_DXT1);
+        const u32* pixels = reinterpret_cast<const u32*>(texturedata);
+        scale_job->levels.push_back({ twidth, theight, texpandedWidth,
+          std::vector<u32>(pixels, pixels + texpandedWidth * theight) });
       }
-      if (use_scaling)
+      else if (use_scaling)
       {
-        texturedata = reinterpret_cast<u8*>(m_scaler->Scale((u32*)texturedata, expandedWidth, height));
+        scale_key.width = expandedWidth;
+        scale_key.height = height;
+        scale_key.level = 0;
+        texturedata = reinterpret_cast<u8*>(ScaleLevel(*m_scaler, scale_key,
+          reinterpret_cast<u32*>(texturedata), cached_scaled, g_ActiveConfig.bTexScalingCache));
         twidth *= g_ActiveConfig.iTexScalingFactor;
         theight *= g_ActiveConfig.iTexScalingFactor;
         texpandedWidth *= g_ActiveConfig.iTexScalingFactor;
@@ -903,14 +1010,27 @@ TextureCacheBase::TCacheEntry* TextureCacheBase::Load(const u32 stage)
         u32 twidth = mip_width;
         u32 theight = mip_height;
         u32 texpandedWidth = expanded_mip_width;
-        TexDecoder::Decode(texturedata, mip_src_data, expanded_mip_width,
-          expanded_mip_height, texformat, tlutaddr,
-          static_cast<TlutFormat>(tlutfmt),
-          PC_TEX_FMT_RGBA32 == config.pcformat,
-          config.pcformat >= PC_TEX_FMT_DXT1);
-        if (use_scaling)
         {
-          texturedata = reinterpret_cast<u8*>(m_scaler->Scale((u32*)texturedata, expandedWidth, height));
+          FrameProfiler::Scope profile_scope(FrameProfiler::Stage::TextureDecode);
+          TexDecoder::Decode(texturedata, mip_src_data, expanded_mip_width,
+            expanded_mip_height, texformat, tlutaddr,
+            static_cast<TlutFormat>(tlutfmt),
+            PC_TEX_FMT_RGBA32 == config.pcformat,
+            config.pcformat >= PC_TEX_FMT_DXT1);
+        }
+        if (scale_job)
+        {
+          const u32* pixels = reinterpret_cast<const u32*>(texturedata);
+          scale_job->levels.push_back({ twidth, theight, texpandedWidth,
+            std::vector<u32>(pixels, pixels + texpandedWidth * theight) });
+        }
+        else if (use_scaling)
+        {
+          scale_key.width = expanded_mip_width;
+          scale_key.height = mip_height;
+          scale_key.level = level;
+          texturedata = reinterpret_cast<u8*>(ScaleLevel(*m_scaler, scale_key,
+            reinterpret_cast<u32*>(texturedata), cached_scaled, g_ActiveConfig.bTexScalingCache));
           twidth *= g_ActiveConfig.iTexScalingFactor;
           theight *= g_ActiveConfig.iTexScalingFactor;
           texpandedWidth *= g_ActiveConfig.iTexScalingFactor;
@@ -922,6 +1042,10 @@ TextureCacheBase::TCacheEntry* TextureCacheBase::Load(const u32 stage)
       if (g_ActiveConfig.bDumpTextures)
         DumpTexture(entry, basename, level);
     }
+    if (scale_job)
+    {
+      QueueScaleJob(std::move(scale_job));
+    }
   }
 
   INCSTAT(stats.numTexturesCreated);
@@ -930,6 +1054,115 @@ TextureCacheBase::TCacheEntry* TextureCacheBase::Load(const u32 stage)
   return ReturnEntry(stage, entry);
 }
 
+std::shared_ptr<TextureCacheBase::AsyncScaleJob> TextureCacheBase::CreateScaleJob(const TCacheEntry* entry)
+{
+  auto job = std::make_shared<AsyncScaleJob>();
+  job->address = entry->addr;
+  job->hash = entry->hash;
+  job->format = entry->format;
+  job->native_width = entry->native_width;
+  job->native_height = entry->native_height;
+  job->generation = m_async_scaling->generation.load();
+  job->tex_hash = entry->base_hash;
+  job->tlut_hash = entry->hash ^ entry->base_hash;
+  job->type = g_ActiveConfig.iTexScalingType;
+  job->factor = g_ActiveConfig.iTexScalingFactor;
+  job->deposterize = g_ActiveConfig.bTexDeposterize;
+  job->use_disk_cache = g_ActiveConfig.bTexScalingCache;
+  return job;
+}
+
+void TextureCacheBase::QueueScaleJob(std::shared_ptr<AsyncScaleJob> job)
+{
+  std::shared_ptr<AsyncScalingState> state = m_async_scaling;
+  Common::AsyncWorker::ExecuteAsync([state, job]() {
+    if (job->generation != state->generation.load())
+      return;
+    {
+      // Each job has its own buffers, so the jobs run in parallel on the pool
+      TextureScaler scaler;
+      std::vector<u32> cached_scaled;
+      for (u32 i = 0; i < job->levels.size(); ++i)
+      {
+        AsyncScaleJob::Level& level = job->levels[i];
+        ScaledTextureCache::Key key;
+        key.tex_hash = job->tex_hash;
+        key.tlut_hash = job->tlut_hash;
+        key.width = level.expanded_width;
+        key.height = level.height;
+        key.level = i;
+        key.type = job->type;
+        key.factor = job->factor;
+        key.deposterize = job->deposterize;
+        const u32* scaled = ScaleLevel(scaler, key, level.data.data(), cached_scaled,
+          job->use_disk_cache);
+        level.data.assign(scaled, scaled + level.expanded_width * level.height * job->factor * job->factor);
+      }
+    }
+    std::lock_guard<std::mutex> guard(state->results_lock);
+    state->results.push_back(job);
+    state->has_results.store(true);
+  });
+}
+
+TextureCacheBase::TCacheEntry* TextureCacheBase::FindScaleJobTarget(const AsyncScaleJob& job)
+{
+  auto iter_range = textures_by_address.equal_range(job.address);
+  for (auto iter = iter_range.first; iter != iter_range.second; ++iter)
+  {
+    TCacheEntry* entry = iter->second;
+    // Entries that got partial updates from efb copies are left alone, the scaled texture would lose them
+    if (entry->hash == job.hash && entry->format == job.format &&
+      entry->native_width == job.native_width && entry->native_height == job.native_height &&
+      !entry->is_scaled && !entry->is_custom_tex && !entry->IsEfbCopy() && !entry->tmem_only &&
+      entry->references.empty() && entry->GetConfig().width == job.native_width &&
+      entry->GetConfig().levels == job.levels.size())
+    {
+      return entry;
+    }
+  }
+  return nullptr;
+}
+
+void TextureCacheBase::ApplyAsyncScaledTextures()
+{
+  if (!m_async_scaling->has_results.load())
+    return;
+
+  std::vector<std::shared_ptr<AsyncScaleJob>> results;
+  {
+    std::lock_guard<std::mutex> guard(m_async_scaling->results_lock);
+    results.swap(m_async_scaling->results);
+    m_async_scaling->has_results.store(false);
+  }
+  const u32 generation = m_async_scaling->generation.load();
+  for (const auto& job : results)
+  {
+    if (job->generation != generation)
+      continue;
+    // The entry may have been invalidated or overwritten in the meantime, then the result is stale
+    TCacheEntry* entry = FindScaleJobTarget(*job);
+    if (!entry)
+      continue;
+
+    TextureConfig config = entry->GetConfig();
+    config.width *= job->factor;
+    config.height *= job->factor;
+    std::unique_ptr<HostTexture> scaled = AllocateTexture(config);
+    if (!scaled)
+      continue;
+    for (u32 level = 0; level < job->levels.size(); ++level)
+    {
+      const AsyncScaleJob::Level& data = job->levels[level];
+      scaled->Load(reinterpret_cast<const u8*>(data.data.data()), data.width * job->factor,
+        data.height * job->factor, data.expanded_width * job->factor, level);
+    }
+    DisposeTexture(entry->textures[TCacheEntryGroupIndex::Color]);
+    entry->textures[TCacheEntryGroupIndex::Color] = std::move(scaled);
+    entry->is_scaled = true;
+  }
+}
+
 void TextureCacheBase::CopyRenderTargetToTexture(u32 dstAddr, u32 dstFormat, u32 dstStride, bool is_depth_copy,
   const EFBRectangle& srcRect, bool isIntensity, bool scaleByHalf)
 {
@@ -228,6 +228,15 @@ private:
   using TexHashCache = std::multimap<u64, TCacheEntry*>;
   using TexPool = std::unordered_multimap<TextureConfig, TexPoolEntry, TextureConfig::Hasher>;
 
+  // Background texture scaling: the entry is uploaded at native resolution first and
+  // the scaled texture replaces it once the worker is done with it.
+  struct AsyncScaleJob;
+  struct AsyncScalingState;
+  std::shared_ptr<AsyncScaleJob> CreateScaleJob(const TCacheEntry* entry);
+  void QueueScaleJob(std::shared_ptr<AsyncScaleJob> job);
+  void ApplyAsyncScaledTextures();
+  TCacheEntry* FindScaleJobTarget(const AsyncScaleJob& job);
+
   void SetBackupConfig(const VideoConfig& config);
   void ScaleTextureCacheEntryTo(TCacheEntry* entry, u32 new_width, u32 new_height);
   void CheckTempSize(size_t required_size);
@@ -272,6 +281,7 @@ private:
   };
   BackupConfig backup_config = {};
   std::unique_ptr<TextureScaler> m_scaler;
+  std::shared_ptr<AsyncScalingState> m_async_scaling;
 };
 
 extern std::unique_ptr<TextureCacheBase> g_texture_cache;
@@ -23,6 +23,8 @@
 #include <algorithm>
 #include <cstdlib>
 #include <cmath>
+#include <functional>
+#include <mutex>
 #include <xbrz.h>
 
 
@@ -32,6 +34,7 @@
 #include "Common/CommonFuncs.h"
 #include "Common/CPUDetect.h"
 #include "Common/Intrinsics.h"
+#include "Common/ThreadPool.h"
 #include "VideoCommon/VideoConfig.h"
 #include "VideoCommon/TextureScalerCommon.h"
 
@@ -401,7 +404,7 @@ void scaleBicubicT(u32* data, u32* out, int w, int h, int l, int u)
 {
   int outw = w * f, outh = h * f, factor = f - 2, offset = -(f >> 1);
   int rc[4][4], gc[4][4], bc[4][4], ac[4][4];
-  for (int cy = 0; cy <= h; ++cy)
+  for (int cy = l; cy < u; ++cy)
   {
     for (int cx = 0; cx <= w; ++cx)
     {
@@ -483,11 +486,11 @@ void scaleBicubicT(u32* data, u32* out, int w, int h, int l, int u)
 
 // perform jinc scaling by factor f.
 template<int f, int T>
-void scaleJincT(u32* data, u32* out, int w, int h)
+void scaleJincT(u32* data, u32* out, int w, int h, int l, int u)
 {
   int outw = w * f, outh = h * f, factor = f - 2, offset = -(f >> 1);
   int rc[4][4], gc[4][4], bc[4][4], ac[4][4];
-  for (int cy = 0; cy <= h; ++cy)
+  for (int cy = l; cy < u; ++cy)
   {
     for (int cx = 0; cx <= w; ++cx)
     {
@@ -557,11 +560,11 @@ void scaleJincT(u32* data, u32* out, int w, int h)
 
 // perform DDT-Sharp scaling by factor f.
 template<int f>
-void scaleDDTSharpT(u32* data, u32* out, int w, int h)
+void scaleDDTSharpT(u32* data, u32* out, int w, int h, int l, int u)
 {
   int outw = w * f, outh = h * f, offset = -(f >> 1);
   int rc[4][4], gc[4][4], bc[4][4], ac[4][4];
-  for (int cy = 0; cy <= h; ++cy)
+  for (int cy = l; cy < u; ++cy)
   {
     for (int cx = 0; cx <= w; ++cx)
     {
@@ -652,11 +655,11 @@ void scaleDDTSharpT(u32* data, u32* out, int w, int h)
 
 // perform DDT scaling by factor f.
 template<int f>
-void scaleDDTT(u32* data, u32* out, int w, int h)
+void scaleDDTT(u32* data, u32* out, int w, int h, int l, int u)
 {
   int outw = w * f, outh = h * f, offset = -(f >> 1);
   int rc[2][2], gc[2][2], bc[2][2], ac[2][2];
-  for (int cy = 0; cy <= h; ++cy)
+  for (int cy = l; cy < u; ++cy)
   {
     for (int cx = 0; cx <= w; ++cx)
     {
@@ -742,11 +745,11 @@ void scaleDDTT(u32* data, u32* out, int w, int h)
 
 // perform 3-point scaling by factor f.
 template<int f>
-void scale3PointT(u32* data, u32* out, int w, int h)
+void scale3PointT(u32* data, u32* out, int w, int h, int l, int u)
 {
   int outw = w * f, outh = h * f, offset = -(f >> 1);
   int rc[2][2], gc[2][2], bc[2][2], ac[2][2];
-  for (int cy = 0; cy <= h; ++cy)
+  for (int cy = l; cy < u; ++cy)
   {
     for (int cx = 0; cx <= w; ++cx)
     {
@@ -804,11 +807,11 @@ void scale3PointT(u32* data, u32* out, int w, int h)
 
 // perform smoothstep scaling by factor f.
 template<int f>
-void scaleSmoothstepT(u32* data, u32* out, int w, int h)
+void scaleSmoothstepT(u32* data, u32* out, int w, int h, int l, int u)
 {
   int outw = w * f, outh = h * f, factor = f - 2, offset = -(f >> 1);
   int rc[2][2], gc[2][2], bc[2][2], ac[2][2];
-  for (int cy = 0; cy <= h; ++cy)
+  for (int cy = l; cy < u; ++cy)
   {
     for (int cx = 0; cx <= w; ++cx)
     {
@@ -865,10 +868,10 @@ void scaleSmoothstepT(u32* data, u32* out, int w, int h)
 
 // perform jinc scaling by factor f.
 template<int f, int T>
-void scaleJincTSSE41(u32* data, u32* out, int w, int h)
+void scaleJincTSSE41(u32* data, u32* out, int w, int h, int l, int u)
 {
   int outw = w * f, outh = h * f, factor = f - 2, offset = -(f >> 1);
-  for (int cy = 0; cy <= h; ++cy)
+  for (int cy = l; cy < u; ++cy)
   {
     for (int cx = 0; cx <= w; ++cx)
     {
@@ -933,7 +936,7 @@ template<int f, int T>
 void scaleBicubicTSSE41(u32* data, u32* out, int w, int h, int l, int u)
 {
   int outw = w * f, outh = h * f, factor = f - 2, offset = -(f >> 1);
-  for (int cy = 0; cy <= h; ++cy)
+  for (int cy = l; cy < u; ++cy)
   {
     for (int cx = 0; cx <= w; ++cx)
     {
@@ -981,10 +984,10 @@ void scaleBicubicTSSE41(u32* data, u32* out, int w, int h, int l, int u)
 }
 
 template<int f>
-void scaleSmoothstepTSSE41(u32* data, u32* out, int w, int h)
+void scaleSmoothstepTSSE41(u32* data, u32* out, int w, int h, int l, int u)
 {
   int outw = w * f, outh = h * f, factor = f - 2, offset = -(f >> 1);
-  for (int cy = 0; cy <= h; ++cy)
+  for (int cy = l; cy < u; ++cy)
   {
     for (int cx = 0; cx <= w; ++cx)
     {
@@ -1032,10 +1035,10 @@ void scaleSmoothstepTSSE41(u32* data, u32* out, int w, int h)
 }
 
 template<int f>
-void scale3PointTSSE41(u32* data, u32* out, int w, int h)
+void scale3PointTSSE41(u32* data, u32* out, int w, int h, int l, int u)
 {
   int outw = w * f, outh = h * f, factor = f - 2, offset = -(f >> 1);
-  for (int cy = 0; cy <= h; ++cy)
+  for (int cy = l; cy < u; ++cy)
   {
     for (int cx = 0; cx <= w; ++cx)
     {
@@ -1083,10 +1086,10 @@ void scale3PointTSSE41(u32* data, u32* out, int w, int h)
 
 
 template<int f>
-void scaleDDTSharpTSSE41(u32* data, u32* out, int w, int h)
+void scaleDDTSharpTSSE41(u32* data, u32* out, int w, int h, int l, int u)
 {
   int outw = w * f, outh = h * f, factor = f - 2, offset = -(f >> 1);
-  for (int cy = 0; cy <= h; ++cy)
+  for (int cy = l; cy < u; ++cy)
   {
     for (int cx = 0; cx <= w; ++cx)
     {
@@ -1158,10 +1161,10 @@ void scaleDDTSharpTSSE41(u32* data, u32* out, int w, int h)
 }
 
 template<int f>
-void scaleDDTTSSE41(u32* data, u32* out, int w, int h)
+void scaleDDTTSSE41(u32* data, u32* out, int w, int h, int l, int u)
 {
   int outw = w * f, outh = h * f, factor = f - 2, offset = -(f >> 1);
-  for (int cy = 0; cy <= h; ++cy)
+  for (int cy = l; cy < u; ++cy)
   {
     for (int cx = 0; cx <= w; ++cx)
     {
@@ -1231,6 +1234,9 @@ void scaleDDTTSSE41(u32* data, u32* out, int w, int h)
 
 #endif
 
+// [l, u) is the range of output cells rows to process,
+// each source row produces one row of cells plus one extra at the bottom (h + 1 in total)
+// cells rows write to disjoint output rows so the range can be split across threads
 void scaleBicubicBSpline(int factor, u32* data, u32* out, int w, int h, int l, int u)
 {
 #if _M_SSE >= 0x401
@@ -1292,17 +1298,17 @@ void scaleBicubicMitchell(int factor, u32* data, u32* out, int w, int h, int l,
 }
 
 
-void scaleJinc(int factor, u32* data, u32* out, int w, int h)
+void scaleJinc(int factor, u32* data, u32* out, int w, int h, int l, int u)
 {
 #if _M_SSE >= 0x401
   if (cpu_info.bSSE4_1)
   {
     switch (factor)
     {
-    case 2: scaleJincTSSE41<2, 0>(data, out, w, h); break;
-    case 3: scaleJincTSSE41<3, 0>(data, out, w, h); break;
-    case 4: scaleJincTSSE41<4, 0>(data, out, w, h); break;
-    case 5: scaleJincTSSE41<5, 0>(data, out, w, h); break;
+    case 2: scaleJincTSSE41<2, 0>(data, out, w, h, l, u); break;
+    case 3: scaleJincTSSE41<3, 0>(data, out, w, h, l, u); break;
+    case 4: scaleJincTSSE41<4, 0>(data, out, w, h, l, u); break;
+    case 5: scaleJincTSSE41<5, 0>(data, out, w, h, l, u); break;
     default: ERROR_LOG(VIDEO, "Jinc upsampling only implemented for factors 2 to 5");
     }
   }
@@ -1311,10 +1317,10 @@ void scaleJinc(int factor, u32* data, u32* out, int w, int h)
 #endif
     switch (factor)
     {
-    case 2: scaleJincT<2, 0>(data, out, w, h); break;
-    case 3: scaleJincT<3, 0>(data, out, w, h); break;
-    case 4: scaleJincT<4, 0>(data, out, w, h); break;
-    case 5: scaleJincT<5, 0>(data, out, w, h); break;
+    case 2: scaleJincT<2, 0>(data, out, w, h, l, u); break;
+    case 3: scaleJincT<3, 0>(data, out, w, h, l, u); break;
+    case 4: scaleJincT<4, 0>(data, out, w, h, l, u); break;
+    case 5: scaleJincT<5, 0>(data, out, w, h, l, u); break;
     default: ERROR_LOG(VIDEO, "Jinc upsampling only implemented for factors 2 to 5");
     }
 #if _M_SSE >= 0x401
@@ -1322,17 +1328,17 @@ void scaleJinc(int factor, u32* data, u32* out, int w, int h)
 #endif
 }
 
-void scaleJincSharper(int factor, u32* data, u32* out, int w, int h)
+void scaleJincSharper(int factor, u32* data, u32* out, int w, int h, int l, int u)
 {
 #if _M_SSE >= 0x401
   if (cpu_info.bSSE4_1)
   {
     switch (factor)
     {
-    case 2: scaleJincTSSE41<2, 1>(data, out, w, h); break;
-    case 3: scaleJincTSSE41<3, 1>(data, out, w, h); break;
-    case 4: scaleJincTSSE41<4, 1>(data, out, w, h); break;
-    case 5: scaleJincTSSE41<5, 1>(data, out, w, h); break;
+    case 2: scaleJincTSSE41<2, 1>(data, out, w, h, l, u); break;
+    case 3: scaleJincTSSE41<3, 1>(data, out, w, h, l, u); break;
+    case 4: scaleJincTSSE41<4, 1>(data, out, w, h, l, u); break;
+    case 5: scaleJincTSSE41<5, 1>(data, out, w, h, l, u); break;
     default: ERROR_LOG(VIDEO, "Jinc upsampling only implemented for factors 2 to 5");
     }
   }
@@ -1341,10 +1347,10 @@ void scaleJincSharper(int factor, u32* data, u32* out, int w, int h)
 #endif
     switch (factor)
     {
-    case 2: scaleJincT<2, 1>(data, out, w, h); break;
-    case 3: scaleJincT<3, 1>(data, out, w, h); break;
-    case 4: scaleJincT<4, 1>(data, out, w, h); break;
-    case 5: scaleJincT<5, 1>(data, out, w, h); break;
+    case 2: scaleJincT<2, 1>(data, out, w, h, l, u); break;
+    case 3: scaleJincT<3, 1>(data, out, w, h, l, u); break;
+    case 4: scaleJincT<4, 1>(data, out, w, h, l, u); break;
+    case 5: scaleJincT<5, 1>(data, out, w, h, l, u); break;
     default: ERROR_LOG(VIDEO, "Jinc upsampling only implemented for factors 2 to 5");
     }
 #if _M_SSE >= 0x401
@@ -1353,17 +1359,17 @@ void scaleJincSharper(int factor, u32* data, u32* out, int w, int h)
 }
 
 
-void scaleSmoothstep(int factor, u32* data, u32* out, int w, int h)
+void scaleSmoothstep(int factor, u32* data, u32* out, int w, int h, int l, int u)
 {
 #if _M_SSE >= 0x401
   if (cpu_info.bSSE4_1)
   {
     switch (factor)
     {
-    case 2: scaleSmoothstepTSSE41<2>(data, out, w, h); break;
-    case 3: scaleSmoothstepTSSE41<3>(data, out, w, h); break;
-    case 4: scaleSmoothstepTSSE41<4>(data, out, w, h); break;
-    case 5: scaleSmoothstepTSSE41<5>(data, out, w, h); break;
+    case 2: scaleSmoothstepTSSE41<2>(data, out, w, h, l, u); break;
+    case 3: scaleSmoothstepTSSE41<3>(data, out, w, h, l, u); break;
+    case 4: scaleSmoothstepTSSE41<4>(data, out, w, h, l, u); break;
+    case 5: scaleSmoothstepTSSE41<5>(data, out, w, h, l, u); break;
     default: ERROR_LOG(VIDEO, "Smoothstep upsampling only implemented for factors 2 to 5");
     }
   }
@@ -1372,10 +1378,10 @@ void scaleSmoothstep(int factor, u32* data, u32* out, int w, int h)
 #endif
     switch (factor)
     {
-    case 2: scaleSmoothstepT<2>(data, out, w, h); break;
-    case 3: scaleSmoothstepT<3>(data, out, w, h); break;
-    case 4: scaleSmoothstepT<4>(data, out, w, h); break;
-    case 5: scaleSmoothstepT<5>(data, out, w, h); break;
+    case 2: scaleSmoothstepT<2>(data, out, w, h, l, u); break;
+    case 3: scaleSmoothstepT<3>(data, out, w, h, l, u); break;
+    case 4: scaleSmoothstepT<4>(data, out, w, h, l, u); break;
+    case 5: scaleSmoothstepT<5>(data, out, w, h, l, u); break;
     default: ERROR_LOG(VIDEO, "Smoothstep upsampling only implemented for factors 2 to 5");
     }
 #if _M_SSE >= 0x401
@@ -1384,17 +1390,17 @@ void scaleSmoothstep(int factor, u32* data, u32* out, int w, int h)
 }
 
 
-void scale3Point(int factor, u32* data, u32* out, int w, int h)
+void scale3Point(int factor, u32* data, u32* out, int w, int h, int l, int u)
 {
 #if _M_SSE >= 0x401
   if (cpu_info.bSSE4_1)
   {
     switch (factor)
     {
-    case 2: scale3PointTSSE41<2>(data, out, w, h); break;
-    case 3: scale3PointTSSE41<3>(data, out, w, h); break;
-    case 4: scale3PointTSSE41<4>(data, out, w, h); break;
-    case 5: scale3PointTSSE41<5>(data, out, w, h); break;
+    case 2: scale3PointTSSE41<2>(data, out, w, h, l, u); break;
+    case 3: scale3PointTSSE41<3>(data, out, w, h, l, u); break;
+    case 4: scale3PointTSSE41<4>(data, out, w, h, l, u); break;
+    case 5: scale3PointTSSE41<5>(data, out, w, h, l, u); break;
     default: ERROR_LOG(VIDEO, "3-Point upsampling only implemented for factors 2 to 5");
     }
   }
@@ -1403,10 +1409,10 @@ void scale3Point(int factor, u32* data, u32* out, int w, int h)
 #endif
     switch (factor)
     {
-    case 2: scale3PointT<2>(data, out, w, h); break;
-    case 3: scale3PointT<3>(data, out, w, h); break;
-    case 4: scale3PointT<4>(data, out, w, h); break;
-    case 5: scale3PointT<5>(data, out, w, h); break;
+    case 2: scale3PointT<2>(data, out, w, h, l, u); break;
+    case 3: scale3PointT<3>(data, out, w, h, l, u); break;
+    case 4: scale3PointT<4>(data, out, w, h, l, u); break;
+    case 5: scale3PointT<5>(data, out, w, h, l, u); break;
     default: ERROR_LOG(VIDEO, "3-Point upsampling only implemented for factors 2 to 5");
     }
 #if _M_SSE >= 0x401
@@ -1414,17 +1420,17 @@ void scale3Point(int factor, u32* data, u32* out, int w, int h)
 #endif
 }
 
-void scaleDDTSharp(int factor, u32* data, u32* out, int w, int h)
+void scaleDDTSharp(int factor, u32* data, u32* out, int w, int h, int l, int u)
 {
 #if _M_SSE >= 0x401
   if (cpu_info.bSSE4_1)
   {
     switch (factor)
     {
-    case 2: scaleDDTSharpTSSE41<2>(data, out, w, h); break;
-    case 3: scaleDDTSharpTSSE41<3>(data, out, w, h); break;
-    case 4: scaleDDTSharpTSSE41<4>(data, out, w, h); break;
-    case 5: scaleDDTSharpTSSE41<5>(data, out, w, h); break;
+    case 2: scaleDDTSharpTSSE41<2>(data, out, w, h, l, u); break;
+    case 3: scaleDDTSharpTSSE41<3>(data, out, w, h, l, u); break;
+    case 4: scaleDDTSharpTSSE41<4>(data, out, w, h, l, u); break;
+    case 5: scaleDDTSharpTSSE41<5>(data, out, w, h, l, u); break;
     default: ERROR_LOG(VIDEO, "DDT-Sharp upsampling only implemented for factors 2 to 5");
     }
   }
@@ -1433,10 +1439,10 @@ void scaleDDTSharp(int factor, u32* data, u32* out, int w, int h)
 #endif
     switch (factor)
     {
-    case 2: scaleDDTSharpT<2>(data, out, w, h); break;
-    case 3: scaleDDTSharpT<3>(data, out, w, h); break;
-    case 4: scaleDDTSharpT<4>(data, out, w, h); break;
-    case 5: scaleDDTSharpT<5>(data, out, w, h); break;
+    case 2: scaleDDTSharpT<2>(data, out, w, h, l, u); break;
+    case 3: scaleDDTSharpT<3>(data, out, w, h, l, u); break;
+    case 4: scaleDDTSharpT<4>(data, out, w, h, l, u); break;
+    case 5: scaleDDTSharpT<5>(data, out, w, h, l, u); break;
     default: ERROR_LOG(VIDEO, "DDT-Sharp upsampling only implemented for factors 2 to 5");
     }
 #if _M_SSE >= 0x401
@@ -1444,17 +1450,17 @@ void scaleDDTSharp(int factor, u32* data, u32* out, int w, int h)
 #endif
 }
 
-void scaleDDT(int factor, u32* data, u32* out, int w, int h)
+void scaleDDT(int factor, u32* data, u32* out, int w, int h, int l, int u)
 {
 #if _M_SSE >= 0x401
   if (cpu_info.bSSE4_1)
   {
     switch (factor)
     {
-    case 2: scaleDDTTSSE41<2>(data, out, w, h); break;
-    case 3: scaleDDTTSSE41<3>(data, out, w, h); break;
-    case 4: scaleDDTTSSE41<4>(data, out, w, h); break;
-    case 5: scaleDDTTSSE41<5>(data, out, w, h); break;
+    case 2: scaleDDTTSSE41<2>(data, out, w, h, l, u); break;
+    case 3: scaleDDTTSSE41<3>(data, out, w, h, l, u); break;
+    case 4: scaleDDTTSSE41<4>(data, out, w, h, l, u); break;
+    case 5: scaleDDTTSSE41<5>(data, out, w, h, l, u); break;
     default: ERROR_LOG(VIDEO, "DDT upsampling only implemented for factors 2 to 5");
     }
   }
@@ -1463,10 +1469,10 @@ void scaleDDT(int factor, u32* data, u32* out, int w, int h)
 #endif
     switch (factor)
     {
-    case 2: scaleDDTT<2>(data, out, w, h); break;
-    case 3: scaleDDTT<3>(data, out, w, h); break;
-    case 4: scaleDDTT<4>(data, out, w, h); break;
-    case 5: scaleDDTT<5>(data, out, w, h); break;
+    case 2: scaleDDTT<2>(data, out, w, h, l, u); break;
+    case 3: scaleDDTT<3>(data, out, w, h, l, u); break;
+    case 4: scaleDDTT<4>(data, out, w, h, l, u); break;
+    case 5: scaleDDTT<5>(data, out, w, h, l, u); break;
     default: ERROR_LOG(VIDEO, "DDT upsampling only implemented for factors 2 to 5");
     }
 #if _M_SSE >= 0x401
@@ -1615,7 +1621,9 @@ void dbgPGM(int w, int h, u32* pixels, const char* prefix = "dbg")
 
 TextureScaler::TextureScaler()
 {
-  initFilterWeights();
+  // The weights are shared by all the scalers, some may be scaling on other threads
+  static std::once_flag weights_initialized;
+  std::call_once(weights_initialized, initFilterWeights);
 }
 
 TextureScaler::~TextureScaler()
@@ -1633,6 +1641,11 @@ bool TextureScaler::IsEmptyOrFlat(u32* data, int pixels)
 }
 
 u32* TextureScaler::Scale(u32* data, int width, int height)
+{
+  return Scale(data, width, height, g_ActiveConfig.iTexScalingType, g_ActiveConfig.iTexScalingFactor, g_ActiveConfig.bTexDeposterize);
+}
+
+u32* TextureScaler::Scale(u32* data, int width, int height, int type, int factor, bool deposterize)
 {
   // prevent processing empty or flat textures (this happens a lot in some games)
   // doesn't hurt the standard case, will be very quick for textures with actual texture
@@ -1644,14 +1657,13 @@ u32* TextureScaler::Scale(u32* data, int width, int height)
 #ifdef SCALING_MEASURE_TIME
   double t_start = real_time_now();
 #endif
-  int factor = g_ActiveConfig.iTexScalingFactor;
   //bufInput.resize(width*height); // used to store the input image image if it needs to be reformatted
   bufOutput.resize(width*height*factor*factor); // used to store the upscaled image
   u32 *inputBuf = data;
   u32 *outputBuf = bufOutput.data();
 
   // deposterize
-  if (g_ActiveConfig.bTexDeposterize)
+  if (deposterize)
   {
     bufDeposter.resize(width*height);
     DePosterize(inputBuf, bufDeposter.data(), width, height);
@@ -1659,7 +1671,7 @@ u32* TextureScaler::Scale(u32* data, int width, int height)
   }
 
   // scale 
-  switch (g_ActiveConfig.iTexScalingType)
+  switch (type)
   {
   case XBRZ:
     ScaleXBRZ(factor, inputBuf, outputBuf, width, height);
@@ -1692,7 +1704,7 @@ u32* TextureScaler::Scale(u32* data, int width, int height)
     ScaleDDTSharp(factor, inputBuf, outputBuf, width, height);
     break;
   default:
-    ERROR_LOG(VIDEO, "Unknown scaling type: %d", g_ActiveConfig.iTexScalingType);
+    ERROR_LOG(VIDEO, "Unknown scaling type: %d", type);
   }
 #ifdef SCALING_MEASURE_TIME
   if (width*height > 64 * 64 * factor*factor)
@@ -1705,33 +1717,37 @@ u32* TextureScaler::Scale(u32* data, int width, int height)
   return outputBuf;
 }
 
+void TextureScaler::ParallelLoop(const std::function<void(int, int)>& func, int width, int lower, int upper)
+{
+  // keep the bands big enough to make the dispatch overhead irrelevant
+  int min_band = std::max(MIN_BAND_PIXELS / std::max(width, 1), 1);
+  Common::LoopWorker::Loop(func, lower, upper, min_band, m_max_threads);
+}
+
 void TextureScaler::ScaleXBRZ(int factor, u32* source, u32* dest, int width, int height)
 {
   xbrz::ScalerCfg cfg;
-  //GlobalThreadPool::Loop(std::bind(&xbrz::scale, factor, source, dest, width, height, xbrz::ColorFormat::ARGB, cfg, placeholder::_1, placeholder::_2), 0, height);
-  xbrz::scale(factor, source, dest, width, height, xbrz::ColorFormat::ARGB, cfg, 0, height);
+  ParallelLoop([&](int l, int u) {
+    xbrz::scale(factor, source, dest, width, height, xbrz::ColorFormat::ARGB, cfg, l, u);
+  }, width, 0, height);
 }
 
 void TextureScaler::ScaleBilinear(int factor, u32* source, u32* dest, int width, int height)
 {
   bufTmp1.resize(width*height*factor);
   u32 *tmpBuf = bufTmp1.data();
-  //GlobalThreadPool::Loop(std::bind(&bilinearH, factor, source, tmpBuf, width, placeholder::_1, placeholder::_2), 0, height);
-  //GlobalThreadPool::Loop(std::bind(&bilinearV, factor, tmpBuf, dest, width, 0, height, placeholder::_1, placeholder::_2), 0, height);
-  bilinearH(factor, source, tmpBuf, width, 0, height);
-  bilinearV(factor, tmpBuf, dest, width, 0, height, 0, height);
+  ParallelLoop([&](int l, int u) { bilinearH(factor, source, tmpBuf, width, l, u); }, width, 0, height);
+  ParallelLoop([&](int l, int u) { bilinearV(factor, tmpBuf, dest, width, 0, height, l, u); }, width * factor, 0, height);
 }
 
 void TextureScaler::ScaleBicubicBSpline(int factor, u32* source, u32* dest, int width, int height)
 {
-  //GlobalThreadPool::Loop(std::bind(&scaleBicubicBSpline, factor, source, dest, width, height, placeholder::_1, placeholder::_2), 0, height);
-  scaleBicubicBSpline(factor, source, dest, width, height, 0, height);
+  ParallelLoop([&](int l, int u) { scaleBicubicBSpline(factor, source, dest, width, height, l, u); }, width, 0, height + 1);
 }
 
 void TextureScaler::ScaleBicubicMitchell(int factor, u32* source, u32* dest, int width, int height)
 {
-  //GlobalThreadPool::Loop(std::bind(&scaleBicubicMitchell, factor, source, dest, width, height, placeholder::_1, placeholder::_2), 0, height);
-  scaleBicubicMitchell(factor, source, dest, width, height, 0, height);
+  ParallelLoop([&](int l, int u) { scaleBicubicMitchell(factor, source, dest, width, height, l, u); }, width, 0, height + 1);
 }
 
 void TextureScaler::ScaleHybrid(int factor, u32* source, u32* dest, int width, int height, bool bicubic)
@@ -1748,10 +1764,8 @@ void TextureScaler::ScaleHybrid(int factor, u32* source, u32* dest, int width, i
   bufTmp1.resize(width*height);
   bufTmp2.resize(width*height*factor*factor);
   bufTmp3.resize(width*height*factor*factor);
-  //GlobalThreadPool::Loop(std::bind(&generateDistanceMask, source, bufTmp1.data(), width, height, placeholder::_1, placeholder::_2), 0, height);
-  //GlobalThreadPool::Loop(std::bind(&convolve3x3, bufTmp1.data(), bufTmp2.data(), KERNEL_SPLAT, width, height, placeholder::_1, placeholder::_2), 0, height);
-  generateDistanceMask(source, bufTmp1.data(), width, height, 0, height);
-  convolve3x3(bufTmp1.data(), bufTmp2.data(), KERNEL_SPLAT, width, height, 0, height);
+  ParallelLoop([&](int l, int u) { generateDistanceMask(source, bufTmp1.data(), width, height, l, u); }, width, 0, height);
+  ParallelLoop([&](int l, int u) { convolve3x3(bufTmp1.data(), bufTmp2.data(), KERNEL_SPLAT, width, height, l, u); }, width, 0, height);
 
   ScaleBilinear(factor, bufTmp2.data(), bufTmp3.data(), width, height);
   // mask C is now in bufTmp3
@@ -1765,55 +1779,44 @@ void TextureScaler::ScaleHybrid(int factor, u32* source, u32* dest, int width, i
 
   // Now we can mix it all together
   // The factor 8192 was found through practical testing on a variety of textures
-  //GlobalThreadPool::Loop(std::bind(&mix, dest, bufTmp2.data(), bufTmp3.data(), 8192, width*factor, placeholder::_1, placeholder::_2), 0, height*factor);
-  mix(dest, bufTmp2.data(), bufTmp3.data(), 8192, width*factor, 0, height*factor);
+  ParallelLoop([&](int l, int u) { mix(dest, bufTmp2.data(), bufTmp3.data(), 8192, width*factor, l, u); }, width * factor, 0, height*factor);
 }
 
 void TextureScaler::ScaleJinc(int factor, u32* source, u32* dest, int width, int height)
 {
-  //GlobalThreadPool::Loop(std::bind(&scaleJinc, factor, source, dest, width, height), 0, height);
-  scaleJinc(factor, source, dest, width, height);
+  ParallelLoop([&](int l, int u) { scaleJinc(factor, source, dest, width, height, l, u); }, width, 0, height + 1);
 }
 
 void TextureScaler::ScaleJincSharper(int factor, u32* source, u32* dest, int width, int height)
 {
-  //GlobalThreadPool::Loop(std::bind(&scaleJincSharper, factor, source, dest, width, height), 0, height);
-  scaleJincSharper(factor, source, dest, width, height);
+  ParallelLoop([&](int l, int u) { scaleJincSharper(factor, source, dest, width, height, l, u); }, width, 0, height + 1);
 }
 
 void TextureScaler::ScaleSmoothstep(int factor, u32* source, u32* dest, int width, int height)
 {
-  //GlobalThreadPool::Loop(std::bind(&scaleSmoothstep, factor, source, dest, width, height), 0, height);
-  scaleSmoothstep(factor, source, dest, width, height);
+  ParallelLoop([&](int l, int u) { scaleSmoothstep(factor, source, dest, width, height, l, u); }, width, 0, height + 1);
 }
 
 void TextureScaler::Scale3Point(int factor, u32* source, u32* dest, int width, int height)
 {
-  //GlobalThreadPool::Loop(std::bind(&scale3Point, factor, source, dest, width, height), 0, height);
-  scale3Point(factor, source, dest, width, height);
+  ParallelLoop([&](int l, int u) { scale3Point(factor, source, dest, width, height, l, u); }, width, 0, height + 1);
 }
 
 void TextureScaler::ScaleDDT(int factor, u32* source, u32* dest, int width, int height)
 {
-  //GlobalThreadPool::Loop(std::bind(&scaleDDT, factor, source, dest, width, height), 0, height);
-  scaleDDT(factor, source, dest, width, height);
+  ParallelLoop([&](int l, int u) { scaleDDT(factor, source, dest, width, height, l, u); }, width, 0, height + 1);
 }
 
 void TextureScaler::ScaleDDTSharp(int factor, u32* source, u32* dest, int width, int height)
 {
-  //GlobalThreadPool::Loop(std::bind(&scaleDDTSharp, factor, source, dest, width, height), 0, height);
-  scaleDDTSharp(factor, source, dest, width, height);
+  ParallelLoop([&](int l, int u) { scaleDDTSharp(factor, source, dest, width, height, l, u); }, width, 0, height + 1);
 }
 
 void TextureScaler::DePosterize(u32* source, u32* dest, int width, int height)
 {
   bufTmp3.resize(width*height);
-  //GlobalThreadPool::Loop(std::bind(&deposterizeH, source, bufTmp3.data(), width, placeholder::_1, placeholder::_2), 0, height);
-  //GlobalThreadPool::Loop(std::bind(&deposterizeV, bufTmp3.data(), dest, width, height, placeholder::_1, placeholder::_2), 0, height);
-  //GlobalThreadPool::Loop(std::bind(&deposterizeH, dest, bufTmp3.data(), width, placeholder::_1, placeholder::_2), 0, height);
-  //GlobalThreadPool::Loop(std::bind(&deposterizeV, bufTmp3.data(), dest, width, height, placeholder::_1, placeholder::_2), 0, height);
-  deposterizeH(source, bufTmp3.data(), width, 0, height);
-  deposterizeV(bufTmp3.data(), dest, width, height, 0, height);
-  deposterizeH(dest, bufTmp3.data(), width, 0, height);
-  deposterizeV(bufTmp3.data(), dest, width, height, 0, height);
+  ParallelLoop([&](int l, int u) { deposterizeH(source, bufTmp3.data(), width, l, u); }, width, 0, height);
+  ParallelLoop([&](int l, int u) { deposterizeV(bufTmp3.data(), dest, width, height, l, u); }, width, 0, height);
+  ParallelLoop([&](int l, int u) { deposterizeH(dest, bufTmp3.data(), width, l, u); }, width, 0, height);
+  ParallelLoop([&](int l, int u) { deposterizeV(bufTmp3.data(), dest, width, height, l, u); }, width, 0, height);
 }
@@ -20,6 +20,7 @@
 #include "Common/CommonTypes.h"
 #include "Common/MemoryUtil.h"
 
+#include <functional>
 #include <vector>
 
 class TextureScaler
@@ -29,6 +30,10 @@ public:
   ~TextureScaler();
 
   u32* Scale(u32* data, int width, int height);
+  // Same as above but with explicit settings instead of the active config, for use outside the GPU thread
+  u32* Scale(u32* data, int width, int height, int type, int factor, bool deposterize);
+  // Limits the threads used by a single scaling operation, 0 uses the whole thread pool
+  void SetMaxThreads(int threads) { m_max_threads = threads; }
 
   enum
   {
@@ -36,6 +41,10 @@ public:
   };
 
 private:
+  // minimum amount of pixels processed by each thread in a parallel pass
+  static const int MIN_BAND_PIXELS = 64 * 64;
+
+  void ParallelLoop(const std::function<void(int, int)>& func, int width, int lower, int upper);
 
   void ScaleXBRZ(int factor, u32* source, u32* dest, int width, int height);
   void ScaleBilinear(int factor, u32* source, u32* dest, int width, int height);
@@ -53,6 +62,8 @@ private:
 
   bool IsEmptyOrFlat(u32* data, int pixels);
 
+  int m_max_threads = 0;
+
   // depending on the factor and texture sizes, these can get pretty large 
   // maximum is (100 MB total for a 512 by 512 texture with scaling factor 5 and hybrid scaling)
   // of course, scaling factor 5 is totally silly anyway
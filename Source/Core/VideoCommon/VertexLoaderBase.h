@@ -68,6 +68,14 @@ public:
   {
     return m_fallback.get();
   }
+  const TVtxDesc& GetVtxDesc() const
+  {
+    return m_VtxDesc;
+  }
+  const VAT& GetVAT() const
+  {
+    return m_vat;
+  }
   virtual bool EnvironmentIsSupported()
   {
     return true;
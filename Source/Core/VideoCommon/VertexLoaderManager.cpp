@@ -3,17 +3,24 @@
 // Refer to the license.txt file included.
 // Modified for Ishiiruka by Tino
 
+#include <algorithm>
+#include <cstring>
 #include <map>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 
 #include "Core/ConfigManager.h"
 #include "Core/HW/Memmap.h"
 
+#include "Common/CommonPaths.h"
+#include "Common/File.h"
+#include "Common/FileUtil.h"
 #include "Common/ThreadPool.h"
 #include "Common/StringUtil.h"
 
+#include "VideoCommon/FrameProfiler.h"
 #include "VideoCommon/IndexGenerator.h"
 #include "VideoCommon/Statistics.h"
 #include "VideoCommon/VertexLoaderManager.h"
@@ -32,6 +39,22 @@ namespace VertexLoaderManager
 {
 static VertexLoaderMap s_vertex_loader_map;
 static NativeVertexFormatMap s_native_vertex_map;
+
+// Per game record of the vertex formats that were used and how many vertices they loaded.
+// Loaders for the formats in it are compiled at boot instead of on first use.
+struct LoaderProfileEntry
+{
+  u64 vtx_desc;
+  u32 vat[3];
+  u32 padding;
+  u64 num_verts;
+};
+static const u32 LOADER_PROFILE_MAGIC = 0x31504C56;  // "VLP1"
+static const size_t MAX_PROFILE_ENTRIES = 512;
+static std::vector<LoaderProfileEntry> s_loader_profile;
+
+static void LoadLoaderProfile();
+static void SaveLoaderProfile();
 static NativeVertexFormat* s_current_vtx_fmt;
 u32 g_current_components;
 
@@ -185,12 +208,14 @@ void Init()
   for (VertexLoaderBase*& vertexLoader : g_main_cp_state.vertex_loaders)
     vertexLoader = nullptr;
   last_game_code = SConfig::GetInstance().GetGameID();
+  LoadLoaderProfile();
 }
 
 void Shutdown()
 {
   if (s_vertex_loader_map.size() > 0 && g_ActiveConfig.bDumpVertexLoaders)
     DumpLoadersCode();
+  SaveLoaderProfile();
   s_vertex_loader_map.clear();
   s_native_vertex_map.clear();
 }
@@ -306,18 +331,120 @@ inline VertexLoaderBase *GetOrAddLoader(const TVtxDesc &VtxDesc, const VAT &VtxA
   VertexLoaderMap::iterator iter = s_vertex_loader_map.find(uid);
   if (iter == s_vertex_loader_map.end())
   {
-    s_vertex_loader_map[uid] = VertexLoaderBase::CreateVertexLoader(VtxDesc, VtxAttr);
-    VertexLoaderBase* loader = s_vertex_loader_map[uid].get();
+    iter = s_vertex_loader_map.emplace(uid, VertexLoaderBase::CreateVertexLoader(VtxDesc, VtxAttr)).first;
+    INCSTAT(stats.numVertexLoaders);
+  }
+  VertexLoaderBase* loader = iter->second.get();
+  // Loaders compiled from the profile exist before the vertex manager, they get their format on first use
+  if (!loader->m_native_vertex_format && g_vertex_manager)
+  {
     loader->m_native_vertex_format = GetNativeVertexFormat(loader->m_native_vtx_decl);
     VertexLoaderBase * fallback = loader->GetFallback();
     if (fallback)
     {
       fallback->m_native_vertex_format = GetNativeVertexFormat(fallback->m_native_vtx_decl);
     }
-    INCSTAT(stats.numVertexLoaders);
-    return loader;
   }
-  return iter->second.get();
+  return loader;
+}
+
+static std::string GetLoaderProfileFileName()
+{
+  return File::GetUserPath(D_CACHE_IDX) + VERTEXLOADERS_DIR DIR_SEP + last_game_code + ".vlp";
+}
+
+static void LoadLoaderProfile()
+{
+  s_loader_profile.clear();
+  if (last_game_code.empty())
+    return;
+
+  File::IOFile file(GetLoaderProfileFileName(), "rb");
+  u32 magic = 0;
+  if (!file || !file.ReadArray(&magic, 1) || magic != LOADER_PROFILE_MAGIC)
+    return;
+  size_t count = std::min<size_t>((file.GetSize() - sizeof(magic)) / sizeof(LoaderProfileEntry),
+    MAX_PROFILE_ENTRIES);
+  s_loader_profile.resize(count);
+  if (!file.ReadArray(s_loader_profile.data(), count))
+  {
+    s_loader_profile.clear();
+    return;
+  }
+
+  // The profile is sorted by vertex count, so the hottest formats are compiled first
+  for (const LoaderProfileEntry& entry : s_loader_profile)
+  {
+    TVtxDesc vtx_desc;
+    vtx_desc.Hex = entry.vtx_desc;
+    VAT vat;
+    vat.g0.Hex = entry.vat[0];
+    vat.g1.Hex = entry.vat[1];
+    vat.g2.Hex = entry.vat[2];
+    GetOrAddLoader(vtx_desc, vat);
+  }
+  INFO_LOG(VIDEO, "Compiled %zu vertex loaders from the profile of %s", s_loader_profile.size(),
+    last_game_code.c_str());
+}
+
+static void SaveLoaderProfile()
+{
+  if (last_game_code.empty() || s_vertex_loader_map.empty())
+    return;
+
+  // Halve the old counts, so formats the game stopped using drop out over time
+  std::map<VertexLoaderUID, LoaderProfileEntry> entries;
+  for (LoaderProfileEntry entry : s_loader_profile)
+  {
+    TVtxDesc vtx_desc;
+    vtx_desc.Hex = entry.vtx_desc;
+    VAT vat;
+    vat.g0.Hex = entry.vat[0];
+    vat.g1.Hex = entry.vat[1];
+    vat.g2.Hex = entry.vat[2];
+    entry.num_verts /= 2;
+    entries[VertexLoaderUID(vtx_desc, vat)] = entry;
+  }
+  for (const auto& iter : s_vertex_loader_map)
+  {
+    VertexLoaderBase* loader = iter.second.get();
+    u64 num_verts = loader->m_numLoadedVertices;
+    if (loader->GetFallback())
+      num_verts += loader->GetFallback()->m_numLoadedVertices;
+    auto found = entries.find(iter.first);
+    if (found != entries.end())
+    {
+      found->second.num_verts += num_verts;
+    }
+    else if (num_verts != 0)
+    {
+      LoaderProfileEntry entry = {};
+      entry.vtx_desc = loader->GetVtxDesc().Hex;
+      entry.vat[0] = loader->GetVAT().g0.Hex;
+      entry.vat[1] = loader->GetVAT().g1.Hex;
+      entry.vat[2] = loader->GetVAT().g2.Hex;
+      entry.num_verts = num_verts;
+      entries[iter.first] = entry;
+    }
+  }
+
+  std::vector<LoaderProfileEntry> profile;
+  for (const auto& iter : entries)
+  {
+    if (iter.second.num_verts != 0)
+      profile.push_back(iter.second);
+  }
+  std::sort(profile.begin(), profile.end(), [](const LoaderProfileEntry& a, const LoaderProfileEntry& b) {
+    return a.num_verts > b.num_verts;
+  });
+  if (profile.size() > MAX_PROFILE_ENTRIES)
+    profile.resize(MAX_PROFILE_ENTRIES);
+
+  const std::string filename = GetLoaderProfileFileName();
+  File::CreateFullPath(filename);
+  File::IOFile file(filename, "wb");
+  if (!file || !file.WriteArray(&LOADER_PROFILE_MAGIC, 1) || !file.WriteArray(profile.data(), profile.size()))
+    WARN_LOG(VIDEO, "Failed to write the vertex loader profile %s", filename.c_str());
 }
 
 void GetVertexSizeAndComponents(const VertexLoaderParameters &parameters, u32 &vertexsize, u32 &components)
@@ -336,7 +463,7 @@ inline void UpdateLoader(const VertexLoaderParameters &parameters)
   g_main_cp_state.last_id = parameters.vtx_attr_group;
 }
 
-bool ConvertVertices(VertexLoaderParameters &parameters, u32 &readsize, u32 &writesize)
+VertexLoaderBase* GetLoader(const VertexLoaderParameters &parameters)
 {
   if (parameters.needloaderrefresh)
   {
@@ -347,13 +474,11 @@ bool ConvertVertices(VertexLoaderParameters &parameters, u32 &readsize, u32 &wri
   {
     loader = loader->GetFallback();
   }
-  readsize = parameters.count * loader->m_VertexSize;
-  if (parameters.buf_size < readsize)
-    return false;
-  if (parameters.skip_draw)
-  {
-    return true;
-  }
+  return loader;
+}
+
+static void PrepareForVertices(VertexLoaderBase* loader, int primitive, int count)
+{
   // Lookup pointers for any vertex arrays.
   UpdateVertexArrayPointers();
   NativeVertexFormat *nativefmt = loader->m_native_vertex_format;
@@ -365,9 +490,26 @@ bool ConvertVertices(VertexLoaderParameters &parameters, u32 &readsize, u32 &wri
   s_current_vtx_fmt = nativefmt;
   g_current_components = loader->m_native_components;
   VertexShaderManager::SetVertexFormat(loader->m_native_components);
-  g_vertex_manager->PrepareForAdditionalData(parameters.primitive, parameters.count, loader->m_native_stride);
+  g_vertex_manager->PrepareForAdditionalData(primitive, count, loader->m_native_stride);
+}
+
+bool ConvertVertices(VertexLoaderParameters &parameters, u32 &readsize, u32 &writesize)
+{
+  auto loader = GetLoader(parameters);
+  readsize = parameters.count * loader->m_VertexSize;
+  if (parameters.buf_size < readsize)
+    return false;
+  if (parameters.skip_draw)
+  {
+    return true;
+  }
+  PrepareForVertices(loader, parameters.primitive, parameters.count);
   parameters.destination = g_vertex_manager->GetCurrentBufferPointer();
-  s32 finalcount = loader->RunVertices(parameters);
+  s32 finalcount;
+  {
+    FrameProfiler::Scope profile_scope(FrameProfiler::Stage::VertexLoader);
+    finalcount = loader->RunVertices(parameters);
+  }
   writesize = loader->m_native_stride * finalcount;
   IndexGenerator::AddIndices(parameters.primitive, finalcount);
   ADDSTAT(stats.thisFrame.numPrims, finalcount);
@@ -375,6 +517,17 @@ bool ConvertVertices(VertexLoaderParameters &parameters, u32 &readsize, u32 &wri
   return true;
 }
 
+u32 AddConvertedVertices(VertexLoaderBase* loader, int primitive, int count, const u8* data, int finalcount)
+{
+  PrepareForVertices(loader, primitive, count);
+  u32 writesize = loader->m_native_stride * finalcount;
+  memcpy(g_vertex_manager->GetCurrentBufferPointer(), data, writesize);
+  IndexGenerator::AddIndices(primitive, finalcount);
+  ADDSTAT(stats.thisFrame.numPrims, finalcount);
+  INCSTAT(stats.thisFrame.numPrimitiveJoins);
+  return writesize;
+}
+
 int GetVertexSize(const VertexLoaderParameters &parameters)
 {
   if (parameters.needloaderrefresh)
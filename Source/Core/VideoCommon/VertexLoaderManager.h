@@ -32,6 +32,12 @@ int GetVertexSize(const VertexLoaderParameters &parameters);
 
 bool ConvertVertices(VertexLoaderParameters &parameters, u32 &readsize, u32 &writesize);
 
+// Returns the loader ConvertVertices would use for parameters
+VertexLoaderBase* GetLoader(const VertexLoaderParameters &parameters);
+// Adds vertices that were converted by loader before, returns the size written to the vertex buffer.
+// count is the number of vertices of the draw, finalcount the number the loader produced from them.
+u32 AddConvertedVertices(VertexLoaderBase* loader, int primitive, int count, const u8* data, int finalcount);
+
 void GetVertexSizeAndComponents(const VertexLoaderParameters &parameters, u32 &vertexsize, u32 &components);
 
 // For debugging
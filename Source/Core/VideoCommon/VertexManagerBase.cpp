@@ -11,6 +11,7 @@
 
 #include "VideoCommon/BPStructs.h"
 #include "VideoCommon/Debugger.h"
+#include "VideoCommon/FrameProfiler.h"
 #include "VideoCommon/GeometryShaderManager.h"
 #include "VideoCommon/TessellationShaderManager.h"
 #include "VideoCommon/IndexGenerator.h"
@@ -205,6 +206,7 @@ static void SetSamplerState(u32 index, bool custom_tex)
 
 void VertexManagerBase::DoFlush()
 {
+  FrameProfiler::Scope profile_scope(FrameProfiler::Stage::Flush);
   // loading a state will invalidate BP, so check for it
   NativeVertexFormat* current_vertex_format = VertexLoaderManager::GetCurrentVertexFormat();
   g_video_backend->CheckInvalidState();
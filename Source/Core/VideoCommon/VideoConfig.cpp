@@ -54,6 +54,9 @@ VideoConfig::VideoConfig()
   iStereoConvergence = 20;
   bUseScalingFilter = false;
   bTexDeposterize = false;
+  bTexScalingAsync = false;
+  bTexScalingCache = false;
+  iTexScalingCacheSize = 2048;
   iTexScalingType = 0;
   iTexScalingFactor = 2;
   backend_info.bSupportsMultithreading = false;
@@ -163,6 +166,9 @@ void VideoConfig::Refresh()
   iTexScalingType = Config::Get(Config::GFX_ENHANCE_TEXTURE_SCALING_TYPE);
   iTexScalingFactor = Config::Get(Config::GFX_ENHANCE_TEXTURE_SCALING_FACTOR);
   bTexDeposterize = Config::Get(Config::GFX_ENHANCE_USE_DEPOSTERIZE);
+  bTexScalingAsync = Config::Get(Config::GFX_ENHANCE_TEXTURE_SCALING_ASYNC);
+  bTexScalingCache = Config::Get(Config::GFX_ENHANCE_TEXTURE_SCALING_CACHE);
+  iTexScalingCacheSize = Config::Get(Config::GFX_ENHANCE_TEXTURE_SCALING_CACHE_SIZE);
 
   bTessellation = Config::Get(Config::GFX_ENHANCE_TESSELLATION);
   bTessellationEarlyCulling = Config::Get(Config::GFX_ENHANCE_TESSELLATION_EARLY_CULLING);
@@ -193,6 +199,7 @@ void VideoConfig::Refresh()
   bFullAsyncShaderCompilation = Config::Get(Config::GFX_HACK_FULL_ASYNC_SHADER_COMPILATION);
   bLastStoryEFBToRam = Config::Get(Config::GFX_HACK_LAST_HISTORY_EFBTORAM);
   bForceLogicOpBlend = Config::Get(Config::GFX_HACK_FORCE_LOGICOP_BLEND);
+  bDisplayListCache = Config::Get(Config::GFX_HACK_DISPLAY_LIST_CACHE);
 
   bBackgroundShaderCompiling = Config::Get(Config::GFX_BACKGROUND_SHADER_COMPILING);
   bDisableSpecializedShaders = Config::Get(Config::GFX_DISABLE_SPECIALIZED_SHADERS);
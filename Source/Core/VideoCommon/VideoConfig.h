@@ -124,6 +124,9 @@ struct VideoConfig final
   std::string sStereoShader;
   bool bUseScalingFilter;
   bool bTexDeposterize;
+  bool bTexScalingAsync;
+  bool bTexScalingCache;
+  int iTexScalingCacheSize;
   int iTexScalingType;
   int iTexScalingFactor;
   bool bTessellation;
@@ -194,6 +197,7 @@ struct VideoConfig final
   int iSpecularMultiplier;
   bool bLastStoryEFBToRam;
   bool bForceLogicOpBlend;
+  bool bDisplayListCache;
 
   bool bSimBumpEnabled;
   int iSimBumpDetailBlend;
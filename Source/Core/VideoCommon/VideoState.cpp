@@ -8,6 +8,7 @@
 #include "VideoCommon/CommandProcessor.h"
 #include "VideoCommon/CPMemory.h"
 #include "VideoCommon/Fifo.h"
+#include "VideoCommon/GenericDLCache.h"
 #include "VideoCommon/GeometryShaderManager.h"
 #include "VideoCommon/TessellationShaderManager.h"
 #include "VideoCommon/PixelEngine.h"
@@ -64,6 +65,10 @@ void VideoCommon_DoState(PointerWrap &p)
   BoundingBox::DoState(p);
   p.DoMarker("BoundingBox");
 
+  // Recorded display lists depend on the vertex state that was just replaced
+  if (p.GetMode() == PointerWrap::MODE_READ)
+    DLCache::Clear();
+
 
   // TODO: search for more data that should be saved and add it here
 }
\ No newline at end of file
@@ -0,0 +1,155 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/File.h"
+#include "Common/FileUtil.h"
+#include "Common/LinearDiskCache.h"
+
+namespace
+{
+class CountingReader : public LinearDiskCacheReader<u32, u8>
+{
+public:
+  void Read(const u32& key, const u8* value, u32 value_size) override { count++; }
+  int count = 0;
+};
+
+class LinearDiskCacheTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_dir = File::CreateTempDir();
+    m_filename = m_dir + "/cache.bin";
+  }
+  void TearDown() override { File::DeleteDirRecursively(m_dir); }
+  std::string m_dir;
+  std::string m_filename;
+};
+}
+
+TEST_F(LinearDiskCacheTest, LookupAfterReopen)
+{
+  const std::vector<u8> value = {1, 2, 3, 4, 5};
+  {
+    LinearDiskCache<u32, u8> cache;
+    EXPECT_EQ(0u, cache.Open(m_filename, "test"));
+    cache.Append(1, value.data(), static_cast<u32>(value.size()));
+    cache.Append(2, value.data(), 0);
+
+    u32 size = 0;
+    const u8* data = cache.Lookup(1, &size);
+    ASSERT_NE(nullptr, data);
+    EXPECT_EQ(std::vector<u8>(data, data + size), value);
+  }
+
+  LinearDiskCache<u32, u8> cache;
+  EXPECT_EQ(2u, cache.Open(m_filename, "test"));
+  u32 size = 0;
+  const u8* data = cache.Lookup(1, &size);
+  ASSERT_NE(nullptr, data);
+  EXPECT_EQ(std::vector<u8>(data, data + size), value);
+  EXPECT_NE(nullptr, cache.Lookup(2, &size));
+  EXPECT_EQ(0u, size);
+  EXPECT_EQ(nullptr, cache.Lookup(3, &size));
+}
+
+TEST_F(LinearDiskCacheTest, VersionMismatchRecreates)
+{
+  const u8 value = 42;
+  {
+    LinearDiskCache<u32, u8> cache;
+    cache.Open(m_filename, "old");
+    cache.Append(1, &value, 1);
+  }
+  LinearDiskCache<u32, u8> cache;
+  EXPECT_EQ(0u, cache.Open(m_filename, "new"));
+  EXPECT_FALSE(cache.Contains(1));
+}
+
+TEST_F(LinearDiskCacheTest, IncompleteAppendIsDropped)
+{
+  const std::vector<u8> value(100, 7);
+  {
+    LinearDiskCache<u32, u8> cache;
+    cache.Open(m_filename, "test");
+    cache.Append(1, value.data(), static_cast<u32>(value.size()));
+    cache.Append(2, value.data(), static_cast<u32>(value.size()));
+  }
+  {
+    File::IOFile file(m_filename, "r+b");
+    ASSERT_TRUE(file.Resize(file.GetSize() - 10));
+  }
+
+  LinearDiskCache<u32, u8> cache;
+  CountingReader reader;
+  EXPECT_EQ(1u, cache.OpenAndRead(m_filename, reader, "test"));
+  EXPECT_EQ(1, reader.count);
+  EXPECT_TRUE(cache.Contains(1));
+  EXPECT_FALSE(cache.Contains(2));
+
+  // Appends continue after the last complete record
+  cache.Append(3, value.data(), static_cast<u32>(value.size()));
+  cache.Close();
+  EXPECT_EQ(2u, cache.Open(m_filename, "test"));
+}
+
+TEST_F(LinearDiskCacheTest, CorruptValueIsIgnored)
+{
+  const std::vector<u8> value(100, 7);
+  {
+    LinearDiskCache<u32, u8> cache;
+    cache.Open(m_filename, "test");
+    cache.Append(1, value.data(), static_cast<u32>(value.size()));
+  }
+  {
+    File::IOFile file(m_filename, "r+b");
+    file.Seek(file.GetSize() - 8, SEEK_SET);
+    const u8 garbage = 0;
+    file.WriteBytes(&garbage, 1);
+  }
+
+  LinearDiskCache<u32, u8> cache;
+  cache.Open(m_filename, "test");
+  u32 size;
+  EXPECT_EQ(nullptr, cache.Lookup(1, &size));
+}
+
+TEST_F(LinearDiskCacheTest, CompactsStaleValues)
+{
+  std::vector<u8> value(4096);
+  {
+    LinearDiskCache<u32, u8> cache;
+    cache.Open(m_filename, "test");
+    for (u8 version = 0; version < 4; version++)
+    {
+      value[0] = version;
+      for (u32 key = 0; key < 64; key++)
+        cache.Append(key, value.data(), static_cast<u32>(value.size()));
+    }
+  }
+  const u64 size_before = File::GetSize(m_filename);
+  {
+    LinearDiskCache<u32, u8> cache;
+    EXPECT_EQ(64u, cache.Open(m_filename, "test"));
+    value[0] = 4;
+    cache.Append(64, value.data(), static_cast<u32>(value.size()));
+  }
+  EXPECT_LT(File::GetSize(m_filename), size_before / 2);
+
+  LinearDiskCache<u32, u8> cache;
+  EXPECT_EQ(65u, cache.Open(m_filename, "test"));
+  for (u32 key = 0; key <= 64; key++)
+  {
+    u32 size;
+    const u8* data = cache.Lookup(key, &size);
+    ASSERT_NE(nullptr, data);
+    EXPECT_EQ(key < 64 ? 3 : 4, data[0]);
+  }
+}
@@ -4,12 +4,16 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <array>
 #include <bitset>
+#include <random>
 #include <string>
+#include <tuple>
+#include <vector>
 
 #include "Common/FileUtil.h"
-#include "Core/Config/Config.h"
+#include "Common/Config/Config.h"
 #include "Core/ConfigManager.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
@@ -346,3 +350,176 @@ TEST(CoreTiming, Overclocking)
   SConfig::GetInstance().m_OCFactor = 1.0;
   AdvanceAndCheck(4, MAX_SLICE_LENGTH);
 }
+
+namespace DifferentialTest
+{
+constexpr int EVENT_TYPES = 64;
+static std::vector<CoreTiming::EventType*> s_types;
+static std::vector<std::pair<u64, s64>> s_fired;
+
+// The callbacks reschedule themselves two times out of three, like most of the hardware timers
+static bool Reschedules(size_t fired_index)
+{
+  return fired_index % 3 != 0;
+}
+
+static s64 ReschedulePeriod(size_t fired_index)
+{
+  return 100 + static_cast<s64>(fired_index * 7919 % 50000);
+}
+
+static void RecordCallback(u64 userdata, s64 lateness)
+{
+  const size_t index = s_fired.size();
+  s_fired.emplace_back(userdata, lateness);
+  if (Reschedules(index))
+    CoreTiming::ScheduleEvent(ReschedulePeriod(index) - lateness, s_types[userdata], userdata);
+}
+
+// What CoreTiming is expected to do, on a sorted list of the pending events
+class ReferenceQueue
+{
+public:
+  void Schedule(s64 cycles, u64 type)
+  {
+    const s64 now = m_global_timer + m_slice_length - m_downcount;
+    const s64 clamped = std::max<s64>(0, cycles);
+    if (m_downcount > clamped)
+    {
+      m_slice_length -= m_downcount - clamped;
+      m_downcount = clamped;
+    }
+    Insert(now + cycles, type);
+  }
+
+  void Remove(u64 type)
+  {
+    m_events.erase(std::remove_if(m_events.begin(), m_events.end(),
+                                  [type](const Event& e) { return e.type == type; }),
+                   m_events.end());
+  }
+
+  void Execute(s64 cycles) { m_downcount -= cycles; }
+
+  void Advance()
+  {
+    m_global_timer += m_slice_length - m_downcount;
+    while (!m_events.empty() && m_events.front().time <= m_global_timer)
+    {
+      const Event event = m_events.front();
+      m_events.erase(m_events.begin());
+      const s64 lateness = m_global_timer - event.time;
+      const size_t index = m_fired.size();
+      m_fired.emplace_back(event.type, lateness);
+      if (Reschedules(index))
+        Insert(m_global_timer + ReschedulePeriod(index) - lateness, event.type);
+    }
+    m_slice_length = MAX_SLICE_LENGTH;
+    if (!m_events.empty())
+      m_slice_length = std::min<s64>(m_events.front().time - m_global_timer, MAX_SLICE_LENGTH);
+    m_downcount = m_slice_length;
+  }
+
+  s64 GetDowncount() const { return m_downcount; }
+  const std::vector<std::pair<u64, s64>>& GetFired() const { return m_fired; }
+
+private:
+  struct Event
+  {
+    s64 time;
+    u64 fifo_order;
+    u64 type;
+  };
+
+  void Insert(s64 time, u64 type)
+  {
+    const Event event{time, m_fifo_order++, type};
+    auto it = std::upper_bound(m_events.begin(), m_events.end(), event,
+                               [](const Event& left, const Event& right) {
+                                 return std::tie(left.time, left.fifo_order) <
+                                        std::tie(right.time, right.fifo_order);
+                               });
+    m_events.insert(it, event);
+  }
+
+  std::vector<Event> m_events;
+  std::vector<std::pair<u64, s64>> m_fired;
+  s64 m_global_timer = 0;
+  s64 m_slice_length = MAX_SLICE_LENGTH;
+  s64 m_downcount = MAX_SLICE_LENGTH;
+  u64 m_fifo_order = 0;
+};
+}
+
+// Random schedules, removals, partial slices and advances must fire the same callbacks in the
+// same order and with the same lateness as a plain sorted queue
+TEST(CoreTiming, MatchesReferenceQueue)
+{
+  using namespace DifferentialTest;
+
+  ScopeInit guard;
+
+  s_types.clear();
+  s_fired.clear();
+  for (int i = 0; i < EVENT_TYPES; ++i)
+    s_types.push_back(CoreTiming::RegisterEvent("random" + std::to_string(i), RecordCallback));
+
+  // Enter slice 0
+  CoreTiming::Advance();
+  ReferenceQueue reference;
+  reference.Advance();
+
+  std::mt19937 rng(0);
+  for (int i = 0; i < 200000; ++i)
+  {
+    const u64 type = rng() % EVENT_TYPES;
+    switch (rng() % 8)
+    {
+    case 0:
+    case 1:
+    case 2:
+    {
+      // Mostly near events, some far enough to go through the upper levels of the wheel, and a
+      // few in the past
+      s64 cycles = rng() % 30000;
+      if (rng() % 16 == 0)
+        cycles = rng() % (1 << 28);
+      else if (rng() % 64 == 0)
+        cycles = -static_cast<s64>(rng() % 1000);
+      CoreTiming::ScheduleEvent(cycles, s_types[type], type);
+      reference.Schedule(cycles, type);
+      break;
+    }
+    case 3:
+      CoreTiming::RemoveEvent(s_types[type]);
+      reference.Remove(type);
+      break;
+    case 4:
+    {
+      // Part of the slice, sometimes a bit more than all of it
+      const s64 cycles = rng() % (std::max<s64>(reference.GetDowncount(), 0) + 100);
+      PowerPC::ppcState.downcount -= static_cast<int>(cycles);
+      reference.Execute(cycles);
+      break;
+    }
+    default:
+      // The end of the slice, or past it
+      if (reference.GetDowncount() > 0)
+      {
+        PowerPC::ppcState.downcount = 0;
+        reference.Execute(reference.GetDowncount());
+      }
+      CoreTiming::Advance();
+      reference.Advance();
+      break;
+    }
+    ASSERT_EQ(reference.GetDowncount(), PowerPC::ppcState.downcount) << "operation " << i;
+  }
+
+  EXPECT_LT(10000u, s_fired.size());
+  ASSERT_EQ(reference.GetFired().size(), s_fired.size());
+  for (size_t i = 0; i < s_fired.size(); ++i)
+  {
+    ASSERT_EQ(reference.GetFired()[i], s_fired[i]) << "callback " << i;
+  }
+}
@@ -0,0 +1,198 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Core/NetPlayPadFrames.h"
+#include "Core/NetPlayProto.h"
+#include "InputCommon/GCPadStatus.h"
+
+using NetPlay::PadFrames;
+using NetPlay::PadFramesEntry;
+
+// Every frame gets a pad state that tells which frame it is
+static GCPadStatus MakePad(FrameNum frame)
+{
+  GCPadStatus pad = {};
+  pad.button = static_cast<u16>(frame);
+  pad.stickX = static_cast<u8>(frame >> 16);
+  pad.triggerRight = static_cast<u8>(frame * 7);
+  return pad;
+}
+
+static FrameNum PadFrame(const GCPadStatus& pad)
+{
+  return pad.button | (pad.stickX << 16);
+}
+
+static PadFramesEntry MakeEntry(FrameNum first, u32 count)
+{
+  PadFramesEntry entry;
+  entry.map = 0;
+  entry.first = first;
+  for (FrameNum frame = first; frame < first + count; frame++)
+    entry.pads.push_back(MakePad(frame));
+  return entry;
+}
+
+static void PushFrames(PadFrames* frames, FrameNum end)
+{
+  for (FrameNum frame = frames->End(); frame < end; frame++)
+    frames->Push(MakePad(frame));
+}
+
+// Goes through a NP_MSG_PAD_FRAMES packet like it does on the network
+static std::vector<PadFramesEntry> RoundTrip(u8 entry_count, const sf::Packet& entries)
+{
+  sf::Packet packet = NetPlay::MakePadFramesPacket(entry_count, entries);
+  MessageId mid = 0;
+  packet >> mid;
+  EXPECT_EQ(NP_MSG_PAD_FRAMES, mid);
+  std::vector<PadFramesEntry> result;
+  EXPECT_TRUE(NetPlay::ReadPadFramesEntries(packet, &result));
+  return result;
+}
+
+TEST(PadFrames, RedundantEntriesOnlyAddNewFrames)
+{
+  PadFrames frames;
+  std::vector<FrameNum> received;
+  const auto on_new = [&received](const GCPadStatus& pad) { received.push_back(PadFrame(pad)); };
+
+  // Each packet repeats the frames of the previous ones
+  EXPECT_TRUE(frames.Receive(MakeEntry(0, 3), on_new));
+  EXPECT_TRUE(frames.Receive(MakeEntry(1, 4), on_new));
+  EXPECT_TRUE(frames.Receive(MakeEntry(2, 4), on_new));
+  EXPECT_EQ(6u, frames.End());
+
+  // A late packet, or the same one twice, adds nothing
+  EXPECT_TRUE(frames.Receive(MakeEntry(0, 2), on_new));
+  EXPECT_TRUE(frames.Receive(MakeEntry(2, 4), on_new));
+  EXPECT_TRUE(frames.Receive(MakeEntry(6, 0), on_new));
+  EXPECT_EQ(6u, frames.End());
+
+  ASSERT_EQ(6u, received.size());
+  for (FrameNum frame = 0; frame < 6; frame++)
+  {
+    EXPECT_EQ(frame, received[frame]);
+    EXPECT_EQ(frame, PadFrame(frames.Get(frame)));
+  }
+}
+
+TEST(PadFrames, GapIsRequestedOnce)
+{
+  PadFrames frames;
+  PushFrames(&frames, 10);
+
+  // Frames 10 and 11 were lost, the entry is dropped until they come
+  EXPECT_FALSE(frames.Receive(MakeEntry(12, 3)));
+  EXPECT_EQ(10u, frames.End());
+  EXPECT_TRUE(frames.TakeRequest());
+  EXPECT_FALSE(frames.Receive(MakeEntry(13, 3)));
+  EXPECT_FALSE(frames.TakeRequest());
+
+  // The answer fills the gap, and the following packets are accepted again
+  EXPECT_TRUE(frames.Receive(MakeEntry(10, 4)));
+  EXPECT_TRUE(frames.Receive(MakeEntry(13, 3)));
+  EXPECT_EQ(16u, frames.End());
+  for (FrameNum frame = 0; frame < 16; frame++)
+    EXPECT_EQ(frame, PadFrame(frames.Get(frame)));
+
+  // A new gap gets a new request
+  EXPECT_FALSE(frames.Receive(MakeEntry(20, 1)));
+  EXPECT_TRUE(frames.TakeRequest());
+
+  // Cleared for the next game
+  frames.Clear();
+  EXPECT_EQ(0u, frames.End());
+  EXPECT_FALSE(frames.Receive(MakeEntry(1, 1)));
+  EXPECT_TRUE(frames.TakeRequest());
+}
+
+TEST(PadFrames, EntriesSurvivePackets)
+{
+  PadFrames sender;
+  PushFrames(&sender, 600);
+
+  // More than an entry holds
+  sf::Packet entries;
+  const u8 entry_count = sender.WriteEntries(entries, 2, 0);
+  EXPECT_EQ(3, entry_count);
+  const std::vector<PadFramesEntry> received = RoundTrip(entry_count, entries);
+  ASSERT_EQ(3u, received.size());
+
+  PadFrames receiver;
+  for (const PadFramesEntry& entry : received)
+  {
+    EXPECT_EQ(2, entry.map);
+    EXPECT_TRUE(receiver.Receive(entry));
+  }
+  EXPECT_EQ(600u, receiver.End());
+  for (FrameNum frame = 0; frame < 600; frame++)
+    EXPECT_EQ(frame, PadFrame(receiver.Get(frame)));
+
+  // The newest frames, as sent with every pad state
+  sf::Packet newest;
+  EXPECT_EQ(1, sender.WriteNewest(newest, 2, 4));
+  const std::vector<PadFramesEntry> newest_received = RoundTrip(1, newest);
+  ASSERT_EQ(1u, newest_received.size());
+  EXPECT_EQ(596u, newest_received[0].first);
+  EXPECT_EQ(4u, newest_received[0].pads.size());
+}
+
+TEST(PadFrames, TruncatedPacketIsRejected)
+{
+  PadFrames sender;
+  PushFrames(&sender, 8);
+  sf::Packet entries;
+  const u8 entry_count = sender.WriteEntries(entries, 0, 0);
+  sf::Packet packet = NetPlay::MakePadFramesPacket(entry_count, entries);
+
+  sf::Packet truncated;
+  truncated.append(packet.getData(), packet.getDataSize() - 1);
+  MessageId mid = 0;
+  truncated >> mid;
+  std::vector<PadFramesEntry> result;
+  EXPECT_FALSE(NetPlay::ReadPadFramesEntries(truncated, &result));
+}
+
+TEST(PadFrames, HistoryOverrun)
+{
+  PadFrames sender;
+  const FrameNum end = PadFrames::HISTORY_SIZE * 2 + 5;
+  PushFrames(&sender, end);
+  const FrameNum oldest = end - PadFrames::HISTORY_SIZE;
+
+  // The oldest frames are overwritten, asking for them can't be answered
+  EXPECT_TRUE(sender.HasFrom(oldest));
+  EXPECT_TRUE(sender.HasFrom(end));
+  EXPECT_FALSE(sender.HasFrom(oldest - 1));
+  EXPECT_FALSE(sender.HasFrom(0));
+  for (FrameNum frame = oldest; frame < end; frame++)
+    ASSERT_EQ(frame, PadFrame(sender.Get(frame)));
+
+  // What is written starts at the oldest kept frame
+  sf::Packet entries;
+  const u8 entry_count = sender.WriteEntries(entries, 0, 0);
+  const std::vector<PadFramesEntry> received = RoundTrip(entry_count, entries);
+  ASSERT_FALSE(received.empty());
+  EXPECT_EQ(oldest, received[0].first);
+  EXPECT_EQ(oldest, PadFrame(received[0].pads[0]));
+
+  // so a receiver that is further behind can't fill its gap with it
+  PadFrames receiver;
+  PushFrames(&receiver, 3);
+  EXPECT_FALSE(receiver.Receive(received[0]));
+  EXPECT_EQ(3u, receiver.End());
+  EXPECT_TRUE(receiver.TakeRequest());
+  EXPECT_FALSE(sender.HasFrom(receiver.End()));
+
+  // A short game keeps everything
+  PadFrames short_game;
+  PushFrames(&short_game, PadFrames::HISTORY_SIZE);
+  EXPECT_TRUE(short_game.HasFrom(0));
+}
@@ -0,0 +1,98 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "InputCommon/ControllerInterface/ControllerInterface.h"
+#include "InputCommon/ControllerInterface/Pipes/Pipes.h"
+
+using ciface::Pipes::PipeDevice;
+
+namespace
+{
+class PipesTest : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    // The device reads until the pipe is empty
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    m_write_fd = fds[1];
+    // Closes the read end
+    m_device = std::make_unique<PipeDevice>(fds[0], "Test");
+  }
+
+  void TearDown() override { close(m_write_fd); }
+
+  void Write(const std::vector<u8>& bytes)
+  {
+    ASSERT_EQ(static_cast<ssize_t>(bytes.size()), write(m_write_fd, bytes.data(), bytes.size()));
+  }
+
+  double State(const std::string& input) const
+  {
+    return m_device->FindInput(input)->GetState();
+  }
+
+  int m_write_fd = -1;
+  std::unique_ptr<PipeDevice> m_device;
+};
+
+// A at bit 0, B at bit 1, START at bit 5, sticks centered and triggers released
+std::vector<u8> Packet(u16 buttons, u8 main_x)
+{
+  return {ciface::Pipes::BINARY_MAGIC, 0, static_cast<u8>(buttons), static_cast<u8>(buttons >> 8),
+          main_x, 128, 128, 128, 0, 0, 0, 0};
+}
+}  // namespace
+
+TEST_F(PipesTest, AppliesPackets)
+{
+  Write(Packet(1 << 0, 255));
+  m_device->UpdateInput();
+  EXPECT_EQ(1.0, State("Button A"));
+  EXPECT_EQ(0.0, State("Button B"));
+  EXPECT_EQ(1.0, State("Axis MAIN X +"));
+
+  Write(Packet(1 << 1, 128));
+  m_device->UpdateInput();
+  EXPECT_EQ(0.0, State("Button A"));
+  EXPECT_EQ(1.0, State("Button B"));
+}
+
+TEST_F(PipesTest, SkipsCorruptedPackets)
+{
+  Write(Packet(0, 128));
+  m_device->UpdateInput();
+
+  // A reserved byte that isn't 0, a button bit past the list and an unknown flag
+  std::vector<u8> reserved = Packet(1 << 5, 0);
+  reserved[10] = 0x55;
+  std::vector<u8> buttons = Packet(0x8000 | 1 << 5, 0);
+  std::vector<u8> flags = Packet(1 << 5, 0);
+  flags[1] = 0x80;
+  // Garbage in front and a packet cut short, the last packet must be found after them
+  std::vector<u8> stream{0x12, 0x34};
+  for (const auto* bad : {&reserved, &buttons, &flags})
+    stream.insert(stream.end(), bad->begin(), bad->end());
+  stream.insert(stream.end(), {ciface::Pipes::BINARY_MAGIC, 0, 0});
+  const std::vector<u8> good = Packet(1 << 0, 255);
+  stream.insert(stream.end(), good.begin(), good.end());
+
+  Write(stream);
+  m_device->UpdateInput();
+  EXPECT_EQ(1.0, State("Button A"));
+  EXPECT_EQ(0.0, State("Button START"));
+  EXPECT_EQ(1.0, State("Axis MAIN X +"));
+  EXPECT_EQ(0.0, State("Axis MAIN X -"));
+}
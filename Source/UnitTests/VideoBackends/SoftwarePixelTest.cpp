@@ -0,0 +1,104 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <array>
+#include <cstring>
+#include <memory>
+#include <random>
+
+#include <gtest/gtest.h>  // NOLINT
+
+#include "Common/CPUDetect.h"
+#include "Common/CommonTypes.h"
+#include "VideoBackends/Software/EfbInterface.h"
+#include "VideoBackends/Software/Tev.h"
+#include "VideoCommon/BPMemory.h"
+
+namespace
+{
+constexpr int PIXEL_COUNT = 200000;
+
+// Random stages, alpha test and blending, without textures, fog or depth
+void RandomizeState(std::mt19937* rng)
+{
+  // BPMemory's bitfields can't be assigned, the registers are cleared as raw memory
+  std::memset(static_cast<void*>(&bpmem), 0, sizeof(bpmem));
+  bpmem.genMode.numcolchans = 2;
+  bpmem.genMode.numtevstages = (*rng)() % 16;
+  for (TevStageCombiner& combiner : bpmem.combiners)
+  {
+    combiner.colorC.hex = (*rng)() & 0xffffff;
+    combiner.alphaC.hex = (*rng)() & 0xffffff;
+  }
+  for (TevKSel& ksel : bpmem.tevksel)
+    ksel.hex = (*rng)() & 0xffffff;
+  bpmem.alpha_test.hex = (*rng)() & 0xffffff;
+  bpmem.blendmode.hex = (*rng)() & 0xffffff;
+  bpmem.dstalpha.hex = (*rng)() & 0x1ff;
+  bpmem.zcontrol.pixel_format = ((*rng)() & 1) ? PEControl::RGBA6_Z24 : PEControl::RGB8_Z24;
+}
+
+void RandomizePixel(std::mt19937* rng, Tev* tev)
+{
+  for (int reg = 0; reg < 4; reg++)
+  {
+    for (int comp = 0; comp < 4; comp++)
+    {
+      // The registers hold 11 bit signed values
+      tev->SetRegColor(reg, comp, false, static_cast<s16>((*rng)() % 2048) - 1024);
+      tev->SetRegColor(reg, comp, true, static_cast<s16>((*rng)() % 256));
+    }
+  }
+  for (auto& color : tev->Color)
+  {
+    for (u8& comp : color)
+      comp = static_cast<u8>((*rng)());
+  }
+  tev->Position[0] = (*rng)() % EFB_WIDTH;
+  tev->Position[1] = (*rng)() % EFB_HEIGHT;
+  tev->Position[2] = (*rng)() & 0xffffff;
+}
+
+std::array<u8, 3> DrawPixel(Tev* tev, const std::array<u8, 3>& initial, bool simd)
+{
+  Tev::SetSIMDEnabled(simd);
+  EfbInterface::SetSIMDEnabled(simd);
+
+  u8* pixel = EfbInterface::GetPixelPointer(tev->Position[0], tev->Position[1], false);
+  std::memcpy(pixel, initial.data(), initial.size());
+  tev->Draw();
+
+  std::array<u8, 3> result;
+  std::memcpy(result.data(), pixel, result.size());
+  return result;
+}
+}
+
+TEST(SoftwarePixel, SIMDMatchesGeneric)
+{
+  if (!cpu_info.bSSE4_1)
+    return;
+
+  std::mt19937 rng(0x5eed);
+  std::unique_ptr<Tev> tev = std::make_unique<Tev>();
+  tev->Init();
+
+  for (int i = 0; i < PIXEL_COUNT; i++)
+  {
+    // The same state is kept for a few pixels, as in a draw
+    if (i % 16 == 0)
+      RandomizeState(&rng);
+    RandomizePixel(&rng, tev.get());
+    const std::array<u8, 3> initial = {{static_cast<u8>(rng()), static_cast<u8>(rng()),
+                                        static_cast<u8>(rng())}};
+
+    const std::array<u8, 3> generic = DrawPixel(tev.get(), initial, false);
+    const std::array<u8, 3> simd = DrawPixel(tev.get(), initial, true);
+    ASSERT_EQ(generic, simd) << "pixel " << i << ", stages " << bpmem.genMode.numtevstages + 1
+                             << ", blend mode " << std::hex << bpmem.blendmode.hex;
+  }
+
+  Tev::SetSIMDEnabled(true);
+  EfbInterface::SetSIMDEnabled(true);
+}
@@ -0,0 +1,178 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <array>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>  // NOLINT
+
+#include "Common/CommonTypes.h"
+#include "VideoBackends/Software/EfbInterface.h"
+#include "VideoBackends/Software/NativeVertexFormat.h"
+#include "VideoBackends/Software/Rasterizer.h"
+#include "VideoCommon/BPMemory.h"
+
+namespace
+{
+constexpr int BATCH_COUNT = 8;
+constexpr int TRIANGLES_PER_BATCH = 24;
+// The color and the depth buffer
+constexpr size_t EFB_BYTES = EFB_WIDTH * EFB_HEIGHT * 6;
+
+struct Batch
+{
+  // BPMemory's bitfields can't be assigned, it is copied as the raw registers
+  std::array<u8, sizeof(BPMemory)> state;
+  s16 regs[4][4][2];
+  std::vector<OutputVertexData> vertices;
+};
+
+// Covers the whole EFB
+void SetFullScissor()
+{
+  bpmem.scissorOffset.x = 342 / 2;
+  bpmem.scissorOffset.y = 342 / 2;
+  bpmem.scissorTL.x = 342;
+  bpmem.scissorTL.y = 342;
+  bpmem.scissorBR.x = 341 + EFB_WIDTH;
+  bpmem.scissorBR.y = 341 + EFB_HEIGHT;
+}
+
+// Random stages, alpha test, depth test and blending, without textures or fog
+void RandomizeState(std::mt19937* rng)
+{
+  std::memset(static_cast<void*>(&bpmem), 0, sizeof(bpmem));
+  bpmem.genMode.numcolchans = 1;
+  bpmem.genMode.numtevstages = (*rng)() % 4;
+  for (TevStageCombiner& combiner : bpmem.combiners)
+  {
+    combiner.colorC.hex = (*rng)() & 0xffffff;
+    combiner.alphaC.hex = (*rng)() & 0xffffff;
+  }
+  for (TevKSel& ksel : bpmem.tevksel)
+    ksel.hex = (*rng)() & 0xffffff;
+  // Mostly passing, so that the batches draw something
+  bpmem.alpha_test.hex = ((*rng)() & 0xffff) | (7 << 16) | (7 << 19) | (((*rng)() & 1) << 22);
+  bpmem.blendmode.hex = (*rng)() & 0xffffff;
+  bpmem.blendmode.colorupdate = 1;
+  bpmem.zmode.hex = (*rng)() & 0x1f;
+  bpmem.zcontrol.pixel_format = ((*rng)() & 1) ? PEControl::RGBA6_Z24 : PEControl::RGB8_Z24;
+  SetFullScissor();
+}
+
+float RandomCoordinate(std::mt19937* rng, int size)
+{
+  // Some vertices are off screen, so the triangles reach the EFB edges
+  return static_cast<float>(static_cast<int>((*rng)() % (size + 80)) - 40) +
+         static_cast<float>((*rng)() % 16) / 16.0f;
+}
+
+OutputVertexData RandomVertex(std::mt19937* rng)
+{
+  OutputVertexData vertex;
+  vertex.screenPosition.x = RandomCoordinate(rng, EFB_WIDTH);
+  vertex.screenPosition.y = RandomCoordinate(rng, EFB_HEIGHT);
+  vertex.screenPosition.z = static_cast<float>((*rng)() & 0xffffff);
+  vertex.projectedPosition.w = 1.0f;
+  for (u8& comp : vertex.color[0])
+    comp = static_cast<u8>((*rng)());
+  return vertex;
+}
+
+// Each batch has thin triangles over the last and first columns, which are next to each other
+// in the EFB at the end of a row, and large ones over many tile seams
+std::vector<Batch> MakeBatches(std::mt19937* rng)
+{
+  std::vector<Batch> batches(BATCH_COUNT);
+  for (Batch& batch : batches)
+  {
+    RandomizeState(rng);
+    std::memcpy(batch.state.data(), &bpmem, sizeof(BPMemory));
+    for (auto& reg : batch.regs)
+    {
+      for (auto& comp : reg)
+      {
+        // The registers hold 11 bit signed values
+        comp[0] = static_cast<s16>((*rng)() % 2048) - 1024;
+        comp[1] = static_cast<s16>((*rng)() % 256);
+      }
+    }
+
+    for (int i = 0; i < TRIANGLES_PER_BATCH; i++)
+    {
+      for (int j = 0; j < 3; j++)
+        batch.vertices.push_back(RandomVertex(rng));
+      if (i % 4 == 0)
+      {
+        const float edge = (i % 8 == 0) ? EFB_WIDTH - 2.5f : 1.5f;
+        for (size_t j = batch.vertices.size() - 3; j < batch.vertices.size(); j++)
+          batch.vertices[j].screenPosition.x = edge + static_cast<float>((*rng)() % 32) / 8.0f - 2;
+      }
+    }
+  }
+  return batches;
+}
+
+std::vector<u8> DrawBatches(const std::vector<Batch>& batches, const std::vector<u8>& initial,
+                            bool tiles)
+{
+  Rasterizer::SetTilesEnabled(tiles);
+  u8* efb = EfbInterface::GetPixelPointer(0, 0, false);
+  std::memcpy(efb, initial.data(), EFB_BYTES);
+
+  for (const Batch& batch : batches)
+  {
+    std::memcpy(static_cast<void*>(&bpmem), batch.state.data(), sizeof(BPMemory));
+    Rasterizer::SetScissor();
+    for (int reg = 0; reg < 4; reg++)
+    {
+      for (int comp = 0; comp < 4; comp++)
+      {
+        Rasterizer::SetTevReg(reg, comp, false, batch.regs[reg][comp][0]);
+        Rasterizer::SetTevReg(reg, comp, true, batch.regs[reg][comp][1]);
+      }
+    }
+
+    // Only one winding is drawn
+    std::vector<OutputVertexData> vertices = batch.vertices;
+    for (size_t i = 0; i < vertices.size(); i += 3)
+    {
+      Rasterizer::DrawTriangleFrontFace(&vertices[i], &vertices[i + 1], &vertices[i + 2]);
+      Rasterizer::DrawTriangleFrontFace(&vertices[i], &vertices[i + 2], &vertices[i + 1]);
+    }
+    Rasterizer::Flush();
+  }
+
+  return std::vector<u8>(efb, efb + EFB_BYTES);
+}
+}
+
+TEST(SoftwareRasterizer, TilesMatchSerial)
+{
+  Rasterizer::Init();
+  std::mt19937 rng(0x711e5);
+  const std::vector<Batch> batches = MakeBatches(&rng);
+  std::vector<u8> initial(EFB_BYTES);
+  for (u8& byte : initial)
+    byte = static_cast<u8>(rng());
+
+  const std::vector<u8> serial = DrawBatches(batches, initial, false);
+  ASSERT_NE(initial, serial);
+
+  // Races between threads don't show up on every run
+  for (int run = 0; run < 4; run++)
+  {
+    const std::vector<u8> tiled = DrawBatches(batches, initial, true);
+    for (size_t i = 0; i < EFB_BYTES; i++)
+    {
+      const size_t pixel = (i % (EFB_BYTES / 2)) / 3;
+      ASSERT_EQ(serial[i], tiled[i]) << "run " << run << (i < EFB_BYTES / 2 ? ", color" : ", depth")
+                                     << " at " << pixel % EFB_WIDTH << "," << pixel / EFB_WIDTH;
+    }
+  }
+
+  Rasterizer::SetTilesEnabled(true);
+}
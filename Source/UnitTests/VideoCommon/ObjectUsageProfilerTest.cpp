@@ -0,0 +1,64 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>  // NOLINT
+
+#include "Common/CommonTypes.h"
+#include "Common/FileUtil.h"
+#include "VideoCommon/ObjectUsageProfiler.h"
+
+namespace
+{
+using Profiler = ObjectUsageProfiler<u32, pKey_t, int, std::hash<u32>>;
+constexpr pKey_t VERSION = 1;
+constexpr pKey_t GAME = 42;
+
+std::vector<u32> Predict(Profiler* profiler, u32 object)
+{
+  std::vector<u32> predicted;
+  profiler->ForEachPredicted(object, 3, [&](const u32& item, int&) { predicted.push_back(item); });
+  return predicted;
+}
+}
+
+TEST(ObjectUsageProfiler, PredictsFromPreviousSession)
+{
+  const std::string dir = File::CreateTempDir();
+  const std::string path = dir + "/test.usage";
+
+  {
+    Profiler profiler(VERSION);
+    profiler.SetCategory(GAME);
+    profiler.BeginSession();
+    for (u32 object : {3, 1, 2})
+      profiler.GetOrAdd(object);
+    profiler.PersistToFile(path);
+  }
+
+  Profiler profiler(VERSION);
+  profiler.ReadFromFile(path);
+  profiler.SetCategory(GAME);
+  // Nothing is recorded before the session starts
+  profiler.GetOrAdd(4);
+  profiler.BeginSession();
+
+  profiler.GetOrAdd(3);
+  // In the order of their first use, without the object already used
+  EXPECT_EQ(std::vector<u32>({1, 2}), Predict(&profiler, 3));
+  // Each scene is only predicted once
+  EXPECT_TRUE(Predict(&profiler, 1).empty());
+  // Never used in a session
+  EXPECT_TRUE(Predict(&profiler, 4).empty());
+
+  profiler.GetOrAdd(1);
+  profiler.GetOrAdd(5);
+  EXPECT_EQ("3 first uses, 1 predicted before use (33.3%), 2 predictions (50.0% used)",
+            profiler.GetPredictionStats());
+
+  File::DeleteDirRecursively(dir);
+}
@@ -0,0 +1,102 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <climits>
+#include <cstdarg>
+#include <string>
+
+#include <gtest/gtest.h>  // NOLINT
+
+#include "Common/StringUtil.h"
+#include "VideoCommon/ShaderGenCommon.h"
+
+namespace
+{
+// Without the format attribute of Write, for the formats the compiler would warn about
+void WriteFormat(ShaderCode* code, const char* fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  code->WriteV(fmt, args);
+  va_end(args);
+}
+
+// Appends after some earlier code, to check that the fallback only replaces its own fragment
+::testing::AssertionResult WritesLikePrintf(const char* fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  va_list expected_args;
+  va_copy(expected_args, args);
+
+  ShaderCode code;
+  code.Write("prefix;");
+  code.WriteV(fmt, args);
+  const std::string expected = "prefix;" + StringFromFormatV(fmt, expected_args);
+
+  va_end(expected_args);
+  va_end(args);
+  if (expected == code.data())
+    return ::testing::AssertionSuccess();
+  return ::testing::AssertionFailure() << "\"" << code.data() << "\" instead of \"" << expected
+                                       << "\"";
+}
+}
+
+TEST(ShaderCode, ConstantText)
+{
+  EXPECT_TRUE(WritesLikePrintf(""));
+  EXPECT_TRUE(WritesLikePrintf("float4 col0 = float4(0.0, 0.0, 0.0, 0.0);\n"));
+}
+
+TEST(ShaderCode, Integers)
+{
+  EXPECT_TRUE(WritesLikePrintf("%d", 0));
+  EXPECT_TRUE(WritesLikePrintf("%d", INT_MIN));
+  EXPECT_TRUE(WritesLikePrintf("%i", INT_MAX));
+  EXPECT_TRUE(WritesLikePrintf("x[%d] = %i;", -1, 12345));
+  EXPECT_TRUE(WritesLikePrintf("%u", 0u));
+  EXPECT_TRUE(WritesLikePrintf("%u", UINT_MAX));
+  EXPECT_TRUE(WritesLikePrintf("%x", 0u));
+  EXPECT_TRUE(WritesLikePrintf("%x", UINT_MAX));
+  EXPECT_TRUE(WritesLikePrintf("0x%x", 0xabcdefu));
+}
+
+TEST(ShaderCode, StringsAndCharacters)
+{
+  EXPECT_TRUE(WritesLikePrintf("%s", "tex"));
+  EXPECT_TRUE(WritesLikePrintf("%s%s", "", "samp"));
+  EXPECT_TRUE(WritesLikePrintf("%s", static_cast<const char*>(nullptr)));
+  EXPECT_TRUE(WritesLikePrintf("rgb%c", 'a'));
+  EXPECT_TRUE(WritesLikePrintf("100%% %s", "done"));
+}
+
+TEST(ShaderCode, Fallback)
+{
+  EXPECT_TRUE(WritesLikePrintf("%s %d %.5f", "scale", 3, 0.125));
+  EXPECT_TRUE(WritesLikePrintf("%s = %08x;", "mask", 0xffu));
+  EXPECT_TRUE(WritesLikePrintf("%d %ld", -7, 1234567890L));
+  EXPECT_TRUE(WritesLikePrintf("%-4s|", "ab"));
+}
+
+// printf leaves it undefined, it is written as is
+TEST(ShaderCode, TrailingPercent)
+{
+  ShaderCode code;
+  WriteFormat(&code, "%s = 50%", "ratio");
+  EXPECT_STREQ("ratio = 50%", code.data());
+}
+
+TEST(ShaderCode, ClearKeepsCapacity)
+{
+  ShaderCode code;
+  for (int i = 0; i < 10000; i++)
+    code.Write("line %d\n", i);
+  const char* data = code.data();
+  code.clear();
+  EXPECT_EQ(0, code.size());
+  code.Write("%s", "short");
+  EXPECT_STREQ("short", code.data());
+  EXPECT_EQ(data, code.data());
+}
@@ -0,0 +1,104 @@
+// Copyright 2017 Dolphin Emulator Project
+// Licensed under GPLv2+
+// Refer to the license.txt file included.
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>  // NOLINT
+
+#include "Common/Common.h"
+#include "Common/ThreadPool.h"
+#include "VideoCommon/TextureScalerCommon.h"
+#include "VideoCommon/VideoConfig.h"
+
+namespace
+{
+constexpr int TEX_WIDTH = 256;
+constexpr int TEX_HEIGHT = 256;
+
+struct ScalerFilter
+{
+  const char* name;
+  int type;
+  bool deposterize;
+};
+
+const ScalerFilter s_filters[] = {
+    {"xBRZ", TextureScaler::XBRZ, false},
+    {"Hybrid", TextureScaler::HYBRID, false},
+    {"Bicubic", TextureScaler::BICUBIC, false},
+    {"HybridBicubic", TextureScaler::HYBRID_BICUBIC, false},
+    {"Jinc", TextureScaler::JINC, false},
+    {"JincSharper", TextureScaler::JINC_SHARPER, false},
+    {"Smoothstep", TextureScaler::SMOOTHSTEP, false},
+    {"ThreePoint", TextureScaler::THREE_POINT, false},
+    {"DDT", TextureScaler::DDT, false},
+    {"DDTSharp", TextureScaler::DDT_SHARP, false},
+    {"Deposterize+xBRZ", TextureScaler::XBRZ, true},
+};
+
+// Posterized gradients with some noise, close enough to real game textures
+std::vector<u32> MakeTexture()
+{
+  std::vector<u32> texture(TEX_WIDTH * TEX_HEIGHT);
+  std::mt19937 rng(0x1234);
+  for (int y = 0; y < TEX_HEIGHT; ++y)
+  {
+    for (int x = 0; x < TEX_WIDTH; ++x)
+    {
+      u32 r = (x & 0xF0) | (rng() & 3);
+      u32 g = (y & 0xF0) | (rng() & 3);
+      u32 b = ((x ^ y) & 0xE0);
+      u32 a = ((x / 16 + y / 16) & 1) ? 0xFF : 0x80;
+      texture[y * TEX_WIDTH + x] = (a << 24) | (b << 16) | (g << 8) | r;
+    }
+  }
+  return texture;
+}
+
+void SelectFilter(const ScalerFilter& filter, int factor)
+{
+  g_ActiveConfig.iTexScalingType = filter.type;
+  g_ActiveConfig.iTexScalingFactor = factor;
+  g_ActiveConfig.bTexDeposterize = filter.deposterize;
+}
+}  // namespace
+
+TEST(TextureScaler, ParallelMatchesSerial)
+{
+  std::vector<u32> texture = MakeTexture();
+  TextureScaler scaler;
+  for (const ScalerFilter& filter : s_filters)
+  {
+    for (int factor = 2; factor <= 5; ++factor)
+    {
+      SelectFilter(filter, factor);
+      size_t out_size = TEX_WIDTH * TEX_HEIGHT * factor * factor;
+
+      scaler.SetMaxThreads(1);
+      std::vector<u32> serial(out_size);
+      std::memcpy(serial.data(), scaler.Scale(texture.data(), TEX_WIDTH, TEX_HEIGHT),
+                  out_size * sizeof(u32));
+
+      scaler.SetMaxThreads(0);
+      const u32* parallel = scaler.Scale(texture.data(), TEX_WIDTH, TEX_HEIGHT);
+      EXPECT_EQ(0, std::memcmp(serial.data(), parallel, out_size * sizeof(u32)))
+          << filter.name << " x" << factor;
+    }
+  }
+}
+
+TEST(TextureScaler, LoopCoversRangeOnce)
+{
+  std::vector<int> hits(1000);
+  Common::LoopWorker::Loop(
+      [&](int l, int u) {
+        for (int i = l; i < u; ++i)
+          hits[i]++;
+      },
+      10, 990, 7);
+  for (int i = 0; i < 1000; ++i)
+    EXPECT_EQ(i >= 10 && i < 990 ? 1 : 0, hits[i]) << i;
+}